@@ -880,6 +880,7 @@ extern cvar_t *cg_flashWindowCount;
 
 #define CG_Malloc( size ) trap_MemAlloc( size, __FILE__, __LINE__ )
 #define CG_Free( data ) trap_MemFree( data, __FILE__, __LINE__ )
+#define CG_FrameMalloc( size ) trap_MemFrameAlloc( size, __FILE__, __LINE__ )
 
 int CG_API( void );
 void CG_Init(	const char *serverName, unsigned int playerNum,
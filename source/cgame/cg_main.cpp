@@ -1012,7 +1012,6 @@ void CG_Init( const char *serverName, unsigned int playerNum,
 	cgs.hasGametypeMenu = false; // this will update as soon as we receive configstrings
 
 	CG_RegisterVariables();
-	CG_InitTemporaryBoneposesCache();
 	CG_PModelsInit();
 
 	CG_ScreenInit();
@@ -30,7 +30,7 @@ typedef unsigned int (*cg_get_raw_samples_cb_t)(void*);
 
 // cg_public.h -- client game dll information visible to engine
 
-#define	CGAME_API_VERSION   73
+#define	CGAME_API_VERSION   74
 
 //
 // structs and variables shared with the main engine
@@ -240,6 +240,7 @@ typedef struct
 	// managed memory allocation
 	void *( *Mem_Alloc )( size_t size, const char *filename, int fileline );
 	void ( *Mem_Free )( void *data, const char *filename, int fileline );
+	void *( *Mem_FrameAlloc )( size_t size, const char *filename, int fileline ); // valid until the next client frame
 
 	// l10n
 	void ( *L10n_ClearDomain )( void );
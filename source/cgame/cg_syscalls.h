@@ -613,6 +613,11 @@ static inline void trap_MemFree( void *data, const char *filename, int fileline
 	CGAME_IMPORT.Mem_Free( data, filename, fileline );
 }
 
+static inline void *trap_MemFrameAlloc( size_t size, const char *filename, int fileline )
+{
+	return CGAME_IMPORT.Mem_FrameAlloc( size, filename, fileline );
+}
+
 static inline void trap_AsyncStream_UrlEncode( const char *src, char *dst, size_t size )
 {
 	CGAME_IMPORT.AsyncStream_UrlEncode( src, dst, size );
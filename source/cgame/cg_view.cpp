@@ -1074,7 +1074,5 @@ void CG_RenderView( float frameTime, float realFrameTime, int realTime, unsigned
 
 	CG_Draw2D();
 
-	CG_ResetTemporaryBoneposesCache(); // clear for next frame
-
 	cg.viewFrameCount++;
 }
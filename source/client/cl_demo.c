@@ -272,6 +272,11 @@ void CL_DemoCompleted( void )
 	Mem_ZoneFree( cls.demo.name );
 	cls.demo.name = NULL;
 
+	Mem_ZoneFree( cls.demo.keyframes );
+	cls.demo.keyframes = NULL;
+	Mem_ZoneFree( cls.demo.configstrings );
+	cls.demo.configstrings = NULL;
+
 	Com_SetDemoPlaying( false );
 
 	CL_PauseDemo( false );
@@ -409,6 +414,101 @@ static void CL_StartDemo( const char *demoname )
 	Mem_TempFree( servername );
 }
 
+/*
+* CL_ReadDemoKeyframes
+* 
+* Reads the keyframe index from demo meta data
+*/
+void CL_ReadDemoKeyframes( void )
+{
+	unsigned int numKeyframes;
+
+	Mem_ZoneFree( cls.demo.keyframes );
+	cls.demo.keyframes = NULL;
+	cls.demo.numKeyframes = 0;
+
+	numKeyframes = SNAP_ReadDemoMetaKeyframes( cls.demo.meta_data, cls.demo.meta_data_realsize, NULL, 0 );
+	if( !numKeyframes )
+		return;
+
+	cls.demo.keyframes = Mem_ZoneMalloc( numKeyframes * sizeof( *cls.demo.keyframes ) );
+	cls.demo.numKeyframes = SNAP_ReadDemoMetaKeyframes( cls.demo.meta_data, cls.demo.meta_data_realsize,
+		cls.demo.keyframes, numKeyframes );
+}
+
+/*
+* CL_DemoPrecache
+* 
+* Keyframes only carry configstrings changed since precache, so keep a copy to seek from
+*/
+void CL_DemoPrecache( void )
+{
+	if( !cls.demo.configstrings )
+		cls.demo.configstrings = Mem_ZoneMalloc( sizeof( cl.configstrings ) );
+	memcpy( cls.demo.configstrings, cl.configstrings, sizeof( cl.configstrings ) );
+}
+
+/*
+* CL_DemoKeyframeForTime
+* 
+* Returns the last keyframe at or before the given time
+*/
+static const snap_demokeyframe_t *CL_DemoKeyframeForTime( unsigned int serverTime )
+{
+	int l, r, m;
+
+	if( !cls.demo.configstrings || !cls.demo.numKeyframes )
+		return NULL;
+
+	l = 0;
+	r = cls.demo.numKeyframes - 1;
+	if( cls.demo.keyframes[0].serverTime > serverTime )
+		return NULL;
+
+	while( l < r )
+	{
+		m = ( l + r + 1 ) / 2;
+		if( cls.demo.keyframes[m].serverTime <= serverTime )
+			l = m;
+		else
+			r = m - 1;
+	}
+
+	return &cls.demo.keyframes[l];
+}
+
+/*
+* CL_DemoSeekKeyframe
+* 
+* Positions the demo at the given keyframe and brings configstrings back to the state
+* the keyframe was recorded against
+*/
+static bool CL_DemoSeekKeyframe( const snap_demokeyframe_t *keyframe )
+{
+	int i;
+	const char *configstring;
+
+	if( FS_Seek( demofilehandle, keyframe->offset, FS_SEEK_SET ) < 0 )
+		return false;
+
+	cl.currentSnapNum = cl.receivedSnapNum = 0;
+
+	for( i = 0; i < MAX_CONFIGSTRINGS; i++ )
+	{
+		configstring = cls.demo.configstrings + i * MAX_CONFIGSTRING_CHARS;
+		if( strcmp( configstring, cl.configstrings[i] ) )
+		{
+			Q_strncpyz( cl.configstrings[i], configstring, sizeof( cl.configstrings[i] ) );
+			CL_GameModule_ConfigString( i, configstring );
+		}
+	}
+
+	CL_GameModule_Reset();
+	CL_SoundModule_StopAllSounds( false, false );
+
+	return true;
+}
+
 /*
 * CL_DemoComplete
 */
@@ -471,6 +571,8 @@ void CL_DemoJump_f( void )
 	bool relative;
 	int time;
 	char *p;
+	bool seeked;
+	const snap_demokeyframe_t *keyframe;
 
 	if( !cls.demo.playing )
 	{
@@ -518,7 +620,16 @@ void CL_DemoJump_f( void )
 
 	CL_AdjustServerTime( 1 );
 
-	if( cl.serverTime < cl.snapShots[cl.receivedSnapNum&UPDATE_MASK].serverTime )
+	// jump to the closest keyframe unless it's quicker to keep reading from here
+	seeked = false;
+	keyframe = CL_DemoKeyframeForTime( cl.serverTime );
+	if( keyframe && ( cl.serverTime < cl.snapShots[cl.receivedSnapNum&UPDATE_MASK].serverTime ||
+		keyframe->serverTime > cl.snapShots[cl.receivedSnapNum&UPDATE_MASK].serverTime ) )
+	{
+		seeked = CL_DemoSeekKeyframe( keyframe );
+	}
+
+	if( !seeked && cl.serverTime < cl.snapShots[cl.receivedSnapNum&UPDATE_MASK].serverTime )
 	{
 		demofilelen = demofilelentotal;
 		FS_Seek( demofilehandle, 0, FS_SEEK_SET );
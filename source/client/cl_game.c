@@ -531,6 +531,7 @@ void CL_GameModule_Init( void )
 
 	import.Mem_Alloc = CL_GameModule_MemAlloc;
 	import.Mem_Free = CL_GameModule_MemFree;
+	import.Mem_FrameAlloc = _Mem_FrameAlloc;
 
 	import.L10n_LoadLangPOFile = &CL_GameModule_L10n_LoadLangPOFile;
 	import.L10n_TranslateString = &CL_GameModule_L10n_TranslateString;
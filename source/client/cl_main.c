@@ -224,15 +224,22 @@ static void CL_Quit_f( void )
 */
 static void CL_SendConnectPacket( void )
 {
+	char userinfo[MAX_INFO_STRING];
+
 	userinfo_modified = false;
 
+	// tell the server which compression methods and snapshot encodings we can decode
+	Q_strncpyz( userinfo, Cvar_Userinfo(), sizeof( userinfo ) );
+	Info_SetValueForKey( userinfo, NETCHAN_COMPRESSION_KEY, va( "%i", Netchan_CompressionMethods() ) );
+	Info_SetValueForKey( userinfo, SNAP_ENCODING_KEY, va( "%i", SNAP_ENCODING_BITPACKED ) );
+
 	Com_DPrintf("CL_MM_Initialized: %d, cls.mm_ticket: %u\n", CL_MM_Initialized(), cls.mm_ticket );
 	if( CL_MM_Initialized() && cls.mm_ticket != 0 )
 		Netchan_OutOfBandPrint( cls.socket, &cls.serveraddress, "connect %i %i %i \"%s\" %i %u\n",
-				APP_PROTOCOL_VERSION, Netchan_GamePort(), cls.challenge, Cvar_Userinfo(), 0, cls.mm_ticket );
+				APP_PROTOCOL_VERSION, Netchan_GamePort(), cls.challenge, userinfo, 0, cls.mm_ticket );
 	else
 		Netchan_OutOfBandPrint( cls.socket, &cls.serveraddress, "connect %i %i %i \"%s\" %i\n",
-				APP_PROTOCOL_VERSION, Netchan_GamePort(), cls.challenge, Cvar_Userinfo(), 0 );
+				APP_PROTOCOL_VERSION, Netchan_GamePort(), cls.challenge, userinfo, 0 );
 }
 
 /*
@@ -1178,6 +1185,8 @@ static void CL_ConnectionlessPacket( const socket_t *socket, const netadr_t *add
 		Q_strncpyz( cls.session, MSG_ReadStringLine( msg ), sizeof( cls.session ) );
 
 		Netchan_Setup( &cls.netchan, socket, address, Netchan_GamePort() );
+		// servers that don't know about negotiated compression send no method
+		cls.netchan.compression = atoi( MSG_ReadStringLine( msg ) );
 		memset( cl.configstrings, 0, sizeof( cl.configstrings ) );
 		CL_SetClientState( CA_HANDSHAKE );
 		CL_AddReliableCommand( "new" );
@@ -1337,7 +1346,7 @@ static bool CL_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	MSG_ReadLong( msg ); // sequence_ack
 	if( msg->compressed )
 	{
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( msg, netchan->compression );
 		if( zerror < 0 )
 		{
 			// compression error. Drop the packet
@@ -1760,6 +1769,8 @@ void CL_Precache_f( void )
 
 		cls.demo.play_ignore_next_frametime = true;
 
+		CL_DemoPrecache();
+
 		return;
 	}
 
@@ -2426,7 +2437,7 @@ void CL_Netchan_Transmit( msg_t *msg )
 	// do not enable client compression until I fix the compression+fragmentation rare case bug
 	if( ( cl_compresspackets->integer && msg->cursize > 60 ) || cl_compresspackets->integer > 1 )
 	{
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( msg, cls.netchan.compression );
 		if( zerror < 0 ) // it's compression error, just send uncompressed
 		{
 			Com_DPrintf( "CL_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
@@ -1093,6 +1093,10 @@ static void CL_UpdateConfigString( int idx, const char *s )
 		return;
 	}
 
+	// demo keyframes resend configstrings, don't bother cgame with the ones it already has
+	if( cls.demo.playing && !cls.demo.play_jump && !strncmp( cl.configstrings[idx], s, sizeof( cl.configstrings[idx] ) - 1 ) )
+		return;
+
 	Q_strncpyz( cl.configstrings[idx], s, sizeof( cl.configstrings[idx] ) );
 
 	// allow cgame to update it too
@@ -1319,6 +1323,8 @@ void CL_ParseServerMessage( msg_t *msg )
 
 				MSG_ReadData( msg, cls.demo.meta_data, cls.demo.meta_data_realsize );
 				MSG_SkipData( msg, meta_data_maxsize - cls.demo.meta_data_realsize );
+
+				CL_ReadDemoKeyframes();
 			}
 			break;
 
@@ -192,6 +192,10 @@ typedef struct
 
 	char meta_data[SNAP_MAX_DEMO_META_DATA_SIZE];
 	size_t meta_data_realsize;
+
+	snap_demokeyframe_t *keyframes;	// full snapshots demojump can seek to
+	unsigned int numKeyframes;
+	char *configstrings;			// configstrings at precache, restored when seeking to a keyframe
 } cl_demo_t;
 
 typedef cl_demo_t demorec_t;
@@ -531,6 +535,8 @@ void CL_PauseDemo_f( void );
 void CL_DemoJump_f( void );
 void CL_BeginDemoAviDump( void );
 size_t CL_ReadDemoMetaData( const char *demopath, char *meta_data, size_t meta_data_size );
+void CL_ReadDemoKeyframes( void );
+void CL_DemoPrecache( void );
 char **CL_DemoComplete( const char *partial );
 #define CL_WriteAvi() ( cls.demo.avi && cls.state == CA_ACTIVE && cls.demo.playing && !cls.demo.play_jump )
 #define CL_SetDemoMetaKeyValue(k,v) cls.demo.meta_data_realsize = SNAP_SetDemoMetaKeyValue(cls.demo.meta_data, sizeof(cls.demo.meta_data), cls.demo.meta_data_realsize, k, v)
@@ -27,9 +27,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //
 //==========================================
 
-static short int alist[MAX_NODES];  //list contains all studied nodes, Open and Closed together
-static int alist_numNodes;
-
 enum
 {
 	NOLIST,
@@ -44,10 +41,21 @@ typedef struct
 	int H;
 
 	short int list;
+	short int heapIndex;	// position in the open heap while in the open list
 
+	unsigned int generation; // the fields above are only valid if this matches astarGeneration
 } astarnode_t;
 
-astarnode_t astarnodes[MAX_NODES];
+static astarnode_t astarnodes[MAX_NODES];
+static unsigned int astarGeneration;
+
+// binary min-heap of the open list, ordered by F = G + H
+static short int openHeap[MAX_NODES];
+static int openHeap_numNodes;
+
+// searched nodes per game frame
+static unsigned int astarBudgetFrame;
+static int astarBudgetUsed;
 
 struct astarpath_s *Apath;
 //==========================================
@@ -66,9 +74,17 @@ static int ValidLinksMask;
 //
 //==========================================
 
+static inline int AStar_NodeList( int node )
+{
+	if( astarnodes[node].generation != astarGeneration )
+		return NOLIST;
+
+	return astarnodes[node].list;
+}
+
 int AStar_nodeIsInClosed( int node )
 {
-	if( astarnodes[node].list == CLOSEDLIST )
+	if( AStar_NodeList( node ) == CLOSEDLIST )
 		return 1;
 
 	return 0;
@@ -76,7 +92,7 @@ int AStar_nodeIsInClosed( int node )
 
 int AStar_nodeIsInOpen( int node )
 {
-	if( astarnodes[node].list == OPENLIST )
+	if( AStar_NodeList( node ) == OPENLIST )
 		return 1;
 
 	return 0;
@@ -84,28 +100,93 @@ int AStar_nodeIsInOpen( int node )
 
 static void AStar_InitLists( void )
 {
-	memset( astarnodes, 0, sizeof( astarnodes ) ); //jabot092
+	// invalidate the state of all nodes at once, clearing only when the counter wraps
+	astarGeneration++;
+	if( !astarGeneration )
+	{
+		memset( astarnodes, 0, sizeof( astarnodes ) );
+		astarGeneration = 1;
+	}
+
 	if( Apath ) Apath->numNodes = 0;
-	alist_numNodes = 0;
+	openHeap_numNodes = 0;
 }
 
-static int AStar_PLinkDistance( int n1, int n2 )
+static inline int AStar_F( int node )
 {
-	int i;
+	return astarnodes[node].G + astarnodes[node].H;
+}
 
-	//teleporters are exceptional
-	//if( nodes[n1].flags & NODEFLAGS_TELEPORTER_IN )
-	//	n1++; //it's tele out is stored in the next node in the array
+static inline void AStar_HeapSet( int index, int node )
+{
+	openHeap[index] = node;
+	astarnodes[node].heapIndex = index;
+}
+
+static void AStar_HeapUp( int index )
+{
+	int node = openHeap[index];
+	int F = AStar_F( node );
 
-	for( i = 0; i < pLinks[n1].numLinks; i++ )
+	while( index > 0 )
 	{
-		if( pLinks[n1].nodes[i] == n2 )
-		{
-			return (int)pLinks[n1].dist[i];
-		}
+		int parent = ( index - 1 ) >> 1;
+		if( AStar_F( openHeap[parent] ) <= F )
+			break;
+
+		AStar_HeapSet( index, openHeap[parent] );
+		index = parent;
 	}
 
-	return -1;
+	AStar_HeapSet( index, node );
+}
+
+static void AStar_HeapDown( int index )
+{
+	int node = openHeap[index];
+	int F = AStar_F( node );
+
+	while( true )
+	{
+		int child = ( index << 1 ) + 1;
+		if( child >= openHeap_numNodes )
+			break;
+
+		if( child + 1 < openHeap_numNodes && AStar_F( openHeap[child + 1] ) < AStar_F( openHeap[child] ) )
+			child++;
+		if( F <= AStar_F( openHeap[child] ) )
+			break;
+
+		AStar_HeapSet( index, openHeap[child] );
+		index = child;
+	}
+
+	AStar_HeapSet( index, node );
+}
+
+static void AStar_HeapPush( int node )
+{
+	AStar_HeapSet( openHeap_numNodes, node );
+	openHeap_numNodes++;
+	AStar_HeapUp( openHeap_numNodes - 1 );
+}
+
+static int AStar_HeapPop( void )
+{
+	int best;
+
+	if( !openHeap_numNodes )
+		return -1;
+
+	best = openHeap[0];
+	openHeap_numNodes--;
+	if( openHeap_numNodes )
+	{
+		AStar_HeapSet( 0, openHeap[openHeap_numNodes] );
+		AStar_HeapDown( 0 );
+	}
+
+	return best;
 }
 
 static int  Astar_HDist_ManhatanGuess( int node )
@@ -133,12 +214,7 @@ static int  Astar_HDist_ManhatanGuess( int node )
 
 static void AStar_PutInClosed( int node )
 {
-	if( !astarnodes[node].list )
-	{
-		alist[alist_numNodes] = node;
-		alist_numNodes++;
-	}
-
+	astarnodes[node].generation = astarGeneration;
 	astarnodes[node].list = CLOSEDLIST;
 }
 
@@ -149,6 +225,7 @@ static void AStar_PutAdjacentsInOpen( int node )
 	for( i = 0; i < pLinks[node].numLinks; i++ )
 	{
 		int addnode;
+		int G;
 
 		//ignore invalid links
 		if( !( ValidLinksMask & pLinks[node].moveType[i] ) )
@@ -160,81 +237,37 @@ static void AStar_PutAdjacentsInOpen( int node )
 		if( addnode == node )
 			continue;
 
-		//ignore if it's already in closed list
-		if( AStar_nodeIsInClosed( addnode ) )
-			continue;
+		G = astarnodes[node].G + (int)pLinks[node].dist[i];
 
-		//if it's already inside open list
-		if( AStar_nodeIsInOpen( addnode ) )
+		switch( AStar_NodeList( addnode ) )
 		{
-			int plinkDist;
+		case CLOSEDLIST:
+			//ignore if it's already in closed list
+			break;
 
-			plinkDist = AStar_PLinkDistance( node, addnode );
-			if( plinkDist != -1 )
+		case OPENLIST:
+			//compare G distances and choose best parent
+			if( astarnodes[addnode].G > G )
 			{
-				//compare G distances and choose best parent
-				if( astarnodes[addnode].G > ( astarnodes[node].G + plinkDist ) )
-				{
-					astarnodes[addnode].parent = node;
-					astarnodes[addnode].G = astarnodes[node].G + plinkDist;
-				}
-			}
-		}
-		else
-		{
-			//just put it in
-
-			int plinkDist;
-
-			plinkDist = AStar_PLinkDistance( node, addnode );
-			if( plinkDist == -1 )
-			{
-				plinkDist = AStar_PLinkDistance( addnode, node );
-				if( plinkDist == -1 )
-					plinkDist = 999; //jalFIXME
-
-				//ERROR
-				//printf("WARNING: AStar_PutAdjacentsInOpen - Couldn't find distance between nodes\n");
-			}
-
-			//put in global list
-			if( !astarnodes[addnode].list )
-			{
-				alist[alist_numNodes] = addnode;
-				alist_numNodes++;
+				astarnodes[addnode].parent = node;
+				astarnodes[addnode].G = G;
+				AStar_HeapUp( astarnodes[addnode].heapIndex );
 			}
+			break;
 
+		default:
+			//just put it in
+			astarnodes[addnode].generation = astarGeneration;
 			astarnodes[addnode].parent = node;
-			astarnodes[addnode].G = astarnodes[node].G + plinkDist;
+			astarnodes[addnode].G = G;
 			astarnodes[addnode].H = Astar_HDist_ManhatanGuess( addnode );
 			astarnodes[addnode].list = OPENLIST;
+			AStar_HeapPush( addnode );
+			break;
 		}
 	}
 }
 
-static int AStar_FindInOpen_BestF( void )
-{
-	int i;
-	int bestF = -1;
-	int best = -1;
-
-	for( i = 0; i < alist_numNodes; i++ )
-	{
-		int node = alist[i];
-
-		if( astarnodes[node].list != OPENLIST )
-			continue;
-
-		if( bestF == -1 || bestF > ( astarnodes[node].G + astarnodes[node].H ) )
-		{
-			bestF = astarnodes[node].G + astarnodes[node].H;
-			best = node;
-		}
-	}
-	//printf("BEST:%i\n", best);
-	return best;
-}
-
 static void AStar_ListsToPath( void )
 {
 	int count = 0;
@@ -259,12 +292,13 @@ static int AStar_FillLists( void )
 {
 	//put current node inside closed list
 	AStar_PutInClosed( currentNode );
+	astarBudgetUsed++;
 
 	//put adjacent nodes inside open list
 	AStar_PutAdjacentsInOpen( currentNode );
 
 	//find best adjacent and make it our current
-	currentNode = AStar_FindInOpen_BestF();
+	currentNode = AStar_HeapPop();
 
 	return ( currentNode != -1 ); //if -1 path is blocked
 }
@@ -277,10 +311,19 @@ int AStar_ResolvePath( int n1, int n2, int movetypes )
 
 	AStar_InitLists();
 
+	// the origin is closed first, so the goal could never make it to the open list
+	if( n1 == n2 )
+		return 0;
+
 	originNode = n1;
 	goalNode = n2;
 	currentNode = originNode;
 
+	astarnodes[originNode].generation = astarGeneration;
+	astarnodes[originNode].list = NOLIST;
+	astarnodes[originNode].G = 0;
+	astarnodes[originNode].H = 0;
+
 	while( !AStar_nodeIsInOpen( goalNode ) )
 	{
 		if( !AStar_FillLists() )
@@ -292,6 +335,23 @@ int AStar_ResolvePath( int n1, int n2, int movetypes )
 	return 1;
 }
 
+/*
+* AStar_HasPathBudget
+*
+* Returns false once the searches of this frame have visited more nodes than bot_pathbudget
+* allows, so that optional searches can be postponed to the next frame.
+*/
+bool AStar_HasPathBudget( void )
+{
+	if( astarBudgetFrame != level.framenum )
+	{
+		astarBudgetFrame = level.framenum;
+		astarBudgetUsed = 0;
+	}
+
+	return bot_pathbudget->integer <= 0 || astarBudgetUsed < bot_pathbudget->integer;
+}
+
 int AStar_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path )
 {
 	Apath = path;
@@ -299,6 +359,9 @@ int AStar_GetPath( int origin, int goal, int movetypes, struct astarpath_s *path
 	if( goal < 0 )
 		return 0;
 
+	// account the search to this frame
+	AStar_HasPathBudget();
+
 	if( !AStar_ResolvePath( origin, goal, movetypes ) )
 		return 0;
 
@@ -33,6 +33,7 @@ extern cvar_t *bot_showcombat;
 extern cvar_t *bot_showsrgoal;
 extern cvar_t *bot_showlrgoal;
 extern cvar_t *bot_dummy;
+extern cvar_t *bot_pathbudget;
 extern cvar_t *sv_botpersonality;
 
 //----------------------------------------------------------
@@ -340,6 +341,8 @@ bool    AI_IsStep( edict_t *ent );
 // ai_navigation.c
 //----------------------------------------------------------
 int	    AI_FindCost( int from, int to, int movetypes );
+void AI_BuildNodeGrid( void );
+void AI_InvalidateNodeGrid( void );
 int	    AI_FindClosestReachableNode( vec3_t origin, edict_t *passent, int range, unsigned int flagsmask );
 int	    AI_FindClosestNode( vec3_t origin, float mindist, int range, unsigned int flagsmask );
 void	    AI_SetGoal( edict_t *self, int goal_node );
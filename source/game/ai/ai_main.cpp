@@ -40,6 +40,7 @@ void AI_InitLevel( void )
 	bot_showsrgoal = trap_Cvar_Get( "bot_showsrgoal", "0", 0 );
 	bot_showlrgoal = trap_Cvar_Get( "bot_showlrgoal", "0", 0 );
 	bot_dummy = trap_Cvar_Get( "bot_dummy", "0", 0 );
+	bot_pathbudget = trap_Cvar_Get( "bot_pathbudget", "4096", CVAR_ARCHIVE );
 	sv_botpersonality =	    trap_Cvar_Get( "sv_botpersonality", "0", CVAR_ARCHIVE );
 
 	nav.debugMode = false;
@@ -328,6 +329,10 @@ void AI_PickLongRangeGoal( edict_t *self )
 		return;
 	}
 
+	// other bots have already searched enough nodes this frame, try again in the next one
+	if( !AStar_HasPathBudget() )
+		return;
+
 	self->ai->longRangeGoalTimeout = level.time + AI_LONG_RANGE_GOAL_DELAY + brandom( 0, 1000 );
 
 	// look for a target
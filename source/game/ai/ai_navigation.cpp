@@ -38,12 +38,176 @@ int AI_FindCost( int from, int to, int movetypes )
 	return path.totalDistance;
 }
 
-int AI_FindClosestReachableNode( vec3_t origin, edict_t *passent, int range, unsigned int flagsmask )
+//==========================================
+// Node grid
+// Nodes are bucketed into a 2D grid of columns so nearest-node
+// queries only look at the cells overlapping their search range.
+// The grid is rebuilt lazily whenever the node count changes.
+//==========================================
+
+#define NODEGRID_CELLSIZE   ( NODE_DENSITY * 2 )
+#define NODEGRID_MAXDIM	    64
+
+typedef struct
 {
-	int i;
-	float closest;
+	int numIndexed;         // nav.num_nodes when the grid was built, -1 if dirty
+	vec2_t mins;
+	float cellSize;
+	int dims[2];
+	int cellStart[NODEGRID_MAXDIM * NODEGRID_MAXDIM + 1];
+	short cellNodes[MAX_NODES];
+} nav_nodegrid_t;
+
+typedef struct
+{
+	float dist;
+	int node;
+} nav_candidate_t;
+
+static nav_nodegrid_t nodegrid = { -1 };
+static nav_candidate_t candidates[MAX_NODES];
+
+/*
+* AI_InvalidateNodeGrid
+*/
+void AI_InvalidateNodeGrid( void )
+{
+	nodegrid.numIndexed = -1;
+}
+
+/*
+* AI_NodeGridCell
+*/
+static inline int AI_NodeGridCell( float v, int axis )
+{
+	int c = (int)( ( v - nodegrid.mins[axis] ) / nodegrid.cellSize );
+	return bound( 0, c, nodegrid.dims[axis] - 1 );
+}
+
+/*
+* AI_BuildNodeGrid
+*/
+void AI_BuildNodeGrid( void )
+{
+	int i, j, cell, numCells;
+	vec2_t maxs;
+	float size;
+
+	nodegrid.numIndexed = nav.num_nodes;
+	nodegrid.cellSize = NODEGRID_CELLSIZE;
+	nodegrid.dims[0] = nodegrid.dims[1] = 1;
+	Vector2Set( nodegrid.mins, 0, 0 );
+	nodegrid.cellStart[0] = nodegrid.cellStart[1] = 0;
+	if( !nav.num_nodes )
+		return;
+
+	Vector2Set( nodegrid.mins, nodes[0].origin[0], nodes[0].origin[1] );
+	Vector2Set( maxs, nodes[0].origin[0], nodes[0].origin[1] );
+	for( i = 1; i < nav.num_nodes; i++ )
+	{
+		for( j = 0; j < 2; j++ )
+		{
+			if( nodes[i].origin[j] < nodegrid.mins[j] )
+				nodegrid.mins[j] = nodes[i].origin[j];
+			if( nodes[i].origin[j] > maxs[j] )
+				maxs[j] = nodes[i].origin[j];
+		}
+	}
+
+	// grow the cells on huge maps instead of the grid
+	size = max( maxs[0] - nodegrid.mins[0], maxs[1] - nodegrid.mins[1] );
+	while( size / nodegrid.cellSize >= NODEGRID_MAXDIM )
+		nodegrid.cellSize *= 2;
+
+	for( j = 0; j < 2; j++ )
+		nodegrid.dims[j] = (int)( ( maxs[j] - nodegrid.mins[j] ) / nodegrid.cellSize ) + 1;
+	numCells = nodegrid.dims[0] * nodegrid.dims[1];
+
+	// counting sort, nodes keep ascending order inside each cell
+	memset( nodegrid.cellStart, 0, sizeof( int ) * ( numCells + 1 ) );
+	for( i = 0; i < nav.num_nodes; i++ )
+	{
+		cell = AI_NodeGridCell( nodes[i].origin[1], 1 ) * nodegrid.dims[0] + AI_NodeGridCell( nodes[i].origin[0], 0 );
+		nodegrid.cellStart[cell + 1]++;
+	}
+	for( i = 0; i < numCells; i++ )
+		nodegrid.cellStart[i + 1] += nodegrid.cellStart[i];
+	for( i = 0; i < nav.num_nodes; i++ )
+	{
+		cell = AI_NodeGridCell( nodes[i].origin[1], 1 ) * nodegrid.dims[0] + AI_NodeGridCell( nodes[i].origin[0], 0 );
+		nodegrid.cellNodes[nodegrid.cellStart[cell]++] = i;
+	}
+	for( i = numCells; i > 0; i-- )
+		nodegrid.cellStart[i] = nodegrid.cellStart[i - 1];
+	nodegrid.cellStart[0] = 0;
+}
+
+/*
+* AI_GatherNodeCandidates
+* Collect the nodes matching flagsmask with mindist < dist < range
+*/
+static int AI_GatherNodeCandidates( vec3_t origin, float mindist, float range, unsigned int flagsmask )
+{
+	int x, y, i, node;
+	int mincell[2], maxcell[2];
+	int numCandidates = 0;
 	float dist;
-	int node = -1;
+
+	if( nodegrid.numIndexed != nav.num_nodes )
+		AI_BuildNodeGrid();
+	if( !nav.num_nodes )
+		return 0;
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( origin[i] + range < nodegrid.mins[i] || origin[i] - range > nodegrid.mins[i] + nodegrid.dims[i] * nodegrid.cellSize )
+			return 0;
+		mincell[i] = AI_NodeGridCell( origin[i] - range, i );
+		maxcell[i] = AI_NodeGridCell( origin[i] + range, i );
+	}
+
+	for( y = mincell[1]; y <= maxcell[1]; y++ )
+	{
+		for( x = mincell[0]; x <= maxcell[0]; x++ )
+		{
+			const int cell = y * nodegrid.dims[0] + x;
+
+			for( i = nodegrid.cellStart[cell]; i < nodegrid.cellStart[cell + 1]; i++ )
+			{
+				node = nodegrid.cellNodes[i];
+				if( flagsmask != NODE_ALL && !( nodes[node].flags & flagsmask ) )
+					continue;
+
+				dist = DistanceFast( nodes[node].origin, origin );
+				if( dist > mindist && dist < range )
+				{
+					candidates[numCandidates].dist = dist;
+					candidates[numCandidates].node = node;
+					numCandidates++;
+				}
+			}
+		}
+	}
+
+	return numCandidates;
+}
+
+/*
+* AI_CandidateCmp
+*/
+static int AI_CandidateCmp( const void *p1, const void *p2 )
+{
+	const nav_candidate_t *c1 = ( const nav_candidate_t * )p1;
+	const nav_candidate_t *c2 = ( const nav_candidate_t * )p2;
+
+	if( c1->dist != c2->dist )
+		return c1->dist < c2->dist ? -1 : 1;
+	return c1->node - c2->node;
+}
+
+int AI_FindClosestReachableNode( vec3_t origin, edict_t *passent, int range, unsigned int flagsmask )
+{
+	int i, best, numCandidates;
 	trace_t	tr;
 	vec3_t maxs, mins;
 
@@ -57,53 +221,46 @@ int AI_FindClosestReachableNode( vec3_t origin, edict_t *passent, int range, uns
 		VectorCopy( vec3_origin, mins );
 	}
 
-	closest = range;
+	numCandidates = AI_GatherNodeCandidates( origin, -1, range, flagsmask );
+	if( !numCandidates )
+		return NODE_INVALID;
 
-	for( i = 0; i < nav.num_nodes; i++ )
+	// the first visible candidate in distance order is the closest one,
+	// usually only a couple of them need tracing so select instead of sorting
+	while( numCandidates > 0 )
 	{
-		if( flagsmask == NODE_ALL || nodes[i].flags & flagsmask )
+		best = 0;
+		for( i = 1; i < numCandidates; i++ )
 		{
-			dist = DistanceFast( nodes[i].origin, origin );
-
-			if( dist < closest )
-			{
-				// make sure it is visible
-				G_Trace( &tr, origin, mins, maxs, nodes[i].origin, passent, MASK_NODESOLID );
-				if( tr.fraction == 1.0 )
-				{
-					node = i;
-					closest = dist;
-				}
-			}
+			if( AI_CandidateCmp( &candidates[i], &candidates[best] ) < 0 )
+				best = i;
 		}
+
+		G_Trace( &tr, origin, mins, maxs, nodes[candidates[best].node].origin, passent, MASK_NODESOLID );
+		if( tr.fraction == 1.0 )
+			return candidates[best].node;
+
+		candidates[best] = candidates[--numCandidates];
 	}
-	return node;
+
+	return NODE_INVALID;
 }
 
 int AI_FindClosestNode( vec3_t origin, float mindist, int range, unsigned int flagsmask )
 {
-	int i;
-	float closest;
-	float dist;
-	int node = NODE_INVALID;
+	int i, numCandidates;
+	int best = -1;
 
 	if( mindist > range ) return -1;
 
-	closest = range;
-
-	for( i = 0; i < nav.num_nodes; i++ )
+	numCandidates = AI_GatherNodeCandidates( origin, mindist, range, flagsmask );
+	for( i = 0; i < numCandidates; i++ )
 	{
-		if( flagsmask == NODE_ALL || nodes[i].flags & flagsmask )
-		{
-			dist = DistanceFast( nodes[i].origin, origin );
-			if( dist > mindist && dist < closest )
-			{
-				node = i;
-				closest = dist;
-			}
-		}
+		if( best < 0 || AI_CandidateCmp( &candidates[i], &candidates[best] ) < 0 )
+			best = i;
 	}
-	return node;
+
+	return best < 0 ? NODE_INVALID : candidates[best].node;
 }
 
 void AI_ClearGoal( edict_t *self )
@@ -1222,6 +1222,7 @@ void AI_InitNavigationData( bool silent )
 	}
 
 	nav.serverNodesStart = nav.num_nodes;
+	AI_BuildNodeGrid();
 
 	if( developer->integer && !silent )
 	{
@@ -2183,6 +2183,7 @@ static asstring_t *objectGameEntity_getTargetname( edict_t *self )
 static void objectGameEntity_setTargetname( asstring_t *targetname, edict_t *self )
 {
 	self->targetname = G_RegisterLevelString( targetname->buffer );
+	G_EntityNamesChanged( self );
 }
 
 static asstring_t *objectGameEntity_getTarget( edict_t *self )
@@ -2208,6 +2209,7 @@ static asstring_t *objectGameEntity_getSoundName( edict_t *self )
 static void objectGameEntity_setClassname( asstring_t *classname, edict_t *self )
 {
 	self->classname = G_RegisterLevelString( classname->buffer );
+	G_EntityNamesChanged( self );
 }
 
 static void objectGameEntity_setMap( asstring_t *map, edict_t *self )
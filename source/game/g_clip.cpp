@@ -67,7 +67,7 @@ static areagrid_t g_areagrid;
 extern cvar_t *g_antilag;
 extern cvar_t *g_antilag_maxtimedelta;
 
-#define	CFRAME_UPDATE_BACKUP	64  // copies of entity_state_t to keep buffered (1 second of backup at 62 fps).
+#define	CFRAME_UPDATE_BACKUP	64  // collision frames to keep buffered (1 second of backup at 62 fps).
 #define	CFRAME_UPDATE_MASK	( CFRAME_UPDATE_BACKUP-1 )
 
 typedef struct c4clipedict_s
@@ -76,82 +76,119 @@ typedef struct c4clipedict_s
 	entity_shared_t	r;
 } c4clipedict_t;
 
-//backups of all server frames areas and edicts
-typedef struct c4frame_s
+// backups of the collision relevant parts of all edicts, one array per field
+// so backing up a frame only touches what antilag rewinds. Only inuse and
+// solid are stored for entities that can't be hit.
+typedef struct
 {
-	c4clipedict_t clipEdicts[MAX_EDICTS];   // fixme: there is a g_maxentities cvar. We have to adjust to it
-	int numedicts;
-
-	unsigned int timestamp;
-	unsigned int framenum;
-} c4frame_t;
-
-c4frame_t sv_collisionframes[CFRAME_UPDATE_BACKUP];
+	unsigned int timestamp[CFRAME_UPDATE_BACKUP];
+
+	bool inuse[CFRAME_UPDATE_BACKUP][MAX_EDICTS];
+	uint8_t solid[CFRAME_UPDATE_BACKUP][MAX_EDICTS];
+	vec3_t origin[CFRAME_UPDATE_BACKUP][MAX_EDICTS];
+	vec3_t angles[CFRAME_UPDATE_BACKUP][MAX_EDICTS];
+	vec3_t mins[CFRAME_UPDATE_BACKUP][MAX_EDICTS];
+	vec3_t maxs[CFRAME_UPDATE_BACKUP][MAX_EDICTS];
+	vec3_t absmin[CFRAME_UPDATE_BACKUP][MAX_EDICTS];
+	vec3_t absmax[CFRAME_UPDATE_BACKUP][MAX_EDICTS];
+
+	// first frame of the current run of identical inuse and solid values,
+	// entities can't be moved back past it
+	unsigned int changeFrame[MAX_EDICTS];
+	int numedicts;                  // high-water mark of game.numentities
+} c4history_t;
+
+static c4history_t sv_collisionhistory;
 static unsigned int sv_collisionFrameNum = 0;
 
+/*
+* GClip_IsAntilagged
+*/
+static inline bool GClip_IsAntilagged( int entNum, bool inuse, int solid )
+{
+	return inuse && solid != SOLID_NOT && ( solid != SOLID_TRIGGER || ( entNum >= 1 && entNum <= gs.maxclients ) );
+}
+
+/*
+* GClip_BackUpCollisionFrame
+*/
 void GClip_BackUpCollisionFrame( void )
 {
-	c4frame_t *cframe;
+	c4history_t *hist = &sv_collisionhistory;
 	edict_t	*svedict;
-	int i;
+	unsigned int cframe, prevframe;
+	int i, numedicts;
 
 	if( !g_antilag->integer )
 		return;
 
-	// fixme: should check for any validation here?
+	cframe = sv_collisionFrameNum & CFRAME_UPDATE_MASK;
+	prevframe = ( sv_collisionFrameNum - 1 ) & CFRAME_UPDATE_MASK;
+	hist->timestamp[cframe] = game.serverTime;
 
-	cframe = &sv_collisionframes[sv_collisionFrameNum & CFRAME_UPDATE_MASK];
-	cframe->timestamp = game.serverTime;
-	cframe->framenum = sv_collisionFrameNum;
-	sv_collisionFrameNum++;
-
-	//memset( cframe->clipEdicts, 0, sizeof(cframe->clipEdicts) );
+	// keep covering entities past game.numentities once they have been seen,
+	// so the stored inuse values never go stale
+	numedicts = max( game.numentities, hist->numedicts );
 
-	//backup edicts
-	for( i = 0; i < game.numentities; i++ )
+	for( i = 0; i < numedicts; i++ )
 	{
 		svedict = &game.edicts[i];
 
-		cframe->clipEdicts[i].r.inuse = svedict->r.inuse;
-		cframe->clipEdicts[i].r.solid = svedict->r.solid;
-		if( !svedict->r.inuse || svedict->r.solid == SOLID_NOT 
-			|| ( svedict->r.solid == SOLID_TRIGGER && !(i >= 1 && i <= gs.maxclients) ) )
+		hist->inuse[cframe][i] = i < game.numentities && svedict->r.inuse;
+		hist->solid[cframe][i] = svedict->r.solid;
+		if( !sv_collisionFrameNum || hist->inuse[cframe][i] != hist->inuse[prevframe][i]
+			|| hist->solid[cframe][i] != hist->solid[prevframe][i] )
+			hist->changeFrame[i] = sv_collisionFrameNum;
+
+		if( !GClip_IsAntilagged( i, hist->inuse[cframe][i], svedict->r.solid ) )
 			continue;
 
-		cframe->clipEdicts[i].r = svedict->r;
-		cframe->clipEdicts[i].s = svedict->s;
+		VectorCopy( svedict->s.origin, hist->origin[cframe][i] );
+		VectorCopy( svedict->s.angles, hist->angles[cframe][i] );
+		VectorCopy( svedict->r.mins, hist->mins[cframe][i] );
+		VectorCopy( svedict->r.maxs, hist->maxs[cframe][i] );
+		VectorCopy( svedict->r.absmin, hist->absmin[cframe][i] );
+		VectorCopy( svedict->r.absmax, hist->absmax[cframe][i] );
 	}
-	cframe->numedicts = game.numentities;
+	hist->numedicts = numedicts;
+
+	sv_collisionFrameNum++;
 }
 
+/*
+* GClip_GetClipEdictForDeltaTime
+*/
 static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime )
 {
 	static int index = 0;
 	static c4clipedict_t clipEnts[8];
 	static c4clipedict_t *clipent;
-	static c4clipedict_t clipentNewer; // for interpolation
-	c4frame_t *cframe = NULL;
-	unsigned int backTime, cframenum, bf, i;
+	const c4history_t *hist = &sv_collisionhistory;
+	unsigned int backTime, backTimestamp, oldest, newest, lo, hi, mid, cframe, cnewer, i;
 	edict_t	*ent = game.edicts + entNum;
 
 	// pick one of the 8 slots to prevent overwritings
 	clipent = &clipEnts[index];
 	index = ( index + 1 )&7;
 
-	if( !entNum || deltaTime >= 0 || !g_antilag->integer )
-	{                                                    // current time entity
-		clipent->r = ent->r;
-		clipent->s = ent->s;
+	// the parts that are not moved back in time always come from the current entity
+	clipent->r = ent->r;
+	clipent->s = ent->s;
+
+	if( !entNum || deltaTime >= 0 || !g_antilag->integer || !sv_collisionFrameNum )
+		return clipent;	// current time entity
+
+	if( !GClip_IsAntilagged( entNum, ent->r.inuse, ent->r.solid ) )
 		return clipent;
-	}
 
-	if( !ent->r.inuse || ent->r.solid == SOLID_NOT 
-		|| ( ent->r.solid == SOLID_TRIGGER && !(entNum >= 1 && entNum <= gs.maxclients) ) )
-	{
-		clipent->r = ent->r;
-		clipent->s = ent->s;
+	// if solid has changed since the last backup we can't move it backwards at all
+	newest = sv_collisionFrameNum - 1;
+	if( entNum >= hist->numedicts || ent->r.inuse != hist->inuse[newest & CFRAME_UPDATE_MASK][entNum] 
+		|| ent->r.solid != hist->solid[newest & CFRAME_UPDATE_MASK][entNum] )
 		return clipent;
-	}
+
+	oldest = newest >= CFRAME_UPDATE_BACKUP - 2 ? newest - ( CFRAME_UPDATE_BACKUP - 2 ) : 0;
+	oldest = max( oldest, hist->changeFrame[entNum] );
 
 	// clamp delta time inside the backed up limits
 	backTime = abs( deltaTime );
@@ -162,85 +199,70 @@ static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime
 		if( backTime > (unsigned int)g_antilag_maxtimedelta->integer )
 			backTime = (unsigned int)g_antilag_maxtimedelta->integer;
 	}
+	backTimestamp = game.serverTime > backTime ? game.serverTime - backTime : 0;
 
-	// find the first snap with timestamp < than realtime - backtime
-	cframenum = sv_collisionFrameNum;
-	for( bf = 1; bf < CFRAME_UPDATE_BACKUP && bf < sv_collisionFrameNum; bf++ ) // never overpass limits
+	// find the newest frame with timestamp <= backTimestamp, or the oldest one we can use
+	lo = oldest;
+	hi = newest;
+	if( hist->timestamp[lo & CFRAME_UPDATE_MASK] > backTimestamp )
 	{
-		cframe = &sv_collisionframes[( cframenum-bf ) & CFRAME_UPDATE_MASK];
-
-		// if solid has changed, we can't keep moving backwards
-		if( ent->r.solid != cframe->clipEdicts[entNum].r.solid 
-			|| ent->r.inuse != cframe->clipEdicts[entNum].r.inuse )
+		hi = lo;
+	}
+	else
+	{
+		while( lo < hi )
 		{
-			bf--;
-			if( bf == 0 )
-			{
-				// we can't step back from first
-				cframe = NULL;
-			}
+			mid = lo + ( hi - lo + 1 ) / 2;
+			if( hist->timestamp[mid & CFRAME_UPDATE_MASK] <= backTimestamp )
+				lo = mid;
 			else
-			{
-				cframe = &sv_collisionframes[( cframenum-bf ) & CFRAME_UPDATE_MASK];
-			}
-			break;
+				hi = mid - 1;
 		}
-
-		if( game.serverTime >= cframe->timestamp + backTime )
-			break;
-	}
-
-	if( !cframe )
-	{
-		// current time entity
-		clipent->r = ent->r;
-		clipent->s = ent->s;
-		return clipent;
 	}
+	cframe = hi & CFRAME_UPDATE_MASK;
 
-	// setup with older for the data that is not interpolated
-	*clipent = cframe->clipEdicts[entNum];
+	VectorCopy( hist->origin[cframe][entNum], clipent->s.origin );
+	VectorCopy( hist->angles[cframe][entNum], clipent->s.angles );
+	VectorCopy( hist->mins[cframe][entNum], clipent->r.mins );
+	VectorCopy( hist->maxs[cframe][entNum], clipent->r.maxs );
+	VectorCopy( hist->absmin[cframe][entNum], clipent->r.absmin );
+	VectorCopy( hist->absmax[cframe][entNum], clipent->r.absmax );
 
 	// if we found an older than desired backtime frame, interpolate to find a more precise position.
-	if( game.serverTime > cframe->timestamp+backTime )
+	if( hist->timestamp[cframe] < backTimestamp )
 	{
+		const float *newerOrigin, *newerAngles, *newerMins, *newerMaxs;
 		float lerpFrac;
 
-		if( bf == 1 )
+		if( hi == newest )
 		{
-			// interpolate from 1st backed up to current
-			lerpFrac = (float)( ( game.serverTime - backTime ) - cframe->timestamp ) 
-				/ (float)( game.serverTime - cframe->timestamp );
-			clipentNewer.r = ent->r;
-			clipentNewer.s = ent->s;
+			// interpolate from the newest backed up to current
+			lerpFrac = (float)( backTimestamp - hist->timestamp[cframe] ) 
+				/ (float)( game.serverTime - hist->timestamp[cframe] );
+			newerOrigin = ent->s.origin;
+			newerAngles = ent->s.angles;
+			newerMins = ent->r.mins;
+			newerMaxs = ent->r.maxs;
 		}
 		else
 		{
 			// interpolate between 2 backed up
-			c4frame_t *cframeNewer = &sv_collisionframes[( cframenum-( bf-1 ) ) & CFRAME_UPDATE_MASK];
-			lerpFrac = (float)( ( game.serverTime - backTime ) - cframe->timestamp ) 
-				/ (float)( cframeNewer->timestamp - cframe->timestamp );
-			clipentNewer = cframeNewer->clipEdicts[entNum];
+			cnewer = ( hi + 1 ) & CFRAME_UPDATE_MASK;
+			lerpFrac = (float)( backTimestamp - hist->timestamp[cframe] ) 
+				/ (float)( hist->timestamp[cnewer] - hist->timestamp[cframe] );
+			newerOrigin = hist->origin[cnewer][entNum];
+			newerAngles = hist->angles[cnewer][entNum];
+			newerMins = hist->mins[cnewer][entNum];
+			newerMaxs = hist->maxs[cnewer][entNum];
 		}
 
-#if 0
-		G_Printf( "backTime:%i cframeBackTime:%i backFrames:%i lerfrac:%f\n",
-			backTime, game.serverTime - cframe->timestamp, backframes, lerpFrac );
-#endif
-
-		// interpolate
-		VectorLerp( clipent->s.origin, lerpFrac, clipentNewer.s.origin, clipent->s.origin );
-		VectorLerp( clipent->r.mins, lerpFrac, clipentNewer.r.mins, clipent->r.mins );
-		VectorLerp( clipent->r.maxs, lerpFrac, clipentNewer.r.maxs, clipent->r.maxs );
+		VectorLerp( clipent->s.origin, lerpFrac, newerOrigin, clipent->s.origin );
+		VectorLerp( clipent->r.mins, lerpFrac, newerMins, clipent->r.mins );
+		VectorLerp( clipent->r.maxs, lerpFrac, newerMaxs, clipent->r.maxs );
 		for( i = 0; i < 3; i++ )
-			clipent->s.angles[i] = LerpAngle( clipent->s.angles[i], clipentNewer.s.angles[i], lerpFrac );
+			clipent->s.angles[i] = LerpAngle( clipent->s.angles[i], newerAngles[i], lerpFrac );
 	}
 
-#if 0
-	G_Printf( "backTime:%i cframeBackTime:%i backFrames:%i\n", backTime,
-		game.serverTime - cframe->timestamp, backframes );
-#endif
-
 	// back time entity
 	return clipent;
 }
@@ -227,7 +227,7 @@ static void G_UpdateServerInfo( void )
 			}
 
 			len++;
-			votable = ( char * )G_Malloc( len );
+			votable = ( char * )G_FrameMalloc( len );
 			votable[0] = 0;
 
 			for( count = 0; ( name = G_ListNameForPosition( g_gametypes_list->string, count, CHAR_GAMETYPE_SEPARATOR ) ) != NULL; count++ )
@@ -241,7 +241,6 @@ static void G_UpdateServerInfo( void )
 
 			//votable[ strlen( votable )-2 ] = 0; // remove the last space
 			trap_Cvar_ForceSet( "g_gametypes_available", votable );
-			G_Free( votable );
 		}
 
 		g_votable_gametypes->modified = false;
@@ -770,6 +769,9 @@ void G_RunFrame( unsigned int msec, unsigned int serverTime )
 	game.serverTime = serverTime;
 	G_UpdateFrameTime( msec );
 
+	// pick up classname and targetname assignments from the last frame
+	G_SyncEntityNames();
+
 	if( !g_snapStarted )
 		G_StartFrameSnap();
 
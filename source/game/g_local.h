@@ -150,6 +150,12 @@ typedef struct
 	int maxentities;
 	int numentities;
 
+	// free edicts past the clients, sorted by freetime so the
+	// head is always the best candidate for reuse
+	edict_t *freeEdictsHead, *freeEdictsTail;
+	int numFreeEdicts;
+	int maxLiveEdicts;              // peak of edicts past the clients in use since the level started
+
 	// cross level triggers
 	int serverflags;
 
@@ -588,6 +594,11 @@ bool Add_Armor( edict_t *ent, edict_t *other, bool pick_it );
 bool KillBox( edict_t *ent );
 float LookAtKillerYAW( edict_t *self, edict_t *inflictor, edict_t *attacker );
 edict_t *G_Find( edict_t *from, size_t fieldofs, const char *match );
+edict_t *G_FindByClassname( edict_t *from, const char *classname );
+edict_t *G_FindByTargetname( edict_t *from, const char *targetname );
+void G_EntityNamesChanged( edict_t *ent );
+void G_SyncEntityNames( void );
+void G_ClearEntityNames( void );
 edict_t *G_FindBoxInRadius( edict_t *from, edict_t *to, vec3_t org, float rad );
 edict_t *G_PickTarget( const char *targetname );
 void G_UseTargets( edict_t *ent, edict_t *activator );
@@ -598,6 +609,7 @@ void G_DropSpawnpointToFloor( edict_t *ent );
 void G_InitEdict( edict_t *e );
 edict_t *G_Spawn( void );
 void G_FreeEdict( edict_t *e );
+void G_ClearFreeEdicts( void );
 
 void G_LevelInitPool( size_t size );
 void G_LevelFreePool( void );
@@ -927,6 +939,7 @@ int G_BoxSlideMove( edict_t *ent, int contentmask, float slideBounce, float fric
 // memory management
 #define G_Malloc( size ) trap_MemAlloc( size, __FILE__, __LINE__ )
 #define G_Free( mem ) trap_MemFree( mem, __FILE__, __LINE__ )
+#define G_FrameMalloc( size ) trap_MemFrameAlloc( size, __FILE__, __LINE__ )
 
 #define	G_LevelMalloc( size ) _G_LevelMalloc( ( size ), __FILE__, __LINE__ )
 #define	G_LevelFree( data ) _G_LevelFree( ( data ), __FILE__, __LINE__ )
@@ -1291,6 +1304,7 @@ struct edict_s
 	const char *model;
 	const char *model2;
 	unsigned int freetime;          // time when the object was freed
+	edict_t *nextFree;              // next in game.freeEdictsHead list while not in use
 
 	int numEvents;
 	bool eventPriority[2];
@@ -65,6 +65,7 @@ cvar_t *bot_showcombat;
 cvar_t *bot_showsrgoal;
 cvar_t *bot_showlrgoal;
 cvar_t *bot_dummy;
+cvar_t *bot_pathbudget;
 //[end]
 
 cvar_t *g_projectile_touch_owner;
@@ -372,6 +373,8 @@ void G_Init( unsigned int seed, unsigned int framemsec, int protocol )
 	game.quits = NULL;
 
 	game.numentities = gs.maxclients + 1;
+	G_ClearFreeEdicts();
+	G_ClearEntityNames();
 
 	trap_LocateEntities( game.edicts, sizeof( game.edicts[0] ), game.numentities, game.maxentities );
 
@@ -20,7 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 // g_public.h -- game dll information visible to server
 
-#define	GAME_API_VERSION    48
+#define	GAME_API_VERSION    49
 
 //===============================================================
 
@@ -116,6 +116,7 @@ typedef struct
 	// managed memory allocation
 	void *( *Mem_Alloc )( size_t size, const char *filename, int fileline );
 	void ( *Mem_Free )( void *data, const char *filename, int fileline );
+	void *( *Mem_FrameAlloc )( size_t size, const char *filename, int fileline ); // valid until the next server frame
 
 	// dynvars
 	dynvar_t *( *Dynvar_Create )( const char *name, bool console, dynvar_getter_f getter, dynvar_setter_f setter );
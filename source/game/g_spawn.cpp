@@ -770,6 +770,8 @@ void G_InitLevel( char *mapname, char *entities, int entstrlen, unsigned int lev
 	}
 
 	game.numentities = gs.maxclients + 1;
+	G_ClearFreeEdicts();
+	G_ClearEntityNames();
 
 	// link client fields on player ents
 	for( i = 0; i < gs.maxclients; i++ )
@@ -869,6 +871,7 @@ void G_InitLevel( char *mapname, char *entities, int entstrlen, unsigned int lev
 				{
 					// override entity's classname with whatever item specifies
 					ent->classname = item->classname;
+					G_EntityNamesChanged( ent );
 					PrecacheItem( item );
 					continue;
 				}
@@ -361,6 +361,19 @@ static void Cmd_WriteIP_f( void )
 	SV_WriteIPList ();
 }
 
+/*
+* Cmd_EdictStats_f
+*/
+static void Cmd_EdictStats_f( void )
+{
+	int numclients = gs.maxclients + 1;
+
+	G_Printf( "edicts         : %i of %i allocated\n", game.numentities, game.maxentities );
+	G_Printf( "live           : %i, %i peak since the level started\n", 
+		game.numentities - numclients - game.numFreeEdicts, game.maxLiveEdicts );
+	G_Printf( "free           : %i\n", game.numFreeEdicts );
+}
+
 /*
 * G_AddCommands
 */
@@ -392,6 +405,8 @@ void G_AddServerCommands( void )
 
 	trap_Cmd_AddCommand( "listratings", G_ListRatings_f );
 	trap_Cmd_AddCommand( "listraces", G_ListRaces_f );
+
+	trap_Cmd_AddCommand( "edictstats", Cmd_EdictStats_f );
 }
 
 /*
@@ -425,4 +440,6 @@ void G_RemoveCommands( void )
 
 	trap_Cmd_RemoveCommand( "listratings" );
 	trap_Cmd_RemoveCommand( "listraces" );
+
+	trap_Cmd_RemoveCommand( "edictstats" );
 }
@@ -162,6 +162,11 @@ static inline void trap_MemFree( void *data, const char *filename, int fileline
 	GAME_IMPORT.Mem_Free( data, filename, fileline );
 }
 
+static inline void *trap_MemFrameAlloc( size_t size, const char *filename, int fileline )
+{
+	return GAME_IMPORT.Mem_FrameAlloc( size, filename, fileline );
+}
+
 // dynvars
 static inline dynvar_t *trap_Dynvar_Create( const char *name, bool console, dynvar_getter_f getter, dynvar_setter_f setter )
 {
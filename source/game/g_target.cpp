@@ -253,6 +253,7 @@ static void use_target_spawner( edict_t *self, edict_t *other, edict_t *activato
 
 	ent = G_Spawn();
 	ent->classname = self->target;
+	G_EntityNamesChanged( ent );
 	VectorCopy( self->s.origin, ent->s.origin );
 	VectorCopy( self->s.angles, ent->s.angles );
 	G_CallSpawn( ent );
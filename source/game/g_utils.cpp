@@ -529,6 +529,253 @@ void G_ProjectSource( vec3_t point, vec3_t distance, vec3_t forward, vec3_t righ
 }
 
 
+//==================================================
+// ENTITY NAMES INDEX
+//
+// classname and targetname are hashed so G_Find doesn't have to scan all
+// edicts for them. The fields are assigned directly all over the code, so
+// the index records the string pointer each edict was linked under:
+// edicts are queued for relinking when initialized, freed, or renamed
+// through G_EntityNamesChanged, and a sweep every frame catches the rest.
+// Matches are always checked against the live field.
+//==================================================
+
+#define ENTNAMES_HASH_SIZE		256
+
+enum
+{
+	ENTNAME_CLASSNAME,
+	ENTNAME_TARGETNAME,
+
+	ENTNAME_TOTAL
+};
+
+typedef struct
+{
+	const char *name[MAX_EDICTS];			// the string the edict is linked under
+	unsigned int hash[MAX_EDICTS];
+	int next[MAX_EDICTS];					// edict number + 1, 0 ends the bucket
+	int prev[MAX_EDICTS];
+	int head[ENTNAMES_HASH_SIZE];			// buckets are sorted by edict number
+	int tail[ENTNAMES_HASH_SIZE];
+} g_entnames_t;
+
+static g_entnames_t g_entnames[ENTNAME_TOTAL];
+
+static int g_entnamesPending[MAX_EDICTS];
+static bool g_entnamesIsPending[MAX_EDICTS];
+static int g_entnamesNumPending;
+
+/*
+* G_EntityNameField
+*/
+static inline const char *G_EntityNameField( edict_t *ent, int field )
+{
+	return field == ENTNAME_CLASSNAME ? ent->classname : ent->targetname;
+}
+
+/*
+* G_HashEntityName
+*/
+static unsigned int G_HashEntityName( const char *name )
+{
+	unsigned int hash = 0;
+
+	for( ; *name; name++ )
+		hash = hash * 31 + tolower( (unsigned char)*name );
+
+	return hash;
+}
+
+/*
+* G_UnlinkEntityName
+*/
+static void G_UnlinkEntityName( g_entnames_t *index, int num )
+{
+	int next = index->next[num], prev = index->prev[num];
+	int bucket = index->hash[num] & ( ENTNAMES_HASH_SIZE - 1 );
+
+	if( prev )
+		index->next[prev - 1] = next;
+	else
+		index->head[bucket] = next;
+
+	if( next )
+		index->prev[next - 1] = prev;
+	else
+		index->tail[bucket] = prev;
+
+	index->name[num] = NULL;
+	index->next[num] = index->prev[num] = 0;
+}
+
+/*
+* G_LinkEntityName
+*/
+static void G_LinkEntityName( g_entnames_t *index, int num, const char *name )
+{
+	int bucket, prev, next;
+
+	index->name[num] = name;
+	index->hash[num] = G_HashEntityName( name );
+	bucket = index->hash[num] & ( ENTNAMES_HASH_SIZE - 1 );
+
+	// edicts are mostly linked in ascending order, so start from the tail
+	for( prev = index->tail[bucket]; prev && prev - 1 > num; prev = index->prev[prev - 1] );
+	next = prev ? index->next[prev - 1] : index->head[bucket];
+
+	index->prev[num] = prev;
+	index->next[num] = next;
+	if( prev )
+		index->next[prev - 1] = num + 1;
+	else
+		index->head[bucket] = num + 1;
+	if( next )
+		index->prev[next - 1] = num + 1;
+	else
+		index->tail[bucket] = num + 1;
+}
+
+/*
+* G_RelinkEntityNames
+*/
+static void G_RelinkEntityNames( edict_t *ent )
+{
+	int i, num = ENTNUM( ent );
+	const char *name;
+
+	for( i = 0; i < ENTNAME_TOTAL; i++ )
+	{
+		name = G_EntityNameField( ent, i );
+		if( name == g_entnames[i].name[num] )
+			continue;
+
+		if( g_entnames[i].name[num] )
+			G_UnlinkEntityName( &g_entnames[i], num );
+		if( name )
+			G_LinkEntityName( &g_entnames[i], num, name );
+	}
+}
+
+/*
+* G_EntityNamesChanged
+* 
+* Queues the edict for relinking, call after assigning its classname or targetname.
+*/
+void G_EntityNamesChanged( edict_t *ent )
+{
+	int num = ENTNUM( ent );
+
+	if( num < 0 || num >= MAX_EDICTS || g_entnamesIsPending[num] )
+		return;
+
+	g_entnamesIsPending[num] = true;
+	g_entnamesPending[g_entnamesNumPending++] = num;
+}
+
+/*
+* G_FlushEntityNames
+*/
+static void G_FlushEntityNames( void )
+{
+	int i, num;
+
+	for( i = 0; i < g_entnamesNumPending; i++ )
+	{
+		num = g_entnamesPending[i];
+		g_entnamesIsPending[num] = false;
+		G_RelinkEntityNames( &game.edicts[num] );
+	}
+	g_entnamesNumPending = 0;
+}
+
+/*
+* G_SyncEntityNames
+* 
+* Relinks all edicts whose names changed, called once per frame.
+*/
+void G_SyncEntityNames( void )
+{
+	int i;
+
+	G_FlushEntityNames();
+
+	for( i = 0; i < game.numentities; i++ )
+		G_RelinkEntityNames( &game.edicts[i] );
+}
+
+/*
+* G_ClearEntityNames
+* 
+* Empties the index, for when the edicts are reset.
+*/
+void G_ClearEntityNames( void )
+{
+	memset( g_entnames, 0, sizeof( g_entnames ) );
+	memset( g_entnamesIsPending, 0, sizeof( g_entnamesIsPending ) );
+	g_entnamesNumPending = 0;
+}
+
+/*
+* G_FindByEntityName
+*/
+static edict_t *G_FindByEntityName( edict_t *from, int field, const char *match )
+{
+	g_entnames_t *index = &g_entnames[field];
+	unsigned int hash = G_HashEntityName( match );
+	int num, fromNum;
+	const char *name;
+	edict_t *ent;
+
+	G_FlushEntityNames();
+
+	fromNum = from ? ENTNUM( from ) : -1;
+	if( fromNum >= 0 && index->name[fromNum] && index->hash[fromNum] == hash )
+	{
+		// continuing an iteration
+		num = index->next[fromNum];
+	}
+	else
+	{
+		for( num = index->head[hash & ( ENTNAMES_HASH_SIZE - 1 )]; num && num - 1 <= fromNum; num = index->next[num - 1] );
+	}
+
+	for( ; num; num = index->next[num - 1] )
+	{
+		if( index->hash[num - 1] != hash )
+			continue;
+
+		ent = &game.edicts[num - 1];
+		if( !ent->r.inuse )
+			continue;
+		name = G_EntityNameField( ent, field );
+		if( name && !Q_stricmp( name, match ) )
+			return ent;
+	}
+
+	return NULL;
+}
+
+/*
+* G_FindByClassname
+* 
+* Returns the next edict after from with the given classname, NULL when there are no more.
+*/
+edict_t *G_FindByClassname( edict_t *from, const char *classname )
+{
+	return G_FindByEntityName( from, ENTNAME_CLASSNAME, classname );
+}
+
+/*
+* G_FindByTargetname
+* 
+* Returns the next edict after from with the given targetname, NULL when there are no more.
+*/
+edict_t *G_FindByTargetname( edict_t *from, const char *targetname )
+{
+	return G_FindByEntityName( from, ENTNAME_TARGETNAME, targetname );
+}
+
 /*
 * G_Find
 * 
@@ -543,6 +790,11 @@ edict_t *G_Find( edict_t *from, size_t fieldofs, const char *match )
 {
 	char *s;
 
+	if( fieldofs == FOFS( classname ) )
+		return G_FindByClassname( from, match );
+	if( fieldofs == FOFS( targetname ) )
+		return G_FindByTargetname( from, match );
+
 	if( !from )
 		from = world;
 	else
@@ -588,7 +840,7 @@ edict_t *G_PickTarget( const char *targetname )
 
 	while( 1 )
 	{
-		ent = G_Find( ent, FOFS( targetname ), targetname );
+		ent = G_FindByTargetname( ent, targetname );
 		if( !ent )
 			break;
 		choice[num_choices++] = ent;
@@ -670,7 +922,7 @@ void G_UseTargets( edict_t *ent, edict_t *activator )
 	if( ent->killtarget )
 	{
 		t = NULL;
-		while( ( t = G_Find( t, FOFS( targetname ), ent->killtarget ) ) )
+		while( ( t = G_FindByTargetname( t, ent->killtarget ) ) )
 		{
 			G_FreeEdict( t );
 			if( !ent->r.inuse )
@@ -689,7 +941,7 @@ void G_UseTargets( edict_t *ent, edict_t *activator )
 	if( ent->target )
 	{
 		t = NULL;
-		while( ( t = G_Find( t, FOFS( targetname ), ent->target ) ) )
+		while( ( t = G_FindByTargetname( t, ent->target ) ) )
 		{
 			if( t == ent )
 			{
@@ -765,6 +1017,61 @@ char *_G_CopyString( const char *in, const char *filename, int fileline )
 	return out;
 }
 
+/*
+* G_ClearFreeEdicts
+* 
+* Forget about the free edicts, for when game.numentities is reset.
+*/
+void G_ClearFreeEdicts( void )
+{
+	game.freeEdictsHead = game.freeEdictsTail = NULL;
+	game.numFreeEdicts = 0;
+	game.maxLiveEdicts = 0;
+}
+
+/*
+* G_LinkFreeEdict
+*/
+static void G_LinkFreeEdict( edict_t *ed )
+{
+	ed->nextFree = NULL;
+
+	if( !game.freeEdictsHead )
+	{
+		game.freeEdictsHead = game.freeEdictsTail = ed;
+	}
+	else if( !ed->freetime )
+	{
+		// can be reused right away
+		ed->nextFree = game.freeEdictsHead;
+		game.freeEdictsHead = ed;
+	}
+	else
+	{
+		// game.realtime never goes backwards, so appending keeps the list sorted
+		game.freeEdictsTail->nextFree = ed;
+		game.freeEdictsTail = ed;
+	}
+
+	game.numFreeEdicts++;
+}
+
+/*
+* G_UnlinkFreeEdict
+*/
+static edict_t *G_UnlinkFreeEdict( void )
+{
+	edict_t *ed = game.freeEdictsHead;
+
+	game.freeEdictsHead = ed->nextFree;
+	if( !game.freeEdictsHead )
+		game.freeEdictsTail = NULL;
+	ed->nextFree = NULL;
+
+	game.numFreeEdicts--;
+	return ed;
+}
+
 /*
 * G_FreeEdict
 * 
@@ -774,6 +1081,11 @@ void G_FreeEdict( edict_t *ed )
 {
 	bool evt = ISEVENTENTITY( &ed->s );
 
+	// an edict freed twice is already on the free list, clearing it
+	// again would cut the list and move its freetime out of order
+	if( !ed->r.inuse )
+		return;
+
 	GClip_UnlinkEntity( ed );   // unlink from world
 
 	AI_RemoveGoalEntity( ed );
@@ -789,6 +1101,12 @@ void G_FreeEdict( edict_t *ed )
 
 	if( !evt && ( level.spawnedTimeStamp != game.realtime ) )
 		ed->freetime = game.realtime; // ET_EVENT or ET_SOUND don't need to wait to be reused
+
+	G_EntityNamesChanged( ed );
+
+	// body queue slots are recycled in place by CopyToBodyQue, never by G_Spawn
+	if( ed->s.number > gs.maxclients + BODY_QUEUE_SIZE )
+		G_LinkFreeEdict( ed );
 }
 
 /*
@@ -798,6 +1116,7 @@ void G_InitEdict( edict_t *e )
 {
 	e->r.inuse = true;
 	e->classname = NULL;
+	G_EntityNamesChanged( e );
 	e->gravity = 1.0;
 	e->s.number = ENTNUM( e );
 	e->timeDelta = 0;
@@ -837,49 +1156,50 @@ void G_InitEdict( edict_t *e )
 */
 edict_t *G_Spawn( void )
 {
-	int i;
-	edict_t	*e, *freed;
+	edict_t	*e;
+	int live;
 
 	if( !level.canSpawnEntities )
 		G_Printf( "WARNING: Spawning entity before map entities have been spawned\n" );
 
-	freed = NULL;
-	e = &game.edicts[gs.maxclients+1];
-	for( i = gs.maxclients + 1; i < game.numentities; i++, e++ )
+	// the first couple seconds of server time can involve a lot of
+	// freeing and allocating, so relax the replacement policy.
+	// the free list is sorted by freetime, so if its head doesn't
+	// satisfy the policy no other free edict does
+	while( game.freeEdictsHead && game.freeEdictsHead->r.inuse )
 	{
-		if( e->r.inuse )
-			continue;
-
-		// the first couple seconds of server time can involve a lot of
-		// freeing and allocating, so relax the replacement policy
-		if( e->freetime < level.spawnedTimeStamp + 2000 || game.realtime > e->freetime + 500 )
-		{
-			G_InitEdict( e );
-			return e;
-		}
+		// got reinitialized in place without going through G_Spawn
+		G_UnlinkFreeEdict();
+	}
+	e = game.freeEdictsHead;
+	if( e && ( e->freetime < level.spawnedTimeStamp + 2000 || game.realtime > e->freetime + 500 ) )
+	{
+		e = G_UnlinkFreeEdict();
+	}
+	else if( game.numentities < game.maxentities )
+	{
+		e = &game.edicts[game.numentities];
+		game.numentities++;
 
-		// this is going to be our second chance to spawn an entity in case all free
+		trap_LocateEntities( game.edicts, sizeof( game.edicts[0] ), game.numentities, game.maxentities );
+	}
+	else if( e )
+	{
+		// second chance to spawn an entity in case all free
 		// entities have been freed only recently
-		if( !freed )
-			freed = e;
+		e = G_UnlinkFreeEdict();
 	}
-
-	if( i == game.maxentities )
+	else
 	{
-		if( freed )
-		{
-			G_InitEdict( freed );
-			return freed;
-		}
 		G_Error( "G_Spawn: no free edicts" );
 	}
 
-	game.numentities++;
-
-	trap_LocateEntities( game.edicts, sizeof( game.edicts[0] ), game.numentities, game.maxentities );
-
 	G_InitEdict( e );
 
+	live = game.numentities - ( gs.maxclients + 1 ) - game.numFreeEdicts;
+	if( live > game.maxLiveEdicts )
+		game.maxLiveEdicts = live;
+
 	return e;
 }
 
@@ -565,6 +565,7 @@ void G_ClientRespawn( edict_t *self, bool ghost )
 		self->classname = "fakeclient";
 	else
 		self->classname = "player";
+	G_EntityNamesChanged( self );
 
 	VectorCopy( playerbox_stand_mins, self->r.mins );
 	VectorCopy( playerbox_stand_maxs, self->r.maxs );
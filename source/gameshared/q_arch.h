@@ -405,6 +405,12 @@ typedef int socket_handle_t;
 #define ATTRIBUTE_NAKED
 #endif
 
+#ifdef _MSC_VER
+#define ATTRIBUTE_THREADLOCAL  __declspec( thread )
+#else
+#define ATTRIBUTE_THREADLOCAL  __thread
+#endif
+
 #ifdef HAVE___STRTOI64
 #define strtoll _strtoi64
 #define strtoull _strtoi64
@@ -418,6 +418,7 @@ typedef enum
 	HTTP_RESP_NONE = 0,
 	HTTP_RESP_OK = 200,
 	HTTP_RESP_PARTIAL_CONTENT = 206,
+	HTTP_RESP_NOT_MODIFIED = 304,
 	HTTP_RESP_BAD_REQUEST = 400,
 	HTTP_RESP_FORBIDDEN = 403,
 	HTTP_RESP_NOT_FOUND = 404,
@@ -333,8 +333,8 @@ float ( *LittleFloat )(float l) = &LittleFloatDetectSwap;
 */
 float *tv( float x, float y, float z )
 {
-	static int index;
-	static float vecs[8][3];
+	static ATTRIBUTE_THREADLOCAL int index;
+	static ATTRIBUTE_THREADLOCAL float vecs[8][3];
 	float *v;
 
 	// use an array so that multiple tempvectors won't collide
@@ -356,8 +356,8 @@ float *tv( float x, float y, float z )
 */
 char *vtos( float v[3] )
 {
-	static int index;
-	static char str[8][32];
+	static ATTRIBUTE_THREADLOCAL int index;
+	static ATTRIBUTE_THREADLOCAL char str[8][32];
 	char *s;
 
 	// use an array so that multiple vtos won't collide
@@ -378,8 +378,8 @@ char *vtos( float v[3] )
 char *va( const char *format, ... )
 {
 	va_list	argptr;
-	static int str_index;
-	static char string[8][2048];
+	static ATTRIBUTE_THREADLOCAL int str_index;
+	static ATTRIBUTE_THREADLOCAL char string[8][2048];
 
 	str_index = ( str_index+1 ) & 7;
 	va_start( argptr, format );
@@ -486,7 +486,7 @@ int COM_Compress( char *data_p )
 	return out - data_p;
 }
 
-static char com_token[MAX_TOKEN_CHARS];
+static ATTRIBUTE_THREADLOCAL char com_token[MAX_TOKEN_CHARS];
 
 /*
 * COM_ParseExt
@@ -711,7 +711,7 @@ int Q_GrabWCharFromColorString( const char **pstr, wchar_t *wc, int *colorindex
 */
 const char *COM_RemoveColorTokensExt( const char *str, bool draw )
 {
-	static char cleanString[MAX_STRING_CHARS];
+	static ATTRIBUTE_THREADLOCAL char cleanString[MAX_STRING_CHARS];
 	char *out = cleanString, *end = cleanString + sizeof( cleanString );
 	const char *in = str;
 	char c;
@@ -855,7 +855,7 @@ const char *Q_ColorStringTerminator( const char *str, int finalcolor )
 	else
 	{
 		int escapecount = 0;
-		static char buf[4];
+		static ATTRIBUTE_THREADLOCAL char buf[4];
 		char *p = buf;
 
 		// count up trailing ^'s
@@ -913,7 +913,7 @@ int Q_ColorStrLastColor( int previous, const char *s, int maxlen )
 */
 const char *COM_RemoveJunkChars( const char *in )
 {
-	static char cleanString[MAX_STRING_CHARS];
+	static ATTRIBUTE_THREADLOCAL char cleanString[MAX_STRING_CHARS];
 	char *out = cleanString, *end = cleanString + sizeof( cleanString ) - 1;
 
 	if( in )
@@ -963,7 +963,7 @@ const char *COM_RemoveJunkChars( const char *in )
 */
 int COM_ReadColorRGBString( const char *in )
 {
-	static int playerColor[3];
+	static ATTRIBUTE_THREADLOCAL int playerColor[3];
 	if( in && in[0] )
 	{
 		if( sscanf( in, "%3i %3i %3i", &playerColor[0], &playerColor[1], &playerColor[2] ) == 3 )
@@ -1310,7 +1310,7 @@ size_t Q_WCharToUtf8( wchar_t wc, char *dest, size_t bufsize )
 */
 char *Q_WCharToUtf8Char( wchar_t wc )
 {
-	static char buf[5];	// longest valid utf-8 sequence is 4 bytes
+	static ATTRIBUTE_THREADLOCAL char buf[5];	// longest valid utf-8 sequence is 4 bytes
 	Q_WCharToUtf8( wc, buf, sizeof( buf ) );
 	return buf;
 }
@@ -1773,8 +1773,8 @@ static char *Info_FindKey( const char *info, const char *key )
 */
 char *Info_ValueForKey( const char *info, const char *key )
 {
-	static char value[2][MAX_INFO_VALUE]; // use two buffers so compares work without stomping on each other
-	static int valueindex;
+	static ATTRIBUTE_THREADLOCAL char value[2][MAX_INFO_VALUE]; // use two buffers so compares work without stomping on each other
+	static ATTRIBUTE_THREADLOCAL int valueindex;
 	const char *p, *start;
 	size_t len;
 
@@ -51,7 +51,6 @@ typedef struct
 typedef struct
 {
 	int contents;
-	int checkcount;             // to avoid repeated testings
 
 	int numsides;
 	cbrushside_t *brushsides;
@@ -60,7 +59,6 @@ typedef struct
 typedef struct
 {
 	int contents;
-	int checkcount;             // to avoid repeated testings
 
 	vec3_t mins, maxs;
 
@@ -105,9 +103,47 @@ typedef struct
 	int floodvalid;
 } carea_t;
 
+/*
+* all state a single trace needs to write to, so that several contexts
+* can trace against the same (read-only) map at once
+*/
+struct cmodel_tracectx_s
+{
+	int checkcount;                 // to avoid repeated testings
+	int numbrushchecks;
+	int *brushchecks;               // checkcount of the last trace that tested map_brushes[i]
+	int numfacechecks;
+	int *facechecks;                // same for map_faces[i]
+
+	trace_t	*trace;
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	vec3_t startmins, endmins;
+	vec3_t startmaxs, endmaxs;
+	vec3_t absmins, absmaxs;
+	vec3_t extents;
+#ifdef TRACEVICFIX
+	float realfraction;
+#endif
+	int contents;
+	bool ispoint;                   // optimized case
+	int numbrushtraces;             // for c_brush_traces, added once per trace
+
+	cplane_t box_planes[6];
+	cbrushside_t box_brushsides[6];
+	cbrush_t box_brush[1];
+	cbrush_t *box_markbrushes[1];
+	cmodel_t box_cmodel[1];
+
+	cplane_t oct_planes[10];
+	cbrushside_t oct_brushsides[10];
+	cbrush_t oct_brush[1];
+	cbrush_t *oct_markbrushes[1];
+	cmodel_t oct_cmodel[1];
+};
+
 struct cmodel_state_s
 {
-	int checkcount;
 	int refcount;
 	struct mempool_s *mempool;
 
@@ -174,22 +210,7 @@ struct cmodel_state_s
 	uint8_t *cmod_base;
 
 	// cm_trace.c
-	cplane_t box_planes[6];
-	cbrushside_t box_brushsides[6];
-	cbrush_t box_brush[1];
-	cbrush_t *box_markbrushes[1];
-	cmodel_t box_cmodel[1];
-
-	cplane_t oct_planes[10];
-	cbrushside_t oct_brushsides[10];
-	cbrush_t oct_brush[1];
-	cbrush_t *oct_markbrushes[1];
-	cmodel_t oct_cmodel[1];
-
-	int leaf_count, leaf_maxcount;
-	int *leaf_list;
-	float *leaf_mins, *leaf_maxs;
-	int leaf_topnode;
+	cmodel_tracectx_t tracectx;     // used by the functions that don't take a context
 
 	// optional special handling of line tracing and point contents
 	void ( *CM_TransformedBoxTrace )( struct cmodel_state_s *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, struct cmodel_s *cmodel, int brushmask, vec3_t origin, vec3_t angles );
@@ -199,7 +220,7 @@ struct cmodel_state_s
 
 //=======================================================================
 
-void	CM_InitBoxHull( cmodel_state_t *cms );
-void	CM_InitOctagonHull( cmodel_state_t *cms );
+void	CM_InitTraceContext( cmodel_state_t *cms, cmodel_tracectx_t *ctx );
+void	CM_ClearTraceContext( cmodel_state_t *cms, cmodel_tracectx_t *ctx );
 
 void	CM_FloodAreaConnections( cmodel_state_t *cms );
@@ -249,9 +249,6 @@ cmodel_t *CM_LoadMap( cmodel_state_t *cms, const char *name, bool clientload, un
 
 	descr->loader( cms, NULL, buf, bspFormat );
 
-	CM_InitBoxHull( cms );
-	CM_InitOctagonHull( cms );
-
 	if( cms->numareas )
 	{
 		cms->map_areas = Mem_Alloc( cms->mempool, cms->numareas * sizeof( *cms->map_areas ) );
@@ -764,15 +761,14 @@ bool CM_HeadnodeVisible( cmodel_state_t *cms, int nodenum, uint8_t *visbits )
 
 
 /*
-* CM_MergePVS
-* Merge PVS at origin into out
+* CM_PVSClusters
+* Clusters merged by CM_MergePVS at origin, sorted and without duplicates.
+* Returns -1 if there are more than maxclusters of them
 */
-void CM_MergePVS( cmodel_state_t *cms, vec3_t org, uint8_t *out )
+int CM_PVSClusters( cmodel_state_t *cms, vec3_t org, int *clusters, int maxclusters )
 {
 	int leafs[128];
-	int i, j, count;
-	int longs;
-	uint8_t *src;
+	int i, j, k, count, numclusters, cluster;
 	vec3_t mins, maxs;
 
 	for( i = 0; i < 3; i++ )
@@ -782,23 +778,47 @@ void CM_MergePVS( cmodel_state_t *cms, vec3_t org, uint8_t *out )
 	}
 
 	count = CM_BoxLeafnums( cms, mins, maxs, leafs, sizeof( leafs )/sizeof( int ), NULL );
+
+	numclusters = 0;
+	for( i = 0; i < count; i++ )
+	{
+		cluster = CM_LeafCluster( cms, leafs[i] );
+
+		for( j = 0; j < numclusters && clusters[j] < cluster; j++ );
+		if( j < numclusters && clusters[j] == cluster )
+			continue; // already have the cluster we want
+		if( numclusters == maxclusters )
+			return -1;
+
+		for( k = numclusters; k > j; k-- )
+			clusters[k] = clusters[k-1];
+		clusters[j] = cluster;
+		numclusters++;
+	}
+
+	return numclusters;
+}
+
+/*
+* CM_MergePVS
+* Merge PVS at origin into out
+*/
+void CM_MergePVS( cmodel_state_t *cms, vec3_t org, uint8_t *out )
+{
+	int clusters[128];
+	int i, j, count;
+	int longs;
+	uint8_t *src;
+
+	count = CM_PVSClusters( cms, org, clusters, sizeof( clusters )/sizeof( int ) );
 	if( count < 1 )
 		Com_Error( ERR_FATAL, "CM_MergePVS: count < 1" );
 	longs = CM_ClusterRowLongs( cms );
 
-	// convert leafs to clusters
-	for( i = 0; i < count; i++ )
-		leafs[i] = CM_LeafCluster( cms, leafs[i] );
-
-	// or in all the other leaf bits
+	// or in all the cluster bits
 	for( i = 0; i < count; i++ )
 	{
-		for( j = 0; j < i; j++ )
-			if( leafs[i] == leafs[j] )
-				break;
-		if( j != i )
-			continue; // already have the cluster we want
-		src = CM_ClusterPVS( cms, leafs[i] );
+		src = CM_ClusterPVS( cms, clusters[i] );
 		for( j = 0; j < longs; j++ )
 			( (int *)out )[j] |= ( (int *)src )[j];
 	}
@@ -842,6 +862,8 @@ cmodel_state_t *CM_New( void *mempool )
 	cms->map_areas = &cms->map_area_empty;
 	cms->map_entitystring = &cms->map_entitystring_empty;
 
+	CM_InitTraceContext( cms, &cms->tracectx );
+
 	return cms;
 }
 
@@ -852,6 +874,8 @@ static void CM_Free( cmodel_state_t *cms )
 {
 	CM_Clear( cms );
 
+	CM_ClearTraceContext( cms, &cms->tracectx );
+
 	Mem_Free( cms );
 }
 
@@ -28,33 +28,33 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 * Set up the planes so that the six floats of a bounding box
 * can just be stored out and get a proper clipping hull structure.
 */
-void CM_InitBoxHull( cmodel_state_t *cms )
+static void CM_InitBoxHull( cmodel_tracectx_t *ctx )
 {
 	int i;
 	cplane_t *p;
 	cbrushside_t *s;
 
-	cms->box_brush->numsides = 6;
-	cms->box_brush->brushsides = cms->box_brushsides;
-	cms->box_brush->contents = CONTENTS_BODY;
+	ctx->box_brush->numsides = 6;
+	ctx->box_brush->brushsides = ctx->box_brushsides;
+	ctx->box_brush->contents = CONTENTS_BODY;
 
-	cms->box_markbrushes[0] = cms->box_brush;
+	ctx->box_markbrushes[0] = ctx->box_brush;
 
-	cms->box_cmodel->builtin = true;
-	cms->box_cmodel->nummarkfaces = 0;
-	cms->box_cmodel->markfaces = NULL;
-	cms->box_cmodel->markbrushes = cms->box_markbrushes;
-	cms->box_cmodel->nummarkbrushes = 1;
+	ctx->box_cmodel->builtin = true;
+	ctx->box_cmodel->nummarkfaces = 0;
+	ctx->box_cmodel->markfaces = NULL;
+	ctx->box_cmodel->markbrushes = ctx->box_markbrushes;
+	ctx->box_cmodel->nummarkbrushes = 1;
 
 	for( i = 0; i < 6; i++ )
 	{
 		// brush sides
-		s = cms->box_brushsides + i;
-		s->plane = cms->box_planes + i;
+		s = ctx->box_brushsides + i;
+		s->plane = ctx->box_planes + i;
 		s->surfFlags = 0;
 
 		// planes
-		p = &cms->box_planes[i];
+		p = &ctx->box_planes[i];
 		VectorClear( p->normal );
 
 		if( ( i & 1 ) )
@@ -78,7 +78,7 @@ void CM_InitBoxHull( cmodel_state_t *cms )
 * Set up the planes so that the six floats of a bounding box
 * can just be stored out and get a proper clipping hull structure.
 */
-void CM_InitOctagonHull( cmodel_state_t *cms )
+static void CM_InitOctagonHull( cmodel_tracectx_t *ctx )
 {
 	int i;
 	cplane_t *p;
@@ -90,28 +90,28 @@ void CM_InitOctagonHull( cmodel_state_t *cms )
 		{  1, -1, 0 }
 	};
 
-	cms->oct_brush->numsides = 10;
-	cms->oct_brush->brushsides = cms->oct_brushsides;
-	cms->oct_brush->contents = CONTENTS_BODY;
+	ctx->oct_brush->numsides = 10;
+	ctx->oct_brush->brushsides = ctx->oct_brushsides;
+	ctx->oct_brush->contents = CONTENTS_BODY;
 
-	cms->oct_markbrushes[0] = cms->oct_brush;
+	ctx->oct_markbrushes[0] = ctx->oct_brush;
 
-	cms->oct_cmodel->builtin = true;
-	cms->oct_cmodel->nummarkfaces = 0;
-	cms->oct_cmodel->markfaces = NULL;
-	cms->oct_cmodel->markbrushes = cms->oct_markbrushes;
-	cms->oct_cmodel->nummarkbrushes = 1;
+	ctx->oct_cmodel->builtin = true;
+	ctx->oct_cmodel->nummarkfaces = 0;
+	ctx->oct_cmodel->markfaces = NULL;
+	ctx->oct_cmodel->markbrushes = ctx->oct_markbrushes;
+	ctx->oct_cmodel->nummarkbrushes = 1;
 
 	// axial planes
 	for( i = 0; i < 6; i++ )
 	{
 		// brush sides
-		s = cms->oct_brushsides + i;
-		s->plane = cms->oct_planes + i;
+		s = ctx->oct_brushsides + i;
+		s->plane = ctx->oct_planes + i;
 		s->surfFlags = 0;
 
 		// planes
-		p = &cms->oct_planes[i];
+		p = &ctx->oct_planes[i];
 		VectorClear( p->normal );
 
 		if( ( i & 1 ) )
@@ -131,12 +131,12 @@ void CM_InitOctagonHull( cmodel_state_t *cms )
 	// non-axial planes
 	for( i = 6; i < 10; i++ ) {
 		// brush sides
-		s = cms->oct_brushsides + i;
-		s->plane = cms->oct_planes + i;
+		s = ctx->oct_brushsides + i;
+		s->plane = ctx->oct_planes + i;
 		s->surfFlags = 0;
 
 		// planes
-		p = &cms->oct_planes[i];
+		p = &ctx->oct_planes[i];
 		VectorCopy( oct_dirs[i-6], p->normal );
 
 		p->type = PLANE_NONAXIAL;
@@ -145,32 +145,94 @@ void CM_InitOctagonHull( cmodel_state_t *cms )
 }
 
 /*
-* CM_ModelForBBox
+* CM_InitTraceContext
+*/
+void CM_InitTraceContext( cmodel_state_t *cms, cmodel_tracectx_t *ctx )
+{
+	CM_InitBoxHull( ctx );
+	CM_InitOctagonHull( ctx );
+}
+
+/*
+* CM_ClearTraceContext
+*/
+void CM_ClearTraceContext( cmodel_state_t *cms, cmodel_tracectx_t *ctx )
+{
+	if( ctx->brushchecks )
+	{
+		Mem_Free( ctx->brushchecks );
+		ctx->brushchecks = NULL;
+		ctx->numbrushchecks = 0;
+	}
+
+	if( ctx->facechecks )
+	{
+		Mem_Free( ctx->facechecks );
+		ctx->facechecks = NULL;
+		ctx->numfacechecks = 0;
+	}
+}
+
+/*
+* CM_NewTraceContext
+*/
+cmodel_tracectx_t *CM_NewTraceContext( cmodel_state_t *cms )
+{
+	cmodel_tracectx_t *ctx;
+
+	ctx = Mem_Alloc( cms->mempool, sizeof( *ctx ) );
+	CM_InitTraceContext( cms, ctx );
+
+	return ctx;
+}
+
+/*
+* CM_FreeTraceContext
+*/
+void CM_FreeTraceContext( cmodel_state_t *cms, cmodel_tracectx_t *ctx )
+{
+	if( !ctx || ctx == &cms->tracectx )
+		return;
+
+	CM_ClearTraceContext( cms, ctx );
+	Mem_Free( ctx );
+}
+
+/*
+* CM_ModelForBBoxCtx
 * 
 * To keep everything totally uniform, bounding boxes are turned into inline models
 */
-cmodel_t *CM_ModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs )
+cmodel_t *CM_ModelForBBoxCtx( cmodel_state_t *cms, cmodel_tracectx_t *ctx, vec3_t mins, vec3_t maxs )
 {
-	cms->box_planes[0].dist = maxs[0];
-	cms->box_planes[1].dist = -mins[0];
-	cms->box_planes[2].dist = maxs[1];
-	cms->box_planes[3].dist = -mins[1];
-	cms->box_planes[4].dist = maxs[2];
-	cms->box_planes[5].dist = -mins[2];
+	ctx->box_planes[0].dist = maxs[0];
+	ctx->box_planes[1].dist = -mins[0];
+	ctx->box_planes[2].dist = maxs[1];
+	ctx->box_planes[3].dist = -mins[1];
+	ctx->box_planes[4].dist = maxs[2];
+	ctx->box_planes[5].dist = -mins[2];
 
-	VectorCopy( mins, cms->box_cmodel->mins );
-	VectorCopy( maxs, cms->box_cmodel->maxs );
+	VectorCopy( mins, ctx->box_cmodel->mins );
+	VectorCopy( maxs, ctx->box_cmodel->maxs );
 
-	return cms->box_cmodel;
+	return ctx->box_cmodel;
 }
 
 /*
-* CM_OctagonModelForBBox
+* CM_ModelForBBox
+*/
+cmodel_t *CM_ModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs )
+{
+	return CM_ModelForBBoxCtx( cms, &cms->tracectx, mins, maxs );
+}
+
+/*
+* CM_OctagonModelForBBoxCtx
 * 
 * Same as CM_ModelForBBox with 4 additional planes at corners.
 * Internally offset to be symmetric on all sides.
 */
-cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs )
+cmodel_t *CM_OctagonModelForBBoxCtx( cmodel_state_t *cms, cmodel_tracectx_t *ctx, vec3_t mins, vec3_t maxs )
 {
 	int i;
 	float a, b, d, t;
@@ -183,16 +245,16 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs
 		size[1][i] = maxs[i] - offset[i];
 	}
 
-	VectorCopy( offset, cms->oct_cmodel->cyl_offset );
-	VectorCopy( size[0], cms->oct_cmodel->mins );
-	VectorCopy( size[1], cms->oct_cmodel->maxs );
+	VectorCopy( offset, ctx->oct_cmodel->cyl_offset );
+	VectorCopy( size[0], ctx->oct_cmodel->mins );
+	VectorCopy( size[1], ctx->oct_cmodel->maxs );
 
-	cms->oct_planes[0].dist = size[1][0];
-	cms->oct_planes[1].dist = -size[0][0];
-	cms->oct_planes[2].dist = size[1][1];
-	cms->oct_planes[3].dist = -size[0][1];
-	cms->oct_planes[4].dist = size[1][2];
-	cms->oct_planes[5].dist = -size[0][2];
+	ctx->oct_planes[0].dist = size[1][0];
+	ctx->oct_planes[1].dist = -size[0][0];
+	ctx->oct_planes[2].dist = size[1][1];
+	ctx->oct_planes[3].dist = -size[0][1];
+	ctx->oct_planes[4].dist = size[1][2];
+	ctx->oct_planes[5].dist = -size[0][2];
 
 	a = size[1][0]; // halfx
 	b = size[1][1]; // halfy
@@ -212,19 +274,27 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs
 
 	// the following should match normals and signbits set in CM_InitOctagonHull
 
-	VectorSet( cms->oct_planes[6].normal, cosa, sina, 0 );
-	cms->oct_planes[6].dist = d;
+	VectorSet( ctx->oct_planes[6].normal, cosa, sina, 0 );
+	ctx->oct_planes[6].dist = d;
+
+	VectorSet( ctx->oct_planes[7].normal, -cosa, sina, 0 );
+	ctx->oct_planes[7].dist = d;
 
-	VectorSet( cms->oct_planes[7].normal, -cosa, sina, 0 );
-	cms->oct_planes[7].dist = d;
+	VectorSet( ctx->oct_planes[8].normal, -cosa, -sina, 0 );
+	ctx->oct_planes[8].dist = d;
 
-	VectorSet( cms->oct_planes[8].normal, -cosa, -sina, 0 );
-	cms->oct_planes[8].dist = d;
+	VectorSet( ctx->oct_planes[9].normal, cosa, -sina, 0 );
+	ctx->oct_planes[9].dist = d;
 
-	VectorSet( cms->oct_planes[9].normal, cosa, -sina, 0 );
-	cms->oct_planes[9].dist = d;
+	return ctx->oct_cmodel;
+}
 
-	return cms->oct_cmodel;
+/*
+* CM_OctagonModelForBBox
+*/
+cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, vec3_t mins, vec3_t maxs )
+{
+	return CM_OctagonModelForBBoxCtx( cms, &cms->tracectx, mins, maxs );
 }
 
 /*
@@ -248,12 +318,20 @@ int CM_PointLeafnum( cmodel_state_t *cms, const vec3_t p )
 	return -1 - num;
 }
 
+typedef struct
+{
+	int count, maxcount;
+	int *list;
+	const float *mins, *maxs;
+	int topnode;
+} cboxleafs_t;
+
 /*
 * CM_BoxLeafnums
 *
 * Fills in a list of all the leafs touched
 */
-static void CM_BoxLeafnums_r( cmodel_state_t *cms, int nodenum )
+static void CM_BoxLeafnums_r( cmodel_state_t *cms, cboxleafs_t *bl, int nodenum )
 {
 	int s;
 	cnode_t	*node;
@@ -261,7 +339,7 @@ static void CM_BoxLeafnums_r( cmodel_state_t *cms, int nodenum )
 	while( nodenum >= 0 )
 	{
 		node = &cms->map_nodes[nodenum];
-		s = BOX_ON_PLANE_SIDE( cms->leaf_mins, cms->leaf_maxs, node->plane ) - 1;
+		s = BOX_ON_PLANE_SIDE( bl->mins, bl->maxs, node->plane ) - 1;
 
 		if( s < 2 )
 		{
@@ -270,35 +348,39 @@ static void CM_BoxLeafnums_r( cmodel_state_t *cms, int nodenum )
 		}
 
 		// go down both sides
-		if( cms->leaf_topnode == -1 )
-			cms->leaf_topnode = nodenum;
-		CM_BoxLeafnums_r( cms, node->children[0] );
+		if( bl->topnode == -1 )
+			bl->topnode = nodenum;
+		CM_BoxLeafnums_r( cms, bl, node->children[0] );
 		nodenum = node->children[1];
 	}
 
-	if( cms->leaf_count < cms->leaf_maxcount )
-		cms->leaf_list[cms->leaf_count++] = -1 - nodenum;
+	if( bl->count < bl->maxcount )
+		bl->list[bl->count++] = -1 - nodenum;
 }
 
 /*
 * CM_BoxLeafnums
+*
+* The walk state lives on the stack so that PVS queries can be
+* issued concurrently against the same map.
 */
 int CM_BoxLeafnums( cmodel_state_t *cms, vec3_t mins, vec3_t maxs, int *list, int listsize, int *topnode )
 {
-	cms->leaf_list = list;
-	cms->leaf_count = 0;
-	cms->leaf_maxcount = listsize;
-	cms->leaf_mins = mins;
-	cms->leaf_maxs = maxs;
+	cboxleafs_t bl;
 
-	cms->leaf_topnode = -1;
+	bl.list = list;
+	bl.count = 0;
+	bl.maxcount = listsize;
+	bl.mins = mins;
+	bl.maxs = maxs;
+	bl.topnode = -1;
 
-	CM_BoxLeafnums_r( cms, 0 );
+	CM_BoxLeafnums_r( cms, &bl, 0 );
 
 	if( topnode )
-		*topnode = cms->leaf_topnode;
+		*topnode = bl.topnode;
 
-	return cms->leaf_count;
+	return bl.count;
 }
 
 /*
@@ -488,24 +570,11 @@ BOX TRACING
 #endif
 #define RADIUS_EPSILON		1.0f
 
-static vec3_t trace_start, trace_end;
-static vec3_t trace_mins, trace_maxs;
-static vec3_t trace_startmins, trace_endmins;
-static vec3_t trace_startmaxs, trace_endmaxs;
-static vec3_t trace_absmins, trace_absmaxs;
-static vec3_t trace_extents;
-
-static trace_t	*trace_trace;
-#ifdef TRACEVICFIX
-static float trace_realfraction;
-#endif
-static int trace_contents;
-static bool trace_ispoint;      // optimized case
 
 /*
 * CM_ClipBoxToBrush
 */
-static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
+static void CM_ClipBoxToBrush( cmodel_tracectx_t *ctx, cbrush_t *brush )
 {
 	int i;
 	cplane_t *p, *clipplane;
@@ -524,7 +593,7 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 	leavefrac = 1;
 	clipplane = NULL;
 
-	c_brush_traces++;
+	ctx->numbrushtraces++;
 
 	getout = false;
 	startout = false;
@@ -538,44 +607,44 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 		// push the plane out apropriately for mins/maxs
 		if( p->type < 3 )
 		{
-			d1 = trace_startmins[p->type] - p->dist;
-			d2 = trace_endmins[p->type] - p->dist;
+			d1 = ctx->startmins[p->type] - p->dist;
+			d2 = ctx->endmins[p->type] - p->dist;
 		}
 		else
 		{
 			switch( p->signbits )
 			{
 			case 0:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*ctx->startmins[0] + p->normal[1]*ctx->startmins[1] + p->normal[2]*ctx->startmins[2] - p->dist;
+				d2 = p->normal[0]*ctx->endmins[0] + p->normal[1]*ctx->endmins[1] + p->normal[2]*ctx->endmins[2] - p->dist;
 				break;
 			case 1:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*ctx->startmaxs[0] + p->normal[1]*ctx->startmins[1] + p->normal[2]*ctx->startmins[2] - p->dist;
+				d2 = p->normal[0]*ctx->endmaxs[0] + p->normal[1]*ctx->endmins[1] + p->normal[2]*ctx->endmins[2] - p->dist;
 				break;
 			case 2:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*ctx->startmins[0] + p->normal[1]*ctx->startmaxs[1] + p->normal[2]*ctx->startmins[2] - p->dist;
+				d2 = p->normal[0]*ctx->endmins[0] + p->normal[1]*ctx->endmaxs[1] + p->normal[2]*ctx->endmins[2] - p->dist;
 				break;
 			case 3:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmins[2] - p->dist;
+				d1 = p->normal[0]*ctx->startmaxs[0] + p->normal[1]*ctx->startmaxs[1] + p->normal[2]*ctx->startmins[2] - p->dist;
+				d2 = p->normal[0]*ctx->endmaxs[0] + p->normal[1]*ctx->endmaxs[1] + p->normal[2]*ctx->endmins[2] - p->dist;
 				break;
 			case 4:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*ctx->startmins[0] + p->normal[1]*ctx->startmins[1] + p->normal[2]*ctx->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*ctx->endmins[0] + p->normal[1]*ctx->endmins[1] + p->normal[2]*ctx->endmaxs[2] - p->dist;
 				break;
 			case 5:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmins[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*ctx->startmaxs[0] + p->normal[1]*ctx->startmins[1] + p->normal[2]*ctx->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*ctx->endmaxs[0] + p->normal[1]*ctx->endmins[1] + p->normal[2]*ctx->endmaxs[2] - p->dist;
 				break;
 			case 6:
-				d1 = p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmins[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*ctx->startmins[0] + p->normal[1]*ctx->startmaxs[1] + p->normal[2]*ctx->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*ctx->endmins[0] + p->normal[1]*ctx->endmaxs[1] + p->normal[2]*ctx->endmaxs[2] - p->dist;
 				break;
 			case 7:
-				d1 = p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] - p->dist;
-				d2 = p->normal[0]*trace_endmaxs[0] + p->normal[1]*trace_endmaxs[1] + p->normal[2]*trace_endmaxs[2] - p->dist;
+				d1 = p->normal[0]*ctx->startmaxs[0] + p->normal[1]*ctx->startmaxs[1] + p->normal[2]*ctx->startmaxs[2] - p->dist;
+				d2 = p->normal[0]*ctx->endmaxs[0] + p->normal[1]*ctx->endmaxs[1] + p->normal[2]*ctx->endmaxs[2] - p->dist;
 				break;
 			default:
 				d1 = d2 = 0; // shut up compiler
@@ -640,42 +709,42 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 	if( !startout )
 	{
 		// original point was inside brush
-		trace_trace->startsolid = true;
-		trace_trace->contents = brush->contents;
+		ctx->trace->startsolid = true;
+		ctx->trace->contents = brush->contents;
 		if( !getout )
 		{
-			trace_trace->allsolid = true;
-			trace_trace->fraction = 0;
+			ctx->trace->allsolid = true;
+			ctx->trace->fraction = 0;
 		}
 		return;
 	}
 #ifdef TRACEVICFIX
 	if( enterfrac - FRAC_EPSILON <= leavefrac )
 	{
-		if( enterfrac > -1 && enterfrac < trace_realfraction )
+		if( enterfrac > -1 && enterfrac < ctx->realfraction )
 		{
 			if( enterfrac < 0 )
 				enterfrac = 0;
-			trace_realfraction = enterfrac;
-			trace_trace->plane = *clipplane;
-			trace_trace->surfFlags = leadside->surfFlags;
-			trace_trace->contents = brush->contents;
-			trace_trace->fraction = ( enterdist - DIST_EPSILON ) / move;
-			if( trace_trace->fraction < 0 )
-				trace_trace->fraction = 0;
+			ctx->realfraction = enterfrac;
+			ctx->trace->plane = *clipplane;
+			ctx->trace->surfFlags = leadside->surfFlags;
+			ctx->trace->contents = brush->contents;
+			ctx->trace->fraction = ( enterdist - DIST_EPSILON ) / move;
+			if( ctx->trace->fraction < 0 )
+				ctx->trace->fraction = 0;
 		}
 	}
 #else
 	if( enterfrac - ( 1.0f / 1024.0f ) <= leavefrac )
 	{
-		if( enterfrac > -1 && enterfrac < trace_trace->fraction )
+		if( enterfrac > -1 && enterfrac < ctx->trace->fraction )
 		{
 			if( enterfrac < 0 )
 				enterfrac = 0;
-			trace_trace->fraction = enterfrac;
-			trace_trace->plane = *clipplane;
-			trace_trace->surfFlags = leadside->surfFlags;
-			trace_trace->contents = brush->contents;
+			ctx->trace->fraction = enterfrac;
+			ctx->trace->plane = *clipplane;
+			ctx->trace->surfFlags = leadside->surfFlags;
+			ctx->trace->contents = brush->contents;
 		}
 	}
 #endif
@@ -684,7 +753,7 @@ static void CM_ClipBoxToBrush( cmodel_state_t *cms, cbrush_t *brush )
 /*
 * CM_TestBoxInBrush
 */
-static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
+static void CM_TestBoxInBrush( cmodel_tracectx_t *ctx, cbrush_t *brush )
 {
 	int i;
 	cplane_t *p;
@@ -702,7 +771,7 @@ static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
 		// if completely in front of face, no intersection
 		if( p->type < 3 )
 		{
-			if( trace_startmins[p->type] > p->dist )
+			if( ctx->startmins[p->type] > p->dist )
 				return;
 		}
 		else
@@ -710,35 +779,35 @@ static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
 			switch( p->signbits )
 			{
 			case 0:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*ctx->startmins[0] + p->normal[1]*ctx->startmins[1] + p->normal[2]*ctx->startmins[2] > p->dist )
 					return;
 				break;
 			case 1:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*ctx->startmaxs[0] + p->normal[1]*ctx->startmins[1] + p->normal[2]*ctx->startmins[2] > p->dist )
 					return;
 				break;
 			case 2:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*ctx->startmins[0] + p->normal[1]*ctx->startmaxs[1] + p->normal[2]*ctx->startmins[2] > p->dist )
 					return;
 				break;
 			case 3:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmins[2] > p->dist )
+				if( p->normal[0]*ctx->startmaxs[0] + p->normal[1]*ctx->startmaxs[1] + p->normal[2]*ctx->startmins[2] > p->dist )
 					return;
 				break;
 			case 4:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*ctx->startmins[0] + p->normal[1]*ctx->startmins[1] + p->normal[2]*ctx->startmaxs[2] > p->dist )
 					return;
 				break;
 			case 5:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmins[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*ctx->startmaxs[0] + p->normal[1]*ctx->startmins[1] + p->normal[2]*ctx->startmaxs[2] > p->dist )
 					return;
 				break;
 			case 6:
-				if( p->normal[0]*trace_startmins[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*ctx->startmins[0] + p->normal[1]*ctx->startmaxs[1] + p->normal[2]*ctx->startmaxs[2] > p->dist )
 					return;
 				break;
 			case 7:
-				if( p->normal[0]*trace_startmaxs[0] + p->normal[1]*trace_startmaxs[1] + p->normal[2]*trace_startmaxs[2] > p->dist )
+				if( p->normal[0]*ctx->startmaxs[0] + p->normal[1]*ctx->startmaxs[1] + p->normal[2]*ctx->startmaxs[2] > p->dist )
 					return;
 				break;
 			default:
@@ -749,18 +818,18 @@ static void CM_TestBoxInBrush( cmodel_state_t *cms, cbrush_t *brush )
 	}
 
 	// inside this brush
-	trace_trace->startsolid = trace_trace->allsolid = true;
-	trace_trace->fraction = 0;
-	trace_trace->contents = brush->contents;
+	ctx->trace->startsolid = ctx->trace->allsolid = true;
+	ctx->trace->fraction = 0;
+	ctx->trace->contents = brush->contents;
 }
 
 /*
 * CM_CollideBox
 */
-static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
-						  int nummarkfaces, void ( *func )( cmodel_state_t *cms, cbrush_t *b ) )
+static void CM_CollideBox( cmodel_state_t *cms, cmodel_tracectx_t *ctx, cbrush_t **markbrushes, int nummarkbrushes,
+						  cface_t **markfaces, int nummarkfaces, bool builtin, void ( *func )( cmodel_tracectx_t *ctx, cbrush_t *b ) )
 {
-	int i, j;
+	int i, j, num;
 	cbrush_t *b;
 	cface_t	*patch;
 	cbrush_t *facet;
@@ -769,13 +838,20 @@ static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int numm
 	for( i = 0; i < nummarkbrushes; i++ )
 	{
 		b = markbrushes[i];
-		if( b->checkcount == cms->checkcount )
-			continue; // already checked this brush
-		b->checkcount = cms->checkcount;
-		if( !( b->contents & trace_contents ) )
+
+		// builtin hulls live outside of map_brushes and are only ever tested once
+		if( !builtin )
+		{
+			num = b - cms->map_brushes;
+			if( ctx->brushchecks[num] == ctx->checkcount )
+				continue; // already checked this brush
+			ctx->brushchecks[num] = ctx->checkcount;
+		}
+
+		if( !( b->contents & ctx->contents ) )
 			continue;
-		func( cms, b );
-		if( !trace_trace->fraction )
+		func( ctx, b );
+		if( !ctx->trace->fraction )
 			return;
 	}
 
@@ -786,18 +862,19 @@ static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int numm
 	for( i = 0; i < nummarkfaces; i++ )
 	{
 		patch = markfaces[i];
-		if( patch->checkcount == cms->checkcount )
+		num = patch - cms->map_faces;
+		if( ctx->facechecks[num] == ctx->checkcount )
 			continue; // already checked this patch
-		patch->checkcount = cms->checkcount;
-		if( !( patch->contents & trace_contents ) )
+		ctx->facechecks[num] = ctx->checkcount;
+		if( !( patch->contents & ctx->contents ) )
 			continue;
-		if( !BoundsIntersect( patch->mins, patch->maxs, trace_absmins, trace_absmaxs ) )
+		if( !BoundsIntersect( patch->mins, patch->maxs, ctx->absmins, ctx->absmaxs ) )
 			continue;
 		facet = patch->facets;
 		for( j = 0; j < patch->numfacets; j++, facet++ )
 		{
-			func( cms, facet );
-			if( !trace_trace->fraction )
+			func( ctx, facet );
+			if( !ctx->trace->fraction )
 				return;
 		}
 	}
@@ -806,25 +883,25 @@ static void CM_CollideBox( cmodel_state_t *cms, cbrush_t **markbrushes, int numm
 /*
 * CM_ClipBox
 */
-static inline void CM_ClipBox( cmodel_state_t *cms, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
-							  int nummarkfaces )
+static inline void CM_ClipBox( cmodel_state_t *cms, cmodel_tracectx_t *ctx, cbrush_t **markbrushes, int nummarkbrushes,
+							  cface_t **markfaces, int nummarkfaces, bool builtin )
 {
-	CM_CollideBox( cms, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_ClipBoxToBrush );
+	CM_CollideBox( cms, ctx, markbrushes, nummarkbrushes, markfaces, nummarkfaces, builtin, CM_ClipBoxToBrush );
 }
 
 /*
 * CM_TestBox
 */
-static inline void CM_TestBox( cmodel_state_t *cms, cbrush_t **markbrushes, int nummarkbrushes, cface_t **markfaces,
-							  int nummarkfaces )
+static inline void CM_TestBox( cmodel_state_t *cms, cmodel_tracectx_t *ctx, cbrush_t **markbrushes, int nummarkbrushes,
+							  cface_t **markfaces, int nummarkfaces, bool builtin )
 {
-	CM_CollideBox( cms, markbrushes, nummarkbrushes, markfaces, nummarkfaces, CM_TestBoxInBrush );
+	CM_CollideBox( cms, ctx, markbrushes, nummarkbrushes, markfaces, nummarkfaces, builtin, CM_TestBoxInBrush );
 }
 
 /*
 * CM_RecursiveHullCheck
 */
-static void CM_RecursiveHullCheck( cmodel_state_t *cms, int num, float p1f, float p2f, vec3_t p1, vec3_t p2 )
+static void CM_RecursiveHullCheck( cmodel_state_t *cms, cmodel_tracectx_t *ctx, int num, float p1f, float p2f, vec3_t p1, vec3_t p2 )
 {
 	cnode_t	*node;
 	cplane_t *plane;
@@ -836,10 +913,10 @@ static void CM_RecursiveHullCheck( cmodel_state_t *cms, int num, float p1f, floa
 
 loc0:
 #ifdef TRACEVICFIX
-	if( trace_realfraction <= p1f )
+	if( ctx->realfraction <= p1f )
 		return; // already hit something nearer
 #else
-	if( trace_trace->fraction <= p1f )
+	if( ctx->trace->fraction <= p1f )
 		return; // already hit something nearer
 #endif
 	// if < 0, we are in a leaf node
@@ -848,8 +925,8 @@ loc0:
 		cleaf_t	*leaf;
 
 		leaf = &cms->map_leafs[-1 - num];
-		if( leaf->contents & trace_contents )
-			CM_ClipBox( cms, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
+		if( leaf->contents & ctx->contents )
+			CM_ClipBox( cms, ctx, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces, false );
 		return;
 	}
 
@@ -864,18 +941,18 @@ loc0:
 	{
 		t1 = p1[plane->type] - plane->dist;
 		t2 = p2[plane->type] - plane->dist;
-		offset = trace_extents[plane->type];
+		offset = ctx->extents[plane->type];
 	}
 	else
 	{
 		t1 = DotProduct( plane->normal, p1 ) - plane->dist;
 		t2 = DotProduct( plane->normal, p2 ) - plane->dist;
-		if( trace_ispoint )
+		if( ctx->ispoint )
 			offset = 0;
 		else
-			offset = fabs( trace_extents[0] * plane->normal[0] ) +
-			fabs( trace_extents[1] * plane->normal[1] ) +
-			fabs( trace_extents[2] * plane->normal[2] );
+			offset = fabs( ctx->extents[0] * plane->normal[0] ) +
+			fabs( ctx->extents[1] * plane->normal[1] ) +
+			fabs( ctx->extents[2] * plane->normal[2] );
 	}
 
 	// see which sides we need to consider
@@ -927,62 +1004,87 @@ loc0:
 	midf = p1f + ( p2f - p1f ) * frac;
 	VectorLerp( p1, frac, p2, mid );
 
-	CM_RecursiveHullCheck( cms, node->children[side], p1f, midf, p1, mid );
+	CM_RecursiveHullCheck( cms, ctx, node->children[side], p1f, midf, p1, mid );
 
 	// go past the node
 	clamp( frac2, 0, 1 );
 	midf = p1f + ( p2f - p1f ) * frac2;
 	VectorLerp( p1, frac2, p2, mid );
 
-	CM_RecursiveHullCheck( cms, node->children[side^1], midf, p2f, mid, p2 );
+	CM_RecursiveHullCheck( cms, ctx, node->children[side^1], midf, p2f, mid, p2 );
 }
 
 //======================================================================
 
+/*
+* CM_AllocTraceChecks
+*
+* (Re)allocates the per-context brush and patch stamps when a bigger map was loaded
+*/
+static void CM_AllocTraceChecks( cmodel_state_t *cms, cmodel_tracectx_t *ctx )
+{
+	if( ctx->numbrushchecks < cms->numbrushes )
+	{
+		if( ctx->brushchecks )
+			Mem_Free( ctx->brushchecks );
+		ctx->numbrushchecks = cms->numbrushes;
+		ctx->brushchecks = Mem_Alloc( cms->mempool, ctx->numbrushchecks * sizeof( *ctx->brushchecks ) );
+	}
+
+	if( ctx->numfacechecks < cms->numfaces )
+	{
+		if( ctx->facechecks )
+			Mem_Free( ctx->facechecks );
+		ctx->numfacechecks = cms->numfaces;
+		ctx->facechecks = Mem_Alloc( cms->mempool, ctx->numfacechecks * sizeof( *ctx->facechecks ) );
+	}
+}
+
 /*
 * CM_BoxTrace
 */
-static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
-						cmodel_t *cmodel, vec3_t origin, int brushmask )
+static void CM_BoxTrace( cmodel_state_t *cms, cmodel_tracectx_t *ctx, trace_t *tr, vec3_t start, vec3_t end,
+						vec3_t mins, vec3_t maxs, cmodel_t *cmodel, vec3_t origin, int brushmask )
 {
 	bool notworld;
 
 	notworld = ( cmodel != cms->map_cmodels ? true : false );
 
-	cms->checkcount++;  // for multi-check avoidance
-	c_traces++;     // for statistics, may be zeroed
-
 	// fill in a default trace
 	memset( tr, 0, sizeof( *tr ) );
 #ifdef TRACEVICFIX
-	tr->fraction = trace_realfraction = 1;
+	tr->fraction = ctx->realfraction = 1;
 #else
 	tr->fraction = 1;
 #endif
 	if( !cms->numnodes )  // map not loaded
 		return;
 
-	trace_trace = tr;
-	trace_contents = brushmask;
-	VectorCopy( start, trace_start );
-	VectorCopy( end, trace_end );
-	VectorCopy( mins, trace_mins );
-	VectorCopy( maxs, trace_maxs );
+	if( ctx->numbrushchecks < cms->numbrushes || ctx->numfacechecks < cms->numfaces )
+		CM_AllocTraceChecks( cms, ctx );
+	ctx->checkcount++;  // for multi-check avoidance
+
+	ctx->trace = tr;
+	ctx->contents = brushmask;
+	VectorCopy( start, ctx->start );
+	VectorCopy( end, ctx->end );
+	VectorCopy( mins, ctx->mins );
+	VectorCopy( maxs, ctx->maxs );
 
 	// build a bounding box of the entire move
-	ClearBounds( trace_absmins, trace_absmaxs );
+	ClearBounds( ctx->absmins, ctx->absmaxs );
 
-	VectorAdd( start, trace_mins, trace_startmins );
-	AddPointToBounds( trace_startmins, trace_absmins, trace_absmaxs );
+	VectorAdd( start, ctx->mins, ctx->startmins );
+	AddPointToBounds( ctx->startmins, ctx->absmins, ctx->absmaxs );
 
-	VectorAdd( start, trace_maxs, trace_startmaxs );
-	AddPointToBounds( trace_startmaxs, trace_absmins, trace_absmaxs );
+	VectorAdd( start, ctx->maxs, ctx->startmaxs );
+	AddPointToBounds( ctx->startmaxs, ctx->absmins, ctx->absmaxs );
 
-	VectorAdd( end, trace_mins, trace_endmins );
-	AddPointToBounds( trace_endmins, trace_absmins, trace_absmaxs );
+	VectorAdd( end, ctx->mins, ctx->endmins );
+	AddPointToBounds( ctx->endmins, ctx->absmins, ctx->absmaxs );
 
-	VectorAdd( end, trace_maxs, trace_endmaxs );
-	AddPointToBounds( trace_endmaxs, trace_absmins, trace_absmaxs );
+	VectorAdd( end, ctx->maxs, ctx->endmaxs );
+	AddPointToBounds( ctx->endmaxs, ctx->absmins, ctx->absmaxs );
 
 	//
 	// check for position test special case
@@ -997,9 +1099,9 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 
 		if( notworld )
 		{
-			if( BoundsIntersect( cmodel->mins, cmodel->maxs, trace_absmins, trace_absmaxs ) )
+			if( BoundsIntersect( cmodel->mins, cmodel->maxs, ctx->absmins, ctx->absmaxs ) )
 			{
-				CM_TestBox( cms, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
+				CM_TestBox( cms, ctx, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces, cmodel->builtin );
 			}
 		}
 		else
@@ -1015,9 +1117,9 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 			{
 				leaf = &cms->map_leafs[leafs[i]];
 
-				if( leaf->contents & trace_contents )
+				if( leaf->contents & ctx->contents )
 				{
-					CM_TestBox( cms, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces );
+					CM_TestBox( cms, ctx, leaf->markbrushes, leaf->nummarkbrushes, leaf->markfaces, leaf->nummarkfaces, false );
 					if( tr->allsolid )
 						break;
 				}
@@ -1033,13 +1135,13 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 	//
 	if( VectorCompare( mins, vec3_origin ) && VectorCompare( maxs, vec3_origin ) )
 	{
-		trace_ispoint = true;
-		VectorClear( trace_extents );
+		ctx->ispoint = true;
+		VectorClear( ctx->extents );
 	}
 	else
 	{
-		trace_ispoint = false;
-		VectorSet( trace_extents,
+		ctx->ispoint = false;
+		VectorSet( ctx->extents,
 			-mins[0] > maxs[0] ? -mins[0] : maxs[0],
 			-mins[1] > maxs[1] ? -mins[1] : maxs[1],
 			-mins[2] > maxs[2] ? -mins[2] : maxs[2] );
@@ -1049,9 +1151,9 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 	// general sweeping through world
 	//
 	if( !notworld )
-		CM_RecursiveHullCheck( cms, 0, 0, 1, start, end );
-	else if( BoundsIntersect( cmodel->mins, cmodel->maxs, trace_absmins, trace_absmaxs ) )
-		CM_ClipBox( cms, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces );
+		CM_RecursiveHullCheck( cms, ctx, 0, 0, 1, start, end );
+	else if( BoundsIntersect( cmodel->mins, cmodel->maxs, ctx->absmins, ctx->absmaxs ) )
+		CM_ClipBox( cms, ctx, cmodel->markbrushes, cmodel->nummarkbrushes, cmodel->markfaces, cmodel->nummarkfaces, cmodel->builtin );
 
 #ifdef TRACEVICFIX
 	clamp( tr->fraction, 0, 1 );
@@ -1071,13 +1173,13 @@ static void CM_BoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t
 }
 
 /*
-* CM_TransformedBoxTrace
+* CM_TransformedBoxTraceCtx
 *
 * Handles offseting and rotation of the end points for moving and
 * rotating entities
 */
-void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
-							cmodel_t *cmodel, int brushmask, vec3_t origin, vec3_t angles )
+void CM_TransformedBoxTraceCtx( cmodel_state_t *cms, cmodel_tracectx_t *ctx, trace_t *tr, vec3_t start, vec3_t end,
+							   vec3_t mins, vec3_t maxs, cmodel_t *cmodel, int brushmask, vec3_t origin, vec3_t angles )
 {
 	vec3_t start_l, end_l;
 	vec3_t a, temp;
@@ -1108,8 +1210,9 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec
 		return;
 	}
 
-	// cylinder offset
-	if( cmodel == cms->oct_cmodel )
+	// cylinder offset, the octagon hull may come from any context
+	// and is the only builtin model with a non-zero offset
+	if( cmodel->builtin )
 	{
 		VectorSubtract( start, cmodel->cyl_offset, start_l );
 		VectorSubtract( end, cmodel->cyl_offset, end_l );
@@ -1150,7 +1253,12 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec
 	}
 
 	// sweep the box through the model
-	CM_BoxTrace( cms, tr, start_l, end_l, mins, maxs, cmodel, origin, brushmask );
+	ctx->numbrushtraces = 0;
+	CM_BoxTrace( cms, ctx, tr, start_l, end_l, mins, maxs, cmodel, origin, brushmask );
+
+	// for statistics, traces may run on several threads at once
+	QAtomic_Add( &c_traces, 1, NULL );
+	QAtomic_Add( &c_brush_traces, ctx->numbrushtraces, NULL );
 
 	if( rotated && tr->fraction != 1.0 )
 	{
@@ -1174,3 +1282,12 @@ void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec
 #endif
 	}
 }
+
+/*
+* CM_TransformedBoxTrace
+*/
+void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
+							cmodel_t *cmodel, int brushmask, vec3_t origin, vec3_t angles )
+{
+	CM_TransformedBoxTraceCtx( cms, &cms->tracectx, tr, start, end, mins, maxs, cmodel, brushmask, origin, angles );
+}
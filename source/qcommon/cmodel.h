@@ -19,6 +19,7 @@
  */
 
 typedef struct cmodel_state_s cmodel_state_t;
+typedef struct cmodel_tracectx_s cmodel_tracectx_t;
 
 extern cvar_t *cm_noCurves;
 
@@ -50,6 +51,18 @@ int CM_TransformedPointContents( cmodel_state_t *cms, vec3_t p, struct cmodel_s
 void CM_TransformedBoxTrace( cmodel_state_t *cms, trace_t *tr, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
                              struct cmodel_s *cmodel, int brushmask, vec3_t origin, vec3_t angles );
 
+// trace contexts hold all the scratch state of a trace and the temporary bbox hulls,
+// each thread that traces against a shared map must use a context of its own,
+// the functions above use the default context of the map and are not reentrant
+cmodel_tracectx_t *CM_NewTraceContext( cmodel_state_t *cms );
+void CM_FreeTraceContext( cmodel_state_t *cms, cmodel_tracectx_t *ctx );
+
+struct cmodel_s *CM_ModelForBBoxCtx( cmodel_state_t *cms, cmodel_tracectx_t *ctx, vec3_t mins, vec3_t maxs );
+struct cmodel_s *CM_OctagonModelForBBoxCtx( cmodel_state_t *cms, cmodel_tracectx_t *ctx, vec3_t mins, vec3_t maxs );
+
+void CM_TransformedBoxTraceCtx( cmodel_state_t *cms, cmodel_tracectx_t *ctx, trace_t *tr, vec3_t start, vec3_t end,
+                                vec3_t mins, vec3_t maxs, struct cmodel_s *cmodel, int brushmask, vec3_t origin, vec3_t angles );
+
 void CM_RoundUpToHullSize( cmodel_state_t *cms, vec3_t mins, vec3_t maxs, struct cmodel_s *cmodel );
 
 uint8_t *CM_ClusterPVS( cmodel_state_t *cms, int cluster );
@@ -76,6 +89,7 @@ bool CM_HeadnodeVisible( cmodel_state_t *cms, int headnode, uint8_t *visbits );
 void CM_WritePortalState( cmodel_state_t *cms, int file );
 void CM_ReadPortalState( cmodel_state_t *cms, int file );
 
+int CM_PVSClusters( cmodel_state_t *cms, vec3_t org, int *clusters, int maxclusters );
 void CM_MergePVS( cmodel_state_t *cms, vec3_t org, uint8_t *out );
 void CM_MergePHS( cmodel_state_t *cms, int cluster, uint8_t *out );
 int CM_MergeVisSets( cmodel_state_t *cms, vec3_t org, uint8_t *pvs, uint8_t *areabits );
@@ -1083,6 +1083,9 @@ void Qcommon_Frame( unsigned int realmsec )
 	if( setjmp( abortframe ) )
 		return; // an ERR_DROP was thrown
 
+	// everything allocated for the previous frame is gone now
+	Mem_ResetFrameArena();
+
 	if( log_stats->modified )
 	{
 		log_stats->modified = false;
@@ -176,6 +176,8 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, cvar_flag_t flags
 			userinfo_modified = true; // transmit at next oportunity
 
 		Cvar_FlagSet( &var->flags, flags );
+		if( Cvar_FlagIsSet( var->flags, CVAR_SERVERINFO ) )
+			serverinfo_modified = true;
 		return var;
 	}
 
@@ -198,6 +200,9 @@ cvar_t *Cvar_Get( const char *var_name, const char *var_value, cvar_flag_t flags
 	var->integer = Q_rint( var->value );
 	var->flags = flags;
 
+	if( Cvar_FlagIsSet( flags, CVAR_SERVERINFO ) )
+		serverinfo_modified = true;
+
 	QMutex_Lock( cvar_mutex );
 	Trie_Insert( cvar_trie, var_name, var );
 	QMutex_Unlock( cvar_mutex );
@@ -293,6 +298,8 @@ static cvar_t *Cvar_Set2( const char *var_name, const char *value, bool force )
 					var->value = atof( var->string );
 					var->integer = Q_rint( var->value );
 					Cvar_SetModified( var );
+					if( Cvar_FlagIsSet( var->flags, CVAR_SERVERINFO ) )
+						serverinfo_modified = true;
 				}
 			}
 			return var;
@@ -314,6 +321,8 @@ static cvar_t *Cvar_Set2( const char *var_name, const char *value, bool force )
 
 	if( Cvar_FlagIsSet( var->flags, CVAR_USERINFO ) )
 		userinfo_modified = true; // transmit at next oportunity
+	if( Cvar_FlagIsSet( var->flags, CVAR_SERVERINFO ) )
+		serverinfo_modified = true;
 
 	Mem_ZoneFree( var->string ); // free the old value string
 
@@ -353,6 +362,9 @@ cvar_t *Cvar_FullSet( const char *var_name, const char *value, cvar_flag_t flags
 	if( !var )
 		return Cvar_Get( var_name, value, flags );
 
+	if( Cvar_FlagIsSet( var->flags, CVAR_SERVERINFO ) || Cvar_FlagIsSet( flags, CVAR_SERVERINFO ) )
+		serverinfo_modified = true;
+
 	if( overwrite_flags )
 	{
 		var->flags = flags;
@@ -416,6 +428,8 @@ void Cvar_GetLatchedVars( cvar_flag_t flags )
 		var->latched_string = NULL;
 		var->value = atof( var->string );
 		var->integer = Q_rint( var->value );
+		if( Cvar_FlagIsSet( var->flags, CVAR_SERVERINFO ) )
+			serverinfo_modified = true;
 	}
 	Trie_FreeDump( dump );
 }
@@ -445,6 +459,8 @@ void Cvar_FixCheatVars( void )
 		var->string = ZoneCopyString( var->dvalue );
 		var->value = atof( var->string );
 		var->integer = Q_rint( var->value );
+		if( Cvar_FlagIsSet( var->flags, CVAR_SERVERINFO ) )
+			serverinfo_modified = true;
 	}
 	Trie_FreeDump( dump );
 }
@@ -710,6 +726,7 @@ static void Cvar_ArchiveList_f( void )
 #endif
 
 bool userinfo_modified;
+bool serverinfo_modified;
 
 static char *Cvar_BitInfo( int bit )
 {
@@ -71,10 +71,10 @@ static const char *forbidden_gamedirs[] = {
 
 typedef struct
 {
-	unsigned char readBuffer[FS_ZIP_BUFSIZE]; // internal buffer for compressed data
 	z_stream zstream;                       // zLib stream structure for inflate
 	size_t compressedSize;
 	size_t restReadCompressed;            // number of bytes to be decompressed
+	unsigned char readBuffer[FS_ZIP_BUFSIZE]; // internal buffer for compressed data, not allocated for mapped paks
 } zipEntry_t;
 
 #define FS_PACKFILE_DEFLATED	    1
@@ -108,6 +108,8 @@ typedef struct pack_s
 	struct pack_s *deferred_pack;
 	void *sysHandle;
 	void *vfsHandle;
+	uint8_t *mapping;   // whole pak mapped to memory, if available
+	size_t mappingSize;
 	int numFiles;
 	packfile_t *files;
 	char *fileNames;
@@ -117,6 +119,7 @@ typedef struct pack_s
 typedef struct filehandle_s
 {
 	FILE *fstream;
+	const uint8_t *mapping;		// data of a file from a mapped pak
 	unsigned pakOffset;
 	unsigned uncompressedSize;		// uncompressed size
 	unsigned offset;				// current read/write pos
@@ -156,6 +159,7 @@ static cvar_t *fs_cdpath;
 static cvar_t *fs_usehomedir;
 static cvar_t *fs_basegame;
 static cvar_t *fs_game;
+static cvar_t *fs_usemmap;
 
 static searchpath_t *fs_basepaths = NULL;       // directories without gamedirs
 static searchpath_t *fs_searchpaths = NULL;     // game search directories, plus paks
@@ -200,20 +204,14 @@ static inline unsigned short LittleShortRaw( const uint8_t *raw )
 }
 
 /*
-* FS_PK3CheckFileCoherency
+* FS_PK3CheckLocalHeader
 * 
-* Read the local header of the current zipfile
 * Check the coherency of the local header and info in the end of central directory about this file
 */
-static unsigned FS_PK3CheckFileCoherency( FILE *f, packfile_t *file )
+static unsigned FS_PK3CheckLocalHeader( const unsigned char *localHeader, packfile_t *file )
 {
 	unsigned flags;
-	unsigned char localHeader[31], compressed;
-
-	if( fseek( f, Sys_VFS_FileOffset( file->vfsHandle ) + file->offset, SEEK_SET ) != 0 )
-		return 0;
-	if( fread( localHeader, 1, sizeof( localHeader ), f ) != sizeof( localHeader ) )
-		return 0;
+	unsigned char compressed;
 
 	// check the magic
 	if( LittleLongRaw( &localHeader[0] ) != FS_ZIP_LOCALHEADERMAGIC )
@@ -233,6 +231,42 @@ static unsigned FS_PK3CheckFileCoherency( FILE *f, packfile_t *file )
 	return FS_ZIP_SIZELOCALHEADER + LittleShortRaw( &localHeader[26] ) + ( unsigned )LittleShortRaw( &localHeader[28] );
 }
 
+/*
+* FS_PK3CheckFileCoherency
+*/
+static unsigned FS_PK3CheckFileCoherency( FILE *f, packfile_t *file )
+{
+	unsigned char localHeader[31];
+
+	if( fseek( f, Sys_VFS_FileOffset( file->vfsHandle ) + file->offset, SEEK_SET ) != 0 )
+		return 0;
+	if( fread( localHeader, 1, sizeof( localHeader ), f ) != sizeof( localHeader ) )
+		return 0;
+
+	return FS_PK3CheckLocalHeader( localHeader, file );
+}
+
+/*
+* FS_PK3CheckMappedFileCoherency
+*/
+static unsigned FS_PK3CheckMappedFileCoherency( pack_t *pack, packfile_t *file )
+{
+	unsigned offset;
+
+	if( (size_t)file->offset + 31 > pack->mappingSize )
+		return 0;
+
+	offset = FS_PK3CheckLocalHeader( pack->mapping + file->offset, file );
+	if( !offset || (size_t)file->offset + offset + file->compressedSize > pack->mappingSize )
+		return 0;
+
+	// stored members are copied straight out of the mapping
+	if( !( file->flags & FS_PACKFILE_DEFLATED ) && file->compressedSize != file->uncompressedSize )
+		return 0;
+
+	return offset;
+}
+
 static int FS_SortStrings( const char **first, const char **second )
 {
 	return Q_stricmp( *first, *second );
@@ -262,6 +296,9 @@ static char **FS_ListFiles( char *findname, int *numfiles, unsigned musthave, un
 	int nfiles = 0;
 	static char **list = NULL;
 
+	// the find functions aren't reentrant and are shared with the file index
+	QMutex_Lock( fs_mutex );
+
 	s = Sys_FS_FindFirst( findname, musthave, canthave );
 	while( s )
 	{
@@ -272,7 +309,10 @@ static char **FS_ListFiles( char *findname, int *numfiles, unsigned musthave, un
 	Sys_FS_FindClose();
 
 	if( !nfiles )
+	{
+		QMutex_Unlock( fs_mutex );
 		return NULL;
+	}
 
 	*numfiles = nfiles;
 	nfiles++; // add space for a guard
@@ -295,6 +335,8 @@ static char **FS_ListFiles( char *findname, int *numfiles, unsigned musthave, un
 	}
 	Sys_FS_FindClose();
 
+	QMutex_Unlock( fs_mutex );
+
 	list[nfiles] = NULL;
 	return list;
 }
@@ -369,62 +411,413 @@ static int FS_FileLength( FILE *f, bool close )
 }
 
 /*
-* FS_SearchPathForFile
-* 
-* Gives the searchpath element where this file exists, or NULL if it doesn't
+* File index
+*
+* Every file the searchpaths can provide, hashed by name, so that lookups don't
+* have to walk all pak tries and probe every game directory with fopen. The index
+* is rebuilt on demand after the searchpaths, the pure paks or the contents of
+* the game directories change through the filesystem API.
 */
-static searchpath_t *FS_SearchPathForFile( const char *filename, packfile_t **pout, char *path, size_t path_size, int mode )
+
+#define FS_FILEINDEX_PURE_PAK	0
+#define FS_FILEINDEX_PAK		1
+#define FS_FILEINDEX_DIR		2
+
+#define FS_FILEINDEX_MIN_HASH_SIZE	1024
+#define FS_FILEINDEX_NAMES_BLOCK	0x10000
+
+typedef struct fs_indexentry_s
 {
+	const char *name;
+	unsigned hash;
+	int kind;
+	int order;                      // position of the searchpath in fs_searchpaths
 	searchpath_t *search;
-	bool purepass;
+	packfile_t *pakFile;
+	struct fs_indexentry_s *hashNext;
+} fs_indexentry_t;
 
-	if( !COM_ValidateRelativeFilename( filename ) )
-		return NULL;
+typedef struct fs_indexnames_s
+{
+	size_t size, used;
+	struct fs_indexnames_s *next;
+	char data[1];
+} fs_indexnames_t;
 
-	if( path && path_size )
-		path[0] = '\0';
+typedef struct
+{
+	bool valid;
+	int numSearchPaths;
 
-	// search through the path, one element at a time
-	search = fs_searchpaths;
-	purepass = true;
-	while( search )
+	int numEntries, maxEntries;
+	fs_indexentry_t *entries;
+
+	unsigned hashSize;              // power of two
+	fs_indexentry_t **hashTable;
+
+	fs_indexnames_t *names;         // names of loose files, pak files point to their pak
+} fs_fileindex_t;
+
+static fs_fileindex_t fs_fileindex;
+
+/*
+* FS_FileIndexHash
+*/
+static unsigned FS_FileIndexHash( const char *name, size_t len )
+{
+	size_t i;
+	unsigned hash = 0;
+
+	for( i = 0; i < len && name[i]; i++ )
+		hash = hash * 31 + tolower( ( unsigned char )name[i] );
+	return hash;
+}
+
+/*
+* FS_FileIndexDirCmp
+* 
+* Loose files are case sensitive, unless the host filesystem isn't
+*/
+static int FS_FileIndexDirCmp( const char *name1, const char *name2, size_t len )
+{
+#ifdef _WIN32
+	return Q_strnicmp( name1, name2, len );
+#else
+	return strncmp( name1, name2, len );
+#endif
+}
+
+/*
+* FS_FreeFileIndex
+*/
+static void FS_FreeFileIndex( void )
+{
+	fs_indexnames_t *names, *next;
+
+	for( names = fs_fileindex.names; names; names = next )
 	{
-		// is the element a pak file?
-		if( search->pack )
+		next = names->next;
+		FS_Free( names );
+	}
+
+	if( fs_fileindex.entries )
+		FS_Free( fs_fileindex.entries );
+	if( fs_fileindex.hashTable )
+		FS_Free( fs_fileindex.hashTable );
+
+	memset( &fs_fileindex, 0, sizeof( fs_fileindex ) );
+}
+
+/*
+* FS_InvalidateFileIndex
+*/
+static void FS_InvalidateFileIndex( void )
+{
+	QMutex_Lock( fs_mutex );
+	fs_fileindex.valid = false;
+	QMutex_Unlock( fs_mutex );
+}
+
+/*
+* FS_FileIndexCopyName
+*/
+static const char *FS_FileIndexCopyName( const char *name )
+{
+	size_t len = strlen( name ) + 1;
+	fs_indexnames_t *names = fs_fileindex.names;
+	char *out;
+
+	if( !names || names->used + len > names->size )
+	{
+		size_t size = max( len, FS_FILEINDEX_NAMES_BLOCK );
+
+		names = ( fs_indexnames_t * )FS_Malloc( sizeof( *names ) + size );
+		names->size = size;
+		names->used = 0;
+		names->next = fs_fileindex.names;
+		fs_fileindex.names = names;
+	}
+
+	out = names->data + names->used;
+	memcpy( out, name, len );
+	names->used += len;
+	return out;
+}
+
+/*
+* FS_AddFileIndexEntry
+*/
+static void FS_AddFileIndexEntry( const char *name, int kind, int order, searchpath_t *search, packfile_t *pakFile )
+{
+	fs_indexentry_t *entry;
+
+	if( fs_fileindex.numEntries == fs_fileindex.maxEntries )
+	{
+		fs_fileindex.maxEntries = max( fs_fileindex.maxEntries * 2, FS_FILEINDEX_MIN_HASH_SIZE );
+		if( fs_fileindex.entries )
+			fs_fileindex.entries = ( fs_indexentry_t * )FS_Realloc( fs_fileindex.entries, 
+				fs_fileindex.maxEntries * sizeof( fs_indexentry_t ) );
+		else
+			fs_fileindex.entries = ( fs_indexentry_t * )FS_Malloc( fs_fileindex.maxEntries * sizeof( fs_indexentry_t ) );
+	}
+
+	entry = &fs_fileindex.entries[fs_fileindex.numEntries++];
+	entry->name = name;
+	entry->hash = FS_FileIndexHash( name, strlen( name ) );
+	entry->kind = kind;
+	entry->order = order;
+	entry->search = search;
+	entry->pakFile = pakFile;
+	entry->hashNext = NULL;
+}
+
+/*
+* FS_IndexDirectory
+* 
+* Adds every file under the game directory, breadth first since the find
+* functions can't be nested
+*/
+static void FS_IndexDirectory( searchpath_t *search, int order )
+{
+	int numDirs, maxDirs;
+	const char **dirs;
+	const char *s;
+	size_t pathlen;
+	char pattern[FS_MAX_PATH];
+
+	numDirs = 0;
+	maxDirs = 16;
+	dirs = ( const char ** )Mem_TempMalloc( maxDirs * sizeof( *dirs ) );
+	dirs[numDirs++] = "";
+
+	pathlen = strlen( search->path ) + 1;
+	while( numDirs )
+	{
+		Q_snprintfz( pattern, sizeof( pattern ), "%s/%s*.*", search->path, dirs[--numDirs] );
+
+		for( s = Sys_FS_FindFirst( pattern, 0, 0 ); s; s = Sys_FS_FindNext( 0, 0 ) )
 		{
-			if( mode & FS_SEARCH_PAKS )
+			const char *name;
+			size_t len;
+
+			// entries shorter than the search path have no name to read
+			if( strlen( s ) <= pathlen )
+				continue;
+
+			name = s + pathlen;
+			len = strlen( name );
+			if( pathlen + len + 1 >= FS_MAX_PATH )
+				continue;
+
+			if( name[len-1] == '/' )
 			{
-				if( search->pack->pure == purepass )
+				if( numDirs == maxDirs )
 				{
-					if( FS_SearchPakForFile( search->pack, filename, pout ) )
-						return search;
+					const char **newdirs = ( const char ** )Mem_TempMalloc( maxDirs * 2 * sizeof( *dirs ) );
+					memcpy( newdirs, dirs, maxDirs * sizeof( *dirs ) );
+					Mem_TempFree( dirs );
+					dirs = newdirs;
+					maxDirs *= 2;
 				}
+				dirs[numDirs++] = FS_FileIndexCopyName( name );
+				continue;
 			}
+
+			// anything that isn't reported as a directory is indexed as a file, including
+			// symlinks to directories: lookups below such names fall back to fopen
+			FS_AddFileIndexEntry( FS_FileIndexCopyName( name ), FS_FILEINDEX_DIR, order, search, NULL );
+		}
+		Sys_FS_FindClose();
+	}
+
+	Mem_TempFree( dirs );
+}
+
+/*
+* FS_BuildFileIndex
+*/
+static void FS_BuildFileIndex( void )
+{
+	int i, order;
+	unsigned hashSize;
+	searchpath_t *search;
+	fs_indexentry_t *entry, *other;
+
+	FS_FreeFileIndex();
+
+	for( search = fs_searchpaths, order = 0; search; search = search->next, order++ )
+	{
+		if( search->pack )
+		{
+			pack_t *pack = search->pack;
+			int kind = pack->pure ? FS_FILEINDEX_PURE_PAK : FS_FILEINDEX_PAK;
+
+			// pak tries keep the last of duplicate names, so add them backwards
+			for( i = pack->numFiles - 1; i >= 0; i-- )
+				FS_AddFileIndexEntry( pack->files[i].name, kind, order, search, &pack->files[i] );
 		}
 		else
 		{
-			if( mode & FS_SEARCH_DIRS )
+			FS_IndexDirectory( search, order );
+		}
+	}
+
+	for( hashSize = FS_FILEINDEX_MIN_HASH_SIZE; hashSize < (unsigned)fs_fileindex.numEntries; hashSize <<= 1 );
+
+	fs_fileindex.numSearchPaths = order;
+	fs_fileindex.hashSize = hashSize;
+	fs_fileindex.hashTable = ( fs_indexentry_t ** )FS_Malloc( hashSize * sizeof( *fs_fileindex.hashTable ) );
+
+	// entries come in searchpath order, so only the first pak file of each kind is kept
+	// per name, while loose files are kept for every directory for the fopen fallback
+	for( i = 0, entry = fs_fileindex.entries; i < fs_fileindex.numEntries; i++, entry++ )
+	{
+		fs_indexentry_t **bucket = &fs_fileindex.hashTable[entry->hash & ( hashSize - 1 )];
+
+		if( entry->kind != FS_FILEINDEX_DIR )
+		{
+			for( other = *bucket; other; other = other->hashNext )
 			{
-				if( !purepass )
-				{
-					if( FS_SearchDirectoryForFile( search, filename, path, path_size ) )
-						return search;
-				}
+				if( other->kind == entry->kind && other->hash == entry->hash && !Q_stricmp( other->name, entry->name ) )
+					break;
 			}
+			if( other )
+				continue;
 		}
 
-		if( !search->next && purepass )
+		entry->hashNext = *bucket;
+		*bucket = entry;
+	}
+
+	fs_fileindex.valid = true;
+}
+
+/*
+* FS_SearchFileIndex
+* 
+* Returns the searchpath which wins the file for the search mode, along with its
+* rank in the pure pass then impure pass order. Must be called with fs_mutex held.
+*/
+static searchpath_t *FS_SearchFileIndex( const char *filename, packfile_t **pout, char *path, size_t path_size, int mode, int *prank )
+{
+	int rank, bestRank;
+	unsigned hash;
+	size_t len;
+	const char *p;
+	fs_indexentry_t *entry;
+	searchpath_t *best;
+	packfile_t *bestFile;
+	char tempname[FS_MAX_PATH];
+
+	if( !fs_fileindex.valid )
+		FS_BuildFileIndex();
+
+	best = NULL;
+	bestFile = NULL;
+	bestRank = INT_MAX;
+
+	len = strlen( filename );
+	hash = FS_FileIndexHash( filename, len );
+	for( entry = fs_fileindex.hashTable[hash & ( fs_fileindex.hashSize - 1 )]; entry; entry = entry->hashNext )
+	{
+		if( entry->hash != hash )
+			continue;
+
+		if( entry->kind == FS_FILEINDEX_DIR )
 		{
-			search = fs_searchpaths;
-			purepass = false;
+			if( !( mode & FS_SEARCH_DIRS ) || FS_FileIndexDirCmp( entry->name, filename, len + 1 ) )
+				continue;
 		}
 		else
 		{
-			search = search->next;
+			if( !( mode & FS_SEARCH_PAKS ) || Q_stricmp( entry->name, filename ) )
+				continue;
+		}
+
+		rank = entry->order;
+		if( entry->kind != FS_FILEINDEX_PURE_PAK )
+			rank += fs_fileindex.numSearchPaths;
+
+		if( rank < bestRank )
+		{
+			best = entry->search;
+			bestFile = entry->pakFile;
+			bestRank = rank;
 		}
 	}
 
-	return NULL;
+	// the directory walk doesn't descend into symlinked directories, so probe files below them
+	if( mode & FS_SEARCH_DIRS )
+	{
+		for( p = strchr( filename, '/' ); p; p = strchr( p + 1, '/' ) )
+		{
+			size_t prefixlen = p - filename;
+
+			hash = FS_FileIndexHash( filename, prefixlen );
+			for( entry = fs_fileindex.hashTable[hash & ( fs_fileindex.hashSize - 1 )]; entry; entry = entry->hashNext )
+			{
+				FILE *f;
+
+				if( entry->kind != FS_FILEINDEX_DIR || entry->hash != hash )
+					continue;
+				if( entry->name[prefixlen] || FS_FileIndexDirCmp( entry->name, filename, prefixlen ) )
+					continue;
+
+				rank = entry->order + fs_fileindex.numSearchPaths;
+				if( rank >= bestRank )
+					continue;
+
+				Q_snprintfz( tempname, sizeof( tempname ), "%s/%s", entry->search->path, filename );
+				if( ( f = fopen( tempname, "rb" ) ) != NULL )
+				{
+					fclose( f );
+					best = entry->search;
+					bestFile = NULL;
+					bestRank = rank;
+				}
+			}
+		}
+	}
+
+	if( prank )
+		*prank = bestRank;
+
+	if( !best )
+		return NULL;
+
+	if( bestFile )
+	{
+		if( pout )
+			*pout = bestFile;
+	}
+	else if( path )
+	{
+		Q_snprintfz( path, path_size, "%s/%s", best->path, filename );
+	}
+
+	return best;
+}
+
+/*
+* FS_SearchPathForFile
+* 
+* Gives the searchpath element where this file exists, or NULL if it doesn't
+*/
+static searchpath_t *FS_SearchPathForFile( const char *filename, packfile_t **pout, char *path, size_t path_size, int mode )
+{
+	searchpath_t *search;
+
+	if( !COM_ValidateRelativeFilename( filename ) )
+		return NULL;
+
+	if( path && path_size )
+		path[0] = '\0';
+
+	QMutex_Lock( fs_mutex );
+	search = FS_SearchFileIndex( filename, pout, path, path_size, mode, NULL );
+	QMutex_Unlock( fs_mutex );
+
+	return search;
 }
 
 /*
@@ -646,8 +1039,8 @@ const char *FS_FirstExtension( const char *filename, const char *extensions[], i
 	size_t filename_size;       // size of one slot
 	int i;
 	size_t max_extension_length;
-	searchpath_t *search;
-	bool purepass;
+	int rank, bestRank;
+	const char *extension;
 
 	assert( filename && extensions );
 
@@ -683,56 +1076,25 @@ const char *FS_FirstExtension( const char *filename, const char *extensions[], i
 		COM_ReplaceExtension( filenames[i], extensions[i], filename_size );
 	}
 
-	// search through the path, one element at a time
-	search = fs_searchpaths;
-	purepass = true;
-	while( search )
+	// the winner is the first searchpath having any of the names, in extension order
+	extension = NULL;
+	bestRank = INT_MAX;
+
+	QMutex_Lock( fs_mutex );
+	for( i = 0; i < num_extensions; i++ )
 	{
-		if( search->pack ) // is the element a pak file?
-		{
-			if( search->pack->pure == purepass )
-			{
-				for( i = 0; i < num_extensions; i++ )
-				{
-					if( FS_SearchPakForFile( search->pack, filenames[i], NULL ) )
-					{
-						Mem_TempFree( filenames[0] );
-						Mem_TempFree( filenames );
-						return extensions[i];
-					}
-				}
-			}
-		}
-		else
-		{
-			if( !purepass )
-			{
-				for( i = 0; i < num_extensions; i++ )
-				{
-					if( FS_SearchDirectoryForFile( search, filenames[i], NULL, 0 ) )
-					{
-						Mem_TempFree( filenames[0] );
-						Mem_TempFree( filenames );
-						return extensions[i];
-					}
-				}
-			}
-		}
-		if( !search->next && purepass )
-		{
-			search = fs_searchpaths;
-			purepass = false;
-		}
-		else
+		if( FS_SearchFileIndex( filenames[i], NULL, NULL, 0, FS_SEARCH_ALL, &rank ) && rank < bestRank )
 		{
-			search = search->next;
+			extension = extensions[i];
+			bestRank = rank;
 		}
 	}
+	QMutex_Unlock( fs_mutex );
 
 	Mem_TempFree( filenames[0] );
 	Mem_TempFree( filenames );
 
-	return NULL;
+	return extension;
 }
 
 /*
@@ -851,7 +1213,10 @@ int FS_FOpenAbsoluteFile( const char *filename, int *filenum, int mode )
 		return -1;
 
 	if( mode == FS_WRITE || mode == FS_APPEND )
+	{
 		FS_CreateAbsolutePath( filename );
+		FS_InvalidateFileIndex();
+	}
 
 	FS_FileModeStr( realmode, modestr, sizeof( modestr ) );
 
@@ -911,7 +1276,7 @@ static void FS_StreamDoneSimpleCb( wswcurl_req *req, int status, void *customp )
 /*
 * _FS_FOpenPakFile
 */
-static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum )
+static int _FS_FOpenPakFile( pack_t *pack, packfile_t *pakFile, int *filenum )
 {
 	filehandle_t *file;
 
@@ -924,29 +1289,54 @@ static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum )
 
 	*filenum = FS_OpenFileHandle();
 	file = &fs_filehandles[*filenum - 1];
-	file->fstream = fopen( pakFile->vfsHandle ? Sys_VFS_VFSName( pakFile->vfsHandle ) : pakFile->pakname, "rb" );
-	if( !file->fstream )
-		Com_Error( ERR_FATAL, "Error opening pak file: %s", pakFile->pakname );
+	file->fstream = NULL;
+	file->mapping = NULL;
 	file->uncompressedSize = pakFile->uncompressedSize;
 	file->offset = 0;
 	file->zipEntry = NULL;
 
-	if( !( pakFile->flags & FS_PACKFILE_COHERENT ) )
+	if( pack->mapping )
 	{
-		unsigned offset = FS_PK3CheckFileCoherency( file->fstream, pakFile );
-		if( !offset )
+		// mapped paks share a single mapping between all handles
+		if( !( pakFile->flags & FS_PACKFILE_COHERENT ) )
 		{
-			Com_DPrintf( "_FS_FOpenPakFile: can't get proper offset for %s\n", pakFile->name );
-			return -1;
+			unsigned offset = FS_PK3CheckMappedFileCoherency( pack, pakFile );
+			if( !offset )
+			{
+				Com_DPrintf( "_FS_FOpenPakFile: can't get proper offset for %s\n", pakFile->name );
+				return -1;
+			}
+			pakFile->offset += offset;
+			pakFile->flags |= FS_PACKFILE_COHERENT;
+		}
+		file->pakOffset = pakFile->offset;
+		file->mapping = pack->mapping + pakFile->offset;
+	}
+	else
+	{
+		file->fstream = fopen( pakFile->vfsHandle ? Sys_VFS_VFSName( pakFile->vfsHandle ) : pakFile->pakname, "rb" );
+		if( !file->fstream )
+			Com_Error( ERR_FATAL, "Error opening pak file: %s", pakFile->pakname );
+
+		if( !( pakFile->flags & FS_PACKFILE_COHERENT ) )
+		{
+			unsigned offset = FS_PK3CheckFileCoherency( file->fstream, pakFile );
+			if( !offset )
+			{
+				Com_DPrintf( "_FS_FOpenPakFile: can't get proper offset for %s\n", pakFile->name );
+				return -1;
+			}
+			pakFile->offset += offset;
+			pakFile->flags |= FS_PACKFILE_COHERENT;
 		}
-		pakFile->offset += offset;
-		pakFile->flags |= FS_PACKFILE_COHERENT;
+		file->pakOffset = Sys_VFS_FileOffset( pakFile->vfsHandle ) + pakFile->offset;
 	}
-	file->pakOffset = Sys_VFS_FileOffset( pakFile->vfsHandle ) + pakFile->offset;
 
 	if( pakFile->flags & FS_PACKFILE_DEFLATED )
 	{
-		file->zipEntry = ( zipEntry_t* )Mem_Alloc( fs_mempool, sizeof( zipEntry_t ) );
+		// compressed data is inflated straight from the mapping, so skip the read buffer
+		file->zipEntry = ( zipEntry_t* )Mem_Alloc( fs_mempool, 
+			file->mapping ? offsetof( zipEntry_t, readBuffer ) : sizeof( zipEntry_t ) );
 		file->zipEntry->compressedSize = pakFile->compressedSize;
 		file->zipEntry->restReadCompressed = pakFile->compressedSize;
 
@@ -962,7 +1352,7 @@ static int _FS_FOpenPakFile( packfile_t *pakFile, int *filenum )
 		}
 	}
 
-	if( fseek( file->fstream, file->pakOffset, SEEK_SET ) != 0 )
+	if( file->fstream && fseek( file->fstream, file->pakOffset, SEEK_SET ) != 0 )
 	{
 		Com_DPrintf( "_FS_FOpenPakFile: can't inflate %s\n", pakFile->name );
 		return -1;
@@ -1084,6 +1474,9 @@ static int _FS_FOpenFile( const char *filename, int *filenum, int mode, bool bas
 		}
 		FS_CreateAbsolutePath( tempname );
 
+		if( mode == FS_WRITE || mode == FS_APPEND )
+			FS_InvalidateFileIndex();
+
 		FS_FileModeStr( realmode, modestr, sizeof( modestr ) );
 
 		if( gz ) {
@@ -1130,7 +1523,7 @@ static int _FS_FOpenFile( const char *filename, int *filenum, int mode, bool bas
 
 		assert( !base );
 
-		uncompressedSize = _FS_FOpenPakFile( pakFile, filenum );
+		uncompressedSize = _FS_FOpenPakFile( search->pack, pakFile, filenum );
 		if( uncompressedSize < 0 )
 		{
 			if( *filenum > 0 )
@@ -1202,6 +1595,37 @@ int FS_FOpenBaseFile( const char *filename, int *filenum, int mode )
 	return _FS_FOpenFile( filename, filenum, mode, true );
 }
 
+/*
+* FS_MMapBaseFile
+* 
+* Maps a base file into memory for reading, won't look inside paks.
+* Returns NULL if the file can't be mapped or mapping is disabled.
+*/
+void *FS_MMapBaseFile( const char *filename, size_t *size )
+{
+	const char *fullname;
+
+	*size = 0;
+
+	if( !fs_usemmap->integer )
+		return NULL;
+
+	fullname = FS_AbsoluteNameForBaseFile( filename );
+	if( !fullname )
+		return NULL;
+
+	return Sys_FS_MMapFile( fullname, size );
+}
+
+/*
+* FS_UnMMapBaseFile
+*/
+void FS_UnMMapBaseFile( void *mapping, size_t size )
+{
+	if( mapping )
+		Sys_FS_UnMMapFile( mapping, size );
+}
+
 /*
 * FS_FCloseFile
 */
@@ -1225,6 +1649,7 @@ void FS_FCloseFile( int file )
 		fclose( fh->fstream );
 		fh->fstream = NULL;
 	}
+	fh->mapping = NULL;
 	if( fh->streamHandle )
 	{
 		if( fh->done_cb && !fh->streamDone )
@@ -1281,8 +1706,23 @@ static int FS_ReadPK3File( uint8_t *buf, size_t len, filehandle_t *fh )
 	zipEntry->zstream.avail_out = (uInt)len;
 
 	totalOutBefore = zipEntry->zstream.total_out;
-	flush = ((len == fh->uncompressedSize) 
-		&& (zipEntry->restReadCompressed <= FS_ZIP_BUFSIZE) && !zipEntry->zstream.avail_in ? Z_FINISH : Z_SYNC_FLUSH);
+
+	if( fh->mapping )
+	{
+		// the whole compressed stream is available at once
+		if( zipEntry->restReadCompressed )
+		{
+			zipEntry->zstream.next_in = (Bytef *)fh->mapping;
+			zipEntry->zstream.avail_in = (uInt)zipEntry->restReadCompressed;
+			zipEntry->restReadCompressed = 0;
+		}
+		flush = ( len == fh->uncompressedSize ) && ( zipEntry->zstream.total_in == 0 ) ? Z_FINISH : Z_SYNC_FLUSH;
+	}
+	else
+	{
+		flush = ((len == fh->uncompressedSize) 
+			&& (zipEntry->restReadCompressed <= FS_ZIP_BUFSIZE) && !zipEntry->zstream.avail_in ? Z_FINISH : Z_SYNC_FLUSH);
+	}
 
 	do
 	{
@@ -1314,6 +1754,19 @@ static int FS_ReadPK3File( uint8_t *buf, size_t len, filehandle_t *fh )
 	return (int)( zipEntry->zstream.total_out - totalOutBefore );
 }
 
+/*
+* FS_ReadMappedFile
+*/
+static int FS_ReadMappedFile( uint8_t *buf, size_t len, filehandle_t *fh )
+{
+	if( fh->offset >= fh->uncompressedSize )
+		return 0;
+
+	len = min( len, fh->uncompressedSize - fh->offset );
+	memcpy( buf, fh->mapping + fh->offset, len );
+	return (int)len;
+}
+
 /*
 * FS_ReadFile
 * 
@@ -1346,6 +1799,8 @@ int FS_Read( void *buffer, size_t len, int file )
 		total = FS_ReadStream( (uint8_t *)buffer, len, fh );
 	else if( fh->gzstream )
 		total = gzread( fh->gzstream, buffer, len );
+	else if( fh->mapping )
+		total = FS_ReadMappedFile( ( uint8_t * )buffer, len, fh );
 	else if( fh->fstream )
 		total = FS_ReadFile( ( uint8_t * )buffer, len, fh );
 	else
@@ -1515,7 +1970,7 @@ int FS_Seek( int file, int offset, int whence )
 		return 0;
 	}
 
-	if( !fh->fstream )
+	if( !fh->fstream && !fh->mapping )
 		return -1;
 	if( offset > (int)fh->uncompressedSize )
 		return -1;
@@ -1523,6 +1978,8 @@ int FS_Seek( int file, int offset, int whence )
 	if( !fh->zipEntry )
 	{
 		fh->offset = offset;
+		if( fh->mapping )
+			return 0;
 		return fseek( fh->fstream, fh->pakOffset + offset, SEEK_SET );
 	}
 
@@ -1535,10 +1992,10 @@ int FS_Seek( int file, int offset, int whence )
 	}
 	else
 	{
-		if( fseek( fh->fstream, fh->pakOffset, SEEK_SET ) != 0 )
+		if( fh->fstream && fseek( fh->fstream, fh->pakOffset, SEEK_SET ) != 0 )
 			return -1;
 
-		zipEntry->zstream.next_in = zipEntry->readBuffer;
+		zipEntry->zstream.next_in = fh->mapping ? NULL : zipEntry->readBuffer;
 		zipEntry->zstream.avail_in = 0;
 		error = inflateReset( &zipEntry->zstream );
 		if( error != Z_OK )
@@ -1573,6 +2030,10 @@ int FS_Eof( int file )
 	fh = FS_FileHandleForNum( file );
 	if( fh->streamHandle )
 		return wswcurl_eof( fh->streamHandle );
+	// mapped deflated members hand the whole input to zlib at once,
+	// so restReadCompressed can't tell when the output is exhausted
+	if( fh->mapping )
+		return fh->offset >= fh->uncompressedSize;
 	if( fh->zipEntry )
 		return fh->zipEntry->restReadCompressed == 0;
 	if( fh->gzstream )
@@ -1832,6 +2293,7 @@ bool FS_AddPurePak( unsigned checksum )
 		if( search->pack && search->pack->checksum == checksum )
 		{
 			search->pack->pure = true;
+			FS_InvalidateFileIndex();
 			return true;
 		}
 	}
@@ -1851,6 +2313,8 @@ void FS_RemovePurePaks( void )
 		if( search->pack )
 			search->pack->pure = false;
 	}
+
+	FS_InvalidateFileIndex();
 }
 
 /*
@@ -1887,6 +2351,8 @@ bool FS_RemoveAbsoluteFile( const char *filename )
 	if( !COM_ValidateFilename( filename ) )
 		return false;
 
+	FS_InvalidateFileIndex();
+
 	// ch : this should return false on error, true on success, c++'ify:
 	// return ( !remove( filename ) );
 	return ( remove( filename ) == 0 ? true : false );
@@ -2019,6 +2485,8 @@ bool _FS_MoveFile( const char *src, const char *dst, bool base )
 	if( !COM_ValidateRelativeFilename( dst ) )
 		return false;
 
+	FS_InvalidateFileIndex();
+
 	if( base )
 		return ( rename( fullname, va( "%s/%s", FS_WriteDirectory(), dst ) ) == 0 ? true : false );
 	return ( rename( fullname, va( "%s/%s/%s", FS_WriteDirectory(), FS_GameDirectory(), dst ) ) == 0 ? true : false );
@@ -2094,6 +2562,8 @@ bool FS_RemoveAbsoluteDirectory( const char *dirname )
 	if( !COM_ValidateFilename( dirname ) )
 		return false;
 
+	FS_InvalidateFileIndex();
+
 	return ( Sys_FS_RemoveDirectory( dirname ) );
 }
 
@@ -2131,7 +2601,7 @@ static void FS_ReadPackManifest( pack_t *pack )
 	if( !FS_SearchPakForFile( pack, FS_PAK_MANIFEST_FILE, &pakFile ) )
 		return;
 
-	size = _FS_FOpenPakFile( pakFile, &file );
+	size = _FS_FOpenPakFile( pack, pakFile, &file );
 	if( (size > -1) && file )
 	{
 		pack->manifest = ( char* )FS_Malloc( size + 1 );
@@ -2398,6 +2868,8 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent )
 	pack->numFiles = numFiles;
 	pack->sysHandle = handle;
 	pack->vfsHandle = vfsHandle;
+	pack->mapping = NULL;
+	pack->mappingSize = 0;
 	pack->trie = NULL;
 
 	Trie_Create( TRIE_CASE_INSENSITIVE, &pack->trie );
@@ -2468,6 +2940,10 @@ static pack_t *FS_LoadPK3File( const char *packfilename, bool silent )
 
 	Mem_TempFree( checksums );
 
+	// map the whole pak so opening its files doesn't cost a descriptor and a seek each
+	if( !vfsHandle && fs_usemmap && fs_usemmap->integer )
+		pack->mapping = ( uint8_t * )Sys_FS_MMapFile( packfilename, &pack->mappingSize );
+
 	// read manifest file if it's a module pk3
 	if( modulepack && manifestFilesize > 0 )
 		FS_ReadPackManifest( pack );
@@ -2602,6 +3078,8 @@ static bool FS_FindPackFilePos( const char *filename, searchpath_t **psearch, se
 */
 static void FS_FreePakFile( pack_t *pack )
 {
+	if( pack->mapping )
+		Sys_FS_UnMMapFile( pack->mapping, pack->mappingSize );
 	if( pack->sysHandle )
 		Sys_FS_UnlockFile( pack->sysHandle );
 	Trie_Destroy( pack->trie );
@@ -3560,6 +4038,8 @@ static int FS_TouchGameDirectory( const char *gamedir, bool initial )
 	if( initial && newpaks )
 		FS_RemoveExtraPaks( old );
 
+	FS_InvalidateFileIndex();
+
 	return newpaks;
 }
 
@@ -3629,6 +4109,8 @@ bool FS_SetGameDirectory( const char *dir, bool force )
 		fs_searchpaths = next;
 	}
 
+	FS_InvalidateFileIndex();
+
 	if( !strcmp( dir, fs_basegame->string ) || ( *dir == 0 ) )
 	{
 		Cvar_ForceSet( "fs_game", fs_basegame->string );
@@ -3893,6 +4375,7 @@ void FS_Init( void )
 	//
 	fs_cdpath = Cvar_Get( "fs_cdpath", "", CVAR_NOSET );
 	fs_basepath = Cvar_Get( "fs_basepath", ".", CVAR_NOSET );
+	fs_usemmap = Cvar_Get( "fs_usemmap", sizeof( void * ) > 4 ? "1" : "0", CVAR_NOSET );
 	homedir = Sys_FS_GetHomeDirectory();
 	if( homedir != NULL )
 #ifdef PUBLIC_BUILD
@@ -3952,6 +4435,9 @@ int FS_Rescan( void )
 	if( strcmp( fs_game->string, fs_basegame->string ) )
 		newpaks += FS_UpdateGameDirectory( fs_game->string );
 
+	// also picks up loose files added behind our back
+	FS_InvalidateFileIndex();
+
 	if( newpaks )
 		FS_AddNotifications( FS_NOTIFY_NEWPAKS );
 
@@ -3986,6 +4472,8 @@ void FS_Shutdown( void )
 	FS_Free( fs_searchfiles );
 	fs_numsearchfiles = 0;
 
+	FS_FreeFileIndex();
+
 	while( fs_searchpaths )
 	{
 		search = fs_searchpaths;
@@ -30,6 +30,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define MEMALIGNMENT_DEFAULT		16
 
+// small blocks are recycled through per-thread free lists, one per power of two size class
+#define MEMCACHE_MINSIZE_SHIFT		6						// 64 bytes
+#define MEMCACHE_NUM_CLASSES		7						// up to 4096 bytes
+#define MEMCACHE_CLASS_SIZE( c )	( (size_t)1 << ( MEMCACHE_MINSIZE_SHIFT + ( c ) ) )
+#define MEMCACHE_MAXSIZE			MEMCACHE_CLASS_SIZE( MEMCACHE_NUM_CLASSES - 1 )
+#define MEMCACHE_CLASS_BYTES		( 32 * 1024 )			// how much each thread may keep per size class
+
+#define MEMFRAME_CHUNK_SIZE			( 256 * 1024 )
+
 typedef struct memheader_s
 {
 	// address returned by malloc (may be significantly before this header to satisify alignment)
@@ -80,6 +89,9 @@ struct mempool_s
 	// name of the pool
 	char name[POOLNAMESIZE];
 
+	// protects the chain and the sizes
+	qmutex_t *mutex;
+
 	// linked into global mempool list or parent's children list
 	struct mempool_s *next;
 
@@ -111,8 +123,55 @@ mempool_t *tempMemPool;
 // only for zone
 mempool_t *zoneMemPool;
 
+// protects the thread cache chain
 static qmutex_t *memMutex;
 
+typedef struct memcacheblock_s
+{
+	struct memcacheblock_s *next;
+} memcacheblock_t;
+
+typedef struct memcache_s
+{
+	memcacheblock_t *blocks[MEMCACHE_NUM_CLASSES];
+	int numblocks[MEMCACHE_NUM_CLASSES];
+
+	// statistics, only written by the owning thread
+	unsigned int allocs;
+	unsigned int hits;					// allocations served from the free lists
+	unsigned int frees;
+	unsigned int cachedfrees;			// frees that went to the free lists
+	unsigned int contentions;			// pool locks that were held by another thread
+
+	struct memcache_s *next;
+} memcache_t;
+
+// frame arena chunks are kept for the lifetime of the program, so that
+// steady state frames don't allocate anything from the system
+typedef struct memframechunk_s
+{
+	size_t size;
+	size_t used;
+	struct memframechunk_s *next;
+	// immediately followed by data
+} memframechunk_t;
+
+typedef struct
+{
+	memframechunk_t *chunks;
+	memframechunk_t *current;
+	size_t used;						// total for this frame, including padding
+	size_t peak;
+	size_t size;						// total size of all chunks
+	int numchunks;
+} memframearena_t;
+
+static memframearena_t memFrameArena;
+
+static ATTRIBUTE_THREADLOCAL memcache_t *memThreadCache;
+static memcache_t *memCacheChain;
+static memcache_t memCacheReleased;		// statistics of the caches of finished threads
+
 static bool memory_initialized = false;
 static bool commands_initialized = false;
 
@@ -128,11 +187,114 @@ static void _Mem_Error( const char *format, ... )
 	Sys_Error( msg );
 }
 
+/*
+* Mem_GetThreadCache
+*/
+static memcache_t *Mem_GetThreadCache( void )
+{
+	memcache_t *cache = memThreadCache;
+
+	if( cache )
+		return cache;
+
+	cache = ( memcache_t * )calloc( 1, sizeof( *cache ) );
+	if( cache == NULL )
+		_Mem_Error( "Mem_GetThreadCache: out of memory" );
+
+	QMutex_Lock( memMutex );
+	cache->next = memCacheChain;
+	memCacheChain = cache;
+	QMutex_Unlock( memMutex );
+
+	memThreadCache = cache;
+	return cache;
+}
+
+/*
+* Mem_FreeThreadCache
+*
+* The cache must be already unlinked from the chain.
+*/
+static void Mem_FreeThreadCache( memcache_t *cache )
+{
+	int i;
+	memcacheblock_t *block, *next;
+
+	for( i = 0; i < MEMCACHE_NUM_CLASSES; i++ )
+	{
+		for( block = cache->blocks[i]; block; block = next )
+		{
+			next = block->next;
+			free( block );
+		}
+	}
+
+	memCacheReleased.allocs += cache->allocs;
+	memCacheReleased.hits += cache->hits;
+	memCacheReleased.frees += cache->frees;
+	memCacheReleased.cachedfrees += cache->cachedfrees;
+	memCacheReleased.contentions += cache->contentions;
+
+	free( cache );
+}
+
+/*
+* Mem_ReleaseThreadCache
+*
+* Frees the blocks cached by the calling thread. Called by threads before they exit.
+*/
+void Mem_ReleaseThreadCache( void )
+{
+	memcache_t *cache = memThreadCache, **prev;
+
+	if( !cache || !memory_initialized )
+		return;
+
+	QMutex_Lock( memMutex );
+	for( prev = &memCacheChain; *prev && *prev != cache; prev = &( *prev )->next ) ;
+	if( *prev )
+		*prev = cache->next;
+	Mem_FreeThreadCache( cache );
+	QMutex_Unlock( memMutex );
+
+	memThreadCache = NULL;
+}
+
+/*
+* Mem_SizeClass
+*
+* Returns the size class a block of realsize bytes is allocated from, or -1 for large blocks.
+*/
+static int Mem_SizeClass( size_t realsize )
+{
+	int sizeclass;
+
+	if( realsize > MEMCACHE_MAXSIZE )
+		return -1;
+
+	for( sizeclass = 0; MEMCACHE_CLASS_SIZE( sizeclass ) < realsize; sizeclass++ ) ;
+	return sizeclass;
+}
+
+/*
+* Mem_LockPool
+*/
+static inline void Mem_LockPool( mempool_t *pool, memcache_t *cache )
+{
+	if( !QMutex_TryLock( pool->mutex ) )
+	{
+		cache->contentions++;
+		QMutex_Lock( pool->mutex );
+	}
+}
+
 void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int musthave, int canthave, const char *filename, int fileline )
 {
 	void *base;
 	size_t realsize;
 	memheader_t *mem;
+	memcache_t *cache;
+	int sizeclass;
 
 	if( size <= 0 )
 		return NULL;
@@ -153,16 +315,32 @@ void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int
 	if( developerMemory && developerMemory->integer )
 		Com_DPrintf( "Mem_Alloc: pool %s, file %s:%i, size %i bytes\n", pool->name, filename, fileline, size );
 
-	QMutex_Lock( memMutex );
-
-	pool->totalsize += size;
 	realsize = sizeof( memheader_t ) + size + alignment + sizeof( int );
 
-	pool->realsize += realsize;
+	cache = Mem_GetThreadCache();
+	cache->allocs++;
+
+	// small blocks are rounded up to their size class so they can be recycled
+	base = NULL;
+	sizeclass = Mem_SizeClass( realsize );
+	if( sizeclass >= 0 )
+	{
+		realsize = MEMCACHE_CLASS_SIZE( sizeclass );
+		if( cache->blocks[sizeclass] )
+		{
+			base = cache->blocks[sizeclass];
+			cache->blocks[sizeclass] = cache->blocks[sizeclass]->next;
+			cache->numblocks[sizeclass]--;
+			cache->hits++;
+		}
+	}
 
-	base = malloc( realsize );
 	if( base == NULL )
-		_Mem_Error( "Mem_Alloc: out of memory (alloc at %s:%i)", filename, fileline );
+	{
+		base = malloc( realsize );
+		if( base == NULL )
+			_Mem_Error( "Mem_Alloc: out of memory (alloc at %s:%i)", filename, fileline );
+	}
 
 	// calculate address that aligns the end of the memheader_t to the specified alignment
 	mem = ( memheader_t * )((((size_t)base + sizeof( memheader_t ) + (alignment-1)) & ~(alignment-1)) - sizeof( memheader_t ));
@@ -177,6 +355,11 @@ void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int
 	// we have to use only a single byte for this sentinel, because it may not be aligned, and some platforms can't use unaligned accesses
 	*( (uint8_t *) mem + sizeof( memheader_t ) + mem->size ) = MEMHEADER_SENTINEL2;
 
+	Mem_LockPool( pool, cache );
+
+	pool->totalsize += size;
+	pool->realsize += realsize;
+
 	// append to head of list
 	mem->next = pool->chain;
 	mem->prev = NULL;
@@ -184,7 +367,7 @@ void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int
 	if( mem->next )
 		mem->next->prev = mem;
 
-	QMutex_Unlock( memMutex );
+	QMutex_Unlock( pool->mutex );
 
 	if( z )
 		memset( (void *)( (uint8_t *) mem + sizeof( memheader_t ) ), 0, mem->size );
@@ -222,6 +405,81 @@ void *_Mem_Realloc( void *data, size_t size, const char *filename, int fileline
 	return newdata;
 }
 
+/*
+* _Mem_FrameAlloc
+*
+* Returns zeroed memory that stays valid until the start of the next
+* Qcommon_Frame. Must only be called from the main thread.
+*/
+void *_Mem_FrameAlloc( size_t size, const char *filename, int fileline )
+{
+	uint8_t *data;
+	size_t offset;
+	memframearena_t *arena = &memFrameArena;
+	memframechunk_t *chunk, **link;
+
+	if( size <= 0 )
+		return NULL;
+
+	size = ( size + MEMALIGNMENT_DEFAULT - 1 ) & ~( MEMALIGNMENT_DEFAULT - 1 );
+
+	// find a chunk with enough free space, starting with the current one
+	link = &arena->chunks;
+	for( chunk = arena->current ? arena->current : arena->chunks; chunk; chunk = chunk->next )
+	{
+		if( chunk->size - chunk->used >= size )
+			break;
+		link = &chunk->next;
+	}
+
+	if( !chunk )
+	{
+		size_t chunksize = max( size, MEMFRAME_CHUNK_SIZE );
+
+		for( ; *link; link = &( *link )->next ) ;
+
+		chunk = ( memframechunk_t * )malloc( sizeof( memframechunk_t ) + MEMALIGNMENT_DEFAULT + chunksize );
+		if( chunk == NULL )
+			_Mem_Error( "Mem_FrameAlloc: out of memory (alloc at %s:%i)", filename, fileline );
+		chunk->size = chunksize;
+		chunk->used = 0;
+		chunk->next = NULL;
+		*link = chunk;
+
+		arena->size += chunksize;
+		arena->numchunks++;
+	}
+
+	arena->current = chunk;
+
+	data = ( uint8_t * )chunk + sizeof( memframechunk_t );
+	offset = ( MEMALIGNMENT_DEFAULT - ( (size_t)data & ( MEMALIGNMENT_DEFAULT - 1 ) ) ) & ( MEMALIGNMENT_DEFAULT - 1 );
+	data += offset + chunk->used;
+	chunk->used += size;
+
+	arena->used += size;
+	if( arena->used > arena->peak )
+		arena->peak = arena->used;
+
+	memset( data, 0, size );
+	return data;
+}
+
+/*
+* Mem_ResetFrameArena
+*
+* Releases everything allocated with Mem_FrameAlloc during the previous frame.
+*/
+void Mem_ResetFrameArena( void )
+{
+	memframechunk_t *chunk;
+
+	for( chunk = memFrameArena.chunks; chunk; chunk = chunk->next )
+		chunk->used = 0;
+	memFrameArena.current = memFrameArena.chunks;
+	memFrameArena.used = 0;
+}
+
 char *_Mem_CopyString( mempool_t *pool, const char *in, const char *filename, int fileline )
 {
 	char *out;
@@ -237,8 +495,11 @@ char *_Mem_CopyString( mempool_t *pool, const char *in, const char *filename, in
 void _Mem_Free( void *data, int musthave, int canthave, const char *filename, int fileline )
 {
 	void *base;
+	size_t realsize;
 	memheader_t *mem;
 	mempool_t *pool;
+	memcache_t *cache;
+	int sizeclass;
 
 	if( data == NULL )
 		//_Mem_Error( "Mem_Free: data == NULL (called at %s:%i)", filename, fileline );
@@ -263,7 +524,10 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 	if( developerMemory && developerMemory->integer )
 		Com_DPrintf( "Mem_Free: pool %s, alloc %s:%i, free %s:%i, size %i bytes\n", pool->name, mem->filename, mem->fileline, filename, fileline, mem->size );
 
-	QMutex_Lock( memMutex );
+	cache = Mem_GetThreadCache();
+	cache->frees++;
+
+	Mem_LockPool( pool, cache );
 
 	// unlink memheader from doubly linked list
 	if( ( mem->prev ? mem->prev->next != mem : pool->chain != mem ) || ( mem->next && mem->next->prev != mem ) )
@@ -280,14 +544,28 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 	pool->totalsize -= mem->size;
 
 	base = mem->baseaddress;
-	pool->realsize -= mem->realsize;
+	realsize = mem->realsize;
+	pool->realsize -= realsize;
 
-	QMutex_Unlock( memMutex );
+	QMutex_Unlock( pool->mutex );
 
 #ifdef MEMTRASH
 	memset( mem, 0xBF, sizeof( memheader_t ) + mem->size + sizeof( int ) );
 #endif
 
+	// keep small blocks around for the next allocation on this thread
+	sizeclass = Mem_SizeClass( realsize );
+	if( sizeclass >= 0 && cache->numblocks[sizeclass] < (int)( MEMCACHE_CLASS_BYTES / realsize ) )
+	{
+		memcacheblock_t *block = ( memcacheblock_t * )base;
+
+		block->next = cache->blocks[sizeclass];
+		cache->blocks[sizeclass] = block;
+		cache->numblocks[sizeclass]++;
+		cache->cachedfrees++;
+		return;
+	}
+
 	free( base );
 }
 
@@ -315,6 +593,7 @@ mempool_t *_Mem_AllocPool( mempool_t *parent, const char *name, int flags, const
 	pool->child = NULL;
 	pool->totalsize = 0;
 	pool->realsize = sizeof( mempool_t );
+	pool->mutex = QMutex_Create();
 	Q_strncpyz( pool->name, name, sizeof( pool->name ) );
 
 	if( parent )
@@ -394,6 +673,8 @@ void _Mem_FreePool( mempool_t **pool, int musthave, int canthave, const char *fi
 
 	*chainAddress = ( *pool )->next;
 
+	QMutex_Destroy( &( *pool )->mutex );
+
 	// free the pool itself
 #ifdef MEMTRASH
 	memset( *pool, 0xBF, sizeof( mempool_t ) );
@@ -647,10 +928,45 @@ static void MemList_f( void )
 	Com_Printf( "MemList_f: unknown pool name '%s'. Usage: [all|pool]\n", name, Cmd_Argv( 0 ) );
 }
 
+static void Mem_PrintCacheStats( void )
+{
+	int i, numcaches;
+	size_t cachedsize;
+	memcache_t total, *cache;
+
+	// the counters of other threads are read without synchronization, they are only statistics
+	QMutex_Lock( memMutex );
+
+	total = memCacheReleased;
+	numcaches = 0;
+	cachedsize = 0;
+	for( cache = memCacheChain; cache; cache = cache->next )
+	{
+		numcaches++;
+		total.allocs += cache->allocs;
+		total.hits += cache->hits;
+		total.frees += cache->frees;
+		total.cachedfrees += cache->cachedfrees;
+		total.contentions += cache->contentions;
+		for( i = 0; i < MEMCACHE_NUM_CLASSES; i++ )
+			cachedsize += cache->numblocks[i] * MEMCACHE_CLASS_SIZE( i );
+	}
+
+	QMutex_Unlock( memMutex );
+
+	Com_Printf( "%i thread caches holding %i bytes (%.3fMB)\n", numcaches, (int)cachedsize, cachedsize / 1048576.0 );
+	Com_Printf( "%u allocations, %.1f%% from thread caches\n", total.allocs, total.allocs ? 100.0 * total.hits / total.allocs : 0.0 );
+	Com_Printf( "%u frees, %.1f%% to thread caches\n", total.frees, total.frees ? 100.0 * total.cachedfrees / total.frees : 0.0 );
+	Com_Printf( "%u contended pool locks\n", total.contentions );
+	Com_Printf( "frame arena: %i bytes (%.3fMB) in %i chunks, %i bytes peak\n", (int)memFrameArena.size,
+		memFrameArena.size / 1048576.0, memFrameArena.numchunks, (int)memFrameArena.peak );
+}
+
 static void MemStats_f( void )
 {
 	Mem_CheckSentinelsGlobal();
 	Mem_PrintStats();
+	Mem_PrintCacheStats();
 }
 
 
@@ -715,6 +1031,23 @@ void Memory_Shutdown( void )
 		Mem_FreePool( &pool );
 	}
 
+	while( memFrameArena.chunks )
+	{
+		memframechunk_t *chunk = memFrameArena.chunks;
+		memFrameArena.chunks = chunk->next;
+		free( chunk );
+	}
+	memset( &memFrameArena, 0, sizeof( memFrameArena ) );
+
+	// other threads have finished by now
+	while( memCacheChain )
+	{
+		memcache_t *cache = memCacheChain;
+		memCacheChain = cache->next;
+		Mem_FreeThreadCache( cache );
+	}
+	memThreadCache = NULL;
+
 	QMutex_Destroy( &memMutex );
 
 	memory_initialized = false;
@@ -43,6 +43,7 @@ void MSG_Clear( msg_t *msg )
 {
 	msg->cursize = 0;
 	msg->compressed = false;
+	msg->writebit = msg->readbit = 0;
 }
 
 void *MSG_GetSpace( msg_t *msg, size_t length )
@@ -55,6 +56,7 @@ void *MSG_GetSpace( msg_t *msg, size_t length )
 
 	ptr = msg->data + msg->cursize;
 	msg->cursize += length;
+	msg->writebit = 0;
 	return ptr;
 }
 
@@ -146,6 +148,105 @@ void MSG_WriteString( msg_t *msg, const char *s )
 	}
 }
 
+/*
+* MSG_WriteBits
+*
+* Writes the low numbits of value, least significant bit first
+*/
+void MSG_WriteBits( msg_t *msg, unsigned int value, int numbits )
+{
+	int put;
+	uint8_t *buf;
+
+	assert( numbits > 0 && numbits <= 32 );
+
+	while( numbits > 0 )
+	{
+		if( !msg->writebit )
+		{
+			buf = ( uint8_t* )MSG_GetSpace( msg, 1 );
+			buf[0] = 0;
+		}
+		else
+		{
+			buf = msg->data + msg->cursize - 1;
+		}
+
+		put = min( 8 - msg->writebit, numbits );
+		buf[0] |= ( value & ( ( 1<<put ) - 1 ) ) << msg->writebit;
+		value >>= put;
+		numbits -= put;
+		msg->writebit = ( msg->writebit + put ) & 7;
+	}
+}
+
+/*
+* MSG_WritePackedUint
+*
+* A 2 bits size class followed by the value
+*/
+static const int msg_packedbits[4] = { 5, 10, 18, 32 };
+
+void MSG_WritePackedUint( msg_t *msg, unsigned int value )
+{
+	int c;
+
+	for( c = 0; c < 3; c++ )
+	{
+		if( value < ( 1u<<msg_packedbits[c] ) )
+			break;
+	}
+
+	MSG_WriteBits( msg, c, 2 );
+	MSG_WriteBits( msg, value, msg_packedbits[c] );
+}
+
+/*
+* MSG_WritePackedInt
+*
+* Zigzag coded, so small values of either sign take few bits
+*/
+void MSG_WritePackedInt( msg_t *msg, int value )
+{
+	MSG_WritePackedUint( msg, ( (unsigned int)value << 1 ) ^ ( value < 0 ? ~0u : 0 ) );
+}
+
+/*
+* MSG_WriteFlagBits
+*
+* Writes one bit for every bit set in mask, telling whether it's set in flags
+*/
+void MSG_WriteFlagBits( msg_t *msg, unsigned int flags, unsigned int mask )
+{
+	int numbits;
+	unsigned int bit, value;
+
+	numbits = 0;
+	value = 0;
+	for( bit = 1; bit && bit <= mask; bit <<= 1 )
+	{
+		if( !( mask & bit ) )
+			continue;
+		if( flags & bit )
+			value |= 1u<<numbits;
+		numbits++;
+	}
+
+	if( numbits )
+		MSG_WriteBits( msg, value, numbits );
+}
+
+/*
+* MSG_AlignBits
+*
+* The next bit written or read starts a new byte
+*/
+void MSG_AlignBits( msg_t *msg )
+{
+	msg->writebit = 0;
+	msg->readbit = 0;
+}
+
 //==================================================
 // READ FUNCTIONS
 //==================================================
@@ -153,11 +254,13 @@ void MSG_WriteString( msg_t *msg, const char *s )
 void MSG_BeginReading( msg_t *msg )
 {
 	msg->readcount = 0;
+	msg->readbit = 0;
 }
 
 int MSG_ReadChar( msg_t *msg )
 {
 	int i = (signed char)msg->data[msg->readcount++];
+	msg->readbit = 0;
 	if( msg->readcount > msg->cursize )
 		i = -1;
 	return i;
@@ -167,6 +270,7 @@ int MSG_ReadChar( msg_t *msg )
 int MSG_ReadByte( msg_t *msg )
 {
 	int i = (unsigned char)msg->data[msg->readcount++];
+	msg->readbit = 0;
 	if( msg->readcount > msg->cursize )
 		i = -1;
 	return i;
@@ -178,6 +282,7 @@ int MSG_ReadShort( msg_t *msg )
 	short *sp = (short *)&msg->data[msg->readcount];
 	i = LittleShort( *sp );
 	msg->readcount += 2;
+	msg->readbit = 0;
 	if( msg->readcount > msg->cursize )
 		i = -1;
 	return i;
@@ -190,6 +295,7 @@ int MSG_ReadInt3( msg_t *msg )
 		| ( msg->data[msg->readcount+2]<<16 )
 		| ( ( msg->data[msg->readcount+2] & 0x80 ) ? ~0xFFFFFF : 0 );
 	msg->readcount += 3;
+	msg->readbit = 0;
 	if( msg->readcount > msg->cursize )
 		i = -1;
 	return i;
@@ -201,6 +307,7 @@ int MSG_ReadLong( msg_t *msg )
 	unsigned int *ip = (unsigned int *)&msg->data[msg->readcount];
 	i = LittleLong( *ip );
 	msg->readcount += 4;
+	msg->readbit = 0;
 	if( msg->readcount > msg->cursize )
 		i = -1;
 	return i;
@@ -240,6 +347,7 @@ int MSG_SkipData( msg_t *msg, size_t length )
 	if( msg->readcount + length <= msg->cursize )
 	{
 		msg->readcount += length;
+		msg->readbit = 0;
 		return 1;
 	}
 	return 0;
@@ -248,7 +356,7 @@ int MSG_SkipData( msg_t *msg, size_t length )
 static char *MSG_ReadString2( msg_t *msg, bool linebreak )
 {
 	int l, c;
-	static char string[MAX_MSG_STRING_CHARS];
+	static ATTRIBUTE_THREADLOCAL char string[MAX_MSG_STRING_CHARS];
 
 	l = 0;
 	do
@@ -276,28 +384,100 @@ char *MSG_ReadStringLine( msg_t *msg )
 	return MSG_ReadString2( msg, true );
 }
 
+/*
+* MSG_ReadBits
+*/
+unsigned int MSG_ReadBits( msg_t *msg, int numbits )
+{
+	int get, shift;
+	unsigned int value;
+
+	assert( numbits > 0 && numbits <= 32 );
+
+	value = 0;
+	shift = 0;
+	while( numbits > 0 )
+	{
+		if( !msg->readbit )
+			msg->readcount++;
+		if( msg->readcount > msg->cursize )
+		{
+			msg->readbit = 0;
+			return 0;
+		}
+
+		get = min( 8 - msg->readbit, numbits );
+		value |= (unsigned int)( ( msg->data[msg->readcount-1] >> msg->readbit ) & ( ( 1<<get ) - 1 ) ) << shift;
+		shift += get;
+		numbits -= get;
+		msg->readbit = ( msg->readbit + get ) & 7;
+	}
+
+	return value;
+}
+
+/*
+* MSG_ReadPackedUint
+*/
+unsigned int MSG_ReadPackedUint( msg_t *msg )
+{
+	return MSG_ReadBits( msg, msg_packedbits[MSG_ReadBits( msg, 2 )] );
+}
+
+/*
+* MSG_ReadPackedInt
+*/
+int MSG_ReadPackedInt( msg_t *msg )
+{
+	unsigned int value = MSG_ReadPackedUint( msg );
+	return (int)( value >> 1 ) ^ -(int)( value & 1 );
+}
+
+/*
+* MSG_ReadFlagBits
+*/
+unsigned int MSG_ReadFlagBits( msg_t *msg, unsigned int mask )
+{
+	int numbits;
+	unsigned int bit, value, flags;
+
+	numbits = 0;
+	for( bit = 1; bit && bit <= mask; bit <<= 1 )
+	{
+		if( mask & bit )
+			numbits++;
+	}
+	if( !numbits )
+		return 0;
+
+	value = MSG_ReadBits( msg, numbits );
+
+	flags = 0;
+	for( bit = 1; bit && bit <= mask; bit <<= 1 )
+	{
+		if( !( mask & bit ) )
+			continue;
+		if( value & 1 )
+			flags |= bit;
+		value >>= 1;
+	}
+
+	return flags;
+}
+
 //==================================================
 // SPECIAL CASES
 //==================================================
 
 /*
-* MSG_WriteDeltaEntity
-* 
-* Writes part of a packetentities message.
-* Can delta from either a baseline or a previous packet_entity
+* MSG_DeltaEntityBits
+*
+* The U_* bits of the fields that differ between the two states
 */
-void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin )
+static int MSG_DeltaEntityBits( entity_state_t *from, entity_state_t *to, bool updateOtherOrigin )
 {
 	int bits;
 
-	if( !to->number )
-		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Unset entity number" );
-	else if( to->number >= MAX_EDICTS )
-		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Entity number >= MAX_EDICTS" );
-	else if( to->number < 0 )
-		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Invalid Entity number" );
-
-	// send an update
 	bits = 0;
 
 	if( to->number & 0xFF00 )
@@ -398,6 +578,29 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg,
 	if( to->team != from->team )
 		bits |= U_TEAM;
 
+	return bits;
+}
+
+/*
+* MSG_WriteDeltaEntity
+* 
+* Writes part of a packetentities message.
+* Can delta from either a baseline or a previous packet_entity
+*/
+void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin )
+{
+	int bits;
+
+	if( !to->number )
+		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Unset entity number" );
+	else if( to->number >= MAX_EDICTS )
+		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Entity number >= MAX_EDICTS" );
+	else if( to->number < 0 )
+		Com_Error( ERR_FATAL, "MSG_WriteDeltaEntity: Invalid Entity number" );
+
+	// send an update
+	bits = MSG_DeltaEntityBits( from, to, updateOtherOrigin );
+
 	//
 	// write the message
 	//
@@ -756,6 +959,351 @@ void MSG_ReadDeltaEntity( msg_t *msg, entity_state_t *from, entity_state_t *to,
 }
 
 
+//==================================================
+// BIT PACKED ENTITIES
+//==================================================
+
+#if MAX_EDICTS > ( 1<<U_PACKED_NUMBERBITS )
+#error "U_PACKED_NUMBERBITS can't hold MAX_EDICTS"
+#endif
+
+static const int msg_originbits[3] = { U_ORIGIN1, U_ORIGIN2, U_ORIGIN3 };
+static const int msg_anglebits[3] = { U_ANGLE1, U_ANGLE2, U_ANGLE3 };
+
+/*
+* MSG_WrapResidual
+*
+* Brings the difference of two values of a numbits wide modular range to the shortest way around
+*/
+static inline int MSG_WrapResidual( int delta, int numbits )
+{
+	delta &= ( 1<<numbits ) - 1;
+	if( delta >= ( 1<<( numbits - 1 ) ) )
+		delta -= 1<<numbits;
+	return delta;
+}
+
+/*
+* MSG_WritePackedDeltaEntity
+*
+* MSG_WriteDeltaEntity for bit packed snapshots. The header holds the entity number and the
+* changed fields, the coordinates and angles are sent as quantized residuals against the old
+* state. Every record starts on a byte boundary, so it can be cached and copied whole.
+*/
+void MSG_WritePackedDeltaEntity( entity_state_t *from, entity_state_t *to, msg_t *msg, bool force, bool updateOtherOrigin )
+{
+	int i, bits, q, oldq, anglebits;
+	bool bmodel;
+	float *coords, *oldcoords;
+
+	if( !to->number )
+		Com_Error( ERR_FATAL, "MSG_WritePackedDeltaEntity: Unset entity number" );
+	else if( to->number >= MAX_EDICTS )
+		Com_Error( ERR_FATAL, "MSG_WritePackedDeltaEntity: Entity number >= MAX_EDICTS" );
+	else if( to->number < 0 )
+		Com_Error( ERR_FATAL, "MSG_WritePackedDeltaEntity: Invalid Entity number" );
+
+	bits = MSG_DeltaEntityBits( from, to, updateOtherOrigin );
+	if( !bits && !force )
+		return; // nothing to send!
+
+	// the packed header doesn't need the size variants
+	if( bits & U_FRAME16 )
+		bits |= U_FRAME8;
+	if( bits & U_SKIN16 )
+		bits |= U_SKIN8;
+	if( bits & U_EFFECTS16 )
+		bits |= U_EFFECTS8;
+	bits &= ( U_PACKED_COMMON|U_PACKED_RARE );
+
+	// the old values of these had another meaning, send them whole
+	if( to->linearProjectile != from->linearProjectile )
+		bits |= U_ORIGIN1|U_ORIGIN2|U_ORIGIN3;
+	if( ( to->solid == SOLID_BMODEL ) != ( from->solid == SOLID_BMODEL ) )
+		bits |= U_ANGLE1|U_ANGLE2|U_ANGLE3;
+
+	MSG_AlignBits( msg );
+	MSG_WriteBits( msg, to->number, U_PACKED_NUMBERBITS );
+	MSG_WriteBits( msg, 0, 1 );		// not removed
+
+	MSG_WriteFlagBits( msg, bits, U_PACKED_COMMON );
+	MSG_WriteBits( msg, ( bits & U_PACKED_RARE ) ? 1 : 0, 1 );
+	if( bits & U_PACKED_RARE )
+		MSG_WriteFlagBits( msg, bits, U_PACKED_RARE );
+
+	if( bits & U_TYPE )
+		MSG_WriteBits( msg, ( to->type & ~ET_INVERSE ) | ( to->linearProjectile ? ET_INVERSE : 0 ), 8 );
+
+	if( bits & U_SOLID )
+		MSG_WritePackedUint( msg, to->solid );
+
+	if( bits & U_MODEL )
+		MSG_WritePackedUint( msg, to->modelindex );
+	if( bits & U_MODEL2 )
+		MSG_WritePackedUint( msg, to->modelindex2 );
+
+	if( bits & U_FRAME8 )
+		MSG_WritePackedUint( msg, to->frame );
+
+	if( bits & U_SKIN8 )
+		MSG_WritePackedUint( msg, to->skinnum );
+
+	if( bits & U_EFFECTS8 )
+		MSG_WritePackedUint( msg, to->effects );
+
+	if( to->linearProjectile )
+	{
+		coords = to->linearProjectileVelocity;
+		oldcoords = from->linearProjectileVelocity;
+	}
+	else
+	{
+		coords = to->origin;
+		oldcoords = from->origin;
+	}
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( bits & msg_originbits[i] ) )
+			continue;
+
+		q = Q_rint( coords[i]*PM_VECTOR_SNAP );
+		if( to->linearProjectile != from->linearProjectile )
+			MSG_WritePackedInt( msg, q );
+		else
+			MSG_WritePackedInt( msg, q - Q_rint( oldcoords[i]*PM_VECTOR_SNAP ) );
+	}
+
+	bmodel = ( to->solid == SOLID_BMODEL );
+	anglebits = bmodel ? 16 : 8;
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( bits & msg_anglebits[i] ) )
+			continue;
+
+		q = bmodel ? ANGLE2SHORT( to->angles[i] ) : ANGLE2BYTE( to->angles[i] );
+		if( bmodel != ( from->solid == SOLID_BMODEL ) )
+		{
+			MSG_WriteBits( msg, q, anglebits );
+		}
+		else
+		{
+			oldq = bmodel ? ANGLE2SHORT( from->angles[i] ) : ANGLE2BYTE( from->angles[i] );
+			MSG_WritePackedInt( msg, MSG_WrapResidual( q - oldq, anglebits ) );
+		}
+	}
+
+	if( bits & U_OTHERORIGIN )
+	{
+		// beams and lerp origins are usually close to the origin
+		for( i = 0; i < 3; i++ )
+		{
+			q = Q_rint( to->origin2[i]*PM_VECTOR_SNAP );
+			if( !to->linearProjectile )
+				q -= Q_rint( to->origin[i]*PM_VECTOR_SNAP );
+			MSG_WritePackedInt( msg, q );
+		}
+	}
+
+	if( bits & U_SOUND )
+		MSG_WritePackedUint( msg, to->sound );
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( !( bits & ( i ? U_EVENT2 : U_EVENT ) ) )
+			continue;
+
+		if( !to->eventParms[i] )
+		{
+			MSG_WriteBits( msg, (uint8_t)( to->events[i] & ~EV_INVERSE ), 8 );
+		}
+		else
+		{
+			MSG_WriteBits( msg, (uint8_t)( to->events[i] | EV_INVERSE ), 8 );
+			MSG_WriteBits( msg, (uint8_t)to->eventParms[i], 8 );
+		}
+	}
+
+	if( bits & U_ATTENUATION )
+		MSG_WriteBits( msg, (uint8_t)( to->attenuation * 16 ), 8 );
+
+	if( bits & U_WEAPON )
+		MSG_WriteBits( msg, ( to->weapon & ~ET_INVERSE ) | ( to->teleported ? ET_INVERSE : 0 ), 8 );
+
+	if( bits & U_SVFLAGS )
+		MSG_WritePackedUint( msg, to->svflags );
+
+	if( bits & U_LIGHT )
+		MSG_WritePackedUint( msg, to->light );
+
+	if( bits & U_TEAM )
+		MSG_WritePackedUint( msg, to->team );
+}
+
+/*
+* MSG_WritePackedEntityRemove
+*/
+void MSG_WritePackedEntityRemove( msg_t *msg, int number )
+{
+	MSG_AlignBits( msg );
+	MSG_WriteBits( msg, number, U_PACKED_NUMBERBITS );
+	MSG_WriteBits( msg, 1, 1 );
+}
+
+/*
+* MSG_ReadPackedEntityBits
+*
+* Returns the entity number and the header bits, 0 at the end of the list
+*/
+int MSG_ReadPackedEntityBits( msg_t *msg, unsigned *bits )
+{
+	int number;
+
+	*bits = 0;
+
+	MSG_AlignBits( msg );
+	number = MSG_ReadBits( msg, U_PACKED_NUMBERBITS );
+	if( !number )
+		return 0;
+
+	if( MSG_ReadBits( msg, 1 ) )
+	{
+		*bits = U_REMOVE;
+		return number;
+	}
+
+	*bits = MSG_ReadFlagBits( msg, U_PACKED_COMMON );
+	if( MSG_ReadBits( msg, 1 ) )
+		*bits |= MSG_ReadFlagBits( msg, U_PACKED_RARE );
+
+	return number;
+}
+
+/*
+* MSG_ReadPackedDeltaEntity
+*/
+void MSG_ReadPackedDeltaEntity( msg_t *msg, entity_state_t *from, entity_state_t *to, int number, unsigned bits )
+{
+	int i, q, anglebits;
+	bool bmodel;
+	float *coords;
+
+	// set everything to the state we are delta'ing from
+	*to = *from;
+
+	to->number = number;
+
+	if( bits & U_TYPE )
+	{
+		uint8_t ttype;
+		ttype = (uint8_t)MSG_ReadBits( msg, 8 );
+		to->type = ttype & ~ET_INVERSE;
+		to->linearProjectile = ( ttype & ET_INVERSE ) ? true : false;
+	}
+
+	if( bits & U_SOLID )
+		to->solid = MSG_ReadPackedUint( msg );
+
+	if( bits & U_MODEL )
+		to->modelindex = MSG_ReadPackedUint( msg );
+	if( bits & U_MODEL2 )
+		to->modelindex2 = MSG_ReadPackedUint( msg );
+
+	if( bits & U_FRAME8 )
+		to->frame = MSG_ReadPackedUint( msg );
+
+	if( bits & U_SKIN8 )
+		to->skinnum = MSG_ReadPackedUint( msg );
+
+	if( bits & U_EFFECTS8 )
+		to->effects = MSG_ReadPackedUint( msg );
+
+	coords = to->linearProjectile ? to->linearProjectileVelocity : to->origin;
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( bits & msg_originbits[i] ) )
+			continue;
+
+		q = MSG_ReadPackedInt( msg );
+		if( to->linearProjectile == from->linearProjectile )
+			q += Q_rint( coords[i]*PM_VECTOR_SNAP );
+		coords[i] = (float)q*( 1.0/PM_VECTOR_SNAP );
+	}
+
+	bmodel = ( to->solid == SOLID_BMODEL );
+	anglebits = bmodel ? 16 : 8;
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( bits & msg_anglebits[i] ) )
+			continue;
+
+		if( bmodel != ( from->solid == SOLID_BMODEL ) )
+		{
+			q = MSG_ReadBits( msg, anglebits );
+		}
+		else
+		{
+			q = bmodel ? ANGLE2SHORT( to->angles[i] ) : ANGLE2BYTE( to->angles[i] );
+			q = ( q + MSG_ReadPackedInt( msg ) ) & ( ( 1<<anglebits ) - 1 );
+		}
+
+		to->angles[i] = bmodel ? SHORT2ANGLE( (short)q ) : BYTE2ANGLE( q );
+	}
+
+	if( bits & U_OTHERORIGIN )
+	{
+		for( i = 0; i < 3; i++ )
+		{
+			q = MSG_ReadPackedInt( msg );
+			if( !to->linearProjectile )
+				q += Q_rint( to->origin[i]*PM_VECTOR_SNAP );
+			to->origin2[i] = (float)q*( 1.0/PM_VECTOR_SNAP );
+		}
+	}
+
+	if( bits & U_SOUND )
+		to->sound = MSG_ReadPackedUint( msg );
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( bits & ( i ? U_EVENT2 : U_EVENT ) )
+		{
+			int event = MSG_ReadBits( msg, 8 );
+			if( event & EV_INVERSE )
+				to->eventParms[i] = MSG_ReadBits( msg, 8 );
+			else
+				to->eventParms[i] = 0;
+			to->events[i] = ( event & ~EV_INVERSE );
+		}
+		else
+		{
+			to->events[i] = 0;
+			to->eventParms[i] = 0;
+		}
+	}
+
+	if( bits & U_ATTENUATION )
+		to->attenuation = (float)MSG_ReadBits( msg, 8 ) / 16.0;
+
+	if( bits & U_WEAPON )
+	{
+		uint8_t tweapon;
+		tweapon = (uint8_t)MSG_ReadBits( msg, 8 );
+		to->weapon = tweapon & ~ET_INVERSE;
+		to->teleported = ( tweapon & ET_INVERSE ) ? true : false;
+	}
+
+	if( bits & U_SVFLAGS )
+		to->svflags = MSG_ReadPackedUint( msg );
+
+	// linearProjectileTimeStamp shares the storage
+	if( bits & U_LIGHT )
+		to->light = MSG_ReadPackedUint( msg );
+
+	if( bits & U_TEAM )
+		to->team = MSG_ReadPackedUint( msg );
+}
+
 void MSG_WriteDeltaUsercmd( msg_t *buf, usercmd_t *from, usercmd_t *cmd )
 {
 	int bits;
@@ -18,6 +18,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 */
 
+#if defined( __linux__ ) && !defined( __ANDROID__ ) && !defined( _GNU_SOURCE )
+#	define _GNU_SOURCE // recvmmsg and sendmmsg
+#endif
+
 #include "qcommon.h"
 
 #include "sys_net.h"
@@ -32,6 +36,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <errno.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #endif
 
 #define	MAX_LOOPBACK	4
@@ -48,6 +57,18 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #	define MSG_NOSIGNAL 0
 #endif
 
+#if defined( __linux__ ) && !defined( __ANDROID__ ) && defined( MSG_WAITFORONE )
+#	define USE_MMSG
+#endif
+
+#if defined( __linux__ )
+#	define USE_EPOLL
+#endif
+
+// how long and how many times a flush waits for a full send buffer to drain
+#define NET_BATCH_WRITE_TIMEOUT		5
+#define NET_BATCH_WRITE_RETRIES		4
+
 
 typedef struct
 {
@@ -63,8 +84,8 @@ typedef struct
 } loopback_t;
 
 static loopback_t loopbacks[2];
-static char *errorstring = NULL;
-static size_t errorstring_size = 0;
+// snapshot worker threads send packets too, each needs its own copy
+static ATTRIBUTE_THREADLOCAL char errorstring[MAX_PRINTMSG];
 static bool	net_initialized = false;
 
 #define MAX_IPS 16
@@ -406,6 +427,201 @@ static bool NET_UDP_SendPacket( const socket_t *socket, const void *data, size_t
 	return true;
 }
 
+/*
+* NET_UDP_GetPackets
+*/
+static int NET_UDP_GetPackets( const socket_t *socket, netadr_t *addresses, msg_t *messages, int maxpackets )
+{
+#ifdef USE_MMSG
+	int i, ret, numpackets;
+	struct mmsghdr hdrs[NET_MAX_BATCH_PACKETS];
+	struct iovec iovs[NET_MAX_BATCH_PACKETS];
+	struct sockaddr_storage from[NET_MAX_BATCH_PACKETS];
+
+	assert( socket && socket->open && socket->type == SOCKET_UDP );
+
+	if( maxpackets > NET_MAX_BATCH_PACKETS )
+		maxpackets = NET_MAX_BATCH_PACKETS;
+
+	do
+	{
+		memset( hdrs, 0, sizeof( hdrs[0] ) * maxpackets );
+		for( i = 0; i < maxpackets; i++ )
+		{
+			assert( messages[i].data && messages[i].maxsize > 0 );
+
+			iovs[i].iov_base = messages[i].data;
+			iovs[i].iov_len = messages[i].maxsize;
+			hdrs[i].msg_hdr.msg_name = &from[i];
+			hdrs[i].msg_hdr.msg_namelen = sizeof( from[i] );
+			hdrs[i].msg_hdr.msg_iov = &iovs[i];
+			hdrs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		ret = recvmmsg( socket->handle, hdrs, maxpackets, MSG_DONTWAIT, NULL );
+		if( ret == SOCKET_ERROR )
+		{
+			net_error_t err;
+
+			NET_SetErrorStringFromLastError( "recvmmsg" );
+
+			err = Sys_NET_GetLastError();
+			if( err == NET_ERR_WOULDBLOCK || err == NET_ERR_CONNRESET )  // would block
+				return 0;
+
+			return -1;
+		}
+
+		// skip the datagrams NET_UDP_GetPacket would have failed on
+		numpackets = 0;
+		for( i = 0; i < ret; i++ )
+		{
+			if( hdrs[i].msg_len >= messages[i].maxsize || ( hdrs[i].msg_hdr.msg_flags & MSG_TRUNC ) )
+			{
+				Com_DPrintf( "NET_GetPackets: Oversized packet\n" );
+				continue;
+			}
+			if( !SockaddressToAddress( (struct sockaddr *)&from[i], &addresses[numpackets] ) )
+				continue;
+
+			if( numpackets != i )
+				memcpy( messages[numpackets].data, messages[i].data, hdrs[i].msg_len );
+			messages[numpackets].readcount = 0;
+			messages[numpackets].cursize = hdrs[i].msg_len;
+			numpackets++;
+		}
+	} while( !numpackets && ret == maxpackets );
+
+	return numpackets;
+#else
+	int ret, numpackets;
+
+	for( numpackets = 0; numpackets < maxpackets; numpackets++ )
+	{
+		ret = NET_UDP_GetPacket( socket, &addresses[numpackets], &messages[numpackets] );
+		if( ret == 0 )
+			break;
+		if( ret < 0 )
+		{
+			if( !numpackets )
+				return -1;
+			Com_DPrintf( "NET_GetPackets: %s\n", NET_ErrorString() );
+			break;
+		}
+	}
+
+	return numpackets;
+#endif
+}
+
+/*
+* NET_UDP_WaitWritable
+*
+* Waits for room in the send buffer of a socket that would have blocked
+*/
+static bool NET_UDP_WaitWritable( const socket_t *socket )
+{
+	struct timeval timeout = { 0, NET_BATCH_WRITE_TIMEOUT * 1000 };
+	fd_set set;
+
+	FD_ZERO( &set );
+	FD_SET( socket->handle, &set );
+
+	return select( socket->handle + 1, NULL, &set, NULL, &timeout ) > 0;
+}
+
+/*
+* NET_UDP_SendPackets
+*
+* Marks the datagrams that couldn't be sent, returns their number
+*/
+static int NET_UDP_SendPackets( const socket_t *socket, const netbatch_t *batch, int numpackets, bool *failures )
+{
+#ifdef USE_MMSG
+	int i, ret, numhdrs, sent, failed, retries;
+	struct mmsghdr hdrs[NET_MAX_BATCH_PACKETS];
+	struct iovec iovs[NET_MAX_BATCH_PACKETS];
+	struct sockaddr_storage addrs[NET_MAX_BATCH_PACKETS];
+	int packets[NET_MAX_BATCH_PACKETS];
+	net_error_t err;
+
+	assert( socket && socket->open && socket->type == SOCKET_UDP );
+
+	failed = 0;
+	numhdrs = 0;
+	memset( hdrs, 0, sizeof( hdrs[0] ) * numpackets );
+	for( i = 0; i < numpackets; i++ )
+	{
+		if( !AddressToSockaddress( &batch->addresses[i], &addrs[numhdrs] ) )
+		{
+			failures[i] = true;
+			failed++;
+			continue;
+		}
+
+		iovs[numhdrs].iov_base = (void *)batch->data[i];
+		iovs[numhdrs].iov_len = batch->lengths[i];
+		hdrs[numhdrs].msg_hdr.msg_name = &addrs[numhdrs];
+		hdrs[numhdrs].msg_hdr.msg_namelen = ( addrs[numhdrs].ss_family == AF_INET6 ?
+			sizeof( struct sockaddr_in6 ) : sizeof( struct sockaddr_in ) );
+		hdrs[numhdrs].msg_hdr.msg_iov = &iovs[numhdrs];
+		hdrs[numhdrs].msg_hdr.msg_iovlen = 1;
+		packets[numhdrs] = i;
+		numhdrs++;
+	}
+
+	retries = 0;
+	for( sent = 0; sent < numhdrs; )
+	{
+		ret = sendmmsg( socket->handle, hdrs + sent, numhdrs - sent, 0 );
+		if( ret == SOCKET_ERROR )
+		{
+			err = Sys_NET_GetLastError();
+			NET_SetErrorStringFromLastError( "sendmmsg" );
+
+			// the send buffer is full, the rest of the batch goes out once it drains
+			if( err == NET_ERR_WOULDBLOCK && retries < NET_BATCH_WRITE_RETRIES )
+			{
+				retries++;
+				NET_UDP_WaitWritable( socket );
+				continue;
+			}
+
+			// the first datagram failed, skip it and carry on with the rest
+			failures[packets[sent]] = true;
+			failed++;
+			sent++;
+			continue;
+		}
+		sent += ret;
+	}
+
+	return failed;
+#else
+	int i, failed, retries;
+
+	failed = 0;
+	retries = 0;
+	for( i = 0; i < numpackets; i++ )
+	{
+		while( !NET_UDP_SendPacket( socket, batch->data[i], batch->lengths[i], &batch->addresses[i] ) )
+		{
+			// the send buffer is full, the rest of the batch goes out once it drains
+			if( Sys_NET_GetLastError() != NET_ERR_WOULDBLOCK || retries == NET_BATCH_WRITE_RETRIES )
+			{
+				failures[i] = true;
+				failed++;
+				break;
+			}
+			retries++;
+			NET_UDP_WaitWritable( socket );
+		}
+	}
+
+	return failed;
+#endif
+}
+
 /*
 * NET_IP_OpenSocket
 */
@@ -1009,6 +1225,45 @@ int NET_GetPacket( const socket_t *socket, netadr_t *address, msg_t *message )
 	}
 }
 
+/*
+* NET_GetPackets
+* 
+* Reads up to maxpackets datagrams into the messages, which must
+* have been initialized. Datagrams that fail to be read are skipped.
+* 
+* >0	number of packets read
+* 0	not ready
+* -1	error
+*/
+int NET_GetPackets( const socket_t *socket, netadr_t *addresses, msg_t *messages, int maxpackets )
+{
+	int ret, numpackets;
+
+	assert( socket->open );
+
+	if( !socket->open )
+		return -1;
+
+	if( socket->type == SOCKET_UDP )
+		return NET_UDP_GetPackets( socket, addresses, messages, maxpackets );
+
+	for( numpackets = 0; numpackets < maxpackets; numpackets++ )
+	{
+		ret = NET_GetPacket( socket, &addresses[numpackets], &messages[numpackets] );
+		if( ret == 0 )
+			break;
+		if( ret < 0 )
+		{
+			if( !numpackets )
+				return -1;
+			Com_DPrintf( "NET_GetPackets: %s\n", NET_ErrorString() );
+			break;
+		}
+	}
+
+	return numpackets;
+}
+
 /*
 * NET_Get
 * 
@@ -1075,6 +1330,94 @@ bool NET_SendPacket( const socket_t *socket, const void *data, size_t length, co
 	}
 }
 
+/*
+* NET_QueuePacket
+* 
+* Queues a datagram to be sent with NET_FlushBatch. Packets for other
+* socket types or larger than MAX_PACKETLEN are sent right away.
+*/
+bool NET_QueuePacket( netbatch_t *batch, const socket_t *socket, const void *data, size_t length, const netadr_t *address )
+{
+	assert( batch );
+
+	if( address->type == NA_NOTRANSMIT )
+		return true;
+
+	if( batch->numpackets && ( batch->socket != socket || batch->numpackets == NET_MAX_BATCH_PACKETS ) )
+		NET_FlushBatch( batch );
+
+	if( socket->type != SOCKET_UDP || length > MAX_PACKETLEN )
+	{
+		// keep the packets in order
+		NET_FlushBatch( batch );
+		return NET_SendPacket( socket, data, length, address );
+	}
+
+	batch->socket = socket;
+	batch->lengths[batch->numpackets] = length;
+	batch->addresses[batch->numpackets] = *address;
+	batch->tags[batch->numpackets] = batch->tag;
+	memcpy( batch->data[batch->numpackets], data, length );
+	batch->numpackets++;
+
+	return true;
+}
+
+/*
+* NET_FlushBatch
+* 
+* Sends all the queued datagrams, returns the number of them that failed.
+* The owner of the batch is told which ones through batch->onfail.
+*/
+int NET_FlushBatch( netbatch_t *batch )
+{
+	int i, failed, numpackets;
+	bool failures[NET_MAX_BATCH_PACKETS];
+	int failedtags[NET_MAX_BATCH_PACKETS];
+
+	assert( batch );
+
+	if( !batch->numpackets )
+		return 0;
+
+	// onfail may queue more packets, so the batch is emptied first
+	numpackets = batch->numpackets;
+	batch->numpackets = 0;
+
+	if( batch->socket->open )
+	{
+		memset( failures, 0, sizeof( failures[0] ) * numpackets );
+		failed = NET_UDP_SendPackets( batch->socket, batch, numpackets, failures );
+	}
+	else
+	{
+		NET_SetErrorString( "Socket closed" );
+		for( i = 0; i < numpackets; i++ )
+			failures[i] = true;
+		failed = numpackets;
+	}
+
+	batch->socket = NULL;
+
+	if( failed )
+	{
+		Com_DPrintf( "NET_FlushBatch: %i of %i packets failed: %s\n", failed, numpackets, NET_ErrorString() );
+
+		if( batch->onfail )
+		{
+			for( i = 0, failed = 0; i < numpackets; i++ )
+			{
+				if( failures[i] )
+					failedtags[failed++] = batch->tags[i];
+			}
+			for( i = 0; i < failed; i++ )
+				batch->onfail( batch, failedtags[i] );
+		}
+	}
+
+	return failed;
+}
+
 /*
 * NET_Send
 */
@@ -1561,21 +1904,10 @@ const char *NET_ErrorString( void )
 void NET_SetErrorString( const char *format, ... )
 {
 	va_list	argptr;
-	char msg[MAX_PRINTMSG];
 
 	va_start( argptr, format );
-	Q_vsnprintfz( msg, sizeof( msg ), format, argptr );
+	Q_vsnprintfz( errorstring, sizeof( errorstring ), format, argptr );
 	va_end( argptr );
-
-	if( errorstring_size < strlen( msg ) + 1 )
-	{
-		if( errorstring )
-			Mem_ZoneFree( errorstring );
-		errorstring_size = strlen( msg ) + 1 + 64;
-		errorstring = ( char* )Mem_ZoneMalloc( errorstring_size );
-	}
-
-	Q_strncpyz( errorstring, msg, errorstring_size );
 }
 
 /*
@@ -1798,119 +2130,475 @@ int NET_SetSocketNoDelay( socket_t *socket, int nodelay )
 }
 
 /*
-* NET_Sleep
+=============================================================================
+EVENT LOOP
+=============================================================================
+*/
+
+typedef struct
+{
+	socket_t *socket;               // NULL once removed while dispatching
+	socket_handle_t handle;
+	void ( *read_cb )( socket_t *socket, void *privatep );
+	void ( *exception_cb )( socket_t *socket, void *privatep );
+	void *privatep;
+} netpollentry_t;
+
+struct netpoll_s
+{
+	int numentries;
+	int maxentries;
+	netpollentry_t *entries;
+
+	bool dispatching;
+	bool compact;                   // there are removed entries to get rid of after dispatching
+
+#if defined( USE_EPOLL )
+	int epfd;
+	int maxevents;
+	struct epoll_event *events;     // only grown outside of dispatching
+#elif !defined( _WIN32 )
+	struct pollfd *pfds;            // [maxentries], parallel to entries
+#endif
+};
+
+/*
+* NET_Poll_FindEntry
 */
-void NET_Sleep( int msec, socket_t *sockets[] )
+static int NET_Poll_FindEntry( const netpoll_t *poll, const socket_t *socket )
 {
-	struct timeval timeout;
-	fd_set fdset;
 	int i;
 
-	if( !sockets || !sockets[0] )
+	for( i = 0; i < poll->numentries; i++ )
+	{
+		if( poll->entries[i].socket == socket )
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+* NET_Poll_Reserve
+*/
+static void NET_Poll_Reserve( netpoll_t *poll, int numentries )
+{
+	int maxentries;
+
+	if( numentries <= poll->maxentries )
 		return;
 
-	FD_ZERO( &fdset );
+	maxentries = max( poll->maxentries * 2, 16 );
+	while( maxentries < numentries )
+		maxentries *= 2;
 
-	for( i = 0; sockets[i]; i++ )
-	{
-		assert( sockets[i]->open );
+	if( poll->entries )
+		poll->entries = Mem_Realloc( poll->entries, maxentries * sizeof( *poll->entries ) );
+	else
+		poll->entries = Mem_ZoneMalloc( maxentries * sizeof( *poll->entries ) );
+
+#if !defined( USE_EPOLL ) && !defined( _WIN32 )
+	if( poll->pfds )
+		poll->pfds = Mem_Realloc( poll->pfds, maxentries * sizeof( *poll->pfds ) );
+	else
+		poll->pfds = Mem_ZoneMalloc( maxentries * sizeof( *poll->pfds ) );
+#endif
+
+	poll->maxentries = maxentries;
+}
 
-		switch( sockets[i]->type )
+/*
+* NET_Poll_EventForEntry
+*/
+#if defined( USE_EPOLL )
+static void NET_Poll_EventForEntry( const netpoll_t *poll, int num, struct epoll_event *ev )
+{
+	memset( ev, 0, sizeof( *ev ) );
+	ev->events = EPOLLIN | ( poll->entries[num].exception_cb ? EPOLLPRI : 0 );
+	ev->data.u32 = num;
+}
+#endif
+
+/*
+* NET_Poll_RemoveEntry
+*
+* Moves the last entry into the freed slot
+*/
+static void NET_Poll_RemoveEntry( netpoll_t *poll, int num )
+{
+	int last = poll->numentries - 1;
+
+	if( num != last )
+	{
+		poll->entries[num] = poll->entries[last];
+#if defined( USE_EPOLL )
 		{
-		case SOCKET_UDP:
+			struct epoll_event ev;
+
+			NET_Poll_EventForEntry( poll, num, &ev );
+			epoll_ctl( poll->epfd, EPOLL_CTL_MOD, poll->entries[num].handle, &ev );
+		}
+#elif !defined( _WIN32 )
+		poll->pfds[num] = poll->pfds[last];
+#endif
+	}
+
+	poll->numentries--;
+}
+
+/*
+* NET_Poll_Dispatch
+*/
+static void NET_Poll_Dispatch( netpoll_t *poll, int num, bool readable, bool exception )
+{
+	netpollentry_t *entry;
+
+	if( num < 0 || num >= poll->numentries )
+		return;
+
+	// the entries array may have been reallocated by the callbacks
+	entry = &poll->entries[num];
+	if( exception && entry->socket && entry->exception_cb )
+		entry->exception_cb( entry->socket, entry->privatep );
+
+	entry = &poll->entries[num];
+	if( readable && entry->socket && entry->read_cb )
+		entry->read_cb( entry->socket, entry->privatep );
+}
+
+/*
+* NET_CreatePoll
+*/
+netpoll_t *NET_CreatePoll( void )
+{
+	netpoll_t *poll;
+
+	poll = Mem_ZoneMalloc( sizeof( *poll ) );
+
+#if defined( USE_EPOLL )
+	poll->epfd = epoll_create( 64 );
+	if( poll->epfd < 0 )
+	{
+		NET_SetErrorStringFromLastError( "epoll_create" );
+		Mem_ZoneFree( poll );
+		return NULL;
+	}
+#endif
+
+	return poll;
+}
+
+/*
+* NET_DestroyPoll
+*/
+void NET_DestroyPoll( netpoll_t **ppoll )
+{
+	netpoll_t *poll;
+
+	if( !ppoll || !*ppoll )
+		return;
+
+	poll = *ppoll;
+	assert( !poll->dispatching );
+
+#if defined( USE_EPOLL )
+	close( poll->epfd );
+	if( poll->events )
+		Mem_ZoneFree( poll->events );
+#elif !defined( _WIN32 )
+	if( poll->pfds )
+		Mem_ZoneFree( poll->pfds );
+#endif
+	if( poll->entries )
+		Mem_ZoneFree( poll->entries );
+	Mem_ZoneFree( poll );
+
+	*ppoll = NULL;
+}
+
+/*
+* NET_PollAddSocket
+*
+* Registers an open UDP or TCP socket, or updates its callbacks if it already is.
+* Sockets must be removed before they are closed.
+*/
+bool NET_PollAddSocket( netpoll_t *poll, socket_t *socket, void ( *read_cb )( socket_t *socket, void *privatep ),
+	void ( *exception_cb )( socket_t *socket, void *privatep ), void *privatep )
+{
+	int num;
+	netpollentry_t *entry;
+
+	assert( poll );
+	assert( socket );
+
+	if( !socket->open )
+	{
+		NET_SetErrorString( "Socket is not open" );
+		return false;
+	}
+
+	switch( socket->type )
+	{
+	case SOCKET_UDP:
 #ifdef TCP_SUPPORT
-		case SOCKET_TCP:
+	case SOCKET_TCP:
 #endif
-			assert( sockets[i]->handle > 0 );
-			FD_SET( (unsigned)sockets[i]->handle, &fdset ); // network socket
-			break;
+		break;
+	default:
+		NET_SetErrorString( "Unsupported socket type" );
+		return false;
+	}
+
+	num = NET_Poll_FindEntry( poll, socket );
+	if( num >= 0 && poll->entries[num].handle == socket->handle )
+	{
+		entry = &poll->entries[num];
+		entry->read_cb = read_cb;
+		entry->exception_cb = exception_cb;
+		entry->privatep = privatep;
+#if defined( USE_EPOLL )
+		{
+			struct epoll_event ev;
+
+			NET_Poll_EventForEntry( poll, num, &ev );
+			epoll_ctl( poll->epfd, EPOLL_CTL_MOD, socket->handle, &ev );
+		}
+#elif !defined( _WIN32 )
+		poll->pfds[num].events = POLLIN | ( exception_cb ? POLLPRI : 0 );
+#endif
+		return true;
+	}
+
+	if( num >= 0 )
+	{
+		// the socket has been reopened without being removed first
+		NET_PollRemoveSocket( poll, socket );
+	}
 
-		default:
-			Com_Printf( "Warning: Invalid socket type on Sys_NET_Sleep\n" );
-			return;
+	NET_Poll_Reserve( poll, poll->numentries + 1 );
+
+	num = poll->numentries;
+	entry = &poll->entries[num];
+	entry->socket = socket;
+	entry->handle = socket->handle;
+	entry->read_cb = read_cb;
+	entry->exception_cb = exception_cb;
+	entry->privatep = privatep;
+
+#if defined( USE_EPOLL )
+	{
+		struct epoll_event ev;
+
+		NET_Poll_EventForEntry( poll, num, &ev );
+		if( epoll_ctl( poll->epfd, EPOLL_CTL_ADD, socket->handle, &ev ) < 0 )
+		{
+			NET_SetErrorStringFromLastError( "epoll_ctl" );
+			return false;
 		}
 	}
+#elif !defined( _WIN32 )
+	poll->pfds[num].fd = socket->handle;
+	poll->pfds[num].events = POLLIN | ( exception_cb ? POLLPRI : 0 );
+	poll->pfds[num].revents = 0;
+#endif
+
+	poll->numentries++;
+	return true;
+}
+
+/*
+* NET_PollRemoveSocket
+*
+* Safe to call from within the callbacks
+*/
+void NET_PollRemoveSocket( netpoll_t *poll, socket_t *socket )
+{
+	int num;
+
+	assert( poll );
+
+	num = NET_Poll_FindEntry( poll, socket );
+	if( num < 0 )
+		return;
+
+#if defined( USE_EPOLL )
+	// closed descriptors are dropped by the kernel already
+	if( socket->open && socket->handle == poll->entries[num].handle )
+		epoll_ctl( poll->epfd, EPOLL_CTL_DEL, poll->entries[num].handle, NULL );
+#endif
+
+	if( poll->dispatching )
+	{
+		// keep the indices of the pending events valid
+		poll->entries[num].socket = NULL;
+#if !defined( USE_EPOLL ) && !defined( _WIN32 )
+		poll->pfds[num].fd = -1;
+#endif
+		poll->compact = true;
+		return;
+	}
+
+	NET_Poll_RemoveEntry( poll, num );
+}
 
-	timeout.tv_sec = msec / 1000;
-	timeout.tv_usec = ( msec % 1000 ) * 1000;
-	select( FD_SETSIZE, &fdset, NULL, NULL, &timeout );
+/*
+* NET_PollWait
+*/
+int NET_PollWait( netpoll_t *np, int msec )
+{
+	return NET_PollWaitMicroseconds( np, msec > 0 ? (unsigned)msec * 1000 : 0 );
 }
 
 /*
-* NET_Monitor
-* Monitors the given sockets with the given timeout in milliseconds
-* It ignores closed and loopback sockets.
-* Calls the callback function read_cb(socket_t *) with the socket as parameter the socket when incoming data was detected on it
-* Calls the callback function exception_cb(socket_t *) with the socket as parameter when a socket exception was detected on that socket
-* For both callbacks, NULL can be passed. When NULL is passed for the exception_cb, no exception detection is performed
-* Incoming data is always detected, even if the 'read_cb' callback was NULL.
+* NET_PollWaitMicroseconds
+*
+* Waits up to usec microseconds for any of the registered sockets to become
+* readable and calls the callbacks of the ones that did. Sleeps for the whole
+* time if no sockets are registered.
+* The epoll backend honours the full resolution, the others round down to
+* whole milliseconds.
+* Returns the number of sockets that triggered or -1 on error.
 */
-int NET_Monitor( int msec, socket_t *sockets[], void (*read_cb)(socket_t *, void*), void (*exception_cb)(socket_t *, void*), void *privatep[] )
+int NET_PollWaitMicroseconds( netpoll_t *np, unsigned int usec )
 {
-	struct timeval timeout;
-	fd_set fdsetr, fdsete;
-	fd_set *p_fdsete = NULL;
 	int i, ret;
-	int fdmax = 0;
+	int msec = usec / 1000;
+
+	assert( np );
+	assert( !np->dispatching );
+
+#if defined( USE_EPOLL )
+	if( np->maxevents < max( np->maxentries, 1 ) )
+	{
+		if( np->events )
+			Mem_ZoneFree( np->events );
+		np->maxevents = max( np->maxentries, 1 );
+		np->events = Mem_ZoneMalloc( np->maxevents * sizeof( *np->events ) );
+	}
 
-	if( !sockets || !sockets[0] )
+	if( usec % 1000 )
+	{
+		// epoll_wait only has millisecond resolution, but the epoll
+		// descriptor itself becomes readable when any of its sockets are
+		struct pollfd pfd;
+		struct timespec timeout;
+
+		pfd.fd = np->epfd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		timeout.tv_sec = usec / 1000000;
+		timeout.tv_nsec = ( usec % 1000000 ) * 1000;
+
+		ret = ppoll( &pfd, 1, &timeout, NULL );
+		if( ret <= 0 )
+		{
+			if( ret == 0 || errno == EINTR )
+				return 0;
+			NET_SetErrorStringFromLastError( "ppoll" );
+			return -1;
+		}
+		msec = 0;
+	}
+
+	ret = epoll_wait( np->epfd, np->events, np->maxevents, msec );
+	if( ret < 0 )
+	{
+		if( errno == EINTR )
+			return 0;
+		NET_SetErrorStringFromLastError( "epoll_wait" );
+		return -1;
+	}
+
+	np->dispatching = true;
+	for( i = 0; i < ret; i++ )
+	{
+		const struct epoll_event *ev = &np->events[i];
+
+		NET_Poll_Dispatch( np, ev->data.u32,
+			( ev->events & ( EPOLLIN|EPOLLERR|EPOLLHUP ) ) != 0, ( ev->events & EPOLLPRI ) != 0 );
+	}
+#elif !defined( _WIN32 )
+	if( !np->numentries )
+	{
+		if( msec )
+			Sys_Sleep( msec );
 		return 0;
+	}
 
-	FD_ZERO( &fdsetr );
-	if (exception_cb) {
-		FD_ZERO( &fdsete );
-		p_fdsete = &fdsete;
+	ret = poll( np->pfds, np->numentries, msec );
+	if( ret < 0 )
+	{
+		if( errno == EINTR )
+			return 0;
+		NET_SetErrorStringFromLastError( "poll" );
+		return -1;
 	}
 
-	for( i = 0; sockets[i]; i++ )
+	np->dispatching = true;
+	for( i = 0; i < np->numentries && ret > 0; i++ )
 	{
-		if (!sockets[i]->open)
+		short revents = np->pfds[i].revents;
+
+		if( !revents )
 			continue;
-		switch( sockets[i]->type )
+
+		np->pfds[i].revents = 0;
+		NET_Poll_Dispatch( np, i, ( revents & ( POLLIN|POLLERR|POLLHUP ) ) != 0, ( revents & POLLPRI ) != 0 );
+	}
+#else
+	{
+		// winsock select has no descriptor value limit, only FD_SETSIZE entries
+		struct timeval timeout;
+		fd_set fdsetr, fdsete;
+		int numentries = min( np->numentries, FD_SETSIZE );
+
+		if( !numentries )
 		{
-		case SOCKET_UDP:
-#ifdef TCP_SUPPORT
-		case SOCKET_TCP:
-#endif
-			assert( sockets[i]->handle > 0 );
-			fdmax = max( (int)sockets[i]->handle, fdmax );
-			FD_SET( sockets[i]->handle, &fdsetr ); // network socket
-			if( p_fdsete )
-				FD_SET( sockets[i]->handle, p_fdsete );
-			break;
-		case SOCKET_LOOPBACK:
-		default:
-			continue;
+			if( msec )
+				Sys_Sleep( msec );
+			return 0;
 		}
-	}
 
-	timeout.tv_sec = msec / 1000;
-	timeout.tv_usec = ( msec % 1000 ) * 1000;
-	ret = select( fdmax+1, &fdsetr, NULL, p_fdsete, &timeout );
-	if ( ( ret > 0) && ( (read_cb) || (exception_cb)) ) {
-		// Launch callbacks
-		for( i = 0; sockets[i]; i++ ) {
-			if (!sockets[i]->open)
-				continue;
+		FD_ZERO( &fdsetr );
+		FD_ZERO( &fdsete );
+		for( i = 0; i < numentries; i++ )
+		{
+			FD_SET( np->entries[i].handle, &fdsetr );
+			if( np->entries[i].exception_cb )
+				FD_SET( np->entries[i].handle, &fdsete );
+		}
 
-			switch( sockets[i]->type ) {
-			case SOCKET_UDP:
-#ifdef TCP_SUPPORT
-			case SOCKET_TCP:
+		timeout.tv_sec = usec / 1000000;
+		timeout.tv_usec = usec % 1000000;
+		ret = select( 0, &fdsetr, NULL, &fdsete, &timeout );
+		if( ret == SOCKET_ERROR )
+		{
+			NET_SetErrorStringFromLastError( "select" );
+			return -1;
+		}
+
+		np->dispatching = true;
+		for( i = 0; i < numentries && ret > 0; i++ )
+		{
+			socket_handle_t handle = np->entries[i].handle;
+
+			NET_Poll_Dispatch( np, i, FD_ISSET( handle, &fdsetr ) != 0, FD_ISSET( handle, &fdsete ) != 0 );
+		}
+	}
 #endif
-				if ( (exception_cb) && (p_fdsete) && (FD_ISSET(sockets[i]->handle, p_fdsete )) ) {
-					exception_cb(sockets[i], privatep ? privatep[i] : NULL);
-				}
-				if ( (read_cb) && (FD_ISSET(sockets[i]->handle, &fdsetr )) ) {
-					read_cb(sockets[i], privatep ? privatep[i] : NULL);
-				}
-				break;
-			case SOCKET_LOOPBACK:
-			default:
-				continue;
-			}
+
+	np->dispatching = false;
+
+	if( np->compact )
+	{
+		for( i = np->numentries - 1; i >= 0; i-- )
+		{
+			if( !np->entries[i].socket )
+				NET_Poll_RemoveEntry( np, i );
 		}
+		np->compact = false;
 	}
+
 	return ret;
 }
 
@@ -1936,13 +2624,6 @@ void NET_Shutdown( void )
 	if( !net_initialized )
 		return;
 
-	if( errorstring )
-	{
-		Mem_ZoneFree( errorstring );
-		errorstring = NULL;
-		errorstring_size = 0;
-	}
-
 	Sys_NET_Shutdown();
 
 	net_initialized = false;
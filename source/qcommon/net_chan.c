@@ -115,7 +115,7 @@ void Netchan_OutOfBand( const socket_t *socket, const netadr_t *address, size_t
 void Netchan_OutOfBandPrint( const socket_t *socket, const netadr_t *address, const char *format, ... )
 {
 	va_list	argptr;
-	static char string[MAX_PACKETLEN - 4];
+	static ATTRIBUTE_THREADLOCAL char string[MAX_PACKETLEN - 4];
 
 	va_start( argptr, format );
 	Q_vsnprintfz( string, sizeof( string ), format, argptr );
@@ -141,8 +141,6 @@ void Netchan_Setup( netchan_t *chan, const socket_t *socket, const netadr_t *add
 }
 
 
-static uint8_t msg_process_data[MAX_MSGLEN];
-
 //=============================================================
 // Zlib compression
 //=============================================================
@@ -319,35 +317,445 @@ int Netchan_ZLibCompressChunk( uint8_t *in, int len_in, uint8_t *out, int max_le
 }
 
 #endif // ALT_ZLIB_COMPRESSION
+//=============================================================
+// Negotiated compression
+//
+// Peers that advertise their NETCHAN_COMPRESSION_* methods at connect
+// time prefix every compressed payload with the method byte. Both methods
+// are primed with the preset dictionary below, which holds strings that
+// keep showing up in the gamestate, configstrings and server commands.
+// Changing the dictionary is a protocol change.
+//=============================================================
+
+static const char netchan_dictionary[] =
+	"Gunblade Machinegun Riotgun Grenade Launcher Rocket Launcher Plasmagun Lasergun Electrobolt Instagun "
+	"Green Armor Yellow Armor Red Armor Armor Shard Mega Health Ultra Health Quad Damage Warshell Regeneration "
+	"Rockets Grenades Plasma Lasers Bolts Bullets Shells Cells Ammo Pack Alpha Flag Beta Flag "
+	"Spectators Players Alpha Beta Name Score Ping C R %n 164 %i 64 %l 48 %p 18 %p 18 "
+	"cvarinfo position players spectators stats say say_team svscore use give kill putaway chase chasenext chaseprev "
+	"spec enterqueue leavequeue camswitch timeout timein whois callvote vote opcall operator ready unready notready "
+	"join coach lockteam unlockteam invite vsay vsay_team "
+	"sounds/announcer/ sounds/vsay/ sounds/world/ sounds/items/ sounds/misc/ sounds/weapons/ sounds/players/ "
+	"models/objects/projectile/ models/weapons/ models/items/ models/powerups/ models/flags/ "
+	"gfx/simpleitems/ gfx/hud/icons/ gfx/hud/keys/ gfx/decals/ gfx/misc/ textures/ maps/ .bsp .md3 .skm .wav .ogg .tga "
+	"\\name\\\\hand\\\\color\\\\skin\\default\\model\\bigvic\\models/players/bigvic "
+	"mm \"pr \"print \"ch \"tvch \"aw \"motd 1 \"precache cmd configstrings cmd baselines cs 0 \"cs 1 \"cs 2 \"cs ";
+
+#define NETCHAN_DICTIONARY_SIZE		( sizeof( netchan_dictionary ) - 1 )
+
+// LZ4-style byte aligned LZ77, matches may reach back into the dictionary
+#define NETCHAN_LZ_HASHBITS			12
+#define NETCHAN_LZ_MINMATCH			4
+#define NETCHAN_LZ_LASTLITERALS		5       // the stream always ends with a few literals
+#define NETCHAN_LZ_MFLIMIT			12      // no match may start closer than this to the end
+#define NETCHAN_LZ_MAXOFFSET		65535
+#define NETCHAN_LZ_WINDOWSIZE		( NETCHAN_DICTIONARY_SIZE + MAX_MSGLEN )   // must stay below 64k, positions are 16 bits
+
+// the dictionary hashed into a clean table, copied into place before each compression
+static uint16_t netchan_lzdicttable[1<<NETCHAN_LZ_HASHBITS];
+
+// scratch buffers, one set per thread: snapshots are compressed by several threads
+static ATTRIBUTE_THREADLOCAL uint8_t msg_process_data[MAX_MSGLEN];
+static ATTRIBUTE_THREADLOCAL uint8_t netchan_lzwindow[NETCHAN_LZ_WINDOWSIZE];
+static ATTRIBUTE_THREADLOCAL uint16_t netchan_lztable[1<<NETCHAN_LZ_HASHBITS];
+
+typedef struct
+{
+	uint64_t messages;          // messages handed to the compressor
+	uint64_t compressed;        // messages actually sent compressed
+	uint64_t bytesIn;
+	uint64_t bytesOut;
+	uint64_t usec;
+
+	uint64_t decompressed;
+	uint64_t decompressedIn;
+	uint64_t decompressedOut;
+	uint64_t decompressUsec;
+} netchan_compressionstats_t;
+
+static const char *netchan_compressionNames[NETCHAN_COMPRESSION_TOTAL] = { "legacy", "zlib", "fast" };
+
+static netchan_compressionstats_t netchan_compressionStats[NETCHAN_COMPRESSION_TOTAL];
+static qmutex_t *netchan_statsMutex;
+
+/*
+* Netchan_ZLibDictCompressChunk
+* 
+* Raw deflate primed with the preset dictionary
+*/
+static int Netchan_ZLibDictCompressChunk( const uint8_t *in, int len_in, uint8_t *out, int max_len_out )
+{
+	z_stream zs;
+	int result;
+
+	memset( &zs, 0, sizeof( zs ) );
+	zs.zalloc = Z_NULL;
+	zs.zfree = Z_NULL;
+	zs.opaque = Z_NULL;
+	zs.data_type = Z_BINARY;
+
+	result = deflateInit2( &zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY );
+	if( result != Z_OK )
+	{
+		Com_DPrintf( "ZLib data error! Error %d on deflateInit.\n", result );
+		return -1;
+	}
+
+	result = deflateSetDictionary( &zs, (const Bytef *)netchan_dictionary, NETCHAN_DICTIONARY_SIZE );
+	if( result != Z_OK )
+	{
+		deflateEnd( &zs );
+		return -1;
+	}
+
+	zs.next_in = (Bytef *)in;
+	zs.avail_in = len_in;
+	zs.next_out = out;
+	zs.avail_out = max_len_out;
+
+	result = deflate( &zs, Z_FINISH );
+	deflateEnd( &zs );
+
+	// Z_OK means the output buffer was too small, it's not worth compressing then
+	if( result != Z_STREAM_END )
+		return ( result == Z_OK ? 0 : -1 );
+
+	return zs.total_out;
+}
+
+/*
+* Netchan_ZLibDictDecompressChunk
+*/
+static int Netchan_ZLibDictDecompressChunk( const uint8_t *in, int inlen, uint8_t *out, int outlen )
+{
+	z_stream zs;
+	int result;
+
+	memset( &zs, 0, sizeof( zs ) );
+
+	result = inflateInit2( &zs, -MAX_WBITS );
+	if( result != Z_OK )
+	{
+		Com_DPrintf( "ZLib data error! Error %d on inflateInit.\n", result );
+		return -1;
+	}
+
+	// raw inflate streams take the dictionary right away
+	result = inflateSetDictionary( &zs, (const Bytef *)netchan_dictionary, NETCHAN_DICTIONARY_SIZE );
+	if( result != Z_OK )
+	{
+		inflateEnd( &zs );
+		return -1;
+	}
+
+	zs.next_in = (Bytef *)in;
+	zs.avail_in = inlen;
+	zs.next_out = out;
+	zs.avail_out = outlen;
+
+	result = inflate( &zs, Z_FINISH );
+	inflateEnd( &zs );
+
+	if( result != Z_STREAM_END )
+	{
+		Com_DPrintf( "ZLib data error! Error %d on inflate.\n", result );
+		return -1;
+	}
+
+	return zs.total_out;
+}
+
+/*
+* Netchan_LZHash
+*/
+static inline unsigned int Netchan_LZHash( const uint8_t *p )
+{
+	uint32_t v = p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (uint32_t)p[3] << 24 );
+	return ( v * 2654435761U ) >> ( 32 - NETCHAN_LZ_HASHBITS );
+}
+
+/*
+* Netchan_LZWriteLength
+*/
+static inline uint8_t *Netchan_LZWriteLength( uint8_t *op, int len )
+{
+	for( ; len >= 255; len -= 255 )
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+/*
+* Netchan_LZCompressChunk
+* 
+* Compresses the inlen bytes that follow the dictionary in the window
+*/
+static int Netchan_LZCompressChunk( const uint8_t *window, int inlen, uint8_t *out, int max_len_out, uint16_t *table )
+{
+	const uint8_t *ip = window + NETCHAN_DICTIONARY_SIZE;
+	const uint8_t *anchor = ip;
+	const uint8_t *iend = ip + inlen;
+	const uint8_t *mflimit = iend - NETCHAN_LZ_MFLIMIT;
+	const uint8_t *matchlimit = iend - NETCHAN_LZ_LASTLITERALS;
+	const uint8_t *ref;
+	uint8_t *op = out, *oend = out + max_len_out;
+	uint8_t *token;
+	unsigned int h, misses = 0;
+	int litlen, matchlen;
+
+	if( inlen > NETCHAN_LZ_MFLIMIT )
+	{
+		while( ip < mflimit )
+		{
+			h = Netchan_LZHash( ip );
+			ref = window + table[h];
+			table[h] = (uint16_t)( ip - window );
+
+			if( ip - ref > NETCHAN_LZ_MAXOFFSET || memcmp( ref, ip, NETCHAN_LZ_MINMATCH ) )
+			{
+				// skip faster through data that doesn't compress
+				ip += 1 + ( misses++ >> 5 );
+				continue;
+			}
+			misses = 0;
+
+			// catch up with the literals
+			while( ip > anchor && ref > window && ip[-1] == ref[-1] )
+			{
+				ip--;
+				ref--;
+			}
+
+			for( matchlen = NETCHAN_LZ_MINMATCH; ip + matchlen < matchlimit && ip[matchlen] == ref[matchlen]; matchlen++ );
+
+			litlen = ip - anchor;
+			if( op + 1 + litlen / 255 + 1 + litlen + 2 + matchlen / 255 + 1 > oend )
+				return 0; // not smaller, send it uncompressed
+
+			token = op++;
+			if( litlen >= 15 )
+			{
+				*token = 15 << 4;
+				op = Netchan_LZWriteLength( op, litlen - 15 );
+			}
+			else
+			{
+				*token = litlen << 4;
+			}
+			memcpy( op, anchor, litlen );
+			op += litlen;
+
+			*op++ = ( ip - ref ) & 0xff;
+			*op++ = ( ip - ref ) >> 8;
+
+			if( matchlen - NETCHAN_LZ_MINMATCH >= 15 )
+			{
+				*token |= 15;
+				op = Netchan_LZWriteLength( op, matchlen - NETCHAN_LZ_MINMATCH - 15 );
+			}
+			else
+			{
+				*token |= matchlen - NETCHAN_LZ_MINMATCH;
+			}
+
+			ip += matchlen;
+			anchor = ip;
+		}
+	}
+
+	// the last sequence only carries literals
+	litlen = iend - anchor;
+	if( op + 1 + litlen / 255 + 1 + litlen > oend )
+		return 0;
+
+	token = op++;
+	if( litlen >= 15 )
+	{
+		*token = 15 << 4;
+		op = Netchan_LZWriteLength( op, litlen - 15 );
+	}
+	else
+	{
+		*token = litlen << 4;
+	}
+	memcpy( op, anchor, litlen );
+	op += litlen;
+
+	return op - out;
+}
+
+/*
+* Netchan_LZDecompressChunk
+* 
+* Decompresses into the window, right after the dictionary
+*/
+static int Netchan_LZDecompressChunk( const uint8_t *in, int inlen, uint8_t *window, int outlen )
+{
+	const uint8_t *ip = in, *iend = in + inlen;
+	uint8_t *ostart = window + NETCHAN_DICTIONARY_SIZE;
+	uint8_t *op = ostart, *oend = ostart + outlen;
+	const uint8_t *ref;
+	int token, len, offset, b;
+
+	while( ip < iend )
+	{
+		token = *ip++;
+
+		len = token >> 4;
+		if( len == 15 )
+		{
+			do
+			{
+				if( ip >= iend )
+					return -1;
+				b = *ip++;
+				len += b;
+			} while( b == 255 );
+		}
+		if( len > iend - ip || len > oend - op )
+			return -1;
+		memcpy( op, ip, len );
+		op += len;
+		ip += len;
+
+		if( ip == iend )
+			break;
+
+		if( iend - ip < 2 )
+			return -1;
+		offset = ip[0] | ( ip[1] << 8 );
+		ip += 2;
+		if( !offset || offset > op - window )
+			return -1;
+
+		len = token & 15;
+		if( len == 15 )
+		{
+			do
+			{
+				if( ip >= iend )
+					return -1;
+				b = *ip++;
+				len += b;
+			} while( b == 255 );
+		}
+		len += NETCHAN_LZ_MINMATCH;
+		if( len > oend - op )
+			return -1;
+
+		// the match may overlap the bytes being written
+		for( ref = op - offset; len > 0; len-- )
+			*op++ = *ref++;
+	}
+
+	return op - ostart;
+}
+
+/*
+* Netchan_CompressionMethods
+* 
+* Mask of the methods this build can negotiate
+*/
+int Netchan_CompressionMethods( void )
+{
+	return ( 1<<NETCHAN_COMPRESSION_ZLIB )|( 1<<NETCHAN_COMPRESSION_FAST );
+}
+
+/*
+* Netchan_NegotiateCompression
+* 
+* Picks the method used on a channel from what the peer advertised
+*/
+int Netchan_NegotiateCompression( int peerMethods, int preferred )
+{
+	int methods = peerMethods & Netchan_CompressionMethods();
+
+	if( preferred <= NETCHAN_COMPRESSION_LEGACY || preferred >= NETCHAN_COMPRESSION_TOTAL )
+		return NETCHAN_COMPRESSION_LEGACY;
+	if( methods & ( 1<<preferred ) )
+		return preferred;
+	if( methods & ( 1<<NETCHAN_COMPRESSION_ZLIB ) )
+		return NETCHAN_COMPRESSION_ZLIB;
+	return NETCHAN_COMPRESSION_LEGACY;
+}
 
 /*
 * Netchan_CompressMessage
+* 
+* Compression with any method other than NETCHAN_COMPRESSION_LEGACY
+* must have been negotiated with the peer.
 */
-int Netchan_CompressMessage( msg_t *msg )
+int Netchan_CompressMessage( msg_t *msg, int method )
 {
-	int length;
+	int length, headerlength;
+	static ATTRIBUTE_THREADLOCAL uint8_t compressed[MAX_MSGLEN];
+	netchan_compressionstats_t *stats;
+	uint64_t start;
 
 	if( msg == NULL || !msg->data )
 		return 0;
 
-	// zero-fill our buffer
-	length = 0;
-	memset( msg_process_data, 0, sizeof( msg_process_data ) );
+	if( msg->cursize > MAX_MSGLEN )
+		return 0;
+
+	if( method < NETCHAN_COMPRESSION_LEGACY || method >= NETCHAN_COMPRESSION_TOTAL )
+		method = NETCHAN_COMPRESSION_LEGACY;
+
+	start = Sys_Microseconds();
 
 	//compress the message
-	length = Netchan_ZLibCompressChunk( msg->data, msg->cursize, 
-		msg_process_data, sizeof( msg_process_data ), Z_DEFAULT_COMPRESSION, -MAX_WBITS );
+	headerlength = 0;
+	switch( method )
+	{
+	case NETCHAN_COMPRESSION_ZLIB:
+		compressed[headerlength++] = method;
+		length = Netchan_ZLibDictCompressChunk( msg->data, msg->cursize,
+			compressed + headerlength, sizeof( compressed ) - headerlength );
+		break;
+	case NETCHAN_COMPRESSION_FAST:
+		compressed[headerlength++] = method;
+		memcpy( netchan_lzwindow, netchan_dictionary, NETCHAN_DICTIONARY_SIZE );
+		memcpy( netchan_lzwindow + NETCHAN_DICTIONARY_SIZE, msg->data, msg->cursize );
+		memcpy( netchan_lztable, netchan_lzdicttable, sizeof( netchan_lztable ) );
+		length = Netchan_LZCompressChunk( netchan_lzwindow, msg->cursize, 
+			compressed + headerlength, sizeof( compressed ) - headerlength, netchan_lztable );
+		break;
+	default:
+		length = Netchan_ZLibCompressChunk( msg->data, msg->cursize, 
+			compressed, sizeof( compressed ), Z_DEFAULT_COMPRESSION, -MAX_WBITS );
+		break;
+	}
+
+	if( length > 0 )
+		length += headerlength;
+
+	stats = &netchan_compressionStats[method];
+	QMutex_Lock( netchan_statsMutex );
+	stats->messages++;
+	stats->bytesIn += msg->cursize;
+	stats->usec += Sys_Microseconds() - start;
+	if( length > 0 && (size_t)length < msg->cursize )
+	{
+		stats->compressed++;
+		stats->bytesOut += length;
+	}
+	else
+	{
+		stats->bytesOut += msg->cursize;
+	}
+	QMutex_Unlock( netchan_statsMutex );
+
 	if( length < 0 )  // failed to compress, return the error
 		return length;
 
-	if( (size_t)length >= msg->cursize || length >= MAX_MSGLEN )
+	if( !length || (size_t)length >= msg->cursize || length >= MAX_MSGLEN )
 	{
 		return 0; // compressed was bigger. Send uncompressed
 	}
 
 	//write it back into the original container
 	MSG_Clear( msg );
-	MSG_CopyData( msg, msg_process_data, length );
+	MSG_CopyData( msg, compressed, length );
 	msg->compressed = true;
 
 	return length; // return the new size
@@ -355,10 +763,17 @@ int Netchan_CompressMessage( msg_t *msg )
 
 /*
 * Netchan_DecompressMessage
+* 
+* The method is the one negotiated for the channel, which tells whether
+* the payload starts with the method byte
 */
-int Netchan_DecompressMessage( msg_t *msg )
+int Netchan_DecompressMessage( msg_t *msg, int method )
 {
-	int length;
+	int length, inlen;
+	const uint8_t *in;
+	size_t outlen;
+	uint64_t start;
+	netchan_compressionstats_t *stats;
 
 	if( msg == NULL || !msg->data )
 		return 0;
@@ -366,10 +781,50 @@ int Netchan_DecompressMessage( msg_t *msg )
 	if( msg->compressed == false )
 		return 0;
 
-	length = Netchan_ZLibDecompressChunk( msg->data + msg->readcount, msg->cursize - msg->readcount, msg_process_data, ( sizeof( msg_process_data ) - msg->readcount ), -MAX_WBITS );
+	in = msg->data + msg->readcount;
+	inlen = msg->cursize - msg->readcount;
+	outlen = sizeof( msg_process_data ) - msg->readcount;
+
+	if( method != NETCHAN_COMPRESSION_LEGACY )
+	{
+		if( inlen < 1 )
+			return -1;
+		method = *in++;
+		inlen--;
+	}
+
+	start = Sys_Microseconds();
+
+	switch( method )
+	{
+	case NETCHAN_COMPRESSION_LEGACY:
+		length = Netchan_ZLibDecompressChunk( (uint8_t *)in, inlen, msg_process_data, outlen, -MAX_WBITS );
+		break;
+	case NETCHAN_COMPRESSION_ZLIB:
+		length = Netchan_ZLibDictDecompressChunk( in, inlen, msg_process_data, outlen );
+		break;
+	case NETCHAN_COMPRESSION_FAST:
+		memcpy( netchan_lzwindow, netchan_dictionary, NETCHAN_DICTIONARY_SIZE );
+		length = Netchan_LZDecompressChunk( in, inlen, netchan_lzwindow, outlen );
+		if( length > 0 )
+			memcpy( msg_process_data, netchan_lzwindow + NETCHAN_DICTIONARY_SIZE, length );
+		break;
+	default:
+		Com_DPrintf( "Netchan_DecompressMessage: Unknown compression method %i\n", method );
+		return -1;
+	}
+
 	if( length < 0 )
 		return length;
 
+	stats = &netchan_compressionStats[method];
+	QMutex_Lock( netchan_statsMutex );
+	stats->decompressed++;
+	stats->decompressedIn += inlen;
+	stats->decompressedOut += length;
+	stats->decompressUsec += Sys_Microseconds() - start;
+	QMutex_Unlock( netchan_statsMutex );
+
 	if( ( msg->readcount + length ) >= msg->maxsize )
 	{
 		Com_Printf( "Netchan_DecompressMessage: Packet too big\n" );
@@ -384,6 +839,31 @@ int Netchan_DecompressMessage( msg_t *msg )
 	return length;
 }
 
+/*
+* Netchan_CompressionStats_f
+*/
+static void Netchan_CompressionStats_f( void )
+{
+	int i;
+	netchan_compressionstats_t stats[NETCHAN_COMPRESSION_TOTAL];
+
+	QMutex_Lock( netchan_statsMutex );
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) )
+		memset( netchan_compressionStats, 0, sizeof( netchan_compressionStats ) );
+	memcpy( stats, netchan_compressionStats, sizeof( stats ) );
+	QMutex_Unlock( netchan_statsMutex );
+
+	Com_Printf( "method   messages  compressed    bytes in   bytes out  saved  usec/msg | inflated  usec/msg\n" );
+	for( i = 0; i < NETCHAN_COMPRESSION_TOTAL; i++ )
+	{
+		Com_Printf( "%-6s %10.0f %11.0f %11.0f %11.0f %5.1f%% %9.1f | %8.0f %9.1f\n", netchan_compressionNames[i],
+			(double)stats[i].messages, (double)stats[i].compressed, (double)stats[i].bytesIn, (double)stats[i].bytesOut,
+			stats[i].bytesIn ? 100.0 * ( (double)stats[i].bytesIn - (double)stats[i].bytesOut ) / stats[i].bytesIn : 0.0,
+			stats[i].messages ? (double)stats[i].usec / stats[i].messages : 0.0, (double)stats[i].decompressed,
+			stats[i].decompressed ? (double)stats[i].decompressUsec / stats[i].decompressed : 0.0 );
+	}
+}
+
 /*
 * Netchan_DropAllFragments
 * 
@@ -398,6 +878,16 @@ static void Netchan_DropAllFragments( netchan_t *chan )
 	}
 }
 
+/*
+* Netchan_SendPacket
+*/
+static inline bool Netchan_SendPacket( netchan_t *chan, const void *data, size_t length )
+{
+	if( chan->batch )
+		return NET_QueuePacket( chan->batch, chan->socket, data, length, &chan->remoteAddress );
+	return NET_SendPacket( chan->socket, data, length, &chan->remoteAddress );
+}
+
 /*
 * Netchan_TransmitNextFragment
 * 
@@ -446,7 +936,7 @@ bool Netchan_TransmitNextFragment( netchan_t *chan )
 	MSG_CopyData( &send, chan->unsentBuffer + chan->unsentFragmentStart, fragmentLength );
 
 	// send the datagram
-	if( !NET_SendPacket( chan->socket, send.data, send.cursize, &chan->remoteAddress ) )
+	if( !Netchan_SendPacket( chan, send.data, send.cursize ) )
 	{
 		Netchan_DropAllFragments( chan );
 		return false;
@@ -543,7 +1033,7 @@ bool Netchan_Transmit( netchan_t *chan, msg_t *msg )
 	MSG_CopyData( &send, msg->data, msg->cursize );
 
 	// send the datagram
-	if( !NET_SendPacket( chan->socket, send.data, send.cursize, &chan->remoteAddress ) )
+	if( !Netchan_SendPacket( chan, send.data, send.cursize ) )
 		return false;
 
 	if( showpackets->integer )
@@ -761,12 +1251,24 @@ int Netchan_GamePort( void )
 */
 void Netchan_Init( void )
 {
+	int i;
+
 	// pick a game port value that should be nice and random
 	game_port = Sys_Milliseconds() & 0xffff;
 
 	showpackets = Cvar_Get( "showpackets", "0", 0 );
 	showdrop = Cvar_Get( "showdrop", "0", 0 );
 	net_showfragments = Cvar_Get( "net_showfragments", "0", 0 );
+
+	// hash the dictionary once, the fast compressor starts from a copy of the table
+	memset( netchan_lzdicttable, 0, sizeof( netchan_lzdicttable ) );
+	for( i = 0; i + NETCHAN_LZ_MINMATCH <= (int)NETCHAN_DICTIONARY_SIZE; i++ )
+		netchan_lzdicttable[Netchan_LZHash( (const uint8_t *)netchan_dictionary + i )] = i;
+
+	memset( netchan_compressionStats, 0, sizeof( netchan_compressionStats ) );
+	netchan_statsMutex = QMutex_Create();
+
+	Cmd_AddCommand( "net_compressionstats", Netchan_CompressionStats_f );
 }
 
 /*
@@ -774,4 +1276,7 @@ void Netchan_Init( void )
 */
 void Netchan_Shutdown( void )
 {
+	Cmd_RemoveCommand( "net_compressionstats" );
+
+	QMutex_Destroy( &netchan_statsMutex );
 }
@@ -59,6 +59,8 @@ typedef struct
 	size_t cursize;
 	size_t readcount;
 	bool compressed;
+	int writebit;		// bits used in the last byte written by MSG_WriteBits, 0 if none
+	int readbit;		// bits consumed from the last byte read by MSG_ReadBits, 0 if none
 } msg_t;
 
 // msg.c
@@ -88,6 +90,15 @@ void MSG_WriteDeltaUsercmd( msg_t *sb, struct usercmd_s *from, struct usercmd_s
 void MSG_WriteDeltaEntity( struct entity_state_s *from, struct entity_state_s *to, msg_t *msg, bool force, bool newentity );
 void MSG_WriteDir( msg_t *sb, vec3_t vector );
 
+// bit IO, least significant bit first. Consecutive bit writes (reads) share bytes,
+// any byte sized write (read) in between starts a new byte, as does MSG_AlignBits
+void MSG_WriteBits( msg_t *sb, unsigned int value, int numbits );
+void MSG_WritePackedUint( msg_t *sb, unsigned int value );
+void MSG_WritePackedInt( msg_t *sb, int value );
+void MSG_WriteFlagBits( msg_t *sb, unsigned int flags, unsigned int mask );
+void MSG_AlignBits( msg_t *sb );
+void MSG_WritePackedDeltaEntity( struct entity_state_s *from, struct entity_state_s *to, msg_t *msg, bool force, bool updateOtherOrigin );
+void MSG_WritePackedEntityRemove( msg_t *msg, int number );
 
 void MSG_BeginReading( msg_t *sb );
 
@@ -109,6 +120,13 @@ void MSG_ReadDeltaUsercmd( msg_t *sb, struct usercmd_s *from, struct usercmd_s *
 int MSG_ReadEntityBits( msg_t *msg, unsigned *bits );
 void MSG_ReadDeltaEntity( msg_t *msg, entity_state_t *from, entity_state_t *to, int number, unsigned bits );
 
+unsigned int MSG_ReadBits( msg_t *sb, int numbits );
+unsigned int MSG_ReadPackedUint( msg_t *sb );
+int MSG_ReadPackedInt( msg_t *sb );
+unsigned int MSG_ReadFlagBits( msg_t *sb, unsigned int mask );
+int MSG_ReadPackedEntityBits( msg_t *msg, unsigned *bits );
+void MSG_ReadPackedDeltaEntity( msg_t *msg, entity_state_t *from, entity_state_t *to, int number, unsigned bits );
+
 void MSG_ReadDir( msg_t *sb, vec3_t vector );
 void MSG_ReadData( msg_t *sb, void *buffer, size_t length );
 int MSG_SkipData( msg_t *sb, size_t length );
@@ -137,19 +155,56 @@ void Com_FreePureList( purelist_t **purelist );
 // define this 0 to disable compression of demo files
 #define SNAP_DEMO_GZ					FS_GZ
 
+// demo keyframes are full (non-delta) snapshots the playback can seek to,
+// offset points at the uncompressed position of the record to start reading from
+typedef struct
+{
+	unsigned int serverTime;
+	unsigned int offset;
+} snap_demokeyframe_t;
+
 void SNAP_ParseBaseline( msg_t *msg, entity_state_t *baselines );
 void SNAP_SkipFrame( msg_t *msg, struct snapshot_s *header );
 struct snapshot_s *SNAP_ParseFrame( msg_t *msg, struct snapshot_s *lastFrame, int *suppressCount, struct snapshot_s *backup, entity_state_t *baselines, int showNet );
 
+typedef struct snap_deltacache_s snap_deltacache_t;
+
+typedef struct
+{
+	unsigned int start;					// Sys_Milliseconds() when the stats were reset
+	unsigned int frames;
+	uint64_t hits;						// entity deltas copied from another client's snapshot
+	uint64_t misses;
+	uint64_t bytesReused;
+	unsigned int overflows;				// deltas not cached because the frame's data buffer was full
+	unsigned int maxDataUsed;
+} snap_deltacache_stats_t;
+
+snap_deltacache_t *SNAP_CreateDeltaCache( struct mempool_s *mempool );
+void SNAP_DestroyDeltaCache( snap_deltacache_t **pcache );
+void SNAP_BeginDeltaCacheFrame( snap_deltacache_t *cache );
+void SNAP_SetDeltaCacheVolatileEntity( snap_deltacache_t *cache, int entNum );
+void SNAP_GetDeltaCacheStats( snap_deltacache_t *cache, snap_deltacache_stats_t *stats );
+void SNAP_ResetDeltaCacheStats( snap_deltacache_t *cache );
+
+int SNAP_NegotiateEncoding( int peerEncoding, int preferred );
 void SNAP_WriteFrameSnapToClient( struct ginfo_s *gi, struct client_s *client, msg_t *msg, unsigned int frameNum, unsigned int gameTime,
-								 entity_state_t *baselines, struct client_entities_s *client_entities,
+								 entity_state_t *baselines, struct client_entities_s *client_entities, snap_deltacache_t *deltacache,
 								 int numcmds, gcommand_t *commands, const char *commandsData );
 
+typedef struct snap_viscache_s snap_viscache_t;
+
+snap_viscache_t *SNAP_CreateVisCache( struct mempool_s *mempool );
+void SNAP_DestroyVisCache( snap_viscache_t **pcache );
+void SNAP_BeginVisCacheFrame( snap_viscache_t *cache, struct cmodel_state_s *cms, struct ginfo_s *gi );
+
+void SNAP_FixEntityNumbers( struct ginfo_s *gi );
 void SNAP_BuildClientFrameSnap( struct cmodel_state_s *cms, struct ginfo_s *gi, unsigned int frameNum, unsigned int timeStamp,
-							   struct fatvis_s *fatvis, struct client_s *client, 
+							   struct fatvis_s *fatvis, snap_viscache_t *viscache, struct client_s *client, 
 							   game_state_t *gameState, struct client_entities_s *client_entities,
 							   bool relay, struct mempool_s *mempool );
 
+void SNAP_CopyClientFrameSnap( struct client_s *client, struct client_s *from, unsigned int frameNum, struct mempool_s *mempool );
 void SNAP_FreeClientFrames( struct client_s *client );
 
 void SNAP_RecordDemoMessage( int demofile, msg_t *msg, int offset );
@@ -163,6 +218,11 @@ size_t SNAP_ClearDemoMeta( char *meta_data, size_t meta_data_max_size );
 size_t SNAP_SetDemoMetaKeyValue( char *meta_data, size_t meta_data_max_size, size_t meta_data_realsize,
 							  const char *key, const char *value );
 size_t SNAP_ReadDemoMetaData( int demofile, char *meta_data, size_t meta_data_size );
+size_t SNAP_SetDemoMetaKeyframes( char *meta_data, size_t meta_data_max_size, size_t meta_data_realsize,
+							  const snap_demokeyframe_t *keyframes, unsigned int numKeyframes );
+unsigned int SNAP_ReadDemoMetaKeyframes( const char *meta_data, size_t meta_data_realsize,
+							  snap_demokeyframe_t *keyframes, unsigned int maxKeyframes );
+snap_demokeyframe_t *SNAP_ScanDemoKeyframes( int demofile, unsigned int *numKeyframes );
 
 //============================================================================
 
@@ -279,6 +339,19 @@ enum clc_ops_e
 #define FRAMESNAP_FLAG_DELTA		( 1<<0 )
 #define FRAMESNAP_FLAG_ALLENTITIES	( 1<<1 )
 #define FRAMESNAP_FLAG_MULTIPOV		( 1<<2 )
+#define FRAMESNAP_FLAG_BITPACKED	( 1<<3 )	// playerstates and entities use SNAP_ENCODING_BITPACKED
+
+// snapshot encodings, negotiated at connect time through the SNAP_ENCODING_KEY userinfo key
+#define SNAP_ENCODING_KEY			"snapencoding"
+
+#define SNAP_ENCODING_LEGACY		0	// byte aligned fields behind the U_* and PS_* bitmasks
+#define SNAP_ENCODING_BITPACKED		1	// bit packed, quantized residuals against the delta state
+#define SNAP_ENCODING_TOTAL			2
+
+// the bit packed playerstate origin is coded against the old origin moved by the old velocity
+#define SNAP_PREDICT_MAXMSEC		1000
+#define SNAP_PredictMsec( time, oldtime ) ( (unsigned)( time ) - (unsigned)( oldtime ) <= SNAP_PREDICT_MAXMSEC ? (int)( ( time ) - ( oldtime ) ) : 0 )
+#define SNAP_PredictCoord( coord, velocity, msec ) ( ( coord ) + (int)( (int64_t)( velocity ) * ( msec ) / 1000 ) )
 
 // plyer_state_t communication
 
@@ -314,6 +387,13 @@ enum clc_ops_e
 #define	PS_M_DELTA_ANGLES2  ( 1<<27 )
 #define	PS_PLAYERNUM	    ( 1<<28 )
 
+// bit packed playerstates send the flags that change in most snapshots one bit
+// each, and the rest of them behind a single bit
+#define PS_PACKED_COMMON	( PS_M_ORIGIN0|PS_M_ORIGIN1|PS_M_ORIGIN2|PS_M_VELOCITY0|PS_M_VELOCITY1|PS_M_VELOCITY2 \
+							|PS_VIEWANGLES|PS_EVENT|PS_M_FLAGS|PS_PLRKEYS|PS_PMOVESTATS )
+#define PS_PACKED_RARE		( PS_M_TYPE|PS_M_TIME|PS_EVENT2|PS_WEAPONSTATE|PS_INVENTORY|PS_FOV|PS_POVNUM|PS_VIEWHEIGHT \
+							|PS_M_GRAVITY|PS_M_DELTA_ANGLES0|PS_M_DELTA_ANGLES1|PS_M_DELTA_ANGLES2|PS_PLAYERNUM )
+
 
 
 //==============================================
@@ -375,6 +455,13 @@ enum clc_ops_e
 #define	U_FRAME16	( 1<<29 )     // frame is a short
 #define	U_TEAM		( 1<<30 )     // gameteam. Will rarely change
 
+// bit packed entities send the flags that change in most deltas one bit each, and
+// the rest of them behind a single bit. frame, skin and effects use the *8 flag only
+#define U_PACKED_COMMON	( U_ORIGIN1|U_ORIGIN2|U_ORIGIN3|U_ANGLE1|U_ANGLE2|U_ANGLE3|U_EVENT )
+#define U_PACKED_RARE	( U_TYPE|U_SOLID|U_MODEL|U_MODEL2|U_FRAME8|U_SKIN8|U_EFFECTS8|U_OTHERORIGIN \
+						|U_SOUND|U_EVENT2|U_ATTENUATION|U_WEAPON|U_SVFLAGS|U_LIGHT|U_TEAM )
+#define U_PACKED_NUMBERBITS	10
+
 /*
 ==============================================================
 
@@ -592,6 +679,29 @@ typedef struct
 	socket_handle_t handle;
 } socket_t;
 
+// persistent set of sockets waited on by NET_PollWait
+typedef struct netpoll_s netpoll_t;
+
+#define NET_MAX_BATCH_PACKETS	64
+
+// datagrams queued for a single socket, so that they can be sent
+// with as few system calls as the platform allows
+typedef struct netbatch_s
+{
+	const socket_t *socket;
+	int numpackets;
+	size_t lengths[NET_MAX_BATCH_PACKETS];
+	netadr_t addresses[NET_MAX_BATCH_PACKETS];
+	int tags[NET_MAX_BATCH_PACKETS];
+	uint8_t data[NET_MAX_BATCH_PACKETS][MAX_PACKETLEN];
+
+	// queued packets are tagged with the current tag, onfail is called
+	// with the tag of each packet that couldn't be sent, from the thread
+	// that flushed the batch so NET_ErrorString still holds the reason
+	int tag;
+	void ( *onfail )( struct netbatch_s *batch, int tag );
+} netbatch_t;
+
 typedef enum
 {
 	CONNECTION_FAILED = -1,
@@ -626,13 +736,20 @@ int						NET_Accept( const socket_t *socket, socket_t *newsocket, netadr_t *addr
 
 int			NET_GetPacket( const socket_t *socket, netadr_t *address, msg_t *message );
 bool    NET_SendPacket( const socket_t *socket, const void *data, size_t length, const netadr_t *address );
+int			NET_GetPackets( const socket_t *socket, netadr_t *addresses, msg_t *messages, int maxpackets );
+bool    NET_QueuePacket( netbatch_t *batch, const socket_t *socket, const void *data, size_t length, const netadr_t *address );
+int			NET_FlushBatch( netbatch_t *batch );
 
 int			NET_Get( const socket_t *socket, netadr_t *address, void *data, size_t length );
 int         NET_Send( const socket_t *socket, const void *data, size_t length, const netadr_t *address );
 
-void	    NET_Sleep( int msec, socket_t *sockets[] );
-int         NET_Monitor( int msec, socket_t *sockets[], 
-	void (*read_cb)(socket_t *socket, void*), void (*exception_cb)(socket_t *socket, void*), void *privatep[] );
+netpoll_t  *NET_CreatePoll( void );
+void		NET_DestroyPoll( netpoll_t **poll );
+bool		NET_PollAddSocket( netpoll_t *poll, socket_t *socket,
+	void (*read_cb)(socket_t *socket, void*), void (*exception_cb)(socket_t *socket, void*), void *privatep );
+void		NET_PollRemoveSocket( netpoll_t *poll, socket_t *socket );
+int			NET_PollWait( netpoll_t *poll, int msec );
+int			NET_PollWaitMicroseconds( netpoll_t *poll, unsigned int usec );
 const char *NET_ErrorString( void );
 void	    NET_SetErrorString( const char *format, ... );
 void		NET_SetErrorStringFromLastError( const char *function );
@@ -657,6 +774,15 @@ void	    NET_BroadcastAddress( netadr_t *address, int port );
 
 //============================================================================
 
+// compression methods, negotiated at connect time through the
+// NETCHAN_COMPRESSION_KEY userinfo key and the client_connect reply
+#define NETCHAN_COMPRESSION_KEY		"compression"
+
+#define NETCHAN_COMPRESSION_LEGACY	0   // plain zlib, the payload carries no method byte
+#define NETCHAN_COMPRESSION_ZLIB	1   // raw deflate primed with the preset dictionary
+#define NETCHAN_COMPRESSION_FAST	2   // LZ4-style byte aligned LZ77, primed with the preset dictionary
+#define NETCHAN_COMPRESSION_TOTAL	3
+
 typedef struct
 {
 	const socket_t *socket;
@@ -684,7 +810,11 @@ typedef struct
 	uint8_t unsentBuffer[MAX_MSGLEN];
 	bool unsentIsCompressed;
 
+	int compression;            // negotiated NETCHAN_COMPRESSION_* method
+
 	bool fatal_error;
+
+	netbatch_t *batch;          // if set, datagrams are queued here instead of being sent right away
 } netchan_t;
 
 extern netadr_t	net_from;
@@ -697,8 +827,10 @@ bool Netchan_Process( netchan_t *chan, msg_t *msg );
 bool Netchan_Transmit( netchan_t *chan, msg_t *msg );
 bool Netchan_PushAllFragments( netchan_t *chan );
 bool Netchan_TransmitNextFragment( netchan_t *chan );
-int Netchan_CompressMessage( msg_t *msg );
-int Netchan_DecompressMessage( msg_t *msg );
+int Netchan_CompressionMethods( void );
+int Netchan_NegotiateCompression( int peerMethods, int preferred );
+int Netchan_CompressMessage( msg_t *msg, int method );
+int Netchan_DecompressMessage( msg_t *msg, int method );
 void Netchan_OutOfBand( const socket_t *socket, const netadr_t *address, size_t length, const uint8_t *data );
 void Netchan_OutOfBandPrint( const socket_t *socket, const netadr_t *address, const char *format, ... );
 int Netchan_GamePort( void );
@@ -740,6 +872,8 @@ const char *FS_AbsoluteNameForBaseFile( const char *filename );
 // file streaming
 int	    FS_FOpenFile( const char *filename, int *filenum, int mode );
 int	    FS_FOpenBaseFile( const char *filename, int *filenum, int mode );
+void		*FS_MMapBaseFile( const char *filename, size_t *size );
+void	    FS_UnMMapBaseFile( void *mapping, size_t size );
 int		FS_FOpenAbsoluteFile( const char *filename, int *filenum, int mode );
 void	FS_FCloseFile( int file );
 
@@ -874,6 +1008,7 @@ void Memory_Init( void );
 void Memory_InitCommands( void );
 void Memory_Shutdown( void );
 void Memory_ShutdownCommands( void );
+void Mem_ReleaseThreadCache( void );
 
 void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t aligment, int z, int musthave, int canthave, const char *filename, int fileline );
 void *_Mem_Alloc( mempool_t *pool, size_t size, int musthave, int canthave, const char *filename, int fileline );
@@ -884,6 +1019,8 @@ mempool_t *_Mem_AllocTempPool( const char *name, const char *filename, int filel
 void _Mem_FreePool( mempool_t **pool, int musthave, int canthave, const char *filename, int fileline );
 void _Mem_EmptyPool( mempool_t *pool, int musthave, int canthave, const char *filename, int fileline );
 char *_Mem_CopyString( mempool_t *pool, const char *in, const char *filename, int fileline );
+void *_Mem_FrameAlloc( size_t size, const char *filename, int fileline );
+void Mem_ResetFrameArena( void );
 
 void _Mem_CheckSentinels( void *data, const char *filename, int fileline );
 void _Mem_CheckSentinelsGlobal( const char *filename, int fileline );
@@ -899,6 +1036,7 @@ size_t Mem_PoolTotalSize( mempool_t *pool );
 #define Mem_FreePool( pool ) _Mem_FreePool( pool, 0, 0, __FILE__, __LINE__ )
 #define Mem_EmptyPool( pool ) _Mem_EmptyPool( pool, 0, 0, __FILE__, __LINE__ )
 #define Mem_CopyString( pool, str ) _Mem_CopyString( pool, str, __FILE__, __LINE__ )
+#define Mem_FrameAlloc( size ) _Mem_FrameAlloc( size, __FILE__, __LINE__ )
 
 #define Mem_CheckSentinels( data ) _Mem_CheckSentinels( data, __FILE__, __LINE__ )
 #define Mem_CheckSentinelsGlobal() _Mem_CheckSentinelsGlobal( __FILE__, __LINE__ )
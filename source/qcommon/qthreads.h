@@ -27,19 +27,32 @@ typedef struct qmutex_s qmutex_t;
 struct qthread_s;
 typedef struct qthread_s qthread_t;
 
+struct qcondvar_s;
+typedef struct qcondvar_s qcondvar_t;
+
 struct qbufQueue_s;
 typedef struct qbufQueue_s qbufQueue_t;
 
+#define Q_THREADS_WAIT_INFINITE 0xFFFFFFFF
+
 qmutex_t *QMutex_Create( void );
 void QMutex_Destroy( qmutex_t **pmutex );
 void QMutex_Lock( qmutex_t *mutex );
+bool QMutex_TryLock( qmutex_t *mutex );
 void QMutex_Unlock( qmutex_t *mutex );
 
+qcondvar_t *QCondVar_Create( void );
+void QCondVar_Destroy( qcondvar_t **pcond );
+bool QCondVar_Wait( qcondvar_t *cond, qmutex_t *mutex, unsigned int timeout_msec );
+void QCondVar_Wake( qcondvar_t *cond );
+
 qthread_t *QThread_Create( void *(*routine) (void*), void *param );
 void QThread_Join( qthread_t *thread );
 int QThread_Cancel( qthread_t *thread );
 void QThread_Yield( void );
 
+int QAtomic_Add( volatile int *value, int add, qmutex_t *mutex );
+
 void QThreads_Init( void );
 void QThreads_Shutdown( void );
 
@@ -416,3 +416,264 @@ size_t SNAP_ReadDemoMetaData( int demofile, char *meta_data, size_t meta_data_si
 
 	return meta_data_realsize;
 }
+
+/*
+* SNAP_FindDemoMetaValue
+*
+* Returns the value of the given key and its length, the value may not be null-terminated
+* if it's the last one in the buffer
+*/
+static const char *SNAP_FindDemoMetaValue( const char *meta_data, size_t meta_data_realsize, const char *key, size_t *value_len )
+{
+	const char *s, *m_key, *m_val;
+	const char *end = meta_data + meta_data_realsize;
+
+	for( s = meta_data; s < end && *s; ) {
+		m_key = s;
+		for( m_val = m_key; m_val < end && *m_val; m_val++ );
+		if( ++m_val >= end ) {
+			// key without the value pair, EOF
+			break;
+		}
+
+		for( s = m_val; s < end && *s; s++ );
+
+		if( !Q_stricmp( m_key, key ) ) {
+			*value_len = s - m_val;
+			return m_val;
+		}
+
+		// some other key, skip
+		s++;
+	}
+
+	*value_len = 0;
+	return NULL;
+}
+
+/*
+* SNAP_SetDemoMetaKeyframes
+*
+* Stores the keyframe index as "serverTime offset serverTime offset..." under the "keyframes" key.
+* If the index doesn't fit into the meta data, every other keyframe is dropped until it does.
+*/
+size_t SNAP_SetDemoMetaKeyframes( char *meta_data, size_t meta_data_max_size, size_t meta_data_realsize,
+							  const snap_demokeyframe_t *keyframes, unsigned int numKeyframes )
+{
+	unsigned int i, step;
+	size_t len, kflen, max_len, used;
+	char *value, kf[32];
+
+	if( !numKeyframes ) {
+		return meta_data_realsize;
+	}
+
+	// the old index gets replaced, so its space is available to the new one
+	used = meta_data_realsize;
+	if( SNAP_FindDemoMetaValue( meta_data, meta_data_realsize, "keyframes", &len ) ) {
+		used -= strlen( "keyframes" ) + 1 + len + 1;
+	}
+	if( used + strlen( "keyframes" ) + 1 + 1 >= meta_data_max_size ) {
+		return meta_data_realsize;
+	}
+	max_len = meta_data_max_size - used - strlen( "keyframes" ) - 1 - 1;
+
+	value = Mem_TempMalloc( max_len + 1 );
+
+	for( step = 1; step <= numKeyframes; step *= 2 ) {
+		len = 0;
+		for( i = 0; i < numKeyframes; i += step ) {
+			Q_snprintfz( kf, sizeof( kf ), "%s%u %u", len ? " " : "", keyframes[i].serverTime, keyframes[i].offset );
+			kflen = strlen( kf );
+			if( len + kflen > max_len ) {
+				break;
+			}
+			memcpy( value + len, kf, kflen + 1 );
+			len += kflen;
+		}
+
+		if( i >= numKeyframes ) {
+			if( step > 1 ) {
+				Com_Printf( "SNAP_SetDemoMetaKeyframes: storing every %u%s keyframe\n", step, step == 2 ? "nd" : "th" );
+			}
+			meta_data_realsize = SNAP_SetDemoMetaKeyValue( meta_data, meta_data_max_size, meta_data_realsize, "keyframes", value );
+			break;
+		}
+	}
+
+	Mem_TempFree( value );
+
+	return meta_data_realsize;
+}
+
+/*
+* SNAP_ReadDemoMetaKeyframes
+*
+* Parses the keyframe index stored in meta data. Returns the number of keyframes,
+* or the number of keyframes available if keyframes is NULL.
+*/
+unsigned int SNAP_ReadDemoMetaKeyframes( const char *meta_data, size_t meta_data_realsize,
+							  snap_demokeyframe_t *keyframes, unsigned int maxKeyframes )
+{
+	unsigned int num, field, values[2];
+	size_t len;
+	const char *s, *end;
+	snap_demokeyframe_t *last;
+
+	s = SNAP_FindDemoMetaValue( meta_data, meta_data_realsize, "keyframes", &len );
+	if( !s ) {
+		return 0;
+	}
+
+	num = 0;
+	field = 0;
+	last = NULL;
+	for( end = s + len; s < end; ) {
+		if( *s == ' ' ) {
+			s++;
+			continue;
+		}
+		if( *s < '0' || *s > '9' ) {
+			// garbage, don't trust the rest of the index
+			break;
+		}
+
+		values[field] = 0;
+		for( ; s < end && *s >= '0' && *s <= '9'; s++ ) {
+			values[field] = values[field] * 10 + ( *s - '0' );
+		}
+
+		if( ++field < 2 ) {
+			continue;
+		}
+		field = 0;
+
+		if( keyframes ) {
+			if( num >= maxKeyframes ) {
+				break;
+			}
+
+			// keyframes must come in order, both in time and in the file
+			if( last && ( values[0] <= last->serverTime || values[1] <= last->offset ) ) {
+				continue;
+			}
+
+			last = &keyframes[num];
+			last->serverTime = values[0];
+			last->offset = values[1];
+		}
+		num++;
+	}
+
+	return num;
+}
+
+/*
+* SNAP_ScanDemoKeyframes
+*
+* Walks through a multipov demo looking for non-delta frames, which are the keyframes
+* playback can jump to. A keyframe starts at the configstring records preceding the frame,
+* if any. Returns a zone-allocated array of keyframes.
+*/
+snap_demokeyframe_t *SNAP_ScanDemoKeyframes( int demofile, unsigned int *numKeyframes )
+{
+	int cmd, msglen, offset, runStart;
+	int framelen, framestart, flags;
+	unsigned int serverTime, maxKeyframes;
+	bool csOnly, framesInRecord;
+	const char *s;
+	msg_t msg;
+	static uint8_t msg_buffer[MAX_MSGLEN];
+	snap_demokeyframe_t *keyframes;
+
+	*numKeyframes = 0;
+	maxKeyframes = 64;
+	keyframes = Mem_ZoneMalloc( maxKeyframes * sizeof( *keyframes ) );
+
+	MSG_Init( &msg, msg_buffer, sizeof( msg_buffer ) );
+
+	runStart = -1;
+	while( 1 ) {
+		offset = FS_Tell( demofile );
+
+		msglen = -1;
+		if( FS_Read( &msglen, 4, demofile ) != 4 ) {
+			break;
+		}
+		msglen = LittleLong( msglen );
+		if( msglen < 0 || msglen > MAX_MSGLEN ) {
+			break;
+		}
+		if( FS_Read( msg.data, msglen, demofile ) != msglen ) {
+			break;
+		}
+		msg.cursize = msglen;
+		msg.readcount = 0;
+
+		csOnly = msglen > 0;
+		framesInRecord = false;
+		while( msg.readcount < msg.cursize ) {
+			cmd = MSG_ReadByte( &msg );
+
+			if( cmd == svc_nop ) {
+				continue;
+			}
+
+			if( cmd == svc_servercs || cmd == svc_servercmd ) {
+				s = MSG_ReadString( &msg );
+				if( cmd != svc_servercs || strncmp( s, "cs ", 3 ) ) {
+					csOnly = false;
+				}
+				continue;
+			}
+
+			csOnly = false;
+			if( cmd != svc_frame || msg.readcount + 2 + 4 * 4 + 2 > msg.cursize ) {
+				// header records, ignore the rest
+				break;
+			}
+
+			// frame header: length, serverTime, frame number, delta frame number,
+			// executed ucmd, flags, suppress count; skip the rest
+			framelen = MSG_ReadShort( &msg );
+			framestart = msg.readcount;
+			serverTime = (unsigned)MSG_ReadLong( &msg );
+			MSG_ReadLong( &msg );
+			MSG_ReadLong( &msg );
+			MSG_ReadLong( &msg );
+			flags = MSG_ReadByte( &msg );
+			if( !MSG_SkipData( &msg, framelen - ( msg.readcount - framestart ) ) ) {
+				break;
+			}
+
+			if( !( flags & FRAMESNAP_FLAG_MULTIPOV ) ) {
+				// not a server demo, the records can't be parsed blindly
+				Mem_ZoneFree( keyframes );
+				*numKeyframes = 0;
+				return NULL;
+			}
+
+			if( !( flags & FRAMESNAP_FLAG_DELTA ) && !framesInRecord ) {
+				if( *numKeyframes == maxKeyframes ) {
+					maxKeyframes *= 2;
+					keyframes = Mem_Realloc( keyframes, maxKeyframes * sizeof( *keyframes ) );
+				}
+				keyframes[*numKeyframes].serverTime = serverTime;
+				keyframes[*numKeyframes].offset = runStart >= 0 ? runStart : offset;
+				(*numKeyframes)++;
+			}
+			framesInRecord = true;
+		}
+
+		if( csOnly ) {
+			if( runStart < 0 ) {
+				runStart = offset;
+			}
+		}
+		else {
+			runStart = -1;
+		}
+	}
+
+	return keyframes;
+}
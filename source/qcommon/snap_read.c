@@ -272,11 +272,166 @@ static void SNAP_ParsePlayerstate( msg_t *msg, player_state_t *oldstate, player_
 	}
 }
 
+/*
+* SNAP_ParsePackedPlayerstate
+*
+* SNAP_ParsePlayerstate for bit packed frames, see SNAP_WritePackedPlayerstateToClient
+*/
+static void SNAP_ParsePackedPlayerstate( msg_t *msg, player_state_t *oldstate, player_state_t *state, int msec )
+{
+	int flags;
+	int i, j, q;
+	int statbits[SNAP_STATS_LONGS];
+
+	// clear to old value before delta parsing
+	if( oldstate )
+	{
+		memcpy( state, oldstate, sizeof( *state ) );
+	}
+	else
+	{
+		memset( state, 0, sizeof( *state ) );
+		msec = 0;
+	}
+
+	flags = MSG_ReadFlagBits( msg, PS_PACKED_COMMON );
+	if( MSG_ReadBits( msg, 1 ) )
+		flags |= MSG_ReadFlagBits( msg, PS_PACKED_RARE );
+
+	//
+	// parse the pmove_state_t
+	//
+	if( flags & PS_M_TYPE )
+		state->pmove.pm_type = MSG_ReadPackedUint( msg );
+
+	// the origin is predicted from the old velocity, so it goes first
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( flags & ( PS_M_ORIGIN0<<i ) ) )
+			continue;
+		q = SNAP_PredictCoord( (int)( state->pmove.origin[i]*PM_VECTOR_SNAP ), (int)( state->pmove.velocity[i]*PM_VECTOR_SNAP ), msec );
+		q += MSG_ReadPackedInt( msg );
+		state->pmove.origin[i] = ( (float)q*( 1.0/PM_VECTOR_SNAP ) );
+	}
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( flags & ( PS_M_VELOCITY0<<i ) ) )
+			continue;
+		q = (int)( state->pmove.velocity[i]*PM_VECTOR_SNAP ) + MSG_ReadPackedInt( msg );
+		state->pmove.velocity[i] = ( (float)q*( 1.0/PM_VECTOR_SNAP ) );
+	}
+
+	if( flags & PS_M_TIME )
+		state->pmove.pm_time = MSG_ReadPackedUint( msg );
+
+	if( flags & PS_M_FLAGS )
+		state->pmove.pm_flags = MSG_ReadPackedUint( msg );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( flags & ( PS_M_DELTA_ANGLES0<<i ) )
+			state->pmove.delta_angles[i] = (short)( state->pmove.delta_angles[i] + MSG_ReadPackedInt( msg ) );
+	}
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( flags & ( i ? PS_EVENT2 : PS_EVENT ) )
+		{
+			state->event[i] = MSG_ReadBits( msg, 8 );
+			if( state->event[i] & EV_INVERSE )
+				state->eventParm[i] = MSG_ReadBits( msg, 8 );
+			else
+				state->eventParm[i] = 0;
+
+			state->event[i] &= ~EV_INVERSE;
+		}
+		else
+		{
+			state->event[i] = state->eventParm[i] = 0;
+		}
+	}
+
+	if( flags & PS_VIEWANGLES )
+	{
+		for( i = 0; i < 3; i++ )
+		{
+			q = ANGLE2SHORT( state->viewangles[i] ) + MSG_ReadPackedInt( msg );
+			state->viewangles[i] = SHORT2ANGLE( (short)q );
+		}
+	}
+
+	if( flags & PS_M_GRAVITY )
+		state->pmove.gravity = MSG_ReadPackedInt( msg );
+
+	if( flags & PS_WEAPONSTATE )
+		state->weaponState = (uint8_t)MSG_ReadPackedUint( msg );
+
+	if( flags & PS_FOV )
+		state->fov = (uint8_t)MSG_ReadBits( msg, 8 );
+
+	if( flags & PS_POVNUM )
+		state->POVnum = MSG_ReadPackedUint( msg );
+	if( state->POVnum == 0 )
+		Com_Error( ERR_DROP, "SNAP_ParsePackedPlayerstate: Invalid POVnum %i", state->POVnum );
+
+	if( flags & PS_PLAYERNUM )
+		state->playerNum = MSG_ReadPackedUint( msg );
+	if( state->playerNum >= MAX_CLIENTS )
+		Com_Error( ERR_DROP, "SNAP_ParsePackedPlayerstate: Invalid playerNum %i", state->playerNum );
+
+	if( flags & PS_VIEWHEIGHT )
+		state->viewheight = MSG_ReadPackedInt( msg );
+
+	if( flags & PS_PMOVESTATS )
+	{
+		int pmstatbits = MSG_ReadBits( msg, PM_STAT_SIZE );
+		for( i = 0; i < PM_STAT_SIZE; i++ )
+		{
+			if( pmstatbits & ( 1<<i ) )
+				state->pmove.stats[i] = (short)( state->pmove.stats[i] + MSG_ReadPackedInt( msg ) );
+		}
+	}
+
+	if( flags & PS_INVENTORY )
+	{
+		int invstatbits[SNAP_INVENTORY_LONGS];
+
+		for( i = 0; i < SNAP_INVENTORY_LONGS; i++ )
+			invstatbits[i] = MSG_ReadBits( msg, 1 ) ? MSG_ReadBits( msg, 32 ) : 0;
+
+		for( i = 0; i < MAX_ITEMS; i++ )
+		{
+			if( invstatbits[i>>5] & ( 1<<(i&31) ) )
+				state->inventory[i] = (uint8_t)( state->inventory[i] + MSG_ReadPackedInt( msg ) );
+		}
+	}
+
+	if( flags & PS_PLRKEYS )
+		state->plrkeys = MSG_ReadBits( msg, 8 );
+
+	// parse stats
+	for( i = 0; i < SNAP_STATS_LONGS; i++ )
+	{
+		statbits[i] = MSG_ReadBits( msg, 1 ) ? MSG_ReadBits( msg, 32 ) : 0;
+		if( !statbits[i] )
+			continue;
+
+		for( j = i<<5; j < PS_MAX_STATS && j < ( i + 1 )<<5; j++ )
+		{
+			if( statbits[i] & ( 1<<(j&31) ) )
+				state->stats[j] = (short)( state->stats[j] + MSG_ReadPackedInt( msg ) );
+		}
+	}
+}
+
 /*
 * SNAP_ParseEntityBits
 */
-static int SNAP_ParseEntityBits( msg_t *msg, unsigned *bits )
+static int SNAP_ParseEntityBits( msg_t *msg, unsigned *bits, bool bitpacked )
 {
+	if( bitpacked )
+		return MSG_ReadPackedEntityBits( msg, bits );
 	return MSG_ReadEntityBits( msg, bits );
 }
 
@@ -286,13 +441,16 @@ static int SNAP_ParseEntityBits( msg_t *msg, unsigned *bits )
 * Parses deltas from the given base and adds the resulting entity
 * to the current frame
 */
-static void SNAP_DeltaEntity( msg_t *msg, snapshot_t *frame, int newnum, entity_state_t *old, unsigned bits )
+static void SNAP_DeltaEntity( msg_t *msg, snapshot_t *frame, int newnum, entity_state_t *old, unsigned bits, bool bitpacked )
 {
 	entity_state_t *state;
 
 	state = &frame->parsedEntities[frame->numEntities & ( MAX_PARSE_ENTITIES-1 )];
 	frame->numEntities++;
-	MSG_ReadDeltaEntity( msg, old, state, newnum, bits );
+	if( bitpacked )
+		MSG_ReadPackedDeltaEntity( msg, old, state, newnum, bits );
+	else
+		MSG_ReadDeltaEntity( msg, old, state, newnum, bits );
 }
 
 /*
@@ -318,7 +476,8 @@ void SNAP_ParseBaseline( msg_t *msg, entity_state_t *baselines )
 * An svc_packetentities has just been parsed, deal with the
 * rest of the data stream.
 */
-static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot_t *newframe, entity_state_t *baselines, int shownet )
+static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot_t *newframe, entity_state_t *baselines, int shownet, 
+	bool bitpacked )
 {
 	int newnum;
 	unsigned bits;
@@ -343,7 +502,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 
 	while( true )
 	{
-		newnum = SNAP_ParseEntityBits( msg, &bits );
+		newnum = SNAP_ParseEntityBits( msg, &bits, bitpacked );
 		if( newnum >= MAX_EDICTS )
 			Com_Error( ERR_DROP, "CL_ParsePacketEntities: bad number:%i", newnum );
 		if( msg->readcount > msg->cursize )
@@ -358,7 +517,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 			if( shownet == 3 )
 				Com_Printf( "   unchanged: %i\n", oldnum );
 
-			SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, 0 );
+			SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, 0, bitpacked );
 
 			oldindex++;
 			if( oldindex >= oldframe->numEntities )
@@ -385,7 +544,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 			if( shownet == 3 )
 				Com_Printf( "   baseline: %i\n", newnum );
 
-			SNAP_DeltaEntity( msg, newframe, newnum, &baselines[newnum], bits );
+			SNAP_DeltaEntity( msg, newframe, newnum, &baselines[newnum], bits, bitpacked );
 			continue;
 		}
 
@@ -417,7 +576,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 			if( shownet == 3 )
 				Com_Printf( "   delta: %i\n", newnum );
 
-			SNAP_DeltaEntity( msg, newframe, newnum, oldstate, bits );
+			SNAP_DeltaEntity( msg, newframe, newnum, oldstate, bits, bitpacked );
 
 			oldindex++;
 			if( oldindex >= oldframe->numEntities )
@@ -440,7 +599,7 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 		if( shownet == 3 )
 			Com_Printf( "   unchanged: %i\n", oldnum );
 
-		SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, 0 );
+		SNAP_DeltaEntity( msg, newframe, oldnum, oldstate, 0, bitpacked );
 
 		oldindex++;
 		if( oldindex >= oldframe->numEntities )
@@ -458,7 +617,8 @@ static void SNAP_ParsePacketEntities( msg_t *msg, snapshot_t *oldframe, snapshot
 /*
 * SNAP_ParseFrameHeader
 */
-static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int *suppressCount, snapshot_t *backup, bool skipBody )
+static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int *suppressCount, snapshot_t *backup, bool skipBody, 
+	bool *bitpacked )
 {
 	int len, pos;
 	int areabytes;
@@ -492,6 +652,8 @@ static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int
 	newframe->delta = ( flags & FRAMESNAP_FLAG_DELTA ) ? true : false;
 	newframe->multipov = ( flags & FRAMESNAP_FLAG_MULTIPOV ) ? true : false;
 	newframe->allentities = ( flags & FRAMESNAP_FLAG_ALLENTITIES ) ? true : false;
+	if( bitpacked )
+		*bitpacked = ( flags & FRAMESNAP_FLAG_BITPACKED ) ? true : false;
 
 	supCnt = MSG_ReadByte( msg );
 	if( suppressCount )
@@ -555,8 +717,8 @@ static snapshot_t *SNAP_ParseFrameHeader( msg_t *msg, snapshot_t *newframe, int
 */
 void SNAP_SkipFrame( msg_t *msg, snapshot_t *header )
 {
-	static snapshot_t frame;
-	SNAP_ParseFrameHeader( msg, header ? header : &frame, NULL, NULL, true );
+	static ATTRIBUTE_THREADLOCAL snapshot_t frame;
+	SNAP_ParseFrameHeader( msg, header ? header : &frame, NULL, NULL, true, NULL );
 }
 
 /*
@@ -570,11 +732,13 @@ snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCou
 	int numplayers;
 	char *text;
 	int framediff, numtargets;
+	int msec;
+	bool bitpacked;
 	gcommand_t *gcmd;
 	snapshot_t	*newframe;
 
 	// read header
-	newframe = SNAP_ParseFrameHeader( msg, NULL, suppressCount, backup, false );
+	newframe = SNAP_ParseFrameHeader( msg, NULL, suppressCount, backup, false, &bitpacked );
 	deltaframe = NULL;
 
 	if( showNet == 3 )
@@ -653,12 +817,20 @@ snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCou
 
 	// read playerinfos
 	numplayers = 0;
+	msec = deltaframe ? SNAP_PredictMsec( newframe->serverTime, deltaframe->serverTime ) : 0;
 	while( ( cmd = MSG_ReadByte( msg ) ) )
 	{
 		_SHOWNET( msg, svc_strings[cmd], showNet );
 		if( cmd != svc_playerinfo )
 			Com_Error( ERR_DROP, "SNAP_ParseFrame: not playerinfo" );
-		if( deltaframe && deltaframe->numplayers >= numplayers )
+		if( bitpacked )
+		{
+			if( deltaframe && deltaframe->numplayers > numplayers )
+				SNAP_ParsePackedPlayerstate( msg, &deltaframe->playerStates[numplayers], &newframe->playerStates[numplayers], msec );
+			else
+				SNAP_ParsePackedPlayerstate( msg, NULL, &newframe->playerStates[numplayers], msec );
+		}
+		else if( deltaframe && deltaframe->numplayers >= numplayers )
 			SNAP_ParsePlayerstate( msg, &deltaframe->playerStates[numplayers], &newframe->playerStates[numplayers] );
 		else
 			SNAP_ParsePlayerstate( msg, NULL, &newframe->playerStates[numplayers] );
@@ -672,7 +844,7 @@ snapshot_t *SNAP_ParseFrame( msg_t *msg, snapshot_t *lastFrame, int *suppressCou
 	_SHOWNET( msg, svc_strings[cmd], showNet );
 	if( cmd != svc_packetentities )
 		Com_Error( ERR_DROP, "SNAP_ParseFrame: not packetentities" );
-	SNAP_ParsePacketEntities( msg, deltaframe, newframe, baselines, showNet );
+	SNAP_ParsePacketEntities( msg, deltaframe, newframe, baselines, showNet, bitpacked );
 
 	return newframe;
 }
@@ -35,13 +35,349 @@ Encode a client frame onto the network channel
 *
 * Writes a delta update of an entity_state_t list to the message.
 */
-static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, client_snapshot_t *to, msg_t *msg, entity_state_t *baselines, entity_state_t *client_entities, int num_client_entities )
+/*
+=========================================================================
+
+Entity delta cache
+
+Most clients delta an entity from the same previous server frame or from
+its baseline, so the encoded bytes are shared between all the snapshots
+written during a frame. The cache is filled concurrently by the snapshot
+workers, entries are never modified once published and only become stale
+when the next frame begins.
+
+Snapshots tagged with a share key (see client_snapshot_t) have identical
+contents, so everything after the per-client frame header and game
+commands is cached whole, keyed by the shared snapshot and the one it
+was delta compressed from.
+
+=========================================================================
+*/
+
+#define SNAP_DELTACACHE_WAYS		4		// from-frames cached per entity
+#define SNAP_DELTACACHE_LOCKS		16
+#define SNAP_DELTACACHE_DATASIZE	( 512 * 1024 )
+#define SNAP_DELTACACHE_MAXDELTA	512
+
+#define SNAP_DELTACACHE_BASELINE	-1
+
+#define SNAP_DELTACACHE_FRAMES		64		// shared snapshot bodies per frame
+
+typedef struct
+{
+	unsigned int generation;		// valid while equal to the cache generation
+	int fromFrame;					// SNAP_DELTACACHE_BASELINE for baseline deltas
+	int flags;
+	int offset;						// into data
+	int length;
+} snap_deltaentry_t;
+
+typedef struct
+{
+	unsigned int sharekey;
+	unsigned int oldsharekey;		// 0 when not delta compressed
+	bool bitpacked;					// SNAP_ENCODING_BITPACKED
+	int offset;						// into data
+	int length;
+} snap_framebody_t;
+
+struct snap_deltacache_s
+{
+	unsigned int generation;
+	qmutex_t *locks[SNAP_DELTACACHE_LOCKS];		// striped by entity number
+	qmutex_t *statsMutex;
+	qmutex_t *framesMutex;
+
+	int volatileEntity;				// encoded differently for every client, never cached
+
+	volatile int dataUsed;
+	volatile int frameHits;
+	volatile int frameMisses;
+	volatile int frameBytesReused;
+	volatile int frameOverflows;
+	snap_deltacache_stats_t stats;
+
+	snap_deltaentry_t entries[MAX_EDICTS][SNAP_DELTACACHE_WAYS];
+	int numFrames;
+	snap_framebody_t frames[SNAP_DELTACACHE_FRAMES];
+	uint8_t data[SNAP_DELTACACHE_DATASIZE];
+};
+
+/*
+* SNAP_CreateDeltaCache
+*/
+snap_deltacache_t *SNAP_CreateDeltaCache( struct mempool_s *mempool )
+{
+	int i;
+	snap_deltacache_t *cache;
+
+	cache = Mem_Alloc( mempool, sizeof( *cache ) );
+	for( i = 0; i < SNAP_DELTACACHE_LOCKS; i++ )
+		cache->locks[i] = QMutex_Create();
+	cache->statsMutex = QMutex_Create();
+	cache->framesMutex = QMutex_Create();
+	cache->generation = 1;
+	cache->stats.start = Sys_Milliseconds();
+
+	return cache;
+}
+
+/*
+* SNAP_DestroyDeltaCache
+*/
+void SNAP_DestroyDeltaCache( snap_deltacache_t **pcache )
+{
+	int i;
+	snap_deltacache_t *cache = *pcache;
+
+	if( !cache )
+		return;
+
+	for( i = 0; i < SNAP_DELTACACHE_LOCKS; i++ )
+		QMutex_Destroy( &cache->locks[i] );
+	QMutex_Destroy( &cache->statsMutex );
+	QMutex_Destroy( &cache->framesMutex );
+	Mem_Free( cache );
+
+	*pcache = NULL;
+}
+
+/*
+* SNAP_BeginDeltaCacheFrame
+*
+* Invalidates all entries, must not be called while snapshots are being written.
+*/
+void SNAP_BeginDeltaCacheFrame( snap_deltacache_t *cache )
+{
+	if( !cache )
+		return;
+
+	if( cache->frameHits || cache->frameMisses )
+	{
+		cache->stats.frames++;
+		cache->stats.hits += cache->frameHits;
+		cache->stats.misses += cache->frameMisses;
+		cache->stats.bytesReused += cache->frameBytesReused;
+		cache->stats.overflows += cache->frameOverflows;
+		cache->stats.maxDataUsed = max( cache->stats.maxDataUsed, (unsigned)min( cache->dataUsed, SNAP_DELTACACHE_DATASIZE ) );
+	}
+
+	cache->dataUsed = 0;
+	cache->numFrames = 0;
+	cache->frameHits = cache->frameMisses = 0;
+	cache->frameBytesReused = cache->frameOverflows = 0;
+
+	if( !++cache->generation )
+	{
+		memset( cache->entries, 0, sizeof( cache->entries ) );
+		cache->generation = 1;
+	}
+}
+
+/*
+* SNAP_SetDeltaCacheVolatileEntity
+*
+* Excludes an entity whose state is patched for each client before its snapshot
+* is built (a relay's own player slot) from the cache. 0 for none.
+*/
+void SNAP_SetDeltaCacheVolatileEntity( snap_deltacache_t *cache, int entNum )
+{
+	if( cache )
+		cache->volatileEntity = entNum;
+}
+
+/*
+* SNAP_GetDeltaCacheStats
+*/
+void SNAP_GetDeltaCacheStats( snap_deltacache_t *cache, snap_deltacache_stats_t *stats )
+{
+	if( !cache )
+	{
+		memset( stats, 0, sizeof( *stats ) );
+		return;
+	}
+	*stats = cache->stats;
+}
+
+/*
+* SNAP_ResetDeltaCacheStats
+*/
+void SNAP_ResetDeltaCacheStats( snap_deltacache_t *cache )
+{
+	if( !cache )
+		return;
+	memset( &cache->stats, 0, sizeof( cache->stats ) );
+	cache->stats.start = Sys_Milliseconds();
+}
+
+/*
+* SNAP_WriteCachedDeltaEntity
+*
+* MSG_WriteDeltaEntity, reusing the bytes encoded for another client this frame if possible.
+* Returns the number of bytes taken from the cache.
+*/
+static int SNAP_WriteCachedDeltaEntity( snap_deltacache_t *cache, int fromFrame, entity_state_t *from, entity_state_t *to, 
+	msg_t *msg, bool force, bool updateOtherOrigin, bool bitpacked )
+{
+	int i, num, flags, start, length, offset;
+	qmutex_t *lock;
+	snap_deltaentry_t *entry, *free_entry;
+
+	num = to->number;
+	if( !cache || num <= 0 || num >= MAX_EDICTS || num == cache->volatileEntity )
+	{
+		if( bitpacked )
+			MSG_WritePackedDeltaEntity( from, to, msg, force, updateOtherOrigin );
+		else
+			MSG_WriteDeltaEntity( from, to, msg, force, updateOtherOrigin );
+		return -1;
+	}
+
+	flags = ( force ? 1 : 0 ) | ( updateOtherOrigin ? 2 : 0 ) | ( bitpacked ? 4 : 0 );
+	lock = cache->locks[num & ( SNAP_DELTACACHE_LOCKS - 1 )];
+
+	QMutex_Lock( lock );
+	for( i = 0, entry = cache->entries[num]; i < SNAP_DELTACACHE_WAYS; i++, entry++ )
+	{
+		if( entry->generation == cache->generation && entry->fromFrame == fromFrame && entry->flags == flags )
+			break;
+	}
+	QMutex_Unlock( lock );
+
+	if( i < SNAP_DELTACACHE_WAYS )
+	{
+		// the bytes are never overwritten during the frame, no need to hold the lock
+		MSG_WriteData( msg, cache->data + entry->offset, entry->length );
+		return entry->length;
+	}
+
+	start = msg->cursize;
+	if( bitpacked )
+		MSG_WritePackedDeltaEntity( from, to, msg, force, updateOtherOrigin );
+	else
+		MSG_WriteDeltaEntity( from, to, msg, force, updateOtherOrigin );
+	length = msg->cursize - start;
+	if( length > SNAP_DELTACACHE_MAXDELTA )
+		return -1;
+
+	offset = QAtomic_Add( &cache->dataUsed, length, cache->statsMutex ) - length;
+	if( offset + length > SNAP_DELTACACHE_DATASIZE )
+	{
+		QAtomic_Add( &cache->frameOverflows, 1, cache->statsMutex );
+		return -1;
+	}
+	memcpy( cache->data + offset, msg->data + start, length );
+
+	QMutex_Lock( lock );
+	free_entry = NULL;
+	for( i = 0, entry = cache->entries[num]; i < SNAP_DELTACACHE_WAYS; i++, entry++ )
+	{
+		if( entry->generation != cache->generation )
+		{
+			if( !free_entry )
+				free_entry = entry;
+		}
+		else if( entry->fromFrame == fromFrame && entry->flags == flags )
+		{
+			// another client got here first
+			free_entry = NULL;
+			break;
+		}
+	}
+	if( free_entry )
+	{
+		free_entry->fromFrame = fromFrame;
+		free_entry->flags = flags;
+		free_entry->offset = offset;
+		free_entry->length = length;
+		free_entry->generation = cache->generation;
+	}
+	QMutex_Unlock( lock );
+
+	return -1;
+}
+
+/*
+* SNAP_WriteCachedFrameBody
+*
+* Copies the snapshot body another client got for the same pair of shared snapshots.
+*/
+static bool SNAP_WriteCachedFrameBody( snap_deltacache_t *cache, client_snapshot_t *from, client_snapshot_t *to, msg_t *msg, bool bitpacked )
+{
+	int i;
+	unsigned int oldsharekey;
+	snap_framebody_t *body;
+
+	if( !cache || !to->sharekey || ( from && !from->sharekey ) )
+		return false;
+
+	oldsharekey = from ? from->sharekey : 0;
+
+	QMutex_Lock( cache->framesMutex );
+	for( i = 0, body = cache->frames; i < cache->numFrames; i++, body++ )
+	{
+		if( body->sharekey == to->sharekey && body->oldsharekey == oldsharekey && body->bitpacked == bitpacked )
+			break;
+	}
+	QMutex_Unlock( cache->framesMutex );
+
+	if( i == cache->numFrames )
+		return false;
+
+	MSG_WriteData( msg, cache->data + body->offset, body->length );
+	QAtomic_Add( &cache->frameBytesReused, body->length, cache->statsMutex );
+	return true;
+}
+
+/*
+* SNAP_CacheFrameBody
+*/
+static void SNAP_CacheFrameBody( snap_deltacache_t *cache, client_snapshot_t *from, client_snapshot_t *to, msg_t *msg, int start, bool bitpacked )
+{
+	int length, offset;
+	snap_framebody_t *body;
+
+	if( !cache || !to->sharekey || ( from && !from->sharekey ) )
+		return;
+	if( cache->numFrames >= SNAP_DELTACACHE_FRAMES )
+		return;
+
+	length = msg->cursize - start;
+	offset = QAtomic_Add( &cache->dataUsed, length, cache->statsMutex ) - length;
+	if( offset + length > SNAP_DELTACACHE_DATASIZE )
+	{
+		QAtomic_Add( &cache->frameOverflows, 1, cache->statsMutex );
+		return;
+	}
+	memcpy( cache->data + offset, msg->data + start, length );
+
+	QMutex_Lock( cache->framesMutex );
+	if( cache->numFrames < SNAP_DELTACACHE_FRAMES )
+	{
+		body = &cache->frames[cache->numFrames++];
+		body->sharekey = to->sharekey;
+		body->oldsharekey = from ? from->sharekey : 0;
+		body->bitpacked = bitpacked;
+		body->offset = offset;
+		body->length = length;
+	}
+	QMutex_Unlock( cache->framesMutex );
+}
+
+/*
+* SNAP_EmitPacketEntities
+*
+* Writes a delta update of an entity_state_t list to the message.
+*/
+static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, int fromFrame, client_snapshot_t *to, msg_t *msg, entity_state_t *baselines, 
+	entity_state_t *client_entities, int num_client_entities, snap_deltacache_t *deltacache, bool bitpacked )
 {
 	entity_state_t *oldent, *newent;
 	int oldindex, newindex;
 	int oldnum, newnum;
 	int from_num_entities;
-	int bits;
+	int bits, reused;
+	int hits = 0, misses = 0, bytesReused = 0;
 
 	MSG_WriteByte( msg, svc_packetentities );
 
@@ -83,7 +419,13 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 			// in any bytes being emited if the entity has not changed at all
 			// note that players are always 'newentities', this updates their oldorigin always
 			// and prevents warping ( wsw : jal : I removed it from the players )
-			MSG_WriteDeltaEntity( oldent, newent, msg, false, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false );
+			reused = SNAP_WriteCachedDeltaEntity( deltacache, fromFrame, oldent, newent, msg, false, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false, bitpacked );
+			if( reused >= 0 ) {
+				hits++;
+				bytesReused += reused;
+			} else {
+				misses++;
+			}
 			oldindex++;
 			newindex++;
 			continue;
@@ -92,7 +434,13 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 		if( newnum < oldnum )
 		{
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( &baselines[newnum], newent, msg, true, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false );
+			reused = SNAP_WriteCachedDeltaEntity( deltacache, SNAP_DELTACACHE_BASELINE, &baselines[newnum], newent, msg, true, ( ( EDICT_NUM( newent->number ) )->r.svflags & SVF_TRANSMITORIGIN2 ) ? true : false, bitpacked );
+			if( reused >= 0 ) {
+				hits++;
+				bytesReused += reused;
+			} else {
+				misses++;
+			}
 			newindex++;
 			continue;
 		}
@@ -100,6 +448,13 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 		if( newnum > oldnum )
 		{
 			// the old entity isn't present in the new message
+			if( bitpacked )
+			{
+				MSG_WritePackedEntityRemove( msg, oldnum );
+				oldindex++;
+				continue;
+			}
+
 			bits = U_REMOVE;
 			if( oldnum >= 256 )
 				bits |= ( U_NUMBER16 | U_MOREBITS1 );
@@ -119,6 +474,13 @@ static void SNAP_EmitPacketEntities( ginfo_t *gi, client_snapshot_t *from, clien
 	}
 
 	MSG_WriteShort( msg, 0 ); // end of packetentities
+
+	if( deltacache )
+	{
+		QAtomic_Add( &deltacache->frameHits, hits, deltacache->statsMutex );
+		QAtomic_Add( &deltacache->frameMisses, misses, deltacache->statsMutex );
+		QAtomic_Add( &deltacache->frameBytesReused, bytesReused, deltacache->statsMutex );
+	}
 }
 
 /*
@@ -184,24 +546,15 @@ static void SNAP_WriteDeltaGameStateToClient( client_snapshot_t *from, client_sn
 }
 
 /*
-* SNAP_WritePlayerstateToClient
+* SNAP_PlayerstateBits
+*
+* The PS_* bits of the fields that differ between the two states
 */
-static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *ps, msg_t *msg )
+static int SNAP_PlayerstateBits( player_state_t *ops, player_state_t *ps )
 {
 	int i;
 	int pflags;
-	player_state_t dummy;
-	int statbits[SNAP_STATS_LONGS];
-
-	if( !ops )
-	{
-		memset( &dummy, 0, sizeof( dummy ) );
-		ops = &dummy;
-	}
 
-	//
-	// determine what needs to be sent
-	//
 	pflags = 0;
 
 	if( ps->pmove.pm_type != ops->pmove.pm_type )
@@ -284,6 +637,30 @@ static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *
 	if( ps->plrkeys != ops->plrkeys )
 		pflags |= PS_PLRKEYS;
 
+	return pflags;
+}
+
+/*
+* SNAP_WritePlayerstateToClient
+*/
+static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *ps, msg_t *msg )
+{
+	int i;
+	int pflags;
+	player_state_t dummy;
+	int statbits[SNAP_STATS_LONGS];
+
+	if( !ops )
+	{
+		memset( &dummy, 0, sizeof( dummy ) );
+		ops = &dummy;
+	}
+
+	//
+	// determine what needs to be sent
+	//
+	pflags = SNAP_PlayerstateBits( ops, ps );
+
 	//
 	// write it
 	//
@@ -459,6 +836,180 @@ static void SNAP_WritePlayerstateToClient( player_state_t *ops, player_state_t *
 	}
 }
 
+/*
+* SNAP_WritePackedPlayerstateToClient
+*
+* SNAP_WritePlayerstateToClient for bit packed snapshots. Numeric fields are sent as residuals
+* against the old state, the origin against where the old velocity would have carried it.
+*/
+static void SNAP_WritePackedPlayerstateToClient( player_state_t *ops, player_state_t *ps, msg_t *msg, int msec )
+{
+	int i, j;
+	int pflags, q, oldq;
+	player_state_t dummy;
+	int statbits[SNAP_STATS_LONGS];
+
+	if( !ops )
+	{
+		memset( &dummy, 0, sizeof( dummy ) );
+		ops = &dummy;
+		msec = 0;
+	}
+
+	pflags = SNAP_PlayerstateBits( ops, ps );
+
+	MSG_WriteByte( msg, svc_playerinfo );
+
+	MSG_WriteFlagBits( msg, pflags, PS_PACKED_COMMON );
+	MSG_WriteBits( msg, ( pflags & PS_PACKED_RARE ) ? 1 : 0, 1 );
+	if( pflags & PS_PACKED_RARE )
+		MSG_WriteFlagBits( msg, pflags, PS_PACKED_RARE );
+
+	if( pflags & PS_M_TYPE )
+		MSG_WritePackedUint( msg, ps->pmove.pm_type );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( pflags & ( PS_M_ORIGIN0<<i ) ) )
+			continue;
+		q = (int)( ps->pmove.origin[i]*PM_VECTOR_SNAP );
+		oldq = SNAP_PredictCoord( (int)( ops->pmove.origin[i]*PM_VECTOR_SNAP ), (int)( ops->pmove.velocity[i]*PM_VECTOR_SNAP ), msec );
+		MSG_WritePackedInt( msg, q - oldq );
+	}
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( !( pflags & ( PS_M_VELOCITY0<<i ) ) )
+			continue;
+		q = (int)( ps->pmove.velocity[i]*PM_VECTOR_SNAP );
+		oldq = (int)( ops->pmove.velocity[i]*PM_VECTOR_SNAP );
+		MSG_WritePackedInt( msg, q - oldq );
+	}
+
+	if( pflags & PS_M_TIME )
+		MSG_WritePackedUint( msg, ps->pmove.pm_time );
+
+	if( pflags & PS_M_FLAGS )
+		MSG_WritePackedUint( msg, ps->pmove.pm_flags );
+
+	for( i = 0; i < 3; i++ )
+	{
+		if( pflags & ( PS_M_DELTA_ANGLES0<<i ) )
+			MSG_WritePackedInt( msg, (short)( ps->pmove.delta_angles[i] - ops->pmove.delta_angles[i] ) );
+	}
+
+	for( i = 0; i < 2; i++ )
+	{
+		if( !( pflags & ( i ? PS_EVENT2 : PS_EVENT ) ) )
+			continue;
+
+		if( !ps->eventParm[i] )
+		{
+			MSG_WriteBits( msg, (uint8_t)( ps->event[i] & ~EV_INVERSE ), 8 );
+		}
+		else
+		{
+			MSG_WriteBits( msg, (uint8_t)( ps->event[i] | EV_INVERSE ), 8 );
+			MSG_WriteBits( msg, (uint8_t)ps->eventParm[i], 8 );
+		}
+	}
+
+	if( pflags & PS_VIEWANGLES )
+	{
+		for( i = 0; i < 3; i++ )
+			MSG_WritePackedInt( msg, (short)( ANGLE2SHORT( ps->viewangles[i] ) - ANGLE2SHORT( ops->viewangles[i] ) ) );
+	}
+
+	if( pflags & PS_M_GRAVITY )
+		MSG_WritePackedInt( msg, ps->pmove.gravity );
+
+	if( pflags & PS_WEAPONSTATE )
+		MSG_WritePackedUint( msg, ps->weaponState );
+
+	if( pflags & PS_FOV )
+		MSG_WriteBits( msg, (uint8_t)ps->fov, 8 );
+
+	if( pflags & PS_POVNUM )
+		MSG_WritePackedUint( msg, ps->POVnum );
+
+	if( pflags & PS_PLAYERNUM )
+		MSG_WritePackedUint( msg, ps->playerNum );
+
+	if( pflags & PS_VIEWHEIGHT )
+		MSG_WritePackedInt( msg, (char)ps->viewheight );
+
+	if( pflags & PS_PMOVESTATS )
+	{
+		int pmstatbits;
+
+		pmstatbits = 0;
+		for( i = 0; i < PM_STAT_SIZE; i++ )
+		{
+			if( ps->pmove.stats[i] != ops->pmove.stats[i] )
+				pmstatbits |= ( 1<<i );
+		}
+
+		MSG_WriteBits( msg, pmstatbits, PM_STAT_SIZE );
+
+		for( i = 0; i < PM_STAT_SIZE; i++ )
+		{
+			if( pmstatbits & ( 1<<i ) )
+				MSG_WritePackedInt( msg, (short)( ps->pmove.stats[i] - ops->pmove.stats[i] ) );
+		}
+	}
+
+	if( pflags & PS_INVENTORY )
+	{
+		int invstatbits[SNAP_INVENTORY_LONGS];
+
+		memset( invstatbits, 0, sizeof( invstatbits ) );
+		for( i = 0; i < MAX_ITEMS; i++ )
+		{
+			if( ps->inventory[i] != ops->inventory[i] )
+				invstatbits[i>>5] |= ( 1<<(i&31) );
+		}
+
+		// most of the time a single item changes, don't send empty masks
+		for( i = 0; i < SNAP_INVENTORY_LONGS; i++ )
+		{
+			MSG_WriteBits( msg, invstatbits[i] ? 1 : 0, 1 );
+			if( invstatbits[i] )
+				MSG_WriteBits( msg, invstatbits[i], 32 );
+		}
+
+		for( i = 0; i < MAX_ITEMS; i++ )
+		{
+			if( invstatbits[i>>5] & ( 1<<(i&31) ) )
+				MSG_WritePackedInt( msg, (uint8_t)ps->inventory[i] - (uint8_t)ops->inventory[i] );
+		}
+	}
+
+	if( pflags & PS_PLRKEYS )
+		MSG_WriteBits( msg, ps->plrkeys, 8 );
+
+	// send stats
+	memset( statbits, 0, sizeof( statbits ) );
+	for( i = 0; i < PS_MAX_STATS; i++ )
+	{
+		if( ps->stats[i] != ops->stats[i] )
+			statbits[i>>5] |= 1<<(i&31);
+	}
+
+	for( i = 0; i < SNAP_STATS_LONGS; i++ )
+	{
+		MSG_WriteBits( msg, statbits[i] ? 1 : 0, 1 );
+		if( !statbits[i] )
+			continue;
+
+		MSG_WriteBits( msg, statbits[i], 32 );
+		for( j = i<<5; j < PS_MAX_STATS && j < ( i + 1 )<<5; j++ )
+		{
+			if( statbits[i] & ( 1<<(j&31) ) )
+				MSG_WritePackedInt( msg, (short)( ps->stats[j] - ops->stats[j] ) );
+		}
+	}
+}
+
 /*
 * SNAP_WriteMultiPOVCommands
 */
@@ -618,15 +1169,30 @@ static void SNAP_RelayMultiPOVCommands( ginfo_t *gi, client_t *client, msg_t *ms
 	}
 }
 
+/*
+* SNAP_NegotiateEncoding
+*
+* Picks the snapshot encoding for a client that announced it can decode up to peerEncoding
+*/
+int SNAP_NegotiateEncoding( int peerEncoding, int preferred )
+{
+	if( preferred <= SNAP_ENCODING_LEGACY || preferred >= SNAP_ENCODING_TOTAL )
+		return SNAP_ENCODING_LEGACY;
+	if( peerEncoding <= SNAP_ENCODING_LEGACY )
+		return SNAP_ENCODING_LEGACY;
+	return min( peerEncoding, preferred );
+}
+
 /*
 * SNAP_WriteFrameSnapToClient
 */
 void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, unsigned int frameNum, unsigned int gameTime,
-								 entity_state_t *baselines, client_entities_t *client_entities,
+								 entity_state_t *baselines, client_entities_t *client_entities, snap_deltacache_t *deltacache,
 								 int numcmds, gcommand_t *commands, const char *commandsData )
 {
 	client_snapshot_t *frame, *oldframe;
-	int flags, i, index, pos, length, supcnt;
+	int flags, i, index, pos, length, supcnt, start, msec;
+	bool bitpacked;
 
 	// this is the frame we are creating
 	frame = &client->snapShots[frameNum & UPDATE_MASK];
@@ -662,6 +1228,9 @@ void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, uns
 	if( client->nodelta && client->reliable )
 		client->nodelta = false;
 
+	bitpacked = ( client->snapEncoding == SNAP_ENCODING_BITPACKED );
+	frame->serverTime = gameTime;
+
 	MSG_WriteByte( msg, svc_frame );
 
 	pos = msg->cursize;
@@ -679,6 +1248,8 @@ void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, uns
 		flags |= FRAMESNAP_FLAG_ALLENTITIES;
 	if( frame->multipov )
 		flags |= FRAMESNAP_FLAG_MULTIPOV;
+	if( bitpacked )
+		flags |= FRAMESNAP_FLAG_BITPACKED;
 	MSG_WriteByte( msg, flags );
 
 	supcnt = client->suppressCount;
@@ -721,24 +1292,36 @@ void SNAP_WriteFrameSnapToClient( ginfo_t *gi, client_t *client, msg_t *msg, uns
 	}
 	MSG_WriteShort( msg, -1 );
 
-	// send over the areabits
-	MSG_WriteByte( msg, frame->areabytes );
-	MSG_WriteData( msg, frame->areabits, frame->areabytes );
+	// the rest only depends on the contents of the two snapshots
+	if( !SNAP_WriteCachedFrameBody( deltacache, oldframe, frame, msg, bitpacked ) )
+	{
+		start = msg->cursize;
 
-	SNAP_WriteDeltaGameStateToClient( oldframe, frame, msg );
+		// send over the areabits
+		MSG_WriteByte( msg, frame->areabytes );
+		MSG_WriteData( msg, frame->areabits, frame->areabytes );
 
-	// delta encode the playerstate
-	for( i = 0; i < frame->numplayers; i++ )
-	{
-		if( oldframe && oldframe->numplayers > i )
-			SNAP_WritePlayerstateToClient( &oldframe->ps[i], &frame->ps[i], msg );
-		else
-			SNAP_WritePlayerstateToClient( NULL, &frame->ps[i], msg );
-	}
-	MSG_WriteByte( msg, 0 );
+		SNAP_WriteDeltaGameStateToClient( oldframe, frame, msg );
 
-	// delta encode the entities
-	SNAP_EmitPacketEntities( gi, oldframe, frame, msg, baselines, client_entities ? client_entities->entities : NULL, client_entities ? client_entities->num_entities : 0 );
+		// delta encode the playerstate
+		msec = oldframe ? SNAP_PredictMsec( gameTime, oldframe->serverTime ) : 0;
+		for( i = 0; i < frame->numplayers; i++ )
+		{
+			player_state_t *ops = ( oldframe && oldframe->numplayers > i ) ? &oldframe->ps[i] : NULL;
+
+			if( bitpacked )
+				SNAP_WritePackedPlayerstateToClient( ops, &frame->ps[i], msg, msec );
+			else
+				SNAP_WritePlayerstateToClient( ops, &frame->ps[i], msg );
+		}
+		MSG_WriteByte( msg, 0 );
+
+		// delta encode the entities
+		SNAP_EmitPacketEntities( gi, oldframe, client->lastframe, frame, msg, baselines, client_entities ? client_entities->entities : NULL, 
+			client_entities ? client_entities->num_entities : 0, deltacache, bitpacked );
+
+		SNAP_CacheFrameBody( deltacache, oldframe, frame, msg, start, bitpacked );
+	}
 
 	// write length into reserved space
 	length = msg->cursize - pos - 2;
@@ -797,6 +1380,234 @@ static bool SNAP_BitsCullEntity( cmodel_state_t *cms, edict_t *ent, uint8_t *bit
 
 #define SNAP_PVSCullEntity(cms,fatpvs,ent) SNAP_BitsCullEntity(cms,ent,fatpvs,ent->r.num_clusters)
 
+/*
+=========================================================================
+
+Visibility cache
+
+Clients standing close to each other merge the same clusters into their
+fat PVS, so they end up with the same visibility sets and the same results
+of the areaportal and PVS tests for every entity. Those are computed once
+per frame for each distinct set of clusters and client area, the team,
+owner and sound filters still run for each client. Maps with portal
+entities aren't cached, as merging the portal views depends on the client.
+
+=========================================================================
+*/
+
+#define SNAP_VISCACHE_ENTRIES		64
+#define SNAP_VISCACHE_CLUSTERS		8		// more clusters than this in the fat PVS box aren't cached
+
+typedef struct
+{
+	int numClusters;
+	int clusters[SNAP_VISCACHE_CLUSTERS];
+	int clientarea;
+	bool ready;						// set once the sets below have been filled in
+
+	uint8_t *fatpvs;				// with the sky merged in
+	uint8_t *arearow;				// areabits of clientarea with the sky merged in, unused if clientarea < 0
+	uint8_t areavis[MAX_EDICTS/8];	// entities passing the areaportal test
+	uint8_t pvsvis[MAX_EDICTS/8];	// entities passing the PVS test
+} snap_visentry_t;
+
+struct snap_viscache_s
+{
+	mempool_t *mempool;
+	qmutex_t *mutex;
+
+	bool enabled;					// false when the frame can't be cached
+	int pvsSize, areaRowSize;
+	int areabytes;
+	uint8_t *areabits;				// areaportals matrix of the frame
+
+	int numEntries;
+	snap_visentry_t entries[SNAP_VISCACHE_ENTRIES];
+};
+
+/*
+* SNAP_CreateVisCache
+*/
+snap_viscache_t *SNAP_CreateVisCache( struct mempool_s *mempool )
+{
+	snap_viscache_t *cache;
+
+	cache = Mem_Alloc( mempool, sizeof( *cache ) );
+	cache->mempool = mempool;
+	cache->mutex = QMutex_Create();
+
+	return cache;
+}
+
+/*
+* SNAP_FreeVisCacheBuffers
+*/
+static void SNAP_FreeVisCacheBuffers( snap_viscache_t *cache )
+{
+	int i;
+
+	for( i = 0; i < SNAP_VISCACHE_ENTRIES; i++ )
+	{
+		if( cache->entries[i].fatpvs )
+			Mem_Free( cache->entries[i].fatpvs );
+		if( cache->entries[i].arearow )
+			Mem_Free( cache->entries[i].arearow );
+		cache->entries[i].fatpvs = cache->entries[i].arearow = NULL;
+	}
+
+	if( cache->areabits )
+		Mem_Free( cache->areabits );
+	cache->areabits = NULL;
+	cache->pvsSize = cache->areaRowSize = 0;
+}
+
+/*
+* SNAP_DestroyVisCache
+*/
+void SNAP_DestroyVisCache( snap_viscache_t **pcache )
+{
+	snap_viscache_t *cache = *pcache;
+
+	if( !cache )
+		return;
+
+	SNAP_FreeVisCacheBuffers( cache );
+	QMutex_Destroy( &cache->mutex );
+	Mem_Free( cache );
+
+	*pcache = NULL;
+}
+
+/*
+* SNAP_BeginVisCacheFrame
+*
+* Drops all entries, must not be called while snapshots are being built.
+*/
+void SNAP_BeginVisCacheFrame( snap_viscache_t *cache, cmodel_state_t *cms, ginfo_t *gi )
+{
+	int i, entNum;
+	int pvsSize, areaRowSize;
+
+	if( !cache )
+		return;
+
+	cache->numEntries = 0;
+	cache->enabled = false;
+
+	for( entNum = 1; entNum < gi->num_edicts; entNum++ )
+	{
+		if( EDICT_NUM( entNum )->r.svflags & SVF_PORTAL )
+			return;
+	}
+
+	pvsSize = CM_ClusterRowSize( cms );
+	areaRowSize = CM_AreaRowSize( cms );
+	if( !pvsSize || !areaRowSize )
+		return;
+
+	if( cache->pvsSize != pvsSize || cache->areaRowSize != areaRowSize || !cache->areabits )
+	{
+		SNAP_FreeVisCacheBuffers( cache );
+
+		for( i = 0; i < SNAP_VISCACHE_ENTRIES; i++ )
+		{
+			cache->entries[i].fatpvs = Mem_Alloc( cache->mempool, pvsSize );
+			cache->entries[i].arearow = Mem_Alloc( cache->mempool, areaRowSize );
+		}
+		cache->areabits = Mem_Alloc( cache->mempool, areaRowSize * max( CM_NumAreas( cms ), 1 ) );
+		cache->pvsSize = pvsSize;
+		cache->areaRowSize = areaRowSize;
+	}
+
+	cache->areabytes = CM_WriteAreaBits( cms, cache->areabits );
+	cache->enabled = true;
+}
+
+/*
+* SNAP_FindVisCacheEntry
+*
+* Returns the entry for the clusters and area if it's ready for use. Otherwise
+* may reserve a new entry for the caller to fill in and publish, *fill is set then.
+*/
+static snap_visentry_t *SNAP_FindVisCacheEntry( snap_viscache_t *cache, int numClusters, int *clusters, int clientarea, bool *fill )
+{
+	int i;
+	snap_visentry_t *entry;
+
+	*fill = false;
+
+	QMutex_Lock( cache->mutex );
+
+	for( i = 0, entry = cache->entries; i < cache->numEntries; i++, entry++ )
+	{
+		if( entry->clientarea != clientarea || entry->numClusters != numClusters )
+			continue;
+		if( memcmp( entry->clusters, clusters, sizeof( *clusters ) * numClusters ) )
+			continue;
+
+		// another thread may still be filling it in, don't wait for it
+		if( !entry->ready )
+			entry = NULL;
+
+		QMutex_Unlock( cache->mutex );
+		return entry;
+	}
+
+	if( cache->numEntries == SNAP_VISCACHE_ENTRIES )
+	{
+		QMutex_Unlock( cache->mutex );
+		return NULL;
+	}
+
+	entry = &cache->entries[cache->numEntries++];
+	entry->numClusters = numClusters;
+	memcpy( entry->clusters, clusters, sizeof( *clusters ) * numClusters );
+	entry->clientarea = clientarea;
+	entry->ready = false;
+
+	QMutex_Unlock( cache->mutex );
+
+	*fill = true;
+	return entry;
+}
+
+/*
+* SNAP_FillVisCacheEntry
+*
+* Runs the areaportal and PVS tests of SNAP_SnapCullEntity for all entities
+*/
+static void SNAP_FillVisCacheEntry( snap_viscache_t *cache, snap_visentry_t *entry, cmodel_state_t *cms, ginfo_t *gi,
+								   uint8_t *fatpvs, uint8_t *arearow )
+{
+	int entNum;
+	edict_t *ent;
+
+	memcpy( entry->fatpvs, fatpvs, cache->pvsSize );
+	if( arearow )
+		memcpy( entry->arearow, arearow, cache->areaRowSize );
+	memset( entry->areavis, 0, sizeof( entry->areavis ) );
+	memset( entry->pvsvis, 0, sizeof( entry->pvsvis ) );
+
+	for( entNum = 1; entNum < gi->num_edicts; entNum++ )
+	{
+		ent = EDICT_NUM( entNum );
+
+		if( ent->r.areanum >= 0 )
+		{
+			if( !arearow || ( arearow[ent->r.areanum>>3] & ( 1<<( ent->r.areanum&7 ) ) ) ||
+				( ent->r.areanum2 >= 0 && ( arearow[ent->r.areanum2>>3] & ( 1<<( ent->r.areanum2&7 ) ) ) ) )
+				entry->areavis[entNum>>3] |= 1<<( entNum&7 );
+		}
+
+		if( !SNAP_PVSCullEntity( cms, fatpvs, ent ) )
+			entry->pvsvis[entNum>>3] |= 1<<( entNum&7 );
+	}
+
+	QMutex_Lock( cache->mutex );
+	entry->ready = true;
+	QMutex_Unlock( cache->mutex );
+}
+
 //=====================================================================
 
 #define	MAX_SNAPSHOT_ENTITIES	1024
@@ -804,7 +1615,7 @@ typedef struct
 {
 	int numSnapshotEntities;
 	int snapshotEntities[MAX_SNAPSHOT_ENTITIES];
-	int entityAddedToSnapList[MAX_EDICTS];
+	uint8_t entityAddedToSnapList[MAX_EDICTS/8];
 } snapshotEntityNumbers_t;
 
 /*
@@ -816,11 +1627,11 @@ static void SNAP_AddEntNumToSnapList( int entNum, snapshotEntityNumbers_t *entsL
 		return;
 
 	// don't double add entities
-	if( entsList->entityAddedToSnapList[entNum] )
+	if( entsList->entityAddedToSnapList[entNum>>3] & ( 1<<( entNum&7 ) ) )
 		return;
 
 	entsList->snapshotEntities[entsList->numSnapshotEntities++] = entNum;
-	entsList->entityAddedToSnapList[entNum] = true;
+	entsList->entityAddedToSnapList[entNum>>3] |= 1<<( entNum&7 );
 }
 
 /*
@@ -828,14 +1639,22 @@ static void SNAP_AddEntNumToSnapList( int entNum, snapshotEntityNumbers_t *entsL
 */
 static void SNAP_SortSnapList( snapshotEntityNumbers_t *entsList )
 {
-	int i;
+	int i, j;
+	uint8_t bits;
 
 	// avoid adding world to the list by all costs
 	entsList->numSnapshotEntities = 0;
-	for( i = 1; i < MAX_EDICTS; i++ )
+	for( i = 0; i < MAX_EDICTS/8; i++ )
 	{
-		if( entsList->entityAddedToSnapList[i] == true )
-			entsList->snapshotEntities[entsList->numSnapshotEntities++] = i;
+		bits = entsList->entityAddedToSnapList[i];
+		if( !i )
+			bits &= ~1;
+
+		for( j = 0; bits; j++, bits >>= 1 )
+		{
+			if( bits & 1 )
+				entsList->snapshotEntities[entsList->numSnapshotEntities++] = ( i<<3 ) + j;
+		}
 	}
 }
 
@@ -895,8 +1714,11 @@ static bool SNAP_SnapCullSoundEntity( cmodel_state_t *cms, edict_t *ent, vec3_t
 /*
 * SNAP_SnapCullEntity
 */
-static bool SNAP_SnapCullEntity( cmodel_state_t *cms, edict_t *ent, edict_t *clent, client_snapshot_t *frame, vec3_t vieworg, uint8_t *fatpvs )
+static bool SNAP_SnapCullEntity( cmodel_state_t *cms, edict_t *ent, edict_t *clent, client_snapshot_t *frame, vec3_t vieworg, uint8_t *fatpvs,
+								snap_visentry_t *visentry )
 {
+	int entNum;
+
 	uint8_t *areabits;
 	bool snd_cull_only;
 	bool snd_culled;
@@ -923,7 +1745,13 @@ static bool SNAP_SnapCullEntity( cmodel_state_t *cms, edict_t *ent, edict_t *cle
 
 	if( ent->r.areanum < 0 )
 		return true;
-	if( frame->clientarea >= 0 )
+	if( visentry )
+	{
+		entNum = ent->s.number;
+		if( !( visentry->areavis[entNum>>3] & ( 1<<( entNum&7 ) ) ) )
+			return true; // blocked by a door
+	}
+	else if( frame->clientarea >= 0 )
 	{
 		// this is the same as CM_AreasConnected but portal's visibility included
 		areabits = frame->areabits + frame->clientarea * CM_AreaRowSize( cms );
@@ -953,17 +1781,31 @@ static bool SNAP_SnapCullEntity( cmodel_state_t *cms, edict_t *ent, edict_t *cle
 	// pure sound emitters don't use PVS culling at all
 	if( snd_cull_only && snd_culled )
 		return true;
-	return snd_culled && SNAP_PVSCullEntity( cms, fatpvs, ent );	// cull by PVS
+	if( !snd_culled )
+		return false;
+
+	// cull by PVS
+	if( visentry )
+	{
+		entNum = ent->s.number;
+		return ( visentry->pvsvis[entNum>>3] & ( 1<<( entNum&7 ) ) ) ? false : true;
+	}
+	return SNAP_PVSCullEntity( cms, fatpvs, ent );
 }
 
 /*
 * SNAP_BuildSnapEntitiesList
 */
-static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_t *clent, vec3_t vieworg, vec3_t skyorg, uint8_t *fatpvs, client_snapshot_t *frame, snapshotEntityNumbers_t *entsList )
+static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_t *clent, vec3_t vieworg, vec3_t skyorg, uint8_t *fatpvs,
+									   snap_viscache_t *viscache, client_snapshot_t *frame, snapshotEntityNumbers_t *entsList )
 {
 	int leafnum = -1, clusternum = -1, clientarea = -1;
 	int entNum;
 	edict_t	*ent;
+	int numClusters;
+	int clusters[SNAP_VISCACHE_CLUSTERS];
+	snap_visentry_t *visentry = NULL;
+	bool fillVisEntry = false;
 
 	// find the client's PVS
 	if( frame->allentities )
@@ -978,9 +1820,32 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 	}
 
 	frame->clientarea = clientarea;
-	frame->areabytes = CM_WriteAreaBits( cms, frame->areabits );
 
-	if( clent )
+	if( viscache && viscache->enabled && !frame->allentities )
+	{
+		memcpy( frame->areabits, viscache->areabits, viscache->areabytes );
+		frame->areabytes = viscache->areabytes;
+
+		if( clent && clusternum != -1 )
+		{
+			numClusters = CM_PVSClusters( cms, vieworg, clusters, SNAP_VISCACHE_CLUSTERS );
+			if( numClusters > 0 )
+				visentry = SNAP_FindVisCacheEntry( viscache, numClusters, clusters, clientarea, &fillVisEntry );
+		}
+	}
+	else
+	{
+		frame->areabytes = CM_WriteAreaBits( cms, frame->areabits );
+	}
+
+	if( visentry && !fillVisEntry )
+	{
+		// another client has seen the same clusters this frame
+		memcpy( fatpvs, visentry->fatpvs, viscache->pvsSize );
+		if( clientarea >= 0 )
+			memcpy( frame->areabits + clientarea * CM_AreaRowSize( cms ), visentry->arearow, viscache->areaRowSize );
+	}
+	else if( clent )
 	{
 		SNAP_FatPVS( cms, vieworg, fatpvs );
 
@@ -988,11 +1853,6 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 		if( !frame->allentities && clusternum == -1 )
 		{
 			entNum = NUM_FOR_EDICT( clent );
-			if( clent->s.number != entNum )
-			{
-				Com_Printf( "FIXING CLENT->S.NUMBER: %i %i!!!\n", clent->s.number, entNum );
-				clent->s.number = entNum;
-			}
 
 			// FIXME we should send all the entities who's POV we are sending if frame->multipov
 			SNAP_AddEntNumToSnapList( entNum, entsList );
@@ -1000,8 +1860,8 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 		}
 	}
 
-	// no need of merging when we are sending the whole level
-	if( !frame->allentities && clientarea >= 0 )
+	// no need of merging when we are sending the whole level, or the cached sets are merged already
+	if( !frame->allentities && clientarea >= 0 && ( !visentry || fillVisEntry ) )
 	{
 		// make a pass checking for sky portal and portal entities and merge PVS in case of finding any
 		if( skyorg )
@@ -1013,7 +1873,7 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 			if( ent->r.svflags & SVF_PORTAL )
 			{
 				// merge visibility sets if portal
-				if( SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs ) )
+				if( SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs, NULL ) )
 					continue;
 
 				if( !VectorCompare( ent->s.origin, ent->s.origin2 ) )
@@ -1022,7 +1882,43 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 		}
 	}
 
+	if( fillVisEntry )
+	{
+		SNAP_FillVisCacheEntry( viscache, visentry, cms, gi, fatpvs,
+			clientarea >= 0 ? frame->areabits + clientarea * CM_AreaRowSize( cms ) : NULL );
+	}
+
 	// add the entities to the list
+	for( entNum = 1; entNum < gi->num_edicts; entNum++ )
+	{
+		ent = EDICT_NUM( entNum );
+
+		// always add the client entity, even if SVF_NOCLIENT
+		if( ( ent != clent ) && SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs, visentry ) )
+			continue;
+
+		// add it
+		SNAP_AddEntNumToSnapList( entNum, entsList );
+
+		// broken owner numbers were cleared by SNAP_FixEntityNumbers
+		if( ( ent->r.svflags & SVF_FORCEOWNER ) && ent->s.ownerNum > 0 )
+			SNAP_AddEntNumToSnapList( ent->s.ownerNum, entsList );
+	}
+
+	SNAP_SortSnapList( entsList );
+}
+
+/*
+* SNAP_FixEntityNumbers
+*
+* Repairs broken entity and owner numbers. Must be called before the
+* snapshots of a frame are built, the builders only read the edicts.
+*/
+void SNAP_FixEntityNumbers( ginfo_t *gi )
+{
+	int entNum;
+	edict_t *ent;
+
 	for( entNum = 1; entNum < gi->num_edicts; entNum++ )
 	{
 		ent = EDICT_NUM( entNum );
@@ -1034,29 +1930,13 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 			ent->s.number = entNum;
 		}
 
-		// always add the client entity, even if SVF_NOCLIENT
-		if( ( ent != clent ) && SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs ) )
-			continue;
-
-		// add it
-		SNAP_AddEntNumToSnapList( entNum, entsList );
-
-		if( ent->r.svflags & SVF_FORCEOWNER )
+		// make sure owner number is valid too
+		if( ( ent->r.svflags & SVF_FORCEOWNER ) && ( ent->s.ownerNum < 0 || ent->s.ownerNum >= gi->num_edicts ) )
 		{
-			// make sure owner number is valid too
-			if( ent->s.ownerNum > 0 && ent->s.ownerNum < gi->num_edicts )
-			{
-				SNAP_AddEntNumToSnapList( ent->s.ownerNum, entsList );
-			}
-			else
-			{
-				Com_Printf( "FIXING ENT->S.OWNERNUM: %i %i!!!\n", ent->s.type, ent->s.ownerNum );
-				ent->s.ownerNum = 0;
-			}
+			Com_Printf( "FIXING ENT->S.OWNERNUM: %i %i!!!\n", ent->s.type, ent->s.ownerNum );
+			ent->s.ownerNum = 0;
 		}
 	}
-
-	SNAP_SortSnapList( entsList );
 }
 
 /*
@@ -1066,7 +1946,7 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi, edict_
 * copies off the playerstat and areabits.
 */
 void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int frameNum, unsigned int timeStamp,
-							   fatvis_t *fatvis, client_t *client,
+							   fatvis_t *fatvis, snap_viscache_t *viscache, client_t *client,
 							   game_state_t *gameState, client_entities_t *client_entities,
 							   bool relay, mempool_t *mempool )
 {
@@ -1100,6 +1980,7 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 	frame->sentTimeStamp = timeStamp;
 	frame->UcmdExecuted = client->UcmdExecuted;
 	frame->relay = relay;
+	frame->sharekey = 0;
 
 	if( client->mv )
 	{
@@ -1179,7 +2060,7 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 	//=============================
 	entsList.numSnapshotEntities = 0;
 	memset( entsList.entityAddedToSnapList, 0, sizeof( entsList.entityAddedToSnapList ) );
-	SNAP_BuildSnapEntitiesList( cms, gi, clent, org, fatvis->skyorg, fatvis->pvs, frame, &entsList );
+	SNAP_BuildSnapEntitiesList( cms, gi, clent, org, fatvis->skyorg, fatvis->pvs, viscache, frame, &entsList );
 
 	//Com_Printf( "Snap NumEntities:%i\n", entsList.numSnapshotEntities );
 
@@ -1199,8 +2080,10 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 
 	//=============================
 
-	// dump the entities list
-	ne = client_entities->next_entities;
+	// dump the entities list, reserving the range in the circular buffer
+	// atomically as snapshots for several clients may be built in parallel
+	ne = QAtomic_Add( (volatile int *)&client_entities->next_entities, entsList.numSnapshotEntities, NULL );
+	ne -= entsList.numSnapshotEntities;
 	frame->num_entities = 0;
 	frame->first_entity = ne;
 
@@ -1220,8 +2103,55 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, unsigned int f
 		frame->num_entities++;
 		ne++;
 	}
+}
+
+/*
+* SNAP_CopyClientFrameSnap
+*
+* Gives the client a copy of a snapshot built for another client with the same point
+* of view this frame. Both refer to the same range of the client_entities buffer.
+*/
+void SNAP_CopyClientFrameSnap( client_t *client, client_t *from, unsigned int frameNum, mempool_t *mempool )
+{
+	client_snapshot_t *frame, *src;
+	uint8_t *areabits;
+	player_state_t *ps;
+	int numareas, ps_size;
+
+	src = &from->snapShots[frameNum & UPDATE_MASK];
+	frame = &client->snapShots[frameNum & UPDATE_MASK];
+
+	areabits = frame->areabits;
+	numareas = frame->numareas;
+	if( numareas < src->numareas )
+	{
+		if( areabits )
+			Mem_Free( areabits );
+		areabits = (uint8_t*)Mem_Alloc( mempool, max( src->areabytes, 1 ) );
+		numareas = src->numareas;
+	}
+
+	ps = frame->ps;
+	ps_size = frame->ps_size;
+	if( ps_size < src->numplayers )
+	{
+		if( ps )
+			Mem_Free( ps );
+		ps = ( player_state_t* )Mem_Alloc( mempool, sizeof( player_state_t )*src->numplayers );
+		ps_size = src->numplayers;
+	}
+
+	*frame = *src;
+	frame->areabits = areabits;
+	frame->numareas = numareas;
+	frame->ps = ps;
+	frame->ps_size = ps_size;
+	frame->UcmdExecuted = client->UcmdExecuted;
 
-	client_entities->next_entities = ne;
+	if( src->areabytes )
+		memcpy( frame->areabits, src->areabits, src->areabytes );
+	if( src->numplayers )
+		memcpy( frame->ps, src->ps, sizeof( player_state_t ) * src->numplayers );
 }
 
 /*
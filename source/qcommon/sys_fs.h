@@ -35,6 +35,9 @@ void	    Sys_FS_FindClose( void );
 void		*Sys_FS_LockFile( const char *path );
 void	    Sys_FS_UnlockFile( void *handle );
 
+void		*Sys_FS_MMapFile( const char *path, size_t *size );
+void		Sys_FS_UnMMapFile( void *mapping, size_t size );
+
 time_t		Sys_FS_FileMTime( const char *filename );
 
 // virtual storage of pack files, such as .obb on Android
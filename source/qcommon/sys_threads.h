@@ -29,7 +29,13 @@ int Sys_Thread_Cancel( qthread_t *thread );
 int Sys_Mutex_Create( qmutex_t **pmutex );
 void Sys_Mutex_Destroy( qmutex_t *mutex );
 void Sys_Mutex_Lock( qmutex_t *mutex );
+bool Sys_Mutex_TryLock( qmutex_t *mutex );
 void Sys_Mutex_Unlock( qmutex_t *mutex );
+int Sys_CondVar_Create( qcondvar_t **pcond );
+void Sys_CondVar_Destroy( qcondvar_t *cond );
+bool Sys_CondVar_Wait( qcondvar_t *cond, qmutex_t *mutex, unsigned int timeout_msec );
+void Sys_CondVar_Wake( qcondvar_t *cond );
+
 int Sys_Atomic_Add( volatile int *value, int add, qmutex_t *mutex );
 
 #endif // SYS_THREADS_H
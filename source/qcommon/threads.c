@@ -57,6 +57,17 @@ void QMutex_Lock( qmutex_t *mutex )
 	Sys_Mutex_Lock( mutex );
 }
 
+/*
+* QMutex_TryLock
+*
+* Returns true if the mutex has been acquired without blocking.
+*/
+bool QMutex_TryLock( qmutex_t *mutex )
+{
+	assert( mutex != NULL );
+	return Sys_Mutex_TryLock( mutex );
+}
+
 /*
 * QMutex_Unlock
 */
@@ -66,6 +77,80 @@ void QMutex_Unlock( qmutex_t *mutex )
 	Sys_Mutex_Unlock( mutex );
 }
 
+/*
+* QCondVar_Create
+*/
+qcondvar_t *QCondVar_Create( void )
+{
+	int ret;
+	qcondvar_t *cond;
+
+	ret = Sys_CondVar_Create( &cond );
+	if( ret != 0 ) {
+		Sys_Error( "QCondVar_Create: failed with code %i", ret );
+	}
+	return cond;
+}
+
+/*
+* QCondVar_Destroy
+*/
+void QCondVar_Destroy( qcondvar_t **pcond )
+{
+	assert( pcond != NULL );
+	if( pcond && *pcond ) {
+		Sys_CondVar_Destroy( *pcond );
+		*pcond = NULL;
+	}
+}
+
+/*
+* QCondVar_Wait
+*
+* The mutex must be locked by the caller. Returns false on timeout.
+*/
+bool QCondVar_Wait( qcondvar_t *cond, qmutex_t *mutex, unsigned int timeout_msec )
+{
+	assert( cond != NULL );
+	assert( mutex != NULL );
+	return Sys_CondVar_Wait( cond, mutex, timeout_msec );
+}
+
+/*
+* QCondVar_Wake
+*
+* Wakes up all threads waiting on the condition variable.
+*/
+void QCondVar_Wake( qcondvar_t *cond )
+{
+	assert( cond != NULL );
+	Sys_CondVar_Wake( cond );
+}
+
+typedef struct {
+	void *(*routine)(void *);
+	void *param;
+} qthread_start_t;
+
+/*
+* QThread_Start
+*/
+static void *QThread_Start( void *param )
+{
+	void *ret;
+	qthread_start_t start;
+
+	memcpy( &start, param, sizeof( start ) );
+	Q_free( param );
+
+	ret = start.routine( start.param );
+
+	// give the blocks cached by this thread back to the system
+	Mem_ReleaseThreadCache();
+
+	return ret;
+}
+
 /*
 * QThread_Create
 */
@@ -73,8 +158,13 @@ qthread_t *QThread_Create( void *(*routine) (void*), void *param )
 {
 	int ret;
 	qthread_t *thread;
+	qthread_start_t *start;
+
+	start = ( qthread_start_t * )Q_malloc( sizeof( *start ) );
+	start->routine = routine;
+	start->param = param;
 
-	ret = Sys_Thread_Create( &thread, routine, param );
+	ret = Sys_Thread_Create( &thread, QThread_Start, start );
 	if( ret != 0 ) {
 		Sys_Error( "QThread_Create: failed with code %i", ret );
 	}
@@ -96,6 +186,7 @@ int QThread_Cancel( qthread_t *thread )
 {
 	return Sys_Thread_Cancel( thread );
 }
+
 /*
 * QThread_Yield
 */
@@ -104,6 +195,16 @@ void QThread_Yield( void )
 	Sys_Thread_Yield();
 }
 
+/*
+* QAtomic_Add
+*
+* Returns the new value.
+*/
+int QAtomic_Add( volatile int *value, int add, qmutex_t *mutex )
+{
+	return Sys_Atomic_Add( value, add, mutex );
+}
+
 /*
 * QThreads_Init
 */
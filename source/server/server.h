@@ -99,8 +99,10 @@ typedef struct
 	int num_entities;
 	int first_entity;                   // into the circular sv.client_entities[]
 	unsigned int sentTimeStamp;         // time at what this frame snap was sent to the clients
+	unsigned int serverTime;            // timestamp written in the frame header, base of the packed predictions
 	unsigned int UcmdExecuted;
 	game_state_t gameState;
+	unsigned int sharekey;              // snapshots with the same non-zero key have identical contents
 } client_snapshot_t;
 
 typedef struct
@@ -155,6 +157,7 @@ typedef struct client_s
 	int lastframe;                  // used for delta compression etc.
 	bool nodelta;               // send one non delta compressed frame trough
 	int nodelta_frame;              // when we get confirmation of this frame, the non-delta frame is trough
+	int snapEncoding;               // SNAP_ENCODING_*, negotiated at connect
 	unsigned int lastSentFrameNum;  // for knowing which was last frame we sent
 
 	int frame_latency[LATENCY_COUNTS];
@@ -191,21 +194,21 @@ typedef struct client_s
 
 //=============================================================================
 
-// MAX_CHALLENGES is made large to prevent a denial
-// of service attack that could cycle all of them
-// out before legitimate users connected
-#define	MAX_CHALLENGES	1024
-
 // MAX_SNAP_ENTITIES is the guess of what we consider maximum amount of entities
 // to be sent to a client into a snap. It's used for finding size of the backup storage
 #define MAX_SNAP_ENTITIES 64
 
+// challenges are a keyed hash of the client address, so nothing is stored
+// per client and a getchallenge flood can't cycle out legitimate players
+#define CHALLENGE_SECRET_SIZE	16
+#define CHALLENGE_ROTATE_TIME	( 60 * 1000 )    // challenges stay valid for one to two rotations
+
 typedef struct
 {
-	netadr_t adr;
-	int challenge;
-	int time;
-} challenge_t;
+	bool seeded;
+	unsigned int rotatetime;            // Sys_Milliseconds the secrets were last rotated at, svs.realtime restarts on map change
+	uint8_t secrets[2][CHALLENGE_SECRET_SIZE]; // current and previous
+} challenge_secrets_t;
 
 // for server side demo recording
 typedef struct
@@ -218,6 +221,11 @@ typedef struct
 	client_t client;                // special client for writing the messages
 	char meta_data[SNAP_MAX_DEMO_META_DATA_SIZE];
 	size_t meta_data_realsize;
+
+	char *configstrings;            // configstrings at the start of recording, keyframes resend the ones that changed
+	unsigned int nextkeyframe;
+	snap_demokeyframe_t *keyframes;
+	unsigned int numkeyframes, maxkeyframes;
 } server_static_demo_t;
 
 typedef server_static_demo_t demorec_t;
@@ -249,6 +257,34 @@ typedef struct fatvis_s
 	uint8_t phs[MAX_MAP_LEAFS/8];
 } fatvis_t;
 
+#define SV_CLIENT_HASH_SIZE	256         // must be a power of two
+
+// clients indexed by base address and game port, so that incoming
+// sequenced packets don't have to scan all client slots
+typedef struct
+{
+	int head[SV_CLIENT_HASH_SIZE];      // client number + 1, 0 for empty buckets
+	int next[MAX_CLIENTS];              // client number + 1 of the next client in the bucket
+	int bucket[MAX_CLIENTS];            // bucket + 1 the client is linked into, 0 if not linked
+} client_hash_t;
+
+// dedicated server frame scheduling
+typedef struct
+{
+	bool synced;
+	int64_t clockbase;                  // Sys_Milliseconds() when svs.realtime was 0
+	uint64_t deadline;                  // Sys_Microseconds() the next game frame is due at
+
+	uint64_t start;                     // when the stats below were reset
+	unsigned int frames;
+	uint64_t lateness_total;            // how far past the deadline game frames ran, in microseconds
+	uint64_t lateness_sq_total;
+	unsigned int lateness_max;
+	unsigned int sleeps;
+	unsigned int wakeups;               // sleeps cut short by incoming packets
+	uint64_t sleep_total;
+} sv_scheduler_t;
+
 typedef struct
 {
 	bool initialized;               // sv_init has completed
@@ -262,6 +298,7 @@ typedef struct
 	socket_t socket_tcp;
 	socket_t socket_tcp6;
 #endif
+	netpoll_t *netpoll;                 // the UDP sockets, waited on between frames
 
 	char mapcmd[MAX_TOKEN_CHARS];       // ie: *intro.cin+base
 
@@ -270,8 +307,15 @@ typedef struct
 
 	client_t *clients;                  // [sv_maxclients->integer];
 	client_entities_t client_entities;
+	snap_deltacache_t *deltacache;      // entity deltas shared between the snapshots of a frame
+	snap_viscache_t *viscache;          // visible entities shared between clients seeing the same clusters
+
+	client_hash_t client_hash;
+	unsigned int unmatched_packets;     // sequenced packets that didn't belong to any client
+
+	sv_scheduler_t scheduler;
 
-	challenge_t challenges[MAX_CHALLENGES]; // to prevent invalid IPs from connecting
+	challenge_secrets_t challenges;     // to prevent invalid IPs from connecting
 #ifdef TCP_ALLOW_CONNECT
 	incoming_t incoming[MAX_INCOMING_CONNECTIONS]; // holds socket while tcp client is connecting
 #endif
@@ -327,6 +371,7 @@ extern cvar_t *sv_http_port;
 extern cvar_t *sv_http_upstream_baseurl;
 extern cvar_t *sv_http_upstream_ip;
 extern cvar_t *sv_http_upstream_realip_header;
+extern cvar_t *sv_http_threaded;
 #endif
 
 extern cvar_t *sv_skilllevel;
@@ -337,11 +382,16 @@ extern cvar_t *sv_enforcetime;
 extern cvar_t *sv_showRcon;
 extern cvar_t *sv_showChallenge;
 extern cvar_t *sv_showInfoQueries;
+extern cvar_t *sv_oob_ratelimit;
+extern cvar_t *sv_oob_ratelimit_burst;
 extern cvar_t *sv_highchars;
 
 //wsw : jal
 extern cvar_t *sv_maxrate;
 extern cvar_t *sv_compresspackets;
+extern cvar_t *sv_compressmethod;
+extern cvar_t *sv_snapencoding;
+extern cvar_t *sv_snapthreads;
 extern cvar_t *sv_public;         // should heartbeats be sent
 
 // wsw : debug netcode
@@ -365,6 +415,7 @@ extern cvar_t *sv_lastAutoUpdate;
 extern cvar_t *sv_defaultmap;
 
 extern cvar_t *sv_demodir;
+extern cvar_t *sv_demokeyframes;
 
 extern cvar_t *sv_mm_authkey;
 extern cvar_t *sv_mm_loginonly;
@@ -400,6 +451,7 @@ void SV_UpdateActivity( void );
 // sv_oob.c
 //
 void SV_ConnectionlessPacket( const socket_t *socket, const netadr_t *address, msg_t *msg );
+void SV_InvalidateInfoCache( void );
 void SV_InitMaster( void );
 void SV_UpdateMaster( void );
 
@@ -453,6 +505,7 @@ typedef struct
 
 void SV_FlushRedirect( int sv_redirected, const char *outputbuf, const void *extra );
 void SV_SendClientMessages( void );
+void SV_ShutdownSnapWorkers( void );
 
 void SV_Multicast( vec3_t origin, multicast_t to );
 void SV_BroadcastCommand( const char *format, ... );
@@ -468,6 +521,10 @@ void SV_DropClient( client_t *drop, int type, const char *format, ... );
 void SV_ExecuteClientThinks( int clientNum );
 void SV_ClientResetCommandBuffers( client_t *client );
 bool SV_ClientAllowHttpRequest( int clientNum, const char *session );
+void SV_ClearClientHash( void );
+void SV_HashClient( client_t *client );
+void SV_UnhashClient( client_t *client );
+client_t *SV_FindHashedClient( const netadr_t *address, int game_port );
 
 //
 // sv_mv.c
@@ -479,12 +536,14 @@ bool SV_Multiview_CreateStartMessages( bool ( *callback )( msg_t *msg, void *ext
 // sv_ccmds.c
 //
 void SV_Status_f( void );
+void SV_ResetFrameStats( void );
+void SV_ResetSchedulerClock( void );
 
 //
 // sv_ents.c
 //
 void SV_WriteFrameSnapToClient( client_t *client, msg_t *msg );
-void SV_BuildClientFrameSnap( client_t *client );
+void SV_BuildClientFrameSnap( client_t *client, fatvis_t *fatvis );
 
 
 void SV_Error( char *error, ... );
@@ -509,6 +568,7 @@ void SV_Demo_Start_f( void );
 void SV_Demo_Stop_f( void );
 void SV_Demo_Cancel_f( void );
 void SV_Demo_Purge_f( void );
+void SV_Demo_Index_f( void );
 
 void SV_DemoList_f( client_t *client );
 void SV_DemoGet_f( client_t *client );
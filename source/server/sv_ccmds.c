@@ -703,6 +703,77 @@ void SV_Status_f( void )
 		Com_Printf( "\n" );
 	}
 	Com_Printf( "\n" );
+	Com_Printf( "unmatched packets: %u\n", svs.unmatched_packets );
+}
+
+/*
+* SV_FrameStats_f
+*/
+static void SV_FrameStats_f( void )
+{
+	const sv_scheduler_t *sched = &svs.scheduler;
+	double mean, stddev, elapsed;
+
+	if( !svs.initialized )
+	{
+		Com_Printf( "No server running.\n" );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) )
+	{
+		SV_ResetFrameStats();
+		return;
+	}
+
+	if( !sched->frames )
+	{
+		Com_Printf( "No frames measured yet.\n" );
+		return;
+	}
+
+	mean = (double)sched->lateness_total / sched->frames;
+	stddev = sqrt( max( (double)sched->lateness_sq_total / sched->frames - mean * mean, 0.0 ) );
+	elapsed = (double)( Sys_Microseconds() - sched->start );
+
+	Com_Printf( "frames         : %u\n", sched->frames );
+	Com_Printf( "lateness       : %.0f us mean, %.0f us stddev, %u us max\n", mean, stddev, sched->lateness_max );
+	Com_Printf( "sleeps         : %u, %u woken by packets\n", sched->sleeps, sched->wakeups );
+	Com_Printf( "idle           : %.1f%%\n", elapsed > 0 ? 100.0 * sched->sleep_total / elapsed : 0.0 );
+}
+
+/*
+* SV_DeltaStats_f
+*/
+static void SV_DeltaStats_f( void )
+{
+	snap_deltacache_stats_t stats;
+	uint64_t lookups;
+
+	if( !svs.initialized )
+	{
+		Com_Printf( "No server running.\n" );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) )
+	{
+		SNAP_ResetDeltaCacheStats( svs.deltacache );
+		return;
+	}
+
+	SNAP_GetDeltaCacheStats( svs.deltacache, &stats );
+	lookups = stats.hits + stats.misses;
+	if( !lookups )
+	{
+		Com_Printf( "No entity deltas written yet.\n" );
+		return;
+	}
+
+	Com_Printf( "frames         : %u in %.1f s\n", stats.frames, ( Sys_Milliseconds() - stats.start ) * 0.001 );
+	Com_Printf( "hits           : %.0f of %.0f (%.1f%%)\n", (double)stats.hits, (double)lookups, 100.0 * stats.hits / lookups );
+	Com_Printf( "bytes reused   : %.0f\n", (double)stats.bytesReused );
+	Com_Printf( "buffer         : %u bytes peak, %u overflows\n", stats.maxDataUsed, stats.overflows );
 }
 
 /*
@@ -810,6 +881,8 @@ void SV_InitOperatorCommands( void )
 {
 	Cmd_AddCommand( "heartbeat", SV_Heartbeat_f );
 	Cmd_AddCommand( "status", SV_Status_f );
+	Cmd_AddCommand( "framestats", SV_FrameStats_f );
+	Cmd_AddCommand( "deltastats", SV_DeltaStats_f );
 	Cmd_AddCommand( "serverinfo", SV_Serverinfo_f );
 	Cmd_AddCommand( "dumpuser", SV_DumpUser_f );
 
@@ -822,6 +895,7 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "serverrecordstop", SV_Demo_Stop_f );
 	Cmd_AddCommand( "serverrecordcancel", SV_Demo_Cancel_f );
 	Cmd_AddCommand( "serverrecordpurge", SV_Demo_Purge_f );
+	Cmd_AddCommand( "serverrecordindex", SV_Demo_Index_f );
 
 	Cmd_AddCommand( "purelist", SV_PureList_f );
 
@@ -846,6 +920,8 @@ void SV_ShutdownOperatorCommands( void )
 {
 	Cmd_RemoveCommand( "heartbeat" );
 	Cmd_RemoveCommand( "status" );
+	Cmd_RemoveCommand( "framestats" );
+	Cmd_RemoveCommand( "deltastats" );
 	Cmd_RemoveCommand( "serverinfo" );
 	Cmd_RemoveCommand( "dumpuser" );
 
@@ -858,6 +934,7 @@ void SV_ShutdownOperatorCommands( void )
 	Cmd_RemoveCommand( "serverrecordstop" );
 	Cmd_RemoveCommand( "serverrecordcancel" );
 	Cmd_RemoveCommand( "serverrecordpurge" );
+	Cmd_RemoveCommand( "serverrecordindex" );
 
 	Cmd_RemoveCommand( "purelist" );
 
@@ -28,6 +28,125 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //
 //============================================================================
 
+/*
+* SV_ClientHashKey
+*
+* Hashes the address without the port, which translating routers may change,
+* together with the game port the client has sent in its connect request
+*/
+static unsigned int SV_ClientHashKey( const netadr_t *address, int game_port )
+{
+	unsigned int i, hash;
+	const uint8_t *ip;
+	size_t iplen;
+
+	switch( address->type )
+	{
+	case NA_IP:
+		ip = address->address.ipv4.ip;
+		iplen = sizeof( address->address.ipv4.ip );
+		break;
+	case NA_IP6:
+		ip = address->address.ipv6.ip;
+		iplen = sizeof( address->address.ipv6.ip );
+		break;
+	default:
+		ip = NULL;
+		iplen = 0;
+		break;
+	}
+
+	hash = (unsigned)address->type * 31 + ( game_port & 0xffff );
+	for( i = 0; i < iplen; i++ )
+		hash = hash * 31 + ip[i];
+
+	return ( hash ^ ( hash >> 8 ) ^ ( hash >> 16 ) ) & ( SV_CLIENT_HASH_SIZE - 1 );
+}
+
+/*
+* SV_ClearClientHash
+*/
+void SV_ClearClientHash( void )
+{
+	memset( &svs.client_hash, 0, sizeof( svs.client_hash ) );
+}
+
+/*
+* SV_UnhashClient
+*/
+void SV_UnhashClient( client_t *client )
+{
+	int num, *link;
+	client_hash_t *hash = &svs.client_hash;
+
+	num = client - svs.clients;
+	if( !hash->bucket[num] )
+		return;
+
+	for( link = &hash->head[hash->bucket[num] - 1]; *link; link = &hash->next[*link - 1] )
+	{
+		if( *link == num + 1 )
+		{
+			*link = hash->next[num];
+			break;
+		}
+	}
+
+	hash->next[num] = 0;
+	hash->bucket[num] = 0;
+}
+
+/*
+* SV_HashClient
+*
+* Must be called whenever the base address or game port of the client changes
+*/
+void SV_HashClient( client_t *client )
+{
+	int num;
+	unsigned int key;
+	client_hash_t *hash = &svs.client_hash;
+
+	SV_UnhashClient( client );
+
+	num = client - svs.clients;
+	key = SV_ClientHashKey( &client->netchan.remoteAddress, client->netchan.game_port );
+
+	hash->next[num] = hash->head[key];
+	hash->head[key] = num + 1;
+	hash->bucket[num] = key + 1;
+}
+
+/*
+* SV_FindHashedClient
+*
+* Returns the connected client that sequenced packets from this address belong to
+*/
+client_t *SV_FindHashedClient( const netadr_t *address, int game_port )
+{
+	int num;
+	client_t *cl;
+	client_hash_t *hash = &svs.client_hash;
+
+	for( num = hash->head[SV_ClientHashKey( address, game_port )]; num; num = hash->next[num - 1] )
+	{
+		cl = &svs.clients[num - 1];
+
+		if( cl->state == CS_FREE || cl->state == CS_ZOMBIE )
+			continue;
+		if( cl->edict && ( cl->edict->r.svflags & SVF_FAKECLIENT ) )
+			continue;
+		if( cl->netchan.game_port != game_port )
+			continue;
+		if( !NET_CompareBaseAddress( address, &cl->netchan.remoteAddress ) )
+			continue;
+
+		return cl;
+	}
+
+	return NULL;
+}
+
 void SV_ClientResetCommandBuffers( client_t *client )
 {
 	// reset the reliable commands buffer
@@ -82,6 +201,7 @@ bool SV_ClientConnect( const socket_t *socket, const netadr_t *address, client_t
 
 
 	// the connection is accepted, set up the client slot
+	SV_UnhashClient( client );
 	memset( client, 0, sizeof( *client ) );
 	client->edict = ent;
 	client->challenge = challenge; // save challenge for checksumming
@@ -147,6 +267,8 @@ bool SV_ClientConnect( const socket_t *socket, const netadr_t *address, client_t
 		{
 			Netchan_Setup( &client->netchan, socket, address, game_port );
 		}
+
+		SV_HashClient( client );
 	}
 
 	
@@ -256,6 +378,7 @@ void SV_DropClient( client_t *drop, int type, const char *format, ... )
 
 	drop->tvclient = false;
 	drop->state = CS_ZOMBIE;    // become free in a few seconds
+	SV_UnhashClient( drop );
 	drop->name[0] = 0;
 }
 
@@ -46,6 +46,58 @@ static void SV_Demo_WriteStartMessages( void )
 
 	SNAP_BeginDemoRecording( svs.demo.file, svs.spawncount, svc.snapFrameTime, sv.mapname, SV_BITFLAGS_RELIABLE, 
 		svs.purelist, sv.configstrings[0], sv.baselines );
+
+	// keyframes only need to resend configstrings that changed since now
+	svs.demo.configstrings = Mem_ZoneMalloc( sizeof( sv.configstrings ) );
+	memcpy( svs.demo.configstrings, sv.configstrings, sizeof( sv.configstrings ) );
+}
+
+/*
+* SV_Demo_WriteKeyframe
+* 
+* Writes configstrings changed since the start of recording and makes the next
+* frame a full one, so the playback can start reading from here
+*/
+static void SV_Demo_WriteKeyframe( msg_t *msg )
+{
+	int i;
+	unsigned int offset;
+	const char *configstring;
+
+	offset = FS_Tell( svs.demo.file );
+
+	for( i = 0; i < MAX_CONFIGSTRINGS; i++ )
+	{
+		configstring = svs.demo.configstrings + i * MAX_CONFIGSTRING_CHARS;
+		if( !strcmp( configstring, sv.configstrings[i] ) )
+			continue;
+
+		MSG_WriteByte( msg, svc_servercs );
+		MSG_WriteString( msg, va( "cs %i \"%s\"", i, sv.configstrings[i] ) );
+
+		if( msg->cursize > msg->maxsize / 2 )
+		{
+			SV_Demo_WriteMessage( msg );
+			MSG_Clear( msg );
+		}
+	}
+
+	svs.demo.client.nodelta = true;
+
+	if( svs.demo.numkeyframes == svs.demo.maxkeyframes )
+	{
+		svs.demo.maxkeyframes = svs.demo.maxkeyframes ? svs.demo.maxkeyframes * 2 : 64;
+		if( svs.demo.keyframes )
+			svs.demo.keyframes = Mem_Realloc( svs.demo.keyframes, svs.demo.maxkeyframes * sizeof( *svs.demo.keyframes ) );
+		else
+			svs.demo.keyframes = Mem_ZoneMalloc( svs.demo.maxkeyframes * sizeof( *svs.demo.keyframes ) );
+	}
+
+	svs.demo.keyframes[svs.demo.numkeyframes].serverTime = svs.gametime;
+	svs.demo.keyframes[svs.demo.numkeyframes].offset = offset;
+	svs.demo.numkeyframes++;
+
+	svs.demo.nextkeyframe = svs.gametime + sv_demokeyframes->integer * 1000;
 }
 
 /*
@@ -75,7 +127,10 @@ void SV_Demo_WriteSnap( void )
 
 	MSG_Init( &msg, msg_buffer, sizeof( msg_buffer ) );
 
-	SV_BuildClientFrameSnap( &svs.demo.client );
+	if( svs.demo.client.nodelta || ( sv_demokeyframes->integer > 0 && svs.gametime >= svs.demo.nextkeyframe ) )
+		SV_Demo_WriteKeyframe( &msg );
+
+	SV_BuildClientFrameSnap( &svs.demo.client, &svs.fatvis );
 
 	SV_WriteFrameSnapToClient( &svs.demo.client, &msg );
 
@@ -246,6 +301,10 @@ static void SV_Demo_Stop( bool cancel, bool silent )
 		SV_SetDemoMetaKeyValue( "matchscore", sv.configstrings[CS_MATCHSCORE] );
 		SV_SetDemoMetaKeyValue( "matchuuid", sv.configstrings[CS_MATCHUUID] );
 
+		// lets demojump seek without scanning the whole file
+		svs.demo.meta_data_realsize = SNAP_SetDemoMetaKeyframes( svs.demo.meta_data, sizeof( svs.demo.meta_data ),
+			svs.demo.meta_data_realsize, svs.demo.keyframes, svs.demo.numkeyframes );
+
 		SNAP_WriteDemoMetaData( svs.demo.tempname, svs.demo.meta_data, svs.demo.meta_data_realsize );
 
 		if( !FS_MoveFile( svs.demo.tempname, svs.demo.filename ) )
@@ -261,6 +320,13 @@ static void SV_Demo_Stop( bool cancel, bool silent )
 	svs.demo.filename = NULL;
 	Mem_ZoneFree( svs.demo.tempname );
 	svs.demo.tempname = NULL;
+
+	Mem_ZoneFree( svs.demo.configstrings );
+	svs.demo.configstrings = NULL;
+	Mem_ZoneFree( svs.demo.keyframes );
+	svs.demo.keyframes = NULL;
+	svs.demo.numkeyframes = svs.demo.maxkeyframes = 0;
+	svs.demo.nextkeyframe = 0;
 }
 
 /*
@@ -371,6 +437,89 @@ void SV_Demo_Purge_f( void )
 	Mem_TempFree( buffer );
 }
 
+/*
+* SV_Demo_Index_f
+* 
+* Builds the keyframe index of a server demo recorded without one
+*/
+void SV_Demo_Index_f( void )
+{
+	int demofile;
+	char *filename, *meta_data;
+	size_t filename_size, meta_data_realsize;
+	unsigned int numkeyframes;
+	snap_demokeyframe_t *keyframes;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Com_Printf( "Usage: serverrecordindex <demoname>\n" );
+		return;
+	}
+
+	filename_size =
+		sizeof( char ) * ( strlen( SV_DEMO_DIR ) + 1 + strlen( Cmd_Args() ) + strlen( APP_DEMO_EXTENSION_STR ) + 1 );
+	filename = Mem_TempMalloc( filename_size );
+
+	Q_snprintfz( filename, filename_size, "%s/%s", SV_DEMO_DIR, Cmd_Args() );
+
+	COM_SanitizeFilePath( filename );
+
+	if( !COM_ValidateRelativeFilename( filename ) )
+	{
+		Mem_TempFree( filename );
+		Com_Printf( "Invalid filename.\n" );
+		return;
+	}
+
+	COM_DefaultExtension( filename, APP_DEMO_EXTENSION_STR, filename_size );
+
+	if( svs.demo.file && !Q_stricmp( filename, svs.demo.filename ) )
+	{
+		Mem_TempFree( filename );
+		Com_Printf( "Can't index the demo being recorded\n" );
+		return;
+	}
+
+	if( FS_FOpenFile( filename, &demofile, FS_READ|SNAP_DEMO_GZ ) == -1 )
+	{
+		Com_Printf( "Error: Couldn't open file: %s\n", filename );
+		Mem_TempFree( filename );
+		return;
+	}
+
+	meta_data = Mem_TempMalloc( SNAP_MAX_DEMO_META_DATA_SIZE );
+	meta_data_realsize = SNAP_ReadDemoMetaData( demofile, meta_data, SNAP_MAX_DEMO_META_DATA_SIZE );
+
+	// the terminating \0 of the last value isn't stored in the file
+	if( meta_data_realsize > 0 && meta_data_realsize < SNAP_MAX_DEMO_META_DATA_SIZE )
+		meta_data_realsize++;
+
+	keyframes = NULL;
+	numkeyframes = 0;
+	if( FS_Seek( demofile, 0, FS_SEEK_SET ) >= 0 )
+		keyframes = SNAP_ScanDemoKeyframes( demofile, &numkeyframes );
+
+	FS_FCloseFile( demofile );
+
+	if( !numkeyframes )
+	{
+		Com_Printf( "No keyframes found in %s, not a server demo?\n", filename );
+	}
+	else
+	{
+		meta_data_realsize = SNAP_SetDemoMetaKeyframes( meta_data, SNAP_MAX_DEMO_META_DATA_SIZE,
+			meta_data_realsize, keyframes, numkeyframes );
+
+		SNAP_WriteDemoMetaData( filename, meta_data, meta_data_realsize );
+
+		Com_Printf( "Indexed %u keyframes in %s\n", numkeyframes, filename );
+	}
+
+	Mem_ZoneFree( keyframes );
+	Mem_TempFree( meta_data );
+	Mem_TempFree( filename );
+}
+
 /*
 * SV_DemoList_f
 */
@@ -543,6 +543,7 @@ void SV_InitGameProgs( void )
 
 	import.Mem_Alloc = PF_MemAlloc;
 	import.Mem_Free = PF_MemFree;
+	import.Mem_FrameAlloc = _Mem_FrameAlloc;
 
 	import.Dynvar_Create = Dynvar_Create;
 	import.Dynvar_Destroy = Dynvar_Destroy;
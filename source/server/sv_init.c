@@ -259,6 +259,7 @@ static void SV_SpawnServer( const char *server, bool devmap )
 	SV_ResetClientFrameCounters();
 	svs.realtime = 0;
 	svs.gametime = 0;
+	SV_ResetSchedulerClock();
 	SV_UpdateActivity();
 
 	Q_strncpyz( sv.mapname, server, sizeof( sv.mapname ) );
@@ -352,8 +353,11 @@ void SV_InitGame( void )
 
 	svs.spawncount = rand();
 	svs.clients = Mem_Alloc( sv_mempool, sizeof( client_t )*sv_maxclients->integer );
+	SV_ClearClientHash();
 	svs.client_entities.num_entities = sv_maxclients->integer * UPDATE_BACKUP * MAX_SNAP_ENTITIES;
 	svs.client_entities.entities = Mem_Alloc( sv_mempool, sizeof( entity_state_t ) * svs.client_entities.num_entities );
+	svs.deltacache = SNAP_CreateDeltaCache( sv_mempool );
+	svs.viscache = SNAP_CreateVisCache( sv_mempool );
 
 	// init network stuff
 
@@ -391,6 +395,20 @@ void SV_InitGame( void )
 			Com_Printf( "Error: invalid IPv6 address: %s\n", sv_ip6->string );
 	}
 
+	if( dedicated->integer )
+	{
+		svs.netpoll = NET_CreatePoll();
+		if( !svs.netpoll )
+			Com_Printf( "Error: Couldn't create socket poll: %s\n", NET_ErrorString() );
+		else
+		{
+			if( svs.socket_udp.open )
+				NET_PollAddSocket( svs.netpoll, &svs.socket_udp, NULL, NULL, NULL );
+			if( svs.socket_udp6.open )
+				NET_PollAddSocket( svs.netpoll, &svs.socket_udp6, NULL, NULL, NULL );
+		}
+	}
+
 #ifdef TCP_ALLOW_CONNECT
 	if( sv_tcp->integer && ( dedicated->integer || sv_maxclients->integer > 1 ) )
 	{
@@ -522,6 +540,7 @@ void SV_ShutdownGame( const char *finalmsg, bool reconnect )
 
 	// SV_MM_Shutdown();
 
+	NET_DestroyPoll( &svs.netpoll );
 	NET_CloseSocket( &svs.socket_loopback );
 	NET_CloseSocket( &svs.socket_udp );
 	NET_CloseSocket( &svs.socket_udp6 );
@@ -547,6 +566,9 @@ void SV_ShutdownGame( const char *finalmsg, bool reconnect )
 		memset( &svs.client_entities, 0, sizeof( svs.client_entities ) );
 	}
 
+	SNAP_DestroyDeltaCache( &svs.deltacache );
+	SNAP_DestroyVisCache( &svs.viscache );
+
 	if( svs.cms )
 	{
 		// CM_ReleaseReference will take care of freeing up the memory
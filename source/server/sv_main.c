@@ -61,12 +61,15 @@ cvar_t *sv_http_port;
 cvar_t *sv_http_upstream_baseurl;
 cvar_t *sv_http_upstream_ip;
 cvar_t *sv_http_upstream_realip_header;
+cvar_t *sv_http_threaded;
 #endif
 
 cvar_t *sv_showclamp;
 cvar_t *sv_showRcon;
 cvar_t *sv_showChallenge;
 cvar_t *sv_showInfoQueries;
+cvar_t *sv_oob_ratelimit;
+cvar_t *sv_oob_ratelimit_burst;
 cvar_t *sv_highchars;
 
 cvar_t *sv_hostname;
@@ -81,6 +84,9 @@ cvar_t *sv_reconnectlimit; // minimum seconds between connect messages
 
 cvar_t *sv_maxrate;
 cvar_t *sv_compresspackets;
+cvar_t *sv_compressmethod;
+cvar_t *sv_snapencoding;
+cvar_t *sv_snapthreads;
 cvar_t *sv_masterservers;
 cvar_t *sv_skilllevel;
 
@@ -95,6 +101,7 @@ cvar_t *sv_autoUpdate;
 cvar_t *sv_lastAutoUpdate;
 
 cvar_t *sv_demodir;
+cvar_t *sv_demokeyframes;
 
 //============================================================================
 
@@ -163,7 +170,7 @@ static bool SV_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	MSG_ReadShort( msg ); // game_port
 	if( msg->compressed )
 	{
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( msg, netchan->compression );
 		if( zerror < 0 )
 		{
 			// compression error. Drop the packet
@@ -175,6 +182,55 @@ static bool SV_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	return true;
 }
 
+#define SV_MAX_READ_PACKETS	16      // datagrams read from a socket at once
+
+/*
+* SV_ReadPacket
+*/
+static void SV_ReadPacket( const socket_t *socket, const netadr_t *address, msg_t *msg )
+{
+	int game_port;
+	unsigned short addr_port;
+	client_t *cl;
+
+	// check for connectionless packet (0xffffffff) first
+	if( *(int *)msg->data == -1 )
+	{
+		SV_ConnectionlessPacket( socket, address, msg );
+		return;
+	}
+
+	// read the game port out of the message so we can fix up
+	// stupid address translating routers
+	MSG_BeginReading( msg );
+	MSG_ReadLong( msg ); // sequence number
+	MSG_ReadLong( msg ); // sequence number
+	game_port = MSG_ReadShort( msg ) & 0xffff;
+	// data follows
+
+	// check for packets from connected clients
+	cl = SV_FindHashedClient( address, game_port );
+	if( !cl )
+	{
+		svs.unmatched_packets++;
+		return;
+	}
+
+	// the port isn't part of the hash key, so no need to rehash here
+	addr_port = NET_GetAddressPort( address );
+	if( NET_GetAddressPort( &cl->netchan.remoteAddress ) != addr_port )
+	{
+		Com_Printf( "SV_ReadPackets: fixing up a translated port\n" );
+		NET_SetAddressPort( &cl->netchan.remoteAddress, addr_port );
+	}
+
+	if( SV_ProcessPacket( &cl->netchan, msg ) ) // this is a valid, sequenced packet, so process it
+	{
+		cl->lastPacketReceivedTime = svs.realtime;
+		SV_ParseClientMessage( cl, msg );
+	}
+}
+
 /*
 * SV_ReadPackets
 */
@@ -185,12 +241,14 @@ static void SV_ReadPackets( void )
 #ifdef TCP_ALLOW_CONNECT
 	socket_t newsocket;
 #endif
-	int game_port;
 	socket_t *socket;
 	netadr_t address;
 
 	static msg_t msg;
 	static uint8_t msgData[MAX_MSGLEN];
+	static netadr_t addresses[SV_MAX_READ_PACKETS];
+	static msg_t msgs[SV_MAX_READ_PACKETS];
+	static uint8_t msgsData[SV_MAX_READ_PACKETS][MAX_MSGLEN];
 
 #ifdef TCP_ALLOW_CONNECT
 	socket_t* tcpsockets [] =
@@ -208,6 +266,8 @@ static void SV_ReadPackets( void )
 	};
 
 	MSG_Init( &msg, msgData, sizeof( msgData ) );
+	for( i = 0; i < SV_MAX_READ_PACKETS; i++ )
+		MSG_Init( &msgs[i], msgsData[i], sizeof( msgsData[i] ) );
 
 #ifdef TCP_ALLOW_CONNECT
 	for( socketind = 0; socketind < sizeof( tcpsockets ) / sizeof( tcpsockets[0] ); socketind++ )
@@ -281,7 +341,7 @@ static void SV_ReadPackets( void )
 		if( !socket->open )
 			continue;
 
-		while( ( ret = NET_GetPacket( socket, &address, &msg ) ) != 0 )
+		while( ( ret = NET_GetPackets( socket, addresses, msgs, SV_MAX_READ_PACKETS ) ) != 0 )
 		{
 			if( ret == -1 )
 			{
@@ -289,49 +349,8 @@ static void SV_ReadPackets( void )
 				continue;
 			}
 
-			// check for connectionless packet (0xffffffff) first
-			if( *(int *)msg.data == -1 )
-			{
-				SV_ConnectionlessPacket( socket, &address, &msg );
-				continue;
-			}
-
-			// read the game port out of the message so we can fix up
-			// stupid address translating routers
-			MSG_BeginReading( &msg );
-			MSG_ReadLong( &msg ); // sequence number
-			MSG_ReadLong( &msg ); // sequence number
-			game_port = MSG_ReadShort( &msg ) & 0xffff;
-			// data follows
-
-			// check for packets from connected clients
-			for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
-			{
-				unsigned short addr_port;
-
-				if( cl->state == CS_FREE || cl->state == CS_ZOMBIE )
-					continue;
-				if( cl->edict && ( cl->edict->r.svflags & SVF_FAKECLIENT ) )
-					continue;
-				if( !NET_CompareBaseAddress( &address, &cl->netchan.remoteAddress ) )
-					continue;
-				if( cl->netchan.game_port != game_port )
-					continue;
-
-				addr_port = NET_GetAddressPort( &address );
-				if( NET_GetAddressPort( &cl->netchan.remoteAddress ) != addr_port )
-				{
-					Com_Printf( "SV_ReadPackets: fixing up a translated port\n" );
-					NET_SetAddressPort( &cl->netchan.remoteAddress, addr_port );
-				}
-
-				if( SV_ProcessPacket( &cl->netchan, &msg ) ) // this is a valid, sequenced packet, so process it
-				{
-					cl->lastPacketReceivedTime = svs.realtime;
-					SV_ParseClientMessage( cl, &msg );
-				}
-				break;
-			}
+			for( i = 0; i < ret; i++ )
+				SV_ReadPacket( socket, &addresses[i], &msgs[i] );
 		}
 	}
 
@@ -447,6 +466,113 @@ static void SV_CheckTimeouts( void )
 	}
 }
 
+/*
+* SV_SyncSchedulerClock
+*
+* Finds the Sys_Milliseconds value svs.realtime is counted from. The main loop
+* samples the clock a bit before SV_Frame runs, so the smallest offset seen is
+* the exact one.
+*/
+static void SV_SyncSchedulerClock( void )
+{
+	int64_t clockbase = (int64_t)Sys_Milliseconds() - svs.realtime;
+
+	if( !svs.scheduler.synced || clockbase < svs.scheduler.clockbase )
+	{
+		svs.scheduler.clockbase = clockbase;
+		svs.scheduler.synced = true;
+	}
+}
+
+/*
+* SV_ResetSchedulerClock
+*
+* Must be called whenever svs.realtime is restarted, the old clockbase is meaningless then
+*/
+void SV_ResetSchedulerClock( void )
+{
+	svs.scheduler.synced = false;
+	svs.scheduler.clockbase = 0;
+	svs.scheduler.deadline = 0;
+}
+
+/*
+* SV_SleepUntil
+*
+* Sleeps until the deadline, given in Sys_Microseconds time, or until a packet arrives
+*/
+static void SV_SleepUntil( uint64_t deadline )
+{
+	sv_scheduler_t *sched = &svs.scheduler;
+	uint64_t start, now;
+
+	start = now = Sys_Microseconds();
+	if( now >= deadline )
+		return;
+
+	sched->sleeps++;
+	do
+	{
+		if( svs.netpoll )
+		{
+			if( NET_PollWaitMicroseconds( svs.netpoll, deadline - now ) != 0 )
+			{
+				sched->wakeups++;
+				now = Sys_Microseconds();
+				break;
+			}
+		}
+		else
+		{
+			Sys_Sleep( ( deadline - now + 999 ) / 1000 );
+		}
+		now = Sys_Microseconds();
+	} while( now < deadline );
+
+	sched->sleep_total += now - start;
+}
+
+/*
+* SV_UpdateFrameStats
+*/
+static void SV_UpdateFrameStats( void )
+{
+	sv_scheduler_t *sched = &svs.scheduler;
+	uint64_t now = Sys_Microseconds();
+	unsigned int lateness;
+
+	if( !sched->start )
+		sched->start = now;
+
+	// only frames that waited for their deadline are measured
+	if( !sched->deadline )
+		return;
+
+	lateness = now > sched->deadline ? now - sched->deadline : 0;
+	sched->deadline = 0;
+
+	sched->frames++;
+	sched->lateness_total += lateness;
+	sched->lateness_sq_total += (uint64_t)lateness * lateness;
+	if( lateness > sched->lateness_max )
+		sched->lateness_max = lateness;
+}
+
+/*
+* SV_ResetFrameStats
+*/
+void SV_ResetFrameStats( void )
+{
+	sv_scheduler_t *sched = &svs.scheduler;
+
+	sched->start = Sys_Microseconds();
+	sched->frames = 0;
+	sched->lateness_total = sched->lateness_sq_total = 0;
+	sched->lateness_max = 0;
+	sched->sleeps = sched->wakeups = 0;
+	sched->sleep_total = 0;
+}
+
 //#define WORLDFRAMETIME 25 // 40fps
 //#define WORLDFRAMETIME 20 // 50fps
 #define WORLDFRAMETIME 16 // 62.5fps
@@ -478,38 +604,26 @@ static bool SV_RunGameFrame( int msec )
 		refreshGameModule = true;
 	}
 
-	// if there aren't pending packets to be sent, we can sleep
-	if( dedicated->integer && !sentFragments && !refreshSnapshot )
+	if( !refreshGameModule )
 	{
-		int sleeptime = min( WORLDFRAMETIME - ( accTime + 1 ), sv.nextSnapTime - ( svs.gametime + 1 ) );
+		int delay = min( (int)( WORLDFRAMETIME - accTime ), (int)( sv.nextSnapTime - svs.gametime ) );
 
-		if( sleeptime > 0 )
-		{
-			socket_t *sockets [] = { &svs.socket_udp, &svs.socket_udp6 };
-			socket_t *opened_sockets [sizeof( sockets ) / sizeof( sockets[0] ) + 1 ];
-			size_t sock_ind, open_ind;
+		// the main loop hands out whole milliseconds, so the frame will run as soon as
+		// the clock ticks over to the millisecond the deadline falls into
+		if( delay > 0 )
+			svs.scheduler.deadline = (uint64_t)( svs.scheduler.clockbase + svs.realtime + delay ) * 1000;
 
-			// Pass only the opened sockets to the sleep function
-			open_ind = 0;
-			for ( sock_ind = 0; sock_ind < sizeof( sockets ) / sizeof( sockets[0] ); sock_ind++)
-			{
-				socket_t *sock = sockets[sock_ind];
-				if ( sock->open )
-				{
-					opened_sockets[open_ind] = sock;
-					open_ind++;
-				}
-			}
-			opened_sockets[open_ind] = NULL;
-
-			NET_Sleep( sleeptime, opened_sockets );
-		}
+		// if there aren't pending packets to be sent, we can sleep
+		if( dedicated->integer && !sentFragments && delay > 0 )
+			SV_SleepUntil( svs.scheduler.deadline );
 	}
 
 	if( refreshGameModule )
 	{
 		unsigned int moduleTime;
 
+		SV_UpdateFrameStats();
+
 		// update ping based on the last known frame from all clients
 		SV_CalcPings();
 
@@ -720,6 +834,8 @@ void SV_Frame( int realmsec, int gamemsec )
 	svs.realtime += realmsec;
 	svs.gametime += gamemsec;
 
+	SV_SyncSchedulerClock();
+
 	// advance to next map if the server is running for too long (numbers taken from q3 src)
 	if( svs.realtime > wrappingPoint || svs.gametime > wrappingPoint || sv.framenum >= wrappingPoint )
 	{
@@ -825,6 +941,7 @@ void SV_UserinfoChanged( client_t *client )
 		return;
 	}
 	Q_strncpyz( client->name, val, sizeof( client->name ) );
+	SV_InvalidateInfoCache(); // the status reply lists names
 
 #ifndef RATEKILLED
 	// rate command
@@ -900,6 +1017,7 @@ void SV_Init( void )
 	sv_http_upstream_baseurl =	Cvar_Get( "sv_http_upstream_baseurl", "", CVAR_ARCHIVE | CVAR_LATCH );
 	sv_http_upstream_realip_header = Cvar_Get( "sv_http_upstream_realip_header", "", CVAR_ARCHIVE );
 	sv_http_upstream_ip = Cvar_Get( "sv_http_upstream_ip", "", CVAR_ARCHIVE );
+	sv_http_threaded = Cvar_Get( "sv_http_threaded", "0", CVAR_ARCHIVE | CVAR_LATCH );
 #endif
 
 	rcon_password =		    Cvar_Get( "rcon_password", "", 0 );
@@ -911,6 +1029,8 @@ void SV_Init( void )
 	sv_showRcon =		    Cvar_Get( "sv_showRcon", "1", 0 );
 	sv_showChallenge =	    Cvar_Get( "sv_showChallenge", "0", 0 );
 	sv_showInfoQueries =	Cvar_Get( "sv_showInfoQueries", "0", 0 );
+	sv_oob_ratelimit =		Cvar_Get( "sv_oob_ratelimit", "10", CVAR_ARCHIVE );
+	sv_oob_ratelimit_burst = Cvar_Get( "sv_oob_ratelimit_burst", "20", CVAR_ARCHIVE );
 	sv_highchars =			Cvar_Get( "sv_highchars", "1", 0 );
 
 	sv_uploads_http	=       Cvar_Get( "sv_uploads_http", "1", CVAR_READONLY );
@@ -962,9 +1082,15 @@ void SV_Init( void )
 		Cvar_ForceSet( "sv_demodir", "" );
 	}
 
+	// seconds between full snapshots in server demos, lets the playback seek without replaying the whole demo
+	sv_demokeyframes = Cvar_Get( "sv_demokeyframes", "10", CVAR_ARCHIVE );
+
 	// wsw : jal : cap client's exceding server rules
 	sv_maxrate =		    Cvar_Get( "sv_maxrate", "0", CVAR_DEVELOPER );
 	sv_compresspackets =	    Cvar_Get( "sv_compresspackets", "1", CVAR_DEVELOPER );
+	sv_compressmethod =	    Cvar_Get( "sv_compressmethod", "1", CVAR_ARCHIVE );
+	sv_snapencoding =	    Cvar_Get( "sv_snapencoding", "1", CVAR_ARCHIVE );
+	sv_snapthreads =	    Cvar_Get( "sv_snapthreads", "0", CVAR_ARCHIVE );
 	sv_skilllevel =		    Cvar_Get( "sv_skilllevel", "1", CVAR_SERVERINFO|CVAR_ARCHIVE|CVAR_LATCH );
 
 	if( sv_skilllevel->integer > 2 )
@@ -1037,6 +1163,7 @@ void SV_Shutdown( const char *finalmsg )
 	ML_Shutdown();
 	SV_MM_Shutdown( true );
 	SV_ShutdownGame( finalmsg, false );
+	SV_ShutdownSnapWorkers();
 
 	SV_ShutdownOperatorCommands();
 
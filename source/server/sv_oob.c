@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "server.h"
 #include "../matchmaker/mm_common.h"
+#include "../qalgo/md5.h"
 
 static netadr_t master_adr[MAX_MASTERS];    // address of group servers
 
@@ -30,6 +31,60 @@ extern cvar_t *sv_reconnectlimit;     // minimum seconds between connect message
 extern cvar_t *rcon_password;         // password for remote server commands
 extern cvar_t *sv_iplimit;
 
+// connectionless replies are built once and reused until something they
+// depend on changes, server browsers and scanners query us constantly
+#define SV_INFOCACHE_TIMEOUT		1000    // frags, pings and game cvars aren't tracked, refresh once a second
+
+#define MAX_STRING_SVCINFOSTRING 180
+#define MAX_SVCINFOSTRING_LEN ( MAX_STRING_SVCINFOSTRING - 4 )
+
+typedef struct
+{
+	bool valid;
+	unsigned int time;                  // svs.realtime the string was built at
+	size_t size;
+	char *string;
+} sv_infocache_entry_t;
+
+typedef struct
+{
+	int spawncount;
+	bool counted;
+	unsigned int checktime;             // svs.realtime the client list was last counted at
+	int clients, bots;
+
+	char info[MAX_MSGLEN - 16];
+	char status[MAX_MSGLEN - 16];
+	char shortinfo[MAX_STRING_SVCINFOSTRING];
+
+	sv_infocache_entry_t infoEntry;
+	sv_infocache_entry_t statusEntry;
+	sv_infocache_entry_t shortinfoEntry;
+} sv_infocache_t;
+
+static sv_infocache_t sv_infocache =
+{
+	0, false, 0, 0, 0,
+	"", "", "",
+	{ false, 0, sizeof( sv_infocache.info ), sv_infocache.info },
+	{ false, 0, sizeof( sv_infocache.status ), sv_infocache.status },
+	{ false, 0, sizeof( sv_infocache.shortinfo ), sv_infocache.shortinfo },
+};
+
+// token bucket per source address for connectionless packets
+#define SV_OOB_RATELIMIT_HASH_SIZE	1024
+
+typedef struct
+{
+	netadrtype_t type;
+	uint8_t ip[8];                      // IPv4 address or the IPv6 /64 prefix
+	unsigned int time;                  // svs.realtime of the last refill
+	unsigned int tokens;                // in thousandths of a packet
+	bool limited;
+} sv_oob_ratelimit_t;
+
+static sv_oob_ratelimit_t sv_oob_ratelimits[SV_OOB_RATELIMIT_HASH_SIZE];
+
 
 //==============================================================================
 //
@@ -182,17 +237,16 @@ void SV_MasterHeartbeat( void )
 * SV_LongInfoString
 * Builds the string that is sent as heartbeats and status replies
 */
-static char *SV_LongInfoString( bool fullStatus )
+static void SV_LongInfoString( char *status, size_t size, int count, int bots, bool fullStatus )
 {
 	char tempstr[1024] = { 0 };
 	const char *gametype;
-	static char status[MAX_MSGLEN - 16];
-	int i, bots, count;
+	int i;
 	client_t *cl;
 	size_t statusLength;
 	size_t tempstrLength;
 
-	Q_strncpyz( status, Cvar_Serverinfo(), sizeof( status ) );
+	Q_strncpyz( status, Cvar_Serverinfo(), size );
 
 	// convert "g_gametype" to "gametype"
 	gametype = Info_ValueForKey( status, "g_gametype" );
@@ -204,26 +258,13 @@ static char *SV_LongInfoString( bool fullStatus )
 
 	statusLength = strlen( status );
 
-	bots = 0;
-	count = 0;
-	for( i = 0; i < sv_maxclients->integer; i++ )
-	{
-		cl = &svs.clients[i];
-		if( cl->state >= CS_CONNECTED )
-		{
-			if( cl->edict->r.svflags & SVF_FAKECLIENT || cl->tvclient )
-				bots++;
-			count++;
-		}
-	}
-
 	if( bots )
 		Q_snprintfz( tempstr, sizeof( tempstr ), "\\bots\\%i", bots );
 	Q_snprintfz( tempstr + strlen( tempstr ), sizeof( tempstr ) - strlen( tempstr ), "\\clients\\%i%s", count, fullStatus ? "\n" : "" );
 	tempstrLength = strlen( tempstr );
-	if( statusLength + tempstrLength >= sizeof( status ) )
-		return status; // can't hold any more
-	Q_strncpyz( status + statusLength, tempstr, sizeof( status ) - statusLength );
+	if( statusLength + tempstrLength >= size )
+		return; // can't hold any more
+	Q_strncpyz( status + statusLength, tempstr, size - statusLength );
 	statusLength += tempstrLength;
 
 	if ( fullStatus )
@@ -236,49 +277,31 @@ static char *SV_LongInfoString( bool fullStatus )
 				Q_snprintfz( tempstr, sizeof( tempstr ), "%i %i \"%s\" %i\n",
 					cl->edict->r.client->r.frags, cl->ping, cl->name, cl->edict->s.team );
 				tempstrLength = strlen( tempstr );
-				if( statusLength + tempstrLength >= sizeof( status ) )
+				if( statusLength + tempstrLength >= size )
 					break; // can't hold any more
-				Q_strncpyz( status + statusLength, tempstr, sizeof( status ) - statusLength );
+				Q_strncpyz( status + statusLength, tempstr, size - statusLength );
 				statusLength += tempstrLength;
 			}
 		}
 	}
-
-	return status;
 }
 
 /*
 * SV_ShortInfoString
 * Generates a short info string for broadcast scan replies
 */
-#define MAX_STRING_SVCINFOSTRING 180
-#define MAX_SVCINFOSTRING_LEN ( MAX_STRING_SVCINFOSTRING - 4 )
-static char *SV_ShortInfoString( void )
+static void SV_ShortInfoString( char *string, size_t size, int count, int bots )
 {
-	static char string[MAX_STRING_SVCINFOSTRING];
 	char hostname[64];
 	char entry[20];
 	size_t len;
-	int i, count, bots;
 	const char *password;
 
-	bots = 0;
-	count = 0;
-	for( i = 0; i < sv_maxclients->integer; i++ )
-	{
-		if( svs.clients[i].state >= CS_CONNECTED )
-		{
-			if( svs.clients[i].edict->r.svflags & SVF_FAKECLIENT || svs.clients[i].tvclient )
-				bots++;
-			count++;
-		}
-	}
-
 	//format:
 	//" \377\377\377\377info\\n\\server_name\\m\\map name\\u\\clients/maxclients\\g\\gametype\\s\\skill\\EOT "
 
 	Q_strncpyz( hostname, sv_hostname->string, sizeof( hostname ) );
-	Q_snprintfz( string, sizeof( string ),
+	Q_snprintfz( string, size,
 		"\\\\n\\\\%s\\\\m\\\\%8s\\\\u\\\\%2i/%2i\\\\",
 		hostname,
 		sv.mapname,
@@ -290,7 +313,7 @@ static char *SV_ShortInfoString( void )
 	Q_snprintfz( entry, sizeof( entry ), "g\\\\%6s\\\\", Cvar_String( "g_gametype" ) );
 	if( MAX_SVCINFOSTRING_LEN - len > strlen( entry ) )
 	{
-		Q_strncatz( string, entry, sizeof( string ) );
+		Q_strncatz( string, entry, size );
 		len = strlen( string );
 	}
 
@@ -299,7 +322,7 @@ static char *SV_ShortInfoString( void )
 		Q_snprintfz( entry, sizeof( entry ), "mo\\\\%8s\\\\", FS_GameDirectory() );
 		if( MAX_SVCINFOSTRING_LEN - len > strlen( entry ) )
 		{
-			Q_strncatz( string, entry, sizeof( string ) );
+			Q_strncatz( string, entry, size );
 			len = strlen( string );
 		}
 	}
@@ -309,7 +332,7 @@ static char *SV_ShortInfoString( void )
 		Q_snprintfz( entry, sizeof( entry ), "ig\\\\1\\\\" );
 		if( MAX_SVCINFOSTRING_LEN - len > strlen( entry ) )
 		{
-			Q_strncatz( string, entry, sizeof( string ) );
+			Q_strncatz( string, entry, size );
 			len = strlen( string );
 		}
 	}
@@ -318,7 +341,7 @@ static char *SV_ShortInfoString( void )
 	Q_snprintfz( entry, sizeof( entry ), "s\\\\%1d\\\\", sv_skilllevel->integer );
 	if( MAX_SVCINFOSTRING_LEN - len > strlen( entry ) )
 	{
-		Q_strncatz( string, entry, sizeof( string ) );
+		Q_strncatz( string, entry, size );
 		len = strlen( string );
 	}
 
@@ -328,7 +351,7 @@ static char *SV_ShortInfoString( void )
 		Q_snprintfz( entry, sizeof( entry ), "p\\\\1\\\\" );
 		if( MAX_SVCINFOSTRING_LEN - len > strlen( entry ) )
 		{
-			Q_strncatz( string, entry, sizeof( string ) );
+			Q_strncatz( string, entry, size );
 			len = strlen( string );
 		}
 	}
@@ -338,7 +361,7 @@ static char *SV_ShortInfoString( void )
 		Q_snprintfz( entry, sizeof( entry ), "b\\\\%2i\\\\", bots > 99 ? 99 : bots );
 		if( MAX_SVCINFOSTRING_LEN - len > strlen( entry ) )
 		{
-			Q_strncatz( string, entry, sizeof( string ) );
+			Q_strncatz( string, entry, size );
 			len = strlen( string );
 		}
 	}
@@ -348,7 +371,7 @@ static char *SV_ShortInfoString( void )
 		Q_snprintfz( entry, sizeof( entry ), "mm\\\\1\\\\" );
 		if( MAX_SVCINFOSTRING_LEN - len > strlen( entry ) )
 		{
-			Q_strncatz( string, entry, sizeof( string ) );
+			Q_strncatz( string, entry, size );
 			len = strlen( string );
 		}
 	}
@@ -358,14 +381,106 @@ static char *SV_ShortInfoString( void )
 		Q_snprintfz( entry, sizeof( entry ), "r\\\\1\\\\" );
 		if( MAX_SVCINFOSTRING_LEN - len > strlen( entry ) )
 		{
-			Q_strncatz( string, entry, sizeof( string ) );
+			Q_strncatz( string, entry, size );
 			len = strlen( string );
 		}
 	}
 
 	// finish it
-	Q_strncatz( string, "EOT", sizeof( string ) );
-	return string;
+	Q_strncatz( string, "EOT", size );
+}
+
+/*
+* SV_InvalidateInfoCache
+* Forces the connectionless info replies to be rebuilt on the next query
+*/
+void SV_InvalidateInfoCache( void )
+{
+	sv_infocache.infoEntry.valid = false;
+	sv_infocache.statusEntry.valid = false;
+	sv_infocache.shortinfoEntry.valid = false;
+}
+
+/*
+* SV_CheckInfoCache
+* Drops the cached replies when serverinfo cvars, the map or the client list changed
+*/
+static void SV_CheckInfoCache( void )
+{
+	int i, count, bots;
+	client_t *cl;
+
+	if( serverinfo_modified || sv_infocache.spawncount != svs.spawncount )
+	{
+		serverinfo_modified = false;
+		sv_infocache.spawncount = svs.spawncount;
+		sv_infocache.counted = false;
+		SV_InvalidateInfoCache();
+	}
+
+	// recounting the client list once per frame is enough
+	if( sv_infocache.counted && sv_infocache.checktime == svs.realtime )
+		return;
+	sv_infocache.counted = true;
+	sv_infocache.checktime = svs.realtime;
+
+	bots = 0;
+	count = 0;
+	for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
+	{
+		if( cl->state >= CS_CONNECTED )
+		{
+			if( cl->edict->r.svflags & SVF_FAKECLIENT || cl->tvclient )
+				bots++;
+			count++;
+		}
+	}
+
+	if( count != sv_infocache.clients || bots != sv_infocache.bots )
+	{
+		sv_infocache.clients = count;
+		sv_infocache.bots = bots;
+		SV_InvalidateInfoCache();
+	}
+}
+
+/*
+* SV_CachedInfoEntry
+*/
+static bool SV_CachedInfoEntry( sv_infocache_entry_t *entry )
+{
+	if( entry->valid && svs.realtime - entry->time < SV_INFOCACHE_TIMEOUT )
+		return true;
+
+	entry->valid = true;
+	entry->time = svs.realtime;
+	return false;
+}
+
+/*
+* SV_CachedLongInfoString
+*/
+static const char *SV_CachedLongInfoString( bool fullStatus )
+{
+	sv_infocache_entry_t *entry = fullStatus ? &sv_infocache.statusEntry : &sv_infocache.infoEntry;
+
+	SV_CheckInfoCache();
+	if( !SV_CachedInfoEntry( entry ) )
+		SV_LongInfoString( entry->string, entry->size, sv_infocache.clients, sv_infocache.bots, fullStatus );
+	return entry->string;
+}
+
+/*
+* SV_CachedShortInfoString
+*/
+static const char *SV_CachedShortInfoString( void )
+{
+	sv_infocache_entry_t *entry = &sv_infocache.shortinfoEntry;
+
+	SV_CheckInfoCache();
+	if( !SV_CachedInfoEntry( entry ) )
+		SV_ShortInfoString( entry->string, entry->size, sv_infocache.clients, sv_infocache.bots );
+	return entry->string;
 }
 
 
@@ -404,7 +519,7 @@ static void SVC_Ping( const socket_t *socket, const netadr_t *address )
 static void SVC_InfoResponse( const socket_t *socket, const netadr_t *address )
 {
 	int i, count;
-	char *string;
+	const char *string;
 	bool allow_empty = false, allow_full = false;
 
 	if( sv_showInfoQueries->integer )
@@ -440,14 +555,8 @@ static void SVC_InfoResponse( const socket_t *socket, const netadr_t *address )
 			allow_empty = true;
 	}
 
-	count = 0;
-	for( i = 0; i < sv_maxclients->integer; i++ )
-	{
-		if( svs.clients[i].state >= CS_CONNECTED )
-		{
-			count++;
-		}
-	}
+	string = SV_CachedShortInfoString();
+	count = sv_infocache.clients;
 
 	if( ( count == sv_maxclients->integer ) && !allow_full )
 	{
@@ -459,9 +568,7 @@ static void SVC_InfoResponse( const socket_t *socket, const netadr_t *address )
 		return;
 	}
 
-	string = SV_ShortInfoString();
-	if( string )
-		Netchan_OutOfBandPrint( socket, address, "info\n%s", string );
+	Netchan_OutOfBandPrint( socket, address, "info\n%s", string );
 }
 
 /*
@@ -469,7 +576,7 @@ static void SVC_InfoResponse( const socket_t *socket, const netadr_t *address )
 */
 static void SVC_SendInfoString( const socket_t *socket, const netadr_t *address, const char *requestType, const char *responseType, bool fullStatus )
 {
-	char *string;
+	const char *string;
 
 	if( sv_showInfoQueries->integer )
 		Com_Printf( "%s Packet %s\n", requestType, NET_AddressToString( address ) );
@@ -491,9 +598,8 @@ static void SVC_SendInfoString( const socket_t *socket, const netadr_t *address,
 	//	return;
 
 	// send the same string that we would give for a status OOB command
-	string = SV_LongInfoString( fullStatus );
-	if( string )
-		Netchan_OutOfBandPrint( socket, address, "%s\n\\challenge\\%s%s", responseType, Cmd_Argv( 1 ), string );
+	string = SV_CachedLongInfoString( fullStatus );
+	Netchan_OutOfBandPrint( socket, address, "%s\n\\challenge\\%s%s", responseType, Cmd_Argv( 1 ), string );
 }
 
 /*
@@ -513,6 +619,127 @@ static void SVC_GetStatusResponse( const socket_t *socket, const netadr_t *addre
 }
 
 
+/*
+* SV_RotateChallengeSecrets
+* 
+* The next secret is hashed from the previous one and whatever
+* timing noise is at hand, so it can't be derived from the challenges.
+*/
+static void SV_RotateChallengeSecrets( void )
+{
+	challenge_secrets_t *chs = &svs.challenges;
+	md5_state_t state;
+	md5_byte_t digest[16];
+	unsigned int now, elapsed;
+	int rotations;
+	struct
+	{
+		int64_t millis;
+		uint64_t micros;
+		time_t now;
+		int rnd;
+		unsigned int realtime;
+		const void *ptr;
+	} noise;
+
+	now = Sys_Milliseconds();
+
+	if( chs->seeded )
+	{
+		elapsed = now - chs->rotatetime;
+		if( elapsed < CHALLENGE_ROTATE_TIME )
+			return;
+		// challenges from more than one rotation ago must not survive idle periods
+		rotations = elapsed < CHALLENGE_ROTATE_TIME * 2 ? 1 : 2;
+	}
+	else
+	{
+		chs->seeded = true;
+		rotations = 2;
+	}
+
+	chs->rotatetime = now;
+	while( rotations-- > 0 )
+	{
+		memcpy( chs->secrets[1], chs->secrets[0], sizeof( chs->secrets[0] ) );
+
+		noise.millis = Sys_Milliseconds();
+		noise.micros = Sys_Microseconds();
+		noise.now = time( NULL );
+		noise.rnd = rand();
+		noise.realtime = svs.realtime;
+		noise.ptr = &noise;
+
+		md5_init( &state );
+		md5_append( &state, chs->secrets[1], sizeof( chs->secrets[1] ) );
+		md5_append( &state, (const md5_byte_t *)&noise, sizeof( noise ) );
+		md5_finish( &state, digest );
+		memcpy( chs->secrets[0], digest, min( sizeof( digest ), sizeof( chs->secrets[0] ) ) );
+	}
+}
+
+/*
+* SV_ChallengeForAddress
+* 
+* HMAC-MD5 of the base address (no port) keyed with one of the challenge secrets
+*/
+static int SV_ChallengeForAddress( const netadr_t *address, const uint8_t *secret )
+{
+	md5_state_t state;
+	md5_byte_t digest[16];
+	md5_byte_t pad[64];
+	uint8_t msg[1 + sizeof( address->address.ipv6.ip )];
+	size_t msglen, i;
+	int challenge;
+
+	msg[0] = address->type;
+	msglen = 1;
+	if( address->type == NA_IP )
+	{
+		memcpy( msg + msglen, address->address.ipv4.ip, sizeof( address->address.ipv4.ip ) );
+		msglen += sizeof( address->address.ipv4.ip );
+	}
+	else if( address->type == NA_IP6 )
+	{
+		memcpy( msg + msglen, address->address.ipv6.ip, sizeof( address->address.ipv6.ip ) );
+		msglen += sizeof( address->address.ipv6.ip );
+	}
+
+	memset( pad, 0x36, sizeof( pad ) );
+	for( i = 0; i < CHALLENGE_SECRET_SIZE; i++ )
+		pad[i] ^= secret[i];
+	md5_init( &state );
+	md5_append( &state, pad, sizeof( pad ) );
+	md5_append( &state, msg, msglen );
+	md5_finish( &state, digest );
+
+	memset( pad, 0x5c, sizeof( pad ) );
+	for( i = 0; i < CHALLENGE_SECRET_SIZE; i++ )
+		pad[i] ^= secret[i];
+	md5_init( &state );
+	md5_append( &state, pad, sizeof( pad ) );
+	md5_append( &state, digest, sizeof( digest ) );
+	md5_finish( &state, digest );
+
+	// clients parse it with atoi, and 0 means no challenge
+	challenge = md5_reduce( digest ) & 0x7fffffff;
+	return challenge ? challenge : 1;
+}
+
+/*
+* SV_ValidateChallenge
+*/
+static bool SV_ValidateChallenge( const netadr_t *address, int challenge )
+{
+	SV_RotateChallengeSecrets();
+
+	if( challenge == SV_ChallengeForAddress( address, svs.challenges.secrets[0] ) )
+		return true;
+	if( challenge == SV_ChallengeForAddress( address, svs.challenges.secrets[1] ) )
+		return true;
+	return false;
+}
+
 /*
 * SVC_GetChallenge
 * 
@@ -524,38 +751,12 @@ static void SVC_GetStatusResponse( const socket_t *socket, const netadr_t *addre
 */
 static void SVC_GetChallenge( const socket_t *socket, const netadr_t *address )
 {
-	int i;
-	int oldest;
-	int oldestTime;
-
-	oldest = 0;
-	oldestTime = 0x7fffffff;
-
 	if( sv_showChallenge->integer )
 		Com_Printf( "Challenge Packet %s\n", NET_AddressToString( address ) );
 
-	// see if we already have a challenge for this ip
-	for( i = 0; i < MAX_CHALLENGES; i++ )
-	{
-		if( NET_CompareBaseAddress( address, &svs.challenges[i].adr ) )
-			break;
-		if( svs.challenges[i].time < oldestTime )
-		{
-			oldestTime = svs.challenges[i].time;
-			oldest = i;
-		}
-	}
-
-	if( i == MAX_CHALLENGES )
-	{
-		// overwrite the oldest
-		svs.challenges[oldest].challenge = rand() & 0x7fff;
-		svs.challenges[oldest].adr = *address;
-		svs.challenges[oldest].time = Sys_Milliseconds();
-		i = oldest;
-	}
+	SV_RotateChallengeSecrets();
 
-	Netchan_OutOfBandPrint( socket, address, "challenge %i", svs.challenges[i].challenge );
+	Netchan_OutOfBandPrint( socket, address, "challenge %i", SV_ChallengeForAddress( address, svs.challenges.secrets[0] ) );
 }
 
 
@@ -576,6 +777,9 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 	char *session_id_str;
 	unsigned int ticket_id;
 	bool tv_client;
+	int compression, peerCompression;
+	int peerSnapEncoding;
+	char *compression_str, *encoding_str;
 
 	Com_DPrintf( "SVC_DirectConnect (%s)\n", Cmd_Args() );
 
@@ -609,6 +813,16 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 
 	Q_strncpyz( userinfo, Cmd_Argv( 4 ), sizeof( userinfo ) );
 
+	// compression methods the client can decode, this is for the netchan, not for the game
+	compression_str = Info_ValueForKey( userinfo, NETCHAN_COMPRESSION_KEY );
+	peerCompression = compression_str ? atoi( compression_str ) : 0;
+	Info_RemoveKey( userinfo, NETCHAN_COMPRESSION_KEY );
+
+	// newest snapshot encoding the client can parse, old clients don't send it
+	encoding_str = Info_ValueForKey( userinfo, SNAP_ENCODING_KEY );
+	peerSnapEncoding = encoding_str ? atoi( encoding_str ) : SNAP_ENCODING_LEGACY;
+	Info_RemoveKey( userinfo, SNAP_ENCODING_KEY );
+
 	// force the IP key/value pair so the game can filter based on ip
 	if( !Info_SetValueForKey( userinfo, "socket", NET_SocketTypeToString( socket->type ) ) )
 	{
@@ -664,25 +878,9 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 #endif
 
 	// see if the challenge is valid
-	for( i = 0; i < MAX_CHALLENGES; i++ )
-	{
-		if( NET_CompareBaseAddress( address, &svs.challenges[i].adr ) )
-		{
-			if( challenge == svs.challenges[i].challenge )
-			{
-				svs.challenges[i].challenge = 0; // wsw : r1q2 : reset challenge
-				svs.challenges[i].time = 0;
-				NET_InitAddress( &svs.challenges[i].adr, NA_NOTRANSMIT );
-				break; // good
-			}
-			Netchan_OutOfBandPrint( socket, address, "reject\n%i\n%i\nBad challenge\n",
-				DROP_TYPE_GENERAL, DROP_FLAG_AUTORECONNECT );
-			return;
-		}
-	}
-	if( i == MAX_CHALLENGES )
+	if( !SV_ValidateChallenge( address, challenge ) )
 	{
-		Netchan_OutOfBandPrint( socket, address, "reject\n%i\n%i\nNo challenge for address\n",
+		Netchan_OutOfBandPrint( socket, address, "reject\n%i\n%i\nBad challenge\n",
 			DROP_TYPE_GENERAL, DROP_FLAG_AUTORECONNECT );
 		return;
 	}
@@ -786,8 +984,21 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 		return;
 	}
 
-	// send the connect packet to the client
-	Netchan_OutOfBandPrint( socket, address, "client_connect\n%s", newcl->session );
+	// frames are flagged with their encoding, so the client needs no reply for this
+	newcl->snapEncoding = SNAP_NegotiateEncoding( peerSnapEncoding, sv_snapencoding->integer );
+
+	// send the connect packet to the client, along with the compression method
+	// if it told us which ones it supports
+	if( peerCompression )
+	{
+		compression = Netchan_NegotiateCompression( peerCompression, sv_compressmethod->integer );
+		newcl->netchan.compression = compression;
+		Netchan_OutOfBandPrint( socket, address, "client_connect\n%s\n%i", newcl->session, compression );
+	}
+	else
+	{
+		Netchan_OutOfBandPrint( socket, address, "client_connect\n%s", newcl->session );
+	}
 
 	// free the incoming entry
 #ifdef TCP_ALLOW_CONNECT
@@ -942,6 +1153,78 @@ connectionless_cmd_t connectionless_cmds[] =
 	{ NULL, NULL }
 };
 
+/*
+* SV_CheckConnectionlessRateLimit
+* 
+* Token bucket per source address, refilled at sv_oob_ratelimit packets
+* per second up to sv_oob_ratelimit_burst. Addresses hashing to the same
+* slot evict each other, which only ever lets more packets through.
+*/
+static bool SV_CheckConnectionlessRateLimit( const netadr_t *address )
+{
+	sv_oob_ratelimit_t *limit;
+	uint8_t ip[8];
+	unsigned int hash, elapsed, maxtokens;
+	size_t i;
+
+	if( sv_oob_ratelimit->integer <= 0 )
+		return true;
+
+	switch( address->type )
+	{
+	case NA_IP:
+		memset( ip, 0, sizeof( ip ) );
+		memcpy( ip, address->address.ipv4.ip, sizeof( address->address.ipv4.ip ) );
+		break;
+	case NA_IP6:
+		// a single host usually owns the whole /64
+		memcpy( ip, address->address.ipv6.ip, sizeof( ip ) );
+		break;
+	default:
+		return true;
+	}
+
+	if( NET_IsLocalAddress( address ) )
+		return true;
+
+	hash = address->type;
+	for( i = 0; i < sizeof( ip ); i++ )
+		hash = hash * 31 + ip[i];
+	limit = &sv_oob_ratelimits[hash & ( SV_OOB_RATELIMIT_HASH_SIZE - 1 )];
+
+	maxtokens = (unsigned int)max( sv_oob_ratelimit_burst->integer, 1 ) * 1000;
+
+	if( limit->type != address->type || memcmp( limit->ip, ip, sizeof( ip ) ) )
+	{
+		limit->type = address->type;
+		memcpy( limit->ip, ip, sizeof( ip ) );
+		limit->time = svs.realtime;
+		limit->tokens = maxtokens;
+		limit->limited = false;
+	}
+	else
+	{
+		elapsed = svs.realtime - limit->time;
+		limit->time = svs.realtime;
+		if( elapsed >= maxtokens / sv_oob_ratelimit->integer )
+			limit->tokens = maxtokens;
+		else
+			limit->tokens = min( limit->tokens + elapsed * sv_oob_ratelimit->integer, maxtokens );
+	}
+
+	if( limit->tokens < 1000 )
+	{
+		if( !limit->limited )
+			Com_DPrintf( "Rate limiting connectionless packets from %s\n", NET_AddressToString( address ) );
+		limit->limited = true;
+		return false;
+	}
+
+	limit->tokens -= 1000;
+	limit->limited = false;
+	return true;
+}
+
 /*
 * SV_ConnectionlessPacket
 * 
@@ -955,6 +1238,9 @@ void SV_ConnectionlessPacket( const socket_t *socket, const netadr_t *address, m
 	connectionless_cmd_t *cmd;
 	char *s, *c;
 
+	if( !SV_CheckConnectionlessRateLimit( address ) )
+		return;
+
 	MSG_BeginReading( msg );
 	MSG_ReadLong( msg );    // skip the -1 marker
 
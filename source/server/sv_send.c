@@ -252,6 +252,20 @@ void SV_BroadcastCommand( const char *format, ... )
 //
 //===============================================================================
 
+#define SV_MAX_SEND_ERROR	128
+
+static bool sv_fragmentFailed[MAX_CLIENTS];
+static char sv_fragmentError[MAX_CLIENTS][SV_MAX_SEND_ERROR];
+
+/*
+* SV_FragmentPacketFailed
+*/
+static void SV_FragmentPacketFailed( netbatch_t *batch, int clientNum )
+{
+	sv_fragmentFailed[clientNum] = true;
+	Q_strncpyz( sv_fragmentError[clientNum], NET_ErrorString(), sizeof( sv_fragmentError[clientNum] ) );
+}
+
 /*
 * SV_SendClientsFragments
 */
@@ -260,10 +274,16 @@ bool SV_SendClientsFragments( void )
 	client_t *client;
 	int i;
 	bool sent = false;
+	static netbatch_t batch;
+
+	batch.onfail = SV_FragmentPacketFailed;
+	memset( sv_fragmentFailed, 0, sizeof( sv_fragmentFailed[0] ) * sv_maxclients->integer );
 
 	// send a message to each connected client
 	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
 	{
+		bool transmitted;
+
 		if( client->state == CS_FREE || client->state == CS_ZOMBIE )
 			continue;
 		if( client->edict && ( client->edict->r.svflags & SVF_FAKECLIENT ) )
@@ -271,18 +291,34 @@ bool SV_SendClientsFragments( void )
 		if( !client->netchan.unsentFragments )
 			continue;
 
-		if( !Netchan_TransmitNextFragment( &client->netchan ) )
+		batch.tag = i;
+		client->netchan.batch = &batch;
+		transmitted = Netchan_TransmitNextFragment( &client->netchan );
+		client->netchan.batch = NULL;
+
+		if( !transmitted )
 		{
-			Com_Printf( "Error sending fragment to %s: %s\n", NET_AddressToString( &client->netchan.remoteAddress ),
-				NET_ErrorString() );
-			if( client->reliable )
-				SV_DropClient( client, DROP_TYPE_GENERAL, "Error sending fragment: %s\n", NET_ErrorString() );
+			SV_FragmentPacketFailed( &batch, i );
 			continue;
 		}
 
 		sent = true;
 	}
 
+	NET_FlushBatch( &batch );
+
+	// queued fragments may fail as late as the flush, so errors are handled last
+	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
+	{
+		if( !sv_fragmentFailed[i] )
+			continue;
+
+		Com_Printf( "Error sending fragment to %s: %s\n", NET_AddressToString( &client->netchan.remoteAddress ),
+			sv_fragmentError[i] );
+		if( client->reliable )
+			SV_DropClient( client, DROP_TYPE_GENERAL, "Error sending fragment: %s\n", sv_fragmentError[i] );
+	}
+
 	return sent;
 }
 
@@ -299,7 +335,7 @@ bool SV_Netchan_Transmit( netchan_t *netchan, msg_t *msg )
 
 	if( sv_compresspackets->integer )
 	{
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( msg, netchan->compression );
 		if( zerror < 0 )
 		{          // it's compression error, just send uncompressed
 			Com_DPrintf( "SV_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
@@ -369,14 +405,16 @@ void SV_ResetClientFrameCounters( void )
 */
 void SV_WriteFrameSnapToClient( client_t *client, msg_t *msg )
 {
+	// the demo client can build frames outside of SV_SendClientMessages,
+	// after the entities have changed, so it can't share encoded deltas
 	SNAP_WriteFrameSnapToClient( &sv.gi, client, msg, sv.framenum, svs.gametime, sv.baselines,
-		&svs.client_entities, 0, NULL, NULL );
+		&svs.client_entities, client == &svs.demo.client ? NULL : svs.deltacache, 0, NULL, NULL );
 }
 
 /*
 * SV_BuildClientFrameSnap
 */
-void SV_BuildClientFrameSnap( client_t *client )
+void SV_BuildClientFrameSnap( client_t *client, fatvis_t *fatvis )
 {
 	vec_t *skyorg = NULL, origin[3];
 
@@ -392,33 +430,262 @@ void SV_BuildClientFrameSnap( client_t *client )
 		}
 	}
 
-	svs.fatvis.skyorg = skyorg;		// HACK HACK HACK
+	fatvis->skyorg = skyorg;		// HACK HACK HACK
 	SNAP_BuildClientFrameSnap( svs.cms, &sv.gi, sv.framenum, svs.gametime,
-		&svs.fatvis, client, ge->GetGameState(), 
+		fatvis, svs.viscache, client, ge->GetGameState(), 
 		&svs.client_entities,
 		false, sv_mempool );
-	svs.fatvis.skyorg = NULL;
+	fatvis->skyorg = NULL;
 }
 
 /*
 * SV_SendClientDatagram
 */
-static bool SV_SendClientDatagram( client_t *client )
+static bool SV_SendClientDatagram( client_t *client, msg_t *msg, fatvis_t *fatvis )
 {
 	if( client->edict && ( client->edict->r.svflags & SVF_FAKECLIENT ) )
 		return true;
 
-	SV_InitClientMessage( client, &tmpMessage, NULL, 0 );
+	SV_InitClientMessage( client, msg, NULL, 0 );
 
-	SV_AddReliableCommandsToMessage( client, &tmpMessage );
+	SV_AddReliableCommandsToMessage( client, msg );
 
 	// send over all the relevant entity_state_t
 	// and the player_state_t
-	SV_BuildClientFrameSnap( client );
+	SV_BuildClientFrameSnap( client, fatvis );
 
-	SV_WriteFrameSnapToClient( client, &tmpMessage );
+	SV_WriteFrameSnapToClient( client, msg );
 
-	return SV_SendMessageToClient( client, &tmpMessage );
+	return SV_SendMessageToClient( client, msg );
+}
+
+//===============================================================================
+//
+//SNAPSHOT WORKERS
+//
+//===============================================================================
+
+// Snapshots for spawned clients can be built, delta encoded and transmitted
+// in parallel. Each worker owns a message buffer and a fat PVS, the game
+// state and the edicts are only read while the workers are running.
+
+#define SV_MAX_SNAP_THREADS	16
+
+typedef struct
+{
+	qthread_t *thread;
+	msg_t msg;
+	uint8_t msgData[MAX_MSGLEN];
+	fatvis_t fatvis;
+	netbatch_t batch;
+} sv_snapworker_t;
+
+typedef struct
+{
+	int numThreads;
+	sv_snapworker_t *workers;			// [numThreads], the main thread uses svs.fatvis and tmpMessage
+	netbatch_t batch;					// datagrams queued by the main thread
+
+	qmutex_t *mutex;
+	qcondvar_t *startCond;
+	qcondvar_t *doneCond;
+	unsigned int jobSequence;			// incremented for every batch of snapshots
+	int busyThreads;
+	bool terminate;
+
+	int numJobClients;
+	int jobClients[MAX_CLIENTS];		// indices into svs.clients
+	bool jobFailed[MAX_CLIENTS];
+	char jobError[MAX_CLIENTS][SV_MAX_SEND_ERROR];	// the error string is per thread, copied for the main thread
+	volatile int nextJob;
+} sv_snapworkers_t;
+
+static sv_snapworkers_t sv_snapworkers;
+
+/*
+* SV_SnapWorkers_JobFailed
+*
+* Called on the thread that failed to send, for the error string is per thread
+*/
+static void SV_SnapWorkers_JobFailed( netbatch_t *batch, int job )
+{
+	sv_snapworkers_t *pool = &sv_snapworkers;
+
+	pool->jobFailed[job] = true;
+	Q_strncpyz( pool->jobError[job], NET_ErrorString(), sizeof( pool->jobError[job] ) );
+}
+
+/*
+* SV_SnapWorkers_RunJobs
+*
+* Pulls clients off the shared job list until it's exhausted. UDP datagrams
+* are queued and sent in batches, the batch reports the ones that failed
+* by their job index.
+*/
+static void SV_SnapWorkers_RunJobs( msg_t *msg, fatvis_t *fatvis, netbatch_t *batch )
+{
+	int job;
+	client_t *client;
+	sv_snapworkers_t *pool = &sv_snapworkers;
+
+	batch->onfail = SV_SnapWorkers_JobFailed;
+
+	while( ( job = QAtomic_Add( &pool->nextJob, 1, pool->mutex ) - 1 ) < pool->numJobClients )
+	{
+		client = svs.clients + pool->jobClients[job];
+		batch->tag = job;
+		client->netchan.batch = batch;
+		if( !SV_SendClientDatagram( client, msg, fatvis ) )
+			SV_SnapWorkers_JobFailed( batch, job );
+		client->netchan.batch = NULL;
+	}
+
+	NET_FlushBatch( batch );
+}
+
+/*
+* SV_SnapWorker_Thread
+*/
+static void *SV_SnapWorker_Thread( void *param )
+{
+	sv_snapworker_t *worker = ( sv_snapworker_t * )param;
+	sv_snapworkers_t *pool = &sv_snapworkers;
+	unsigned int sequence = 0;
+
+	QMutex_Lock( pool->mutex );
+	while( true )
+	{
+		while( !pool->terminate && pool->jobSequence == sequence )
+			QCondVar_Wait( pool->startCond, pool->mutex, Q_THREADS_WAIT_INFINITE );
+		if( pool->terminate )
+			break;
+		sequence = pool->jobSequence;
+		QMutex_Unlock( pool->mutex );
+
+		SV_SnapWorkers_RunJobs( &worker->msg, &worker->fatvis, &worker->batch );
+
+		QMutex_Lock( pool->mutex );
+		if( --pool->busyThreads == 0 )
+			QCondVar_Wake( pool->doneCond );
+	}
+	QMutex_Unlock( pool->mutex );
+
+	return NULL;
+}
+
+/*
+* SV_InitSnapWorkers
+*/
+static void SV_InitSnapWorkers( int numThreads )
+{
+	int i;
+	sv_snapworker_t *worker;
+	sv_snapworkers_t *pool = &sv_snapworkers;
+
+	if( numThreads <= 0 )
+		return;
+
+	pool->mutex = QMutex_Create();
+	pool->startCond = QCondVar_Create();
+	pool->doneCond = QCondVar_Create();
+	pool->jobSequence = 0;
+	pool->terminate = false;
+
+	pool->workers = Mem_Alloc( sv_mempool, sizeof( *pool->workers ) * numThreads );
+	for( i = 0, worker = pool->workers; i < numThreads; i++, worker++ )
+	{
+		MSG_Init( &worker->msg, worker->msgData, sizeof( worker->msgData ) );
+		worker->thread = QThread_Create( SV_SnapWorker_Thread, worker );
+	}
+	pool->numThreads = numThreads;
+
+	Com_Printf( "Started %i snapshot worker threads\n", numThreads );
+}
+
+/*
+* SV_ShutdownSnapWorkers
+*/
+void SV_ShutdownSnapWorkers( void )
+{
+	int i;
+	sv_snapworkers_t *pool = &sv_snapworkers;
+
+	if( !pool->numThreads )
+		return;
+
+	QMutex_Lock( pool->mutex );
+	pool->terminate = true;
+	QCondVar_Wake( pool->startCond );
+	QMutex_Unlock( pool->mutex );
+
+	for( i = 0; i < pool->numThreads; i++ )
+		QThread_Join( pool->workers[i].thread );
+
+	Mem_Free( pool->workers );
+	QCondVar_Destroy( &pool->startCond );
+	QCondVar_Destroy( &pool->doneCond );
+	QMutex_Destroy( &pool->mutex );
+
+	memset( pool, 0, sizeof( *pool ) );
+}
+
+/*
+* SV_SendClientDatagrams
+*
+* Sends snapshots to all clients in the job list, in parallel if
+* snapshot worker threads are enabled. Errors are reported back
+* on the main thread, as dropping a client touches the game module.
+*/
+static void SV_SendClientDatagrams( void )
+{
+	int i, numThreads;
+	client_t *client;
+	sv_snapworkers_t *pool = &sv_snapworkers;
+
+	numThreads = sv_snapthreads->integer;
+	clamp( numThreads, 0, SV_MAX_SNAP_THREADS );
+	if( pool->numThreads != numThreads )
+	{
+		SV_ShutdownSnapWorkers();
+		SV_InitSnapWorkers( numThreads );
+	}
+
+	pool->nextJob = 0;
+	memset( pool->jobFailed, 0, sizeof( pool->jobFailed[0] ) * pool->numJobClients );
+
+	if( pool->numThreads && pool->numJobClients > 1 )
+	{
+		QMutex_Lock( pool->mutex );
+		pool->busyThreads = pool->numThreads;
+		pool->jobSequence++;
+		QCondVar_Wake( pool->startCond );
+		QMutex_Unlock( pool->mutex );
+
+		// the main thread joins the workers
+		SV_SnapWorkers_RunJobs( &tmpMessage, &svs.fatvis, &pool->batch );
+
+		QMutex_Lock( pool->mutex );
+		while( pool->busyThreads > 0 )
+			QCondVar_Wait( pool->doneCond, pool->mutex, Q_THREADS_WAIT_INFINITE );
+		QMutex_Unlock( pool->mutex );
+	}
+	else
+	{
+		SV_SnapWorkers_RunJobs( &tmpMessage, &svs.fatvis, &pool->batch );
+	}
+
+	for( i = 0; i < pool->numJobClients; i++ )
+	{
+		if( !pool->jobFailed[i] )
+			continue;
+
+		client = svs.clients + pool->jobClients[i];
+		Com_Printf( "Error sending message to %s: %s\n", client->name, pool->jobError[i] );
+		if( client->reliable )
+		{
+			SV_DropClient( client, DROP_TYPE_GENERAL, "Error sending message: %s\n", pool->jobError[i] );
+		}
+	}
 }
 
 /*
@@ -428,6 +695,16 @@ void SV_SendClientMessages( void )
 {
 	int i;
 	client_t *client;
+	sv_snapworkers_t *pool = &sv_snapworkers;
+
+	pool->numJobClients = 0;
+
+	// the snapshot workers must not write to the edicts
+	SNAP_FixEntityNumbers( &sv.gi );
+
+	// encoded entity deltas are shared by all the snapshots of this frame
+	SNAP_BeginDeltaCacheFrame( svs.deltacache );
+	SNAP_BeginVisCacheFrame( svs.viscache, svs.cms, &sv.gi );
 
 	// send a message to each connected client
 	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ )
@@ -445,14 +722,8 @@ void SV_SendClientMessages( void )
 
 		if( client->state == CS_SPAWNED )
 		{
-			if( !SV_SendClientDatagram( client ) )
-			{
-				Com_Printf( "Error sending message to %s: %s\n", client->name, NET_ErrorString() );
-				if( client->reliable )
-				{
-					SV_DropClient( client, DROP_TYPE_GENERAL, "Error sending message: %s\n", NET_ErrorString() );
-				}
-			}
+			// snapshots are sent in a batch below
+			pool->jobClients[pool->numJobClients++] = i;
 		}
 		else
 		{
@@ -473,4 +744,6 @@ void SV_SendClientMessages( void )
 			}
 		}
 	}
+
+	SV_SendClientDatagrams();
 }
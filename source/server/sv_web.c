@@ -32,6 +32,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define INCOMING_HTTP_CONNECTION_RECV_TIMEOUT	5 // seconds
 #define INCOMING_HTTP_CONNECTION_SEND_TIMEOUT	15 // seconds
 
+#define HTTP_SEND_THREAD_MAX_SEND_PER_PASS		0x10000 // bytes per connection before the lock is released
+
 typedef enum
 {
 	HTTP_CONN_STATE_NONE = 0,
@@ -72,7 +74,8 @@ typedef struct {
 	netadr_t realAddr;
 
 	bool partial;
-	sv_http_content_range_t partial_content_range;
+	sv_http_content_range_t partial_content_range;	// begin < 0 for the last N bytes, end < 0 for up to the end
+	time_t if_modified_since;
 
 	bool got_start_line;
 	bool close_after_resp;
@@ -86,6 +89,11 @@ typedef struct {
 	size_t file_send_pos;
 	size_t file_chunk_size;
 	char *filename;
+	time_t file_mtime;
+
+	// base files are sent straight from the memory mapping if possible
+	void *file_mapping;
+	size_t file_mapping_size;
 } sv_http_response_t;
 
 typedef struct sv_http_connection_s
@@ -104,6 +112,8 @@ typedef struct sv_http_connection_s
 
 	bool is_upstream;
 
+	unsigned int send_pass;         // last send thread pass that served this connection
+
 	struct sv_http_connection_s *next, *prev;
 } sv_http_connection_t;
 
@@ -114,9 +124,21 @@ static sv_http_connection_t sv_http_connection_headnode, *sv_free_http_connectio
 static socket_t sv_socket_http;
 static socket_t sv_socket_http6;
 
+static netpoll_t *sv_http_poll;
+
+// with sv_http_threaded, responses are sent from a separate thread and
+// the main thread only accepts connections, parses requests and routes them
+static qthread_t *sv_http_sendthread;
+static qmutex_t *sv_http_mutex;
+static qcondvar_t *sv_http_sendcond;
+static volatile bool sv_http_sendthread_terminate;
+
 static netadr_t sv_web_upstream_addr;
 static bool sv_web_upstream_is_set;
 
+static const char * const sv_http_weekdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static const char * const sv_http_months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
 // ============================================================================
 
 /*
@@ -170,12 +192,30 @@ static void SV_Web_ResetRequest( sv_http_request_t *request )
 	NET_InitAddress( &request->realAddr, NA_NOTRANSMIT );
 
 	request->partial = false;
+	request->partial_content_range.begin = request->partial_content_range.end = 0;
+	request->if_modified_since = 0;
 	request->close_after_resp = false;
 	request->got_start_line = false;
 	request->error = HTTP_RESP_NONE;
 	request->clientNum = -1;
 }
 
+/*
+* SV_Web_CloseResponseFile
+*/
+static void SV_Web_CloseResponseFile( sv_http_response_t *response )
+{
+	if( response->file ) {
+		FS_FCloseFile( response->file );
+		response->file = 0;
+	}
+	if( response->file_mapping ) {
+		FS_UnMMapBaseFile( response->file_mapping, response->file_mapping_size );
+		response->file_mapping = NULL;
+		response->file_mapping_size = 0;
+	}
+}
+
 /*
 * SV_Web_ResetResponse
 */
@@ -185,12 +225,10 @@ static void SV_Web_ResetResponse( sv_http_response_t *response )
 		Mem_Free( response->filename );
 		response->filename = NULL;
 	}
-	if( response->file ) {
-		FS_FCloseFile( response->file );
-		response->file = 0;
-	}
+	SV_Web_CloseResponseFile( response );
 	response->file_send_pos = 0;
 	response->file_chunk_size = 0;
+	response->file_mtime = 0;
 
 	SV_Web_ResetStream( &response->stream );
 
@@ -223,6 +261,7 @@ static sv_http_connection_t *SV_Web_AllocConnection( void )
 	con->state = HTTP_CONN_STATE_NONE;
 	con->close_after_resp = false;
 	con->is_upstream = false;
+	con->send_pass = 0;
 	return con;
 }
 
@@ -263,6 +302,18 @@ static void SV_Web_InitConnections( void )
 	}
 }
 
+/*
+* SV_Web_CloseConnection
+*/
+static void SV_Web_CloseConnection( sv_http_connection_t *con )
+{
+	if( sv_http_poll ) {
+		NET_PollRemoveSocket( sv_http_poll, &con->socket );
+	}
+	NET_CloseSocket( &con->socket );
+	SV_Web_FreeConnection( con );
+}
+
 /*
 * SV_Web_ShutdownConnections
 */
@@ -276,8 +327,7 @@ static void SV_Web_ShutdownConnections( void )
 	{
 		next = con->prev;
 		if( con->open ) {
-			NET_CloseSocket( &con->socket );
-			SV_Web_FreeConnection( con );
+			SV_Web_CloseConnection( con );
 		}
 	}
 }
@@ -408,6 +458,71 @@ static void SV_Web_ParseStartLine( sv_http_request_t *request, char *line )
 	}
 }
 
+/*
+* SV_Web_ParseDate
+*
+* Parses RFC 1123 date, the only format HTTP/1.1 clients are supposed to generate.
+* Returns 0 on failure.
+*/
+static time_t SV_Web_ParseDate( const char *value )
+{
+	int i;
+	int day, year, hour, min, sec;
+	int month, era, yoe, doy, doe;
+	char monthstr[4];
+	const char *comma;
+
+	// Sun, 06 Nov 1994 08:49:37 GMT
+	comma = strchr( value, ',' );
+	if( !comma ) {
+		return 0;
+	}
+	if( sscanf( comma + 1, " %d %3s %d %d:%d:%d GMT", &day, monthstr, &year, &hour, &min, &sec ) != 6 ) {
+		return 0;
+	}
+
+	month = -1;
+	for( i = 0; i < 12; i++ ) {
+		if( !Q_stricmp( monthstr, sv_http_months[i] ) ) {
+			month = i + 1;
+			break;
+		}
+	}
+	if( month < 0 || year < 1970 || day < 1 || day > 31 ) {
+		return 0;
+	}
+
+	// days since the epoch from a proleptic gregorian date
+	if( month <= 2 ) {
+		year--;
+	}
+	era = year / 400;
+	yoe = year - era * 400;
+	doy = ( 153 * ( month + ( month > 2 ? -3 : 9 ) ) + 2 ) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return ( time_t )( era * 146097 + doe - 719468 ) * 86400 + hour * 3600 + min * 60 + sec;
+}
+
+/*
+* SV_Web_FormatDate
+*/
+static const char *SV_Web_FormatDate( time_t t )
+{
+	static char date[64];
+	const struct tm *tm;
+
+	tm = gmtime( &t );
+	if( !tm ) {
+		return "";
+	}
+
+	Q_snprintfz( date, sizeof( date ), "%s, %02i %s %04i %02i:%02i:%02i GMT", 
+		sv_http_weekdays[tm->tm_wday], tm->tm_mday, sv_http_months[tm->tm_mon], tm->tm_year + 1900, 
+		tm->tm_hour, tm->tm_min, tm->tm_sec );
+	return date;
+}
+
 /*
 * SV_Web_AnalyzeHeader
 */
@@ -436,54 +551,56 @@ static void SV_Web_AnalyzeHeader( sv_http_request_t *request, const char *key, c
 	}
 	else if( !Q_stricmp( key, "Range" ) 
 		&& ( request->method == HTTP_METHOD_GET || request->method == HTTP_METHOD_HEAD ) ) {
-		const char *delim = strchr( value, '-' );
+		char *p;
+		long begin = -1, end = -1;
 
-		if( Q_strnicmp( value, "bytes=", 6 ) || !delim ) {
+		if( Q_strnicmp( value, "bytes=", 6 ) || !strchr( value, '-' ) ) {
 			request->error = HTTP_RESP_BAD_REQUEST;
+			return;
+		}
+		if( strchr( value, ',' ) ) {
+			// multiple ranges aren't supported, serve the whole thing instead
+			return;
 		}
-		else {
-			bool neg_end = false;
-			const char *p = value;
-
-			// first byte pos
-			while( *p && p < delim ) {
-				if( *p >= '0' && *p <= '9' )
-					stream->content_range.begin = stream->content_range.begin*10 + *p - '0';
-				p++;
-			}
-			p++;
-
-			// last byte pos
-			if( *p == '-' ) {
-				if( value != delim ) {
-					request->error = HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE;
-					return;
-				}
-				neg_end = true;
-				p++;
-			}
-			while( *p ) {
-				if( *p >= '0' && *p <= '9' )
-				stream->content_range.end = stream->content_range.end*10 + *p++ - '0';
-			}
 
-			// partial content request
-			if( neg_end && stream->content_range.end ) {
-				// bytes=-100
-				request->partial = true;
-				stream->content_range.end = -stream->content_range.end;
-			} else if( stream->content_range.end >= stream->content_range.begin ) {
-				// bytes=200-300
-				request->partial = true;
-			} else if( stream->content_range.begin >= 0 && *(delim+1) == '\0' ) {
-				// bytes=200-
-				request->partial = true;
-			}
+		p = ( char * )value + 6;
+		while( *p == ' ' ) {
+			p++;
+		}
+		if( *p >= '0' && *p <= '9' ) {
+			begin = strtol( p, &p, 10 );
+		}
+		while( *p == ' ' ) {
+			p++;
+		}
+		if( *p++ != '-' ) {
+			request->error = HTTP_RESP_BAD_REQUEST;
+			return;
+		}
+		while( *p == ' ' ) {
+			p++;
+		}
+		if( *p >= '0' && *p <= '9' ) {
+			end = strtol( p, &p, 10 );
+		}
 
-			if( request->partial ) {
-				request->partial_content_range = stream->content_range;
-			}
+		if( begin < 0 && end <= 0 ) {
+			// bytes=- or bytes=-0
+			request->error = HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE;
+		}
+		else if( begin >= 0 && end >= 0 && end < begin ) {
+			// syntactically invalid, ignore it
 		}
+		else {
+			// bytes=200-300, bytes=200- or bytes=-100 for the last 100 bytes
+			request->partial = true;
+			request->partial_content_range.begin = begin;
+			request->partial_content_range.end = end;
+		}
+	}
+	else if( !Q_stricmp( key, "If-Modified-Since" ) 
+		&& ( request->method == HTTP_METHOD_GET || request->method == HTTP_METHOD_HEAD ) ) {
+		request->if_modified_since = SV_Web_ParseDate( value );
 	} else if( !Q_stricmp( key, "X-Client" ) ) {
 		request->clientNum = atoi( value );
 	} else if( !Q_stricmp( key, "X-Session" ) ) {
@@ -746,6 +863,17 @@ static void SV_Web_RouteRequest( const sv_http_request_t *request, sv_http_respo
 			}
 			else {
 				response->code = HTTP_RESP_OK;
+				response->file_mtime = FS_BaseFileMTime( filename );
+
+				if( request->method == HTTP_METHOD_GET ) {
+					response->file_mapping = FS_MMapBaseFile( filename, &response->file_mapping_size );
+					if( response->file_mapping && response->file_mapping_size != *content_length ) {
+						// changed under our feet, stick to the opened file
+						FS_UnMMapBaseFile( response->file_mapping, response->file_mapping_size );
+						response->file_mapping = NULL;
+						response->file_mapping_size = 0;
+					}
+				}
 			}
 		}
 		else {
@@ -780,30 +908,45 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 			Com_Printf( "HTTP serving file '%s' to '%s'\n", response->filename, NET_AddressToString( &con->address ) );
 		}
 
+		if( response->file && request->if_modified_since > 0 && response->file_mtime > 0 
+			&& response->file_mtime <= request->if_modified_since ) {
+			// the client already has this version of the file
+			response->code = HTTP_RESP_NOT_MODIFIED;
+			SV_Web_CloseResponseFile( response );
+		}
+
 		// serve range requests
 		if( request->partial && response->file ) {
-			// seek to first byte pos and clamp the last byte pos to content length
-			if( request->partial_content_range.begin > 0 ) { 
-				FS_Seek( response->file, request->partial_content_range.begin, FS_SEEK_SET );
-				// range.end may be set to 0 for 'bytes=100-' style requests
-				response->stream.content_range.end = request->partial_content_range.end 
-					? request->partial_content_range.end : content_length;
-
-			} else if( request->partial_content_range.end < 0 ) {
-				// seek to N last bytes in the file
-				FS_Seek( response->file, request->partial_content_range.end, FS_SEEK_END );
-				response->stream.content_range.end = -request->partial_content_range.end;
+			long begin = request->partial_content_range.begin;
+			long end = request->partial_content_range.end;
+
+			if( begin < 0 ) {
+				// last N bytes in the file
+				begin = max( (long)content_length - end, 0 );
+				end = (long)content_length - 1;
+			}
+			else if( end < 0 || end >= (long)content_length ) {
+				end = (long)content_length - 1;
 			}
 
-			// Content-Range header values
-			response->stream.content_range.begin = FS_Tell( response->file );
-			response->stream.content_range.end = min( (int)content_length, response->stream.content_range.end );
-			response->code = HTTP_RESP_PARTIAL_CONTENT;
+			if( begin >= (long)content_length ) {
+				response->code = HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE;
+				SV_Web_CloseResponseFile( response );
+			}
+			else {
+				// Content-Range header values
+				response->stream.content_range.begin = begin;
+				response->stream.content_range.end = end;
+				response->code = HTTP_RESP_PARTIAL_CONTENT;
+
+				if( !response->file_mapping ) {
+					FS_Seek( response->file, begin, FS_SEEK_SET );
+				}
+			}
 		}
 
 		if( request->method == HTTP_METHOD_HEAD && response->file ) {
-			FS_FCloseFile( response->file );
-			response->file = 0;
+			SV_Web_CloseResponseFile( response );
 		}
 	}
 
@@ -814,25 +957,36 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 	Q_strncatz( resp_stream->header_buf, "Accept-Ranges: bytes\r\n", 
 			sizeof( resp_stream->header_buf ) );
 
-	if( response->code == HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE ) {
-		int file_length = FS_FOpenBaseFile( request->resource, NULL, FS_READ );
+	if( response->file_mtime > 0 ) {
+		Q_strncatz( resp_stream->header_buf, va( "Last-Modified: %s\r\n", SV_Web_FormatDate( response->file_mtime ) ), 
+			sizeof( resp_stream->header_buf ) );
+	}
 
+	if( response->code == HTTP_RESP_REQUESTED_RANGE_NOT_SATISFIABLE ) {
 		// in accordance with RFC 2616, send the Content-Range entity header,
 		// specifying the length of the resource
-		if( file_length < 0 ) {
+		if( !content_length ) {
 			Q_strncatz( resp_stream->header_buf, "Content-Range: bytes */*\r\n",
 				sizeof( resp_stream->header_buf ) );
 		}
 		else {
-			Q_strncatz( resp_stream->header_buf, va( "Content-Range: bytes */%i\r\n", content_length ),
+			Q_strncatz( resp_stream->header_buf, va( "Content-Range: bytes */%i\r\n", (int)content_length ),
 				sizeof( resp_stream->header_buf ) );
 		}
+		content_length = 0;
 	}
 	else if( response->code == HTTP_RESP_PARTIAL_CONTENT ) {
-		Q_strncatz( resp_stream->header_buf, va( "Content-Range: bytes %i-%i/%i\r\n", 
-			response->stream.content_range.begin, response->stream.content_range.end, content_length ),
+		Q_strncatz( resp_stream->header_buf, va( "Content-Range: bytes %li-%li/%i\r\n", 
+			response->stream.content_range.begin, response->stream.content_range.end, (int)content_length ),
 			sizeof( resp_stream->header_buf ) );
-		content_length = response->stream.content_range.end - response->stream.content_range.begin;
+		content_length = response->stream.content_range.end - response->stream.content_range.begin + 1;
+	}
+	else if( response->code == HTTP_RESP_NOT_MODIFIED ) {
+		// no message body
+		Q_strncatz( resp_stream->header_buf, "\r\n", sizeof( resp_stream->header_buf ) );
+		resp_stream->header_length = strlen( resp_stream->header_buf );
+		resp_stream->content_length = 0;
+		return;
 	}
 
 	if( response->code >= HTTP_RESP_BAD_REQUEST || !content_length ) {
@@ -874,8 +1028,10 @@ static void SV_Web_RespondToQuery( sv_http_connection_t *con )
 
 /*
 * SV_Web_SendResponse
+*
+* Sends up to max_send bytes of the response body, 0 for no limit
 */
-static size_t SV_Web_SendResponse( sv_http_connection_t *con )
+static size_t SV_Web_SendResponse( sv_http_connection_t *con, size_t max_send )
 {
 	int sent;
 	char *sendbuf;
@@ -903,7 +1059,16 @@ static size_t SV_Web_SendResponse( sv_http_connection_t *con )
 
 	if( stream->header_done && stream->content_length ) {
 		while( stream->content_p < stream->content_length ) {
-			if( response->file ) {
+			if( max_send && total_sent >= max_send ) {
+				break;
+			}
+
+			if( response->file_mapping ) {
+				// range requests start at content_range.begin, which is 0 otherwise
+				sendbuf = ( char * )response->file_mapping + response->stream.content_range.begin + stream->content_p;
+				sendbuf_size = stream->content_length - stream->content_p;
+			}
+			else if( response->file ) {
 				if( response->file_send_pos >= response->file_chunk_size ) {
 					// read from file
 					int read_size;
@@ -932,6 +1097,10 @@ static size_t SV_Web_SendResponse( sv_http_connection_t *con )
 				break;
 			}
 
+			if( max_send && sendbuf_size > max_send - total_sent ) {
+				sendbuf_size = max_send - total_sent;
+			}
+
 			sent = SV_Web_Send( con, sendbuf, sendbuf_size );
 			if( sent <= 0 ) {
 				break;
@@ -939,7 +1108,7 @@ static size_t SV_Web_SendResponse( sv_http_connection_t *con )
 
 			stream->content_p += sent;
 			total_sent += sent;
-			if( response->file ) {
+			if( response->file && !response->file_mapping ) {
 				response->file_send_pos += sent;
 			}
 		}
@@ -951,14 +1120,125 @@ static size_t SV_Web_SendResponse( sv_http_connection_t *con )
 
 	// if done sending content body, make the transition to recieving state
 	if( stream->header_done 
-		&& (!stream->content || stream->content_p >= stream->content_length) 
-		&& !response->file ) {
+		&& ( stream->content_p >= stream->content_length || ( !stream->content && !response->file ) ) ) {
 		con->state = HTTP_CONN_STATE_RECV;
 	}
 
 	return total_sent;
 }
 
+/*
+* SV_Web_SendToConnection
+*
+* Sends the response and makes the connection ready for the next request when done
+*/
+static size_t SV_Web_SendToConnection( sv_http_connection_t *con, size_t max_send )
+{
+	size_t sent;
+
+	sent = SV_Web_SendResponse( con, max_send );
+
+	if( con->state == HTTP_CONN_STATE_RECV ) {
+		SV_Web_ResetResponse( &con->response );
+		if( con->close_after_resp ) {
+			con->open = false;
+		}
+		else {
+			SV_Web_ResetRequest( &con->request );
+		}
+	}
+
+	return sent;
+}
+
+/*
+* SV_Web_SendThread
+*/
+static void *SV_Web_SendThread( void *param )
+{
+	size_t sent, con_sent;
+	bool sending;
+	unsigned int pass = 0;
+	sv_http_connection_t *con, *hnode = &sv_http_connection_headnode;
+
+	QMutex_Lock( sv_http_mutex );
+	while( !sv_http_sendthread_terminate ) {
+		sent = 0;
+		sending = false;
+		pass++;
+
+		for( con = hnode->prev; con != hnode; con = con->prev ) {
+			if( con->send_pass == pass ) {
+				continue;
+			}
+			con->send_pass = pass;
+
+			if( !con->open || con->state != HTTP_CONN_STATE_SEND ) {
+				continue;
+			}
+
+			con_sent = SV_Web_SendToConnection( con, HTTP_SEND_THREAD_MAX_SEND_PER_PASS );
+			if( con->open && con->state == HTTP_CONN_STATE_SEND ) {
+				sending = true;
+			}
+
+			if( con_sent ) {
+				sent += con_sent;
+
+				// hold the lock for one connection at a time so the main thread
+				// never waits for more than a single bounded send
+				QMutex_Unlock( sv_http_mutex );
+				QThread_Yield();
+				QMutex_Lock( sv_http_mutex );
+
+				// the list may have changed meanwhile, rescan it from the start,
+				// skipping the connections already served during this pass
+				con = hnode;
+			}
+		}
+
+		if( !sent ) {
+			// either the socket buffers are full or there's nothing to send
+			QCondVar_Wait( sv_http_sendcond, sv_http_mutex, sending ? 1 : Q_THREADS_WAIT_INFINITE );
+		}
+	}
+	QMutex_Unlock( sv_http_mutex );
+
+	return NULL;
+}
+
+/*
+* SV_Web_InitSendThread
+*/
+static void SV_Web_InitSendThread( void )
+{
+	sv_http_mutex = QMutex_Create();
+	sv_http_sendcond = QCondVar_Create();
+	sv_http_sendthread_terminate = false;
+	sv_http_sendthread = QThread_Create( SV_Web_SendThread, NULL );
+}
+
+/*
+* SV_Web_ShutdownSendThread
+*/
+static void SV_Web_ShutdownSendThread( void )
+{
+	if( !sv_http_sendthread ) {
+		return;
+	}
+
+	QMutex_Lock( sv_http_mutex );
+	sv_http_sendthread_terminate = true;
+	QCondVar_Wake( sv_http_sendcond );
+	QMutex_Unlock( sv_http_mutex );
+
+	QThread_Join( sv_http_sendthread );
+	sv_http_sendthread = NULL;
+
+	QCondVar_Destroy( &sv_http_sendcond );
+	QMutex_Destroy( &sv_http_mutex );
+}
+
 /*
 * SV_Web_InitSocket
 */
@@ -989,6 +1269,18 @@ static void SV_Web_InitSocket( const char *addrstr, netadrtype_t adrtype, socket
 	}
 }
 
+/*
+* SV_Web_PollConnection
+*/
+static void SV_Web_PollConnection( socket_t *socket, void *privatep )
+{
+	sv_http_connection_t *con = privatep;
+
+	if( con->open && con->state == HTTP_CONN_STATE_RECV ) {
+		SV_Web_ReceiveRequest( socket, con );
+	}
+}
+
 /*
 * SV_Web_Listen
 */
@@ -1045,6 +1337,10 @@ static void SV_Web_Listen( socket_t *socket )
 			con->open = true;
 			con->state = HTTP_CONN_STATE_RECV;
 			con->is_upstream = is_upstream;
+			if( !NET_PollAddSocket( sv_http_poll, &con->socket, SV_Web_PollConnection, NULL, con ) ) {
+				Com_DPrintf( "HTTP connection from %s not monitored: %s\n", NET_AddressToString( &newaddress ), NET_ErrorString() );
+				con->open = false;
+			}
 			continue;
 		}
 
@@ -1053,6 +1349,14 @@ static void SV_Web_Listen( socket_t *socket )
 	}
 }
 
+/*
+* SV_Web_PollListen
+*/
+static void SV_Web_PollListen( socket_t *socket, void *unused )
+{
+	SV_Web_Listen( socket );
+}
+
 /*
 * SV_Web_Init
 */
@@ -1070,6 +1374,29 @@ void SV_Web_Init( void )
 	SV_Web_InitSocket( sv_http_ipv6->string[0] == '\0' ? sv_ip6->string : sv_http_ipv6->string, NA_IP6, &sv_socket_http6 );
 
 	sv_http_initialized = (sv_socket_http.address.type == NA_IP || sv_socket_http6.address.type == NA_IP6);
+	if( !sv_http_initialized ) {
+		return;
+	}
+
+	sv_http_poll = NET_CreatePoll();
+	if( !sv_http_poll ) {
+		Com_Printf( "Error: Couldn't create HTTP socket poll: %s\n", NET_ErrorString() );
+		NET_CloseSocket( &sv_socket_http );
+		NET_CloseSocket( &sv_socket_http6 );
+		sv_http_initialized = false;
+		return;
+	}
+
+	if( sv_socket_http.address.type == NA_IP ) {
+		NET_PollAddSocket( sv_http_poll, &sv_socket_http, SV_Web_PollListen, NULL, NULL );
+	}
+	if( sv_socket_http6.address.type == NA_IP6 ) {
+		NET_PollAddSocket( sv_http_poll, &sv_socket_http6, SV_Web_PollListen, NULL, NULL );
+	}
+
+	if( sv_http_threaded->integer ) {
+		SV_Web_InitSendThread();
+	}
 }
 
 /*
@@ -1077,44 +1404,23 @@ void SV_Web_Init( void )
 */
 void SV_Web_Frame( void )
 {
+	bool wake = false;
 	sv_http_connection_t *con, *next, *hnode = &sv_http_connection_headnode;
-	socket_t *sockets[MAX_INCOMING_HTTP_CONNECTIONS+1];
-	void *connections[MAX_INCOMING_HTTP_CONNECTIONS];
-	int num_sockets = 0;
 
 	if( !sv_http_initialized ) {
 		return;
 	}
 
-	sv_web_upstream_is_set = sv_http_upstream_ip->string[0] != '\0' && sv_http_upstream_baseurl->string[0] != '\0';
-	NET_StringToAddress( sv_http_upstream_ip->string, &sv_web_upstream_addr );
-
-	// accept new connections
-	if( sv_socket_http.address.type == NA_IP ) {
-		SV_Web_Listen( &sv_socket_http );
-	}
-	if( sv_socket_http6.address.type == NA_IP6 ) {
-		SV_Web_Listen( &sv_socket_http6 );
+	// the send thread only holds the lock for a single bounded send
+	if( sv_http_sendthread ) {
+		QMutex_Lock( sv_http_mutex );
 	}
 
-	// handle incoming data
-	num_sockets = 0;
-	for( con = hnode->prev; con != hnode; con = next )
-	{
-		next = con->prev;
-		switch( con->state ) {
-			case HTTP_CONN_STATE_RECV:
-				sockets[num_sockets] = &con->socket;
-				connections[num_sockets] = con;
-				num_sockets++;
-				break;
-			default:
-				break;
-		}
-	}
-	sockets[num_sockets] = NULL;
+	sv_web_upstream_is_set = sv_http_upstream_ip->string[0] != '\0' && sv_http_upstream_baseurl->string[0] != '\0';
+	NET_StringToAddress( sv_http_upstream_ip->string, &sv_web_upstream_addr );
 
-	NET_Monitor( 0, sockets, (void (*)(socket_t *, void*))SV_Web_ReceiveRequest, NULL, connections );
+	// accept new connections and handle incoming data
+	NET_PollWait( sv_http_poll, 0 );
 
 	for( con = hnode->prev; con != hnode; con = next )
 	{
@@ -1127,18 +1433,17 @@ void SV_Web_Frame( void )
 				con->state = HTTP_CONN_STATE_SEND;
 				SV_Web_RespondToQuery( con );
 
-			case HTTP_CONN_STATE_SEND:
-				SV_Web_SendResponse( con );
+				if( sv_http_sendthread ) {
+					wake = true;
+					break;
+				}
 
-				if( con->state == HTTP_CONN_STATE_RECV ) {
-					SV_Web_ResetResponse( &con->response );
-					if( con->close_after_resp ) {
-						con->open = false;
-					}
-					else {
-						SV_Web_ResetRequest( &con->request );
-					}
+			case HTTP_CONN_STATE_SEND:
+				if( sv_http_sendthread ) {
+					break;
 				}
+
+				SV_Web_SendToConnection( con, 0 );
 				break;
 			default:
 				Com_DPrintf( "Bad connection state %i\n", con->state );
@@ -1173,9 +1478,15 @@ void SV_Web_Frame( void )
 		}
 
 		if( !con->open ) {
-			NET_CloseSocket( &con->socket );
-			SV_Web_FreeConnection( con );
+			SV_Web_CloseConnection( con );
+		}
+	}
+
+	if( sv_http_sendthread ) {
+		if( wake ) {
+			QCondVar_Wake( sv_http_sendcond );
 		}
+		QMutex_Unlock( sv_http_mutex );
 	}
 }
 
@@ -1196,8 +1507,12 @@ void SV_Web_Shutdown( void )
 		return;
 	}
 
+	SV_Web_ShutdownSendThread();
+
 	SV_Web_ShutdownConnections();
 
+	NET_DestroyPoll( &sv_http_poll );
+
 	NET_CloseSocket( &sv_socket_http );
 	NET_CloseSocket( &sv_socket_http6 );
 
@@ -24,6 +24,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "tv_upstream.h"
 #include "tv_upstream_demos.h"
+#include "tv_demobench.h"
 
 static char *TV_ConnstateToString( connstate_t state )
 {
@@ -492,6 +493,7 @@ static cmd_function_t cmdlist[] =
 	{ "demo", TV_Demo_f },
 	{ "record", TV_Record_f },
 	{ "stop", TV_Stop_f },
+	{ "demobench", TV_DemoBench_f },
 
 	{ "status", TV_Status_f },
 	{ "cmd", TV_Cmd_f },
@@ -0,0 +1,424 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "tv_local.h"
+
+#include "tv_demobench.h"
+
+#include "tv_relay.h"
+
+/*
+=========================================================================
+
+Snapshot encoding benchmark
+
+Replays the snapshots of a recorded demo through the snapshot writer
+once per SNAP_ENCODING_*, as if they were relayed to a spectator that
+acknowledges every frame, and parses the result back to make sure it
+decodes to the same snapshot.
+
+=========================================================================
+*/
+
+#define DEMOBENCH_AREABYTES		255		// the areabits length is sent as a byte
+
+typedef struct
+{
+	bool reliable;
+
+	snapshot_t *frames;									// [UPDATE_BACKUP], parsed from the demo
+	snapshot_t *lastFrame;
+	snapshot_t *encoded[SNAP_ENCODING_TOTAL];			// [UPDATE_BACKUP], parsed back from our encoding
+	snapshot_t *lastEncoded[SNAP_ENCODING_TOTAL];
+	uint8_t *areabits;
+
+	entity_state_t baselines[MAX_EDICTS];
+	client_entities_t client_entities;
+	edict_t *edicts;
+	ginfo_t gi;
+	client_t *clients[SNAP_ENCODING_TOTAL];
+	int lastframe;
+
+	int numframes;
+	size_t bytes[SNAP_ENCODING_TOTAL];
+	int mismatches[SNAP_ENCODING_TOTAL];
+
+	uint8_t demobuf[MAX_MSGLEN];
+	uint8_t msgbuf[MAX_MSGLEN];
+} demobench_t;
+
+static const char *demobench_encodings[SNAP_ENCODING_TOTAL] = { "legacy", "bitpacked" };
+
+/*
+* TV_DemoBench_Reset
+*
+* Forgets the snapshots of the previous level
+*/
+static void TV_DemoBench_Reset( demobench_t *bench )
+{
+	int i, j;
+
+	for( i = 0; i < UPDATE_BACKUP; i++ )
+	{
+		bench->frames[i].valid = false;
+		for( j = 0; j < SNAP_ENCODING_TOTAL; j++ )
+			bench->encoded[j][i].valid = false;
+	}
+
+	bench->lastFrame = NULL;
+	for( j = 0; j < SNAP_ENCODING_TOTAL; j++ )
+		bench->lastEncoded[j] = NULL;
+	bench->lastframe = -1;
+
+	memset( bench->baselines, 0, sizeof( bench->baselines ) );
+}
+
+/*
+* TV_DemoBench_Create
+*/
+static demobench_t *TV_DemoBench_Create( void )
+{
+	int i, j;
+	demobench_t *bench;
+	snapshot_t *frame;
+
+	bench = Mem_Alloc( tv_mempool, sizeof( *bench ) );
+
+	bench->frames = Mem_Alloc( tv_mempool, sizeof( snapshot_t ) * UPDATE_BACKUP * ( SNAP_ENCODING_TOTAL + 1 ) );
+	bench->areabits = Mem_Alloc( tv_mempool, DEMOBENCH_AREABYTES * UPDATE_BACKUP * ( SNAP_ENCODING_TOTAL + 1 ) );
+	for( j = 0; j < SNAP_ENCODING_TOTAL; j++ )
+		bench->encoded[j] = bench->frames + UPDATE_BACKUP * ( j + 1 );
+
+	for( i = 0, frame = bench->frames; i < UPDATE_BACKUP * ( SNAP_ENCODING_TOTAL + 1 ); i++, frame++ )
+	{
+		frame->areabytes = DEMOBENCH_AREABYTES;
+		frame->areabits = bench->areabits + i * DEMOBENCH_AREABYTES;
+	}
+
+	bench->client_entities.num_entities = UPDATE_BACKUP * MAX_PARSE_ENTITIES;
+	bench->client_entities.entities = Mem_Alloc( tv_mempool, sizeof( entity_state_t ) * bench->client_entities.num_entities );
+
+	// the entities don't exist on our side, let every origin2 through
+	bench->edicts = Mem_Alloc( tv_mempool, sizeof( edict_t ) * MAX_EDICTS );
+	for( i = 0; i < MAX_EDICTS; i++ )
+		bench->edicts[i].r.svflags = SVF_TRANSMITORIGIN2;
+	bench->gi.edicts = bench->edicts;
+	bench->gi.edict_size = sizeof( edict_t );
+	bench->gi.num_edicts = MAX_EDICTS;
+	bench->gi.max_edicts = MAX_EDICTS;
+
+	for( j = 0; j < SNAP_ENCODING_TOTAL; j++ )
+	{
+		bench->clients[j] = Mem_Alloc( tv_mempool, sizeof( client_t ) );
+		bench->clients[j]->reliable = true;
+		bench->clients[j]->snapEncoding = j;
+	}
+
+	TV_DemoBench_Reset( bench );
+
+	return bench;
+}
+
+/*
+* TV_DemoBench_Destroy
+*/
+static void TV_DemoBench_Destroy( demobench_t *bench )
+{
+	int j;
+
+	for( j = 0; j < SNAP_ENCODING_TOTAL; j++ )
+		Mem_Free( bench->clients[j] );
+	Mem_Free( bench->edicts );
+	Mem_Free( bench->client_entities.entities );
+	Mem_Free( bench->areabits );
+	Mem_Free( bench->frames );
+	Mem_Free( bench );
+}
+
+/*
+* TV_DemoBench_SameFrame
+*/
+static bool TV_DemoBench_SameFrame( snapshot_t *a, snapshot_t *b )
+{
+	int i;
+
+	if( a->numplayers != b->numplayers || a->numEntities != b->numEntities )
+		return false;
+	if( memcmp( &a->gameState, &b->gameState, sizeof( game_state_t ) ) )
+		return false;
+	if( memcmp( a->areabits, b->areabits, min( a->areabytes, b->areabytes ) ) )
+		return false;
+
+	for( i = 0; i < a->numplayers; i++ )
+	{
+		if( memcmp( &a->playerStates[i], &b->playerStates[i], sizeof( player_state_t ) ) )
+			return false;
+	}
+
+	for( i = 0; i < a->numEntities; i++ )
+	{
+		if( memcmp( &a->parsedEntities[i & ( MAX_PARSE_ENTITIES-1 )], &b->parsedEntities[i & ( MAX_PARSE_ENTITIES-1 )],
+			sizeof( entity_state_t ) ) )
+			return false;
+	}
+
+	return true;
+}
+
+/*
+* TV_DemoBench_EncodeFrame
+*/
+static void TV_DemoBench_EncodeFrame( demobench_t *bench, snapshot_t *snap )
+{
+	int i, j;
+	int areabytes;
+	unsigned int first_entity;
+	client_t *client;
+	client_snapshot_t *frame;
+	snapshot_t *parsed;
+	msg_t msg;
+
+	first_entity = bench->client_entities.next_entities;
+	for( i = 0; i < snap->numEntities; i++ )
+	{
+		bench->client_entities.entities[( first_entity + i ) % bench->client_entities.num_entities] =
+			snap->parsedEntities[i & ( MAX_PARSE_ENTITIES-1 )];
+	}
+	bench->client_entities.next_entities += snap->numEntities;
+
+	// the sender's area count is unknown, the trailing zeros cost the same in both encodings
+	for( areabytes = snap->areabytes; areabytes > 0 && !snap->areabits[areabytes-1]; areabytes-- );
+
+	for( j = 0; j < SNAP_ENCODING_TOTAL; j++ )
+	{
+		client = bench->clients[j];
+
+		frame = &client->snapShots[snap->serverFrame & UPDATE_MASK];
+		memset( frame, 0, sizeof( *frame ) );
+		frame->allentities = snap->allentities;
+		frame->multipov = snap->multipov;
+		frame->relay = true;
+		frame->areabytes = areabytes;
+		frame->areabits = snap->areabits;
+		frame->numplayers = snap->numplayers;
+		frame->ps = snap->playerStates;
+		frame->num_entities = snap->numEntities;
+		frame->first_entity = first_entity;
+		frame->UcmdExecuted = snap->ucmdExecuted;
+		frame->gameState = snap->gameState;
+
+		// every snapshot is acknowledged in time
+		client->lastframe = bench->lastframe;
+
+		MSG_Init( &msg, bench->msgbuf, sizeof( bench->msgbuf ) );
+		SNAP_WriteFrameSnapToClient( &bench->gi, client, &msg, snap->serverFrame, snap->serverTime, bench->baselines,
+			&bench->client_entities, NULL, snap->numgamecommands, snap->gamecommands, snap->gamecommandsData );
+		bench->bytes[j] += msg.cursize;
+
+		MSG_BeginReading( &msg );
+		MSG_ReadByte( &msg ); // svc_frame
+		parsed = SNAP_ParseFrame( &msg, bench->lastEncoded[j], NULL, bench->encoded[j], bench->baselines, 0 );
+		if( !parsed->valid || !TV_DemoBench_SameFrame( snap, parsed ) )
+			bench->mismatches[j]++;
+		bench->lastEncoded[j] = parsed;
+	}
+
+	bench->lastframe = snap->serverFrame;
+	bench->numframes++;
+}
+
+/*
+* TV_DemoBench_ParseServerData
+*/
+static bool TV_DemoBench_ParseServerData( demobench_t *bench, msg_t *msg )
+{
+	int protocol, bitflags, numpure;
+
+	protocol = MSG_ReadLong( msg );
+	if( protocol != APP_PROTOCOL_VERSION )
+	{
+		Com_Printf( "Demo protocol is %i, not %i\n", protocol, APP_PROTOCOL_VERSION );
+		return false;
+	}
+
+	MSG_ReadLong( msg );	// servercount
+	MSG_ReadShort( msg );	// snapFrameTime
+	MSG_ReadString( msg );	// basegame
+	MSG_ReadString( msg );	// game
+	MSG_ReadShort( msg );	// playernum
+	MSG_ReadString( msg );	// levelname
+
+	bitflags = MSG_ReadByte( msg );
+	bench->reliable = ( bitflags & SV_BITFLAGS_RELIABLE ) ? true : false;
+
+	if( bitflags & SV_BITFLAGS_HTTP )
+	{
+		if( bitflags & SV_BITFLAGS_HTTP_BASEURL )
+			MSG_ReadString( msg );
+		else
+			MSG_ReadShort( msg );
+	}
+
+	numpure = MSG_ReadShort( msg );
+	while( numpure-- > 0 )
+	{
+		MSG_ReadString( msg );
+		MSG_ReadLong( msg );
+	}
+
+	TV_DemoBench_Reset( bench );
+	return true;
+}
+
+/*
+* TV_DemoBench_ParseMessage
+*/
+static bool TV_DemoBench_ParseMessage( demobench_t *bench, msg_t *msg )
+{
+	int cmd, len;
+	snapshot_t *snap;
+
+	while( msg->readcount < msg->cursize )
+	{
+		cmd = MSG_ReadByte( msg );
+		switch( cmd )
+		{
+		case svc_nop:
+			break;
+
+		case svc_servercmd:
+			if( !bench->reliable )
+				MSG_ReadLong( msg ); // cmdNum
+			// fall trough
+		case svc_servercs:
+			MSG_ReadString( msg );
+			break;
+
+		case svc_serverdata:
+			if( !TV_DemoBench_ParseServerData( bench, msg ) )
+				return false;
+			break;
+
+		case svc_spawnbaseline:
+			SNAP_ParseBaseline( msg, bench->baselines );
+			break;
+
+		case svc_clcack:
+			MSG_ReadLong( msg ); // reliableAcknowledge
+			MSG_ReadLong( msg ); // ucmdAcknowledged
+			break;
+
+		case svc_frame:
+			snap = SNAP_ParseFrame( msg, bench->lastFrame, NULL, bench->frames, bench->baselines, 0 );
+			if( !snap->valid || ( bench->lastFrame && snap->serverFrame <= bench->lastFrame->serverFrame ) )
+				break;
+			bench->lastFrame = snap;
+			TV_DemoBench_EncodeFrame( bench, snap );
+			break;
+
+		case svc_demoinfo:
+			len = MSG_ReadLong( msg );
+			MSG_SkipData( msg, len );
+			break;
+
+		case svc_extension:
+			MSG_ReadByte( msg );			// extension id
+			MSG_ReadByte( msg );			// version number
+			len = MSG_ReadShort( msg );		// command length
+			MSG_SkipData( msg, len );		// command data
+			break;
+
+		default:
+			Com_Printf( "Unexpected demo message %i\n", cmd );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+* TV_DemoBench_f
+*
+* Reports how many bytes the snapshots of a demo take in each snapshot encoding
+*/
+void TV_DemoBench_f( void )
+{
+	int j, filehandle, filelen;
+	char filename[MAX_QPATH];
+	demobench_t *bench;
+	msg_t msg;
+	unsigned int start, msecs;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Com_Printf( "Usage: %s <demo>\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	Q_snprintfz( filename, sizeof( filename ), "demos/%s", Cmd_Argv( 1 ) );
+	COM_DefaultExtension( filename, APP_DEMO_EXTENSION_STR, sizeof( filename ) );
+	if( !COM_ValidateRelativeFilename( filename ) )
+	{
+		Com_Printf( "Invalid filename\n" );
+		return;
+	}
+
+	filelen = FS_FOpenFile( filename, &filehandle, FS_READ|SNAP_DEMO_GZ );
+	if( !filehandle || filelen < 1 )
+	{
+		Com_Printf( "Couldn't open %s\n", filename );
+		if( filehandle )
+			FS_FCloseFile( filehandle );
+		return;
+	}
+
+	bench = TV_DemoBench_Create();
+	start = Sys_Milliseconds();
+
+	MSG_Init( &msg, bench->demobuf, sizeof( bench->demobuf ) );
+	while( SNAP_ReadDemoMessage( filehandle, &msg ) != -1 )
+	{
+		if( !TV_DemoBench_ParseMessage( bench, &msg ) )
+			break;
+	}
+
+	msecs = Sys_Milliseconds() - start;
+	FS_FCloseFile( filehandle );
+
+	if( !bench->numframes )
+	{
+		Com_Printf( "No snapshots in %s\n", filename );
+	}
+	else
+	{
+		Com_Printf( "%s: %i snapshots in %u msecs\n", filename, bench->numframes, msecs );
+		for( j = 0; j < SNAP_ENCODING_TOTAL; j++ )
+		{
+			Com_Printf( "%10s: %7.1f bytes per snapshot (%.1f%%)", demobench_encodings[j],
+				(double)bench->bytes[j] / bench->numframes, 100.0 * bench->bytes[j] / bench->bytes[SNAP_ENCODING_LEGACY] );
+			if( bench->mismatches[j] )
+				Com_Printf( S_COLOR_RED ", %i snapshots didn't decode back" S_COLOR_WHITE, bench->mismatches[j] );
+			Com_Printf( "\n" );
+		}
+	}
+
+	TV_DemoBench_Destroy( bench );
+}
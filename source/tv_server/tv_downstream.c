@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_downstream_parse.h"
 #include "tv_downstream_oob.h"
 #include "tv_relay_client.h"
+#include "tv_main.h"
 
 /*
 * TV_Downstream_ClientResetCommandBuffers
@@ -60,6 +61,58 @@ void TV_Downstream_ClientResetCommandBuffers( client_t *client, bool resetReliab
 	memset( client->ucmds, 0, sizeof( client->ucmds ) );
 }
 
+// game commands for spectators of other relays, held while relays run in parallel
+typedef struct deferred_command_s
+{
+	int clientNum;
+	char command[MAX_STRING_CHARS];
+	struct deferred_command_s *next;
+} deferred_command_t;
+
+static deferred_command_t *tv_deferredcommands;
+static deferred_command_t **tv_deferredcommands_tail = &tv_deferredcommands;
+
+/*
+* TV_Downstream_DeferGameCommand
+*/
+static void TV_Downstream_DeferGameCommand( client_t *client, const char *cmd )
+{
+	deferred_command_t *deferred;
+
+	deferred = Mem_Alloc( tv_mempool, sizeof( *deferred ) );
+	deferred->clientNum = client - tvs.clients;
+	Q_strncpyz( deferred->command, cmd, sizeof( deferred->command ) );
+
+	TV_RelayThreads_Lock();
+	*tv_deferredcommands_tail = deferred;
+	tv_deferredcommands_tail = &deferred->next;
+	TV_RelayThreads_Unlock();
+}
+
+/*
+* TV_Downstream_FlushGameCommands
+* 
+* Adds the game commands deferred while relays were running
+*/
+void TV_Downstream_FlushGameCommands( void )
+{
+	client_t *client;
+	deferred_command_t *deferred;
+
+	while( tv_deferredcommands )
+	{
+		deferred = tv_deferredcommands;
+		tv_deferredcommands = deferred->next;
+
+		client = tvs.clients + deferred->clientNum;
+		if( client->state == CS_SPAWNED )
+			TV_Downstream_AddGameCommand( client->relay, client, deferred->command );
+
+		Mem_Free( deferred );
+	}
+	tv_deferredcommands_tail = &tv_deferredcommands;
+}
+
 /*
 * TV_Downstream_AddGameCommand
 */
@@ -71,6 +124,13 @@ void TV_Downstream_AddGameCommand( relay_t *relay, client_t *client, const char
 	assert( client->relay == relay );
 	assert( cmd && cmd[0] );
 
+	// the relay of this client may be running in another thread
+	if( TV_RelayThreads_IsForeign( relay ) )
+	{
+		TV_Downstream_DeferGameCommand( client, cmd );
+		return;
+	}
+
 	client->gameCommandCurrent++;
 	index = client->gameCommandCurrent & ( MAX_RELIABLE_COMMANDS - 1 );
 	Q_strncpyz( client->gameCommands[index].command, cmd, sizeof( client->gameCommands[index].command ) );
@@ -308,7 +368,7 @@ static bool TV_Downstream_Netchan_Transmit( netchan_t *netchan, msg_t *msg )
 
 	if( tv_compresspackets->integer )
 	{
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( msg, netchan->compression );
 		if( zerror < 0 )
 		{
 			// it's compression error, just send uncompressed
@@ -607,7 +667,7 @@ static bool TV_Downstream_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	/*game_port = */MSG_ReadShort( msg );
 	if( msg->compressed )
 	{
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( msg, netchan->compression );
 		if( zerror < 0 )
 		{          // compression error. Drop the packet
 			Com_DPrintf( "TV_Downstream_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
@@ -618,12 +678,67 @@ static bool TV_Downstream_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	return true;
 }
 
+#define TV_MAX_READ_PACKETS	16      // datagrams read from a socket at once
+
+/*
+* TV_Downstream_ReadPacket
+*/
+static void TV_Downstream_ReadPacket( const socket_t *socket, const netadr_t *address, msg_t *msg )
+{
+	int i, game_port;
+	client_t *cl;
+
+	// check for upstreamless packet (0xffffffff) first
+	if( *(int *)msg->data == -1 )
+	{
+		TV_Downstream_UpstreamlessPacket( socket, address, msg );
+		return;
+	}
+
+	// read the game port out of the message so we can fix up
+	// stupid address translating routers
+	MSG_BeginReading( msg );
+	MSG_ReadLong( msg ); // sequence number
+	MSG_ReadLong( msg ); // sequence number
+	game_port = MSG_ReadShort( msg ) & 0xffff;
+	// data follows
+
+	// check for packets from connected clients
+	for( i = 0, cl = tvs.clients; i < tv_maxclients->integer; i++, cl++ )
+	{
+		unsigned short remoteaddr_port, addr_port;
+
+		if( cl->state == CS_FREE || cl->state == CS_ZOMBIE )
+			continue;
+		if( !NET_CompareBaseAddress( address, &cl->netchan.remoteAddress ) )
+			continue;
+		if( cl->netchan.game_port != game_port )
+			continue;
+
+		remoteaddr_port = NET_GetAddressPort( &cl->netchan.remoteAddress );
+		addr_port = NET_GetAddressPort( address );
+		if( remoteaddr_port != addr_port )
+		{
+			Com_DPrintf( "%s" S_COLOR_WHITE ": Fixing up a translated port from %i to %i\n", cl->name,
+				remoteaddr_port, addr_port );
+			NET_SetAddressPort( &cl->netchan.remoteAddress, addr_port );
+		}
+
+		if( TV_Downstream_ProcessPacket( &cl->netchan, msg ) )
+		{                                           // this is a valid, sequenced packet, so process it
+			cl->lastPacketReceivedTime = tvs.realtime;
+			TV_Downstream_ParseClientMessage( cl, msg );
+		}
+		break;
+	}
+}
+
 /*
 * TV_Downstream_ReadPackets
 */
 void TV_Downstream_ReadPackets( void )
 {
-	int i, socketind, ret, game_port;
+	int i, socketind, ret;
 	client_t *cl;
 #ifdef TCP_ALLOW_CONNECT
 	socket_t newsocket;
@@ -632,6 +747,9 @@ void TV_Downstream_ReadPackets( void )
 	netadr_t address;
 	msg_t msg;
 	uint8_t msgData[MAX_MSGLEN];
+	static netadr_t addresses[TV_MAX_READ_PACKETS];
+	static msg_t msgs[TV_MAX_READ_PACKETS];
+	static uint8_t msgsData[TV_MAX_READ_PACKETS][MAX_MSGLEN];
 
 #ifdef TCP_ALLOW_CONNECT
 	socket_t* tcpsockets [] =
@@ -648,6 +766,8 @@ void TV_Downstream_ReadPackets( void )
 	};
 
 	MSG_Init( &msg, msgData, sizeof( msgData ) );
+	for( i = 0; i < TV_MAX_READ_PACKETS; i++ )
+		MSG_Init( &msgs[i], msgsData[i], sizeof( msgsData[i] ) );
 
 #ifdef TCP_ALLOW_CONNECT
 	for( socketind = 0; socketind < sizeof( tcpsockets ) / sizeof( tcpsockets[0] ); socketind++ )
@@ -713,7 +833,7 @@ void TV_Downstream_ReadPackets( void )
 	{
 		socket = sockets[socketind];
 
-		while( socket->open && ( ret = NET_GetPacket( socket, &address, &msg ) ) != 0 )
+		while( socket->open && ( ret = NET_GetPackets( socket, addresses, msgs, TV_MAX_READ_PACKETS ) ) != 0 )
 		{
 			if( ret == -1 )
 			{
@@ -721,49 +841,8 @@ void TV_Downstream_ReadPackets( void )
 				continue;
 			}
 
-			// check for upstreamless packet (0xffffffff) first
-			if( *(int *)msg.data == -1 )
-			{
-				TV_Downstream_UpstreamlessPacket( socket, &address, &msg );
-				continue;
-			}
-
-			// read the game port out of the message so we can fix up
-			// stupid address translating routers
-			MSG_BeginReading( &msg );
-			MSG_ReadLong( &msg ); // sequence number
-			MSG_ReadLong( &msg ); // sequence number
-			game_port = MSG_ReadShort( &msg ) & 0xffff;
-			// data follows
-
-			// check for packets from connected clients
-			for( i = 0, cl = tvs.clients; i < tv_maxclients->integer; i++, cl++ )
-			{
-				unsigned short remoteaddr_port, addr_port;
-
-				if( cl->state == CS_FREE || cl->state == CS_ZOMBIE )
-					continue;
-				if( !NET_CompareBaseAddress( &address, &cl->netchan.remoteAddress ) )
-					continue;
-				if( cl->netchan.game_port != game_port )
-					continue;
-
-				remoteaddr_port = NET_GetAddressPort( &cl->netchan.remoteAddress );
-				addr_port = NET_GetAddressPort( &address );
-				if( remoteaddr_port != addr_port )
-				{
-					Com_DPrintf( "%s" S_COLOR_WHITE ": Fixing up a translated port from %i to %i\n", cl->name,
-						remoteaddr_port, addr_port );
-					NET_SetAddressPort( &cl->netchan.remoteAddress, addr_port );
-				}
-
-				if( TV_Downstream_ProcessPacket( &cl->netchan, &msg ) )
-				{                                           // this is a valid, sequenced packet, so process it
-					cl->lastPacketReceivedTime = tvs.realtime;
-					TV_Downstream_ParseClientMessage( cl, &msg );
-				}
-				break;
-			}
+			for( i = 0; i < ret; i++ )
+				TV_Downstream_ReadPacket( socket, &addresses[i], &msgs[i] );
 		}
 	}
 
@@ -882,6 +961,8 @@ bool TV_Downstream_SendClientsFragments( void )
 	client_t *client;
 	int i;
 	bool remaining = false;
+	bool transmitted;
+	static netbatch_t batch;
 
 	// send a message to each connected client
 	for( i = 0, client = tvs.clients; i < tv_maxclients->integer; i++, client++ )
@@ -892,7 +973,11 @@ bool TV_Downstream_SendClientsFragments( void )
 		if( !client->netchan.unsentFragments )
 			continue;
 
-		if( !Netchan_TransmitNextFragment( &client->netchan ) )
+		client->netchan.batch = &batch;
+		transmitted = Netchan_TransmitNextFragment( &client->netchan );
+		client->netchan.batch = NULL;
+
+		if( !transmitted )
 		{
 			Com_Printf( "%s" S_COLOR_WHITE ": Error sending fragment: %s\n", client->name, NET_ErrorString() );
 			if( client->reliable )
@@ -907,6 +992,8 @@ bool TV_Downstream_SendClientsFragments( void )
 			remaining = true;
 	}
 
+	NET_FlushBatch( &batch );
+
 	return remaining;
 }
 
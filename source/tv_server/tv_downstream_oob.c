@@ -350,9 +350,11 @@ static void TV_Downstream_DirectConnect( const socket_t *socket, const netadr_t
 #ifdef TCP_ALLOW_CONNECT
 	int incoming = 0;
 #endif
-	char userinfo[MAX_INFO_STRING], *name;
+	char userinfo[MAX_INFO_STRING], *name, *compression_str, *encoding_str;
 	client_t *cl, *newcl;
 	int i, version, game_port, challenge;
+	int compression, peerCompression;
+	int peerSnapEncoding;
 	bool tv_client;
 
 	version = atoi( Cmd_Argv( 1 ) );
@@ -384,6 +386,16 @@ static void TV_Downstream_DirectConnect( const socket_t *socket, const netadr_t
 
 	Q_strncpyz( userinfo, Cmd_Argv( 4 ), sizeof( userinfo ) );
 
+	// compression methods the client can decode
+	compression_str = Info_ValueForKey( userinfo, NETCHAN_COMPRESSION_KEY );
+	peerCompression = compression_str ? atoi( compression_str ) : 0;
+	Info_RemoveKey( userinfo, NETCHAN_COMPRESSION_KEY );
+
+	// newest snapshot encoding the client can parse
+	encoding_str = Info_ValueForKey( userinfo, SNAP_ENCODING_KEY );
+	peerSnapEncoding = encoding_str ? atoi( encoding_str ) : SNAP_ENCODING_LEGACY;
+	Info_RemoveKey( userinfo, SNAP_ENCODING_KEY );
+
 	// force the IP key/value pair so the game can filter based on ip
 	if( !Info_SetValueForKey( userinfo, "socket", NET_SocketTypeToString( socket->type ) ) )
 	{
@@ -508,8 +520,19 @@ static void TV_Downstream_DirectConnect( const socket_t *socket, const netadr_t
 		return;
 	}
 
-	// send the connect packet to the client
-	Netchan_OutOfBandPrint( socket, address, "client_connect" );
+	newcl->snapEncoding = SNAP_NegotiateEncoding( peerSnapEncoding, tv_snapencoding->integer );
+
+	// send the connect packet to the client, the session line is left empty
+	if( peerCompression )
+	{
+		compression = Netchan_NegotiateCompression( peerCompression, tv_compressmethod->integer );
+		newcl->netchan.compression = compression;
+		Netchan_OutOfBandPrint( socket, address, "client_connect\n\n%i", compression );
+	}
+	else
+	{
+		Netchan_OutOfBandPrint( socket, address, "client_connect" );
+	}
 
 	// free the incoming entry
 #ifdef TCP_ALLOW_CONNECT
@@ -101,8 +101,10 @@ typedef struct
 	int num_entities;
 	int first_entity;                   // into the circular sv_packet_entities[]
 	unsigned int sentTimeStamp;         // time at what this frame snap was sent to the clients
+	unsigned int serverTime;            // timestamp written in the frame header, base of the packed predictions
 	unsigned int UcmdExecuted;
 	game_state_t gameState;
+	unsigned int sharekey;              // snapshots with the same non-zero key have identical contents
 } client_snapshot_t;
 
 typedef enum { RD_NONE, RD_PACKET } redirect_t;
@@ -170,6 +172,7 @@ typedef struct client_s
 	int lastframe;                  // used for delta compression etc.
 	bool nodelta;               // send one non delta compressed frame trough
 	int nodelta_frame;              // when we get confirmation of this frame, the non-delta frame is trough
+	int snapEncoding;               // SNAP_ENCODING_*, negotiated at connect
 	usercmd_t lastcmd;              // for filling in big drops
 	unsigned int lastSentFrameNum;  // for knowing which was last frame we sent
 
@@ -220,6 +223,8 @@ typedef struct
 	socket_t socket_udp;
 	socket_t socket_udp6;
 
+	netpoll_t *netpoll;   // downstream and upstream UDP/TCP sockets, waited on between frames
+
 	challenge_t challenges[MAX_CHALLENGES];
 #ifdef TCP_ALLOW_CONNECT
 	incoming_t incoming[MAX_INCOMING_CONNECTIONS];
@@ -250,6 +255,8 @@ extern cvar_t *tv_zombietime;
 extern cvar_t *tv_maxclients;
 extern cvar_t *tv_maxmvclients;
 extern cvar_t *tv_compresspackets;
+extern cvar_t *tv_compressmethod;
+extern cvar_t *tv_snapencoding;
 extern cvar_t *tv_reconnectlimit;
 extern cvar_t *tv_public;
 extern cvar_t *tv_autorecord;
@@ -261,6 +268,8 @@ extern cvar_t *tv_floodprotection_messages;
 extern cvar_t *tv_floodprotection_seconds;
 extern cvar_t *tv_floodprotection_penalty;
 
+extern cvar_t *tv_relaythreads;
+
 extern tv_t tvs;
 
 #endif // __TV_LOCAL_H
@@ -53,6 +53,8 @@ cvar_t *tv_zombietime;
 cvar_t *tv_maxclients;
 cvar_t *tv_maxmvclients;
 cvar_t *tv_compresspackets;
+cvar_t *tv_compressmethod;
+cvar_t *tv_snapencoding;
 cvar_t *tv_name;
 cvar_t *tv_reconnectlimit; // minimum seconds between connect messages
 
@@ -62,6 +64,8 @@ cvar_t *tv_floodprotection_messages;
 cvar_t *tv_floodprotection_seconds;
 cvar_t *tv_floodprotection_penalty;
 
+cvar_t *tv_relaythreads;
+
 /*
 * TV_Init
 * 
@@ -100,6 +104,8 @@ void TV_Init( void )
 	tv_zombietime = Cvar_Get( "tv_zombietime", "2", 0 );
 	tv_name = Cvar_Get( "tv_name", APPLICATION "[TV]", CVAR_SERVERINFO | CVAR_ARCHIVE );
 	tv_compresspackets = Cvar_Get( "tv_compresspackets", "1", 0 );
+	tv_compressmethod = Cvar_Get( "tv_compressmethod", "1", CVAR_ARCHIVE );
+	tv_snapencoding = Cvar_Get( "tv_snapencoding", "1", CVAR_ARCHIVE );
 	tv_maxclients = Cvar_Get( "tv_maxclients", "32", CVAR_ARCHIVE | CVAR_SERVERINFO | CVAR_NOSET );
 	tv_maxmvclients = Cvar_Get( "tv_maxmvclients", "4", CVAR_ARCHIVE | CVAR_SERVERINFO | CVAR_NOSET );
 	tv_public = Cvar_Get( "tv_public", "1", CVAR_ARCHIVE | CVAR_SERVERINFO );
@@ -117,6 +123,8 @@ void TV_Init( void )
 	tv_floodprotection_penalty = Cvar_Get( "tv_floodprotection_delay", "20", 0 );
 	tv_floodprotection_penalty->modified = true;
 
+	tv_relaythreads = Cvar_Get( "tv_relaythreads", "0", CVAR_ARCHIVE );
+
 	if( tv_maxclients->integer < 0 )
 		Cvar_ForceSet( "tv_maxclients", "0" );
 
@@ -158,6 +166,14 @@ void TV_Init( void )
 		}
 	}
 
+	tvs.netpoll = NET_CreatePoll();
+	if( !tvs.netpoll )
+		Com_Error( ERR_FATAL, "Couldn't create socket poll: %s\n", NET_ErrorString() );
+	if( tvs.socket_udp.open )
+		NET_PollAddSocket( tvs.netpoll, &tvs.socket_udp, NULL, NULL, NULL );
+	if( tvs.socket_udp6.open )
+		NET_PollAddSocket( tvs.netpoll, &tvs.socket_udp6, NULL, NULL, NULL );
+
 #ifdef TCP_ALLOW_CONNECT
 	if( tv_tcp->integer )
 	{
@@ -209,17 +225,234 @@ void TV_Init( void )
 	TV_Downstream_InitMaster();
 }
 
+//=============================================================================
+//
+// Relay worker threads
+//
+// Upstreams and their relays can be run in parallel: each job reads the packets
+// of one upstream, runs the relay module frame and sends the snapshots to the
+// spectators of that relay. The lobby, downstream packets and the console stay
+// on the main thread, which joins the workers and waits for all relays to finish
+// before reading the packets from the spectators, so those never race with relays.
+//
+//=============================================================================
+
+#define TV_MAX_RELAY_THREADS	16
+
+typedef struct
+{
+	int numThreads;
+	qthread_t **threads;				// [numThreads]
+
+	qmutex_t *mutex;
+	qcondvar_t *startCond;
+	qcondvar_t *doneCond;
+	unsigned int jobSequence;			// incremented for every batch of relays
+	int busyThreads;
+	bool terminate;
+	bool running;						// relays are being run in parallel
+
+	qmutex_t *sharedMutex;				// guards the state shared between relays
+
+	int numJobs, maxJobs;
+	upstream_t **jobUpstreams;			// [maxJobs]
+	int jobMsec;
+	volatile int nextJob;
+} tv_relayworkers_t;
+
+static tv_relayworkers_t tv_relayworkers;
+
+static ATTRIBUTE_THREADLOCAL relay_t *tv_jobrelay;		// relay run by the calling thread
+static ATTRIBUTE_THREADLOCAL int tv_sharedlockdepth;
+
 /*
-* TV_Frame
+* TV_RelayThreads_Running
 */
-void TV_Frame( int realmsec, int gamemsec )
+bool TV_RelayThreads_Running( void )
+{
+	return tv_relayworkers.running;
+}
+
+/*
+* TV_RelayThreads_IsForeign
+*
+* Returns true if called from a relay job which doesn't own the relay.
+*/
+bool TV_RelayThreads_IsForeign( const relay_t *relay )
+{
+	return tv_relayworkers.running && relay != tv_jobrelay;
+}
+
+/*
+* TV_RelayThreads_Lock
+*
+* Serializes relay jobs around the engine state that isn't thread safe: the
+* command tokenizer, module and map loading, the upstream list and the socket poll.
+* The lock is recursive and does nothing unless relays are run in parallel.
+*/
+void TV_RelayThreads_Lock( void )
+{
+	tv_relayworkers_t *pool = &tv_relayworkers;
+
+	if( !pool->running )
+		return;
+	if( tv_sharedlockdepth++ == 0 )
+		QMutex_Lock( pool->sharedMutex );
+}
+
+/*
+* TV_RelayThreads_Unlock
+*/
+void TV_RelayThreads_Unlock( void )
+{
+	tv_relayworkers_t *pool = &tv_relayworkers;
+
+	if( !pool->running || !tv_sharedlockdepth )
+		return;
+	if( --tv_sharedlockdepth == 0 )
+		QMutex_Unlock( pool->sharedMutex );
+}
+
+/*
+* TV_RelayWorkers_RunJobs
+*/
+static void TV_RelayWorkers_RunJobs( void )
+{
+	int job;
+	upstream_t *upstream;
+	tv_relayworkers_t *pool = &tv_relayworkers;
+
+	while( ( job = QAtomic_Add( &pool->nextJob, 1, pool->mutex ) - 1 ) < pool->numJobs )
+	{
+		upstream = pool->jobUpstreams[job];
+
+		tv_jobrelay = &upstream->relay;
+		TV_Upstream_Run( upstream, pool->jobMsec );
+		tv_jobrelay = NULL;
+
+		// errors jump over the unlocking
+		if( tv_sharedlockdepth )
+		{
+			tv_sharedlockdepth = 0;
+			QMutex_Unlock( pool->sharedMutex );
+		}
+	}
+}
+
+/*
+* TV_RelayWorker_Thread
+*/
+static void *TV_RelayWorker_Thread( void *param )
+{
+	tv_relayworkers_t *pool = &tv_relayworkers;
+	unsigned int sequence = 0;
+
+	QMutex_Lock( pool->mutex );
+	while( true )
+	{
+		while( !pool->terminate && pool->jobSequence == sequence )
+			QCondVar_Wait( pool->startCond, pool->mutex, Q_THREADS_WAIT_INFINITE );
+		if( pool->terminate )
+			break;
+		sequence = pool->jobSequence;
+		QMutex_Unlock( pool->mutex );
+
+		TV_RelayWorkers_RunJobs();
+
+		QMutex_Lock( pool->mutex );
+		if( --pool->busyThreads == 0 )
+			QCondVar_Wake( pool->doneCond );
+	}
+	QMutex_Unlock( pool->mutex );
+
+	return NULL;
+}
+
+/*
+* TV_InitRelayWorkers
+*/
+static void TV_InitRelayWorkers( int numThreads )
 {
 	int i;
+	tv_relayworkers_t *pool = &tv_relayworkers;
 
-	tvs.realtime += realmsec;
+	if( numThreads <= 0 )
+		return;
 
-	TV_Lobby_Run();
+	pool->mutex = QMutex_Create();
+	pool->sharedMutex = QMutex_Create();
+	pool->startCond = QCondVar_Create();
+	pool->doneCond = QCondVar_Create();
+	pool->jobSequence = 0;
+	pool->terminate = false;
+
+	pool->threads = Mem_Alloc( tv_mempool, sizeof( *pool->threads ) * numThreads );
+	for( i = 0; i < numThreads; i++ )
+		pool->threads[i] = QThread_Create( TV_RelayWorker_Thread, NULL );
+	pool->numThreads = numThreads;
+
+	Com_Printf( "Started %i relay worker threads\n", numThreads );
+}
+
+/*
+* TV_ShutdownRelayWorkers
+*/
+static void TV_ShutdownRelayWorkers( void )
+{
+	int i;
+	tv_relayworkers_t *pool = &tv_relayworkers;
+
+	if( pool->numThreads )
+	{
+		QMutex_Lock( pool->mutex );
+		pool->terminate = true;
+		QCondVar_Wake( pool->startCond );
+		QMutex_Unlock( pool->mutex );
+
+		for( i = 0; i < pool->numThreads; i++ )
+			QThread_Join( pool->threads[i] );
+
+		Mem_Free( pool->threads );
+		QCondVar_Destroy( &pool->startCond );
+		QCondVar_Destroy( &pool->doneCond );
+		QMutex_Destroy( &pool->sharedMutex );
+		QMutex_Destroy( &pool->mutex );
+	}
+
+	if( pool->jobUpstreams )
+		Mem_Free( pool->jobUpstreams );
+
+	memset( pool, 0, sizeof( *pool ) );
+}
+
+/*
+* TV_RunUpstreams
+*
+* Runs all upstreams and their relays, in parallel if relay worker threads are enabled.
+*/
+static void TV_RunUpstreams( int msec )
+{
+	int i, numThreads;
+	tv_relayworkers_t *pool = &tv_relayworkers;
+
+	numThreads = tv_relaythreads->integer;
+	clamp( numThreads, 0, TV_MAX_RELAY_THREADS );
+	if( pool->numThreads != numThreads )
+	{
+		TV_ShutdownRelayWorkers();
+		TV_InitRelayWorkers( numThreads );
+	}
+
+	if( pool->maxJobs < tvs.numupstreams )
+	{
+		if( pool->jobUpstreams )
+			Mem_Free( pool->jobUpstreams );
+		pool->maxJobs = tvs.numupstreams;
+		pool->jobUpstreams = Mem_Alloc( tv_mempool, sizeof( *pool->jobUpstreams ) * pool->maxJobs );
+	}
 
+	// upstreams may shut down while running, so take a copy of the list
+	pool->numJobs = 0;
 	for( i = 0; i < tvs.numupstreams; i++ )
 	{
 		if( !tvs.upstreams[i] )
@@ -228,10 +461,51 @@ void TV_Frame( int realmsec, int gamemsec )
 		if( userinfo_modified )
 			tvs.upstreams[i]->userinfo_modified = true;
 
-		TV_Upstream_Run( tvs.upstreams[i], realmsec );
+		pool->jobUpstreams[pool->numJobs++] = tvs.upstreams[i];
 	}
 	userinfo_modified = false;
 
+	pool->jobMsec = msec;
+	pool->nextJob = 0;
+
+	if( pool->numThreads && pool->numJobs > 1 )
+	{
+		QMutex_Lock( pool->mutex );
+		pool->running = true;
+		pool->busyThreads = pool->numThreads;
+		pool->jobSequence++;
+		QCondVar_Wake( pool->startCond );
+		QMutex_Unlock( pool->mutex );
+
+		// the main thread joins the workers
+		TV_RelayWorkers_RunJobs();
+
+		QMutex_Lock( pool->mutex );
+		while( pool->busyThreads > 0 )
+			QCondVar_Wait( pool->doneCond, pool->mutex, Q_THREADS_WAIT_INFINITE );
+		pool->running = false;
+		QMutex_Unlock( pool->mutex );
+
+		// deliver the commands relays have sent to spectators of other relays
+		TV_Downstream_FlushGameCommands();
+	}
+	else
+	{
+		TV_RelayWorkers_RunJobs();
+	}
+}
+
+/*
+* TV_Frame
+*/
+void TV_Frame( int realmsec, int gamemsec )
+{
+	tvs.realtime += realmsec;
+
+	TV_Lobby_Run();
+
+	TV_RunUpstreams( realmsec );
+
 	TV_Downstream_ReadPackets();
 	TV_Downstream_SendClientMessages();
 	TV_Downstream_CheckTimeouts();
@@ -241,7 +515,8 @@ void TV_Frame( int realmsec, int gamemsec )
 
 	TV_Downstream_MasterHeartbeat();
 
-	Sys_Sleep( 5 );
+	// wake up as soon as a packet arrives from either side
+	NET_PollWait( tvs.netpoll, 5 );
 }
 
 /*
@@ -251,6 +526,8 @@ void TV_Shutdown( const char *finalmsg )
 {
 	int i;
 
+	TV_ShutdownRelayWorkers();
+
 	for( i = 0; i < tvs.numupstreams; i++ )
 	{
 		if( !tvs.upstreams[i] )
@@ -262,6 +539,8 @@ void TV_Shutdown( const char *finalmsg )
 	tvs.upstreams = NULL;
 	tvs.numupstreams = 0;
 
+	NET_DestroyPoll( &tvs.netpoll );
+
 	TV_RemoveCommands();
 }
 
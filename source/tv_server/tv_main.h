@@ -23,4 +23,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "tv_local.h"
 
+bool TV_RelayThreads_Running( void );
+bool TV_RelayThreads_IsForeign( const relay_t *relay );
+void TV_RelayThreads_Lock( void );
+void TV_RelayThreads_Unlock( void );
+
 #endif // __TV_MAIN_H
@@ -89,7 +89,7 @@ void TVM_RunLinearProjectiles( tvm_relay_t *relay )
 */
 void TVM_RunFrame( tvm_relay_t *relay, unsigned int msec )
 {
-	tvm.realtime += msec;
+	relay->realtime += msec;
 
 	TVM_RunLinearProjectiles( relay );
 	TVM_RunClients( relay );
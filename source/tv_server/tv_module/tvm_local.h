@@ -59,6 +59,7 @@ struct tvm_relay_s
 	char mapname[MAX_CONFIGSTRING_CHARS];
 
 	unsigned int serverTime;        // time in the server
+	unsigned int realtime;          // actual time, advanced by this relay's frames
 	snapshot_t frame;
 	game_state_t gameState;
 	char configStrings[MAX_CONFIGSTRINGS][MAX_CONFIGSTRING_CHARS];
@@ -81,7 +82,6 @@ struct tvm_relay_s
 
 typedef struct
 {
-	unsigned int realtime;          // actual time
 	int maxclients;
 } tv_module_locals_t;
 
@@ -35,8 +35,8 @@ typedef struct
 	float forwardPush, sidePush, upPush;
 } pml_t;
 
-pmove_t	*pm;
-pml_t pml;
+ATTRIBUTE_THREADLOCAL pmove_t *pm;
+ATTRIBUTE_THREADLOCAL pml_t pml;
 
 vec3_t playerbox_stand_mins = { -16, -16, -24 };
 vec3_t playerbox_stand_maxs = { 16, 16, 40 };
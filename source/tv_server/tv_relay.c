@@ -27,11 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_relay_module.h"
 #include "tv_relay_client.h"
 #include "tv_downstream.h"
-
-#include <setjmp.h>
-
-// for jumping over relay handling when it's disconnected
-jmp_buf relay_abortframe;
+#include "tv_main.h"
 
 /*
 * TV_Relay_RunSnap
@@ -165,7 +161,7 @@ void TV_Relay_Error( relay_t *relay, const char *format, ... )
 	va_end( argptr );
 
 	TV_Relay_Shutdown( relay, "%s", msg );
-	longjmp( relay_abortframe, -1 );
+	longjmp( relay->abortframe, -1 );
 }
 
 /*
@@ -190,6 +186,9 @@ void TV_Relay_Shutdown( relay_t *relay, const char *format, ... )
 
 	Com_Printf( "%s" S_COLOR_WHITE ": Relay shutdown: %s\n", relay->upstream->name, msg );
 
+	// the module, the map and the upstream list are shared with other relays
+	TV_RelayThreads_Lock();
+
 	// send a message to each connected client
 	for( i = 0, client = tvs.clients; i < tv_maxclients->integer; i++, client++ )
 	{
@@ -229,10 +228,15 @@ void TV_Relay_Shutdown( relay_t *relay, const char *format, ... )
 		memset( &relay->client_entities, 0, sizeof( relay->client_entities ) );
 	}
 
+	SNAP_DestroyDeltaCache( &relay->deltacache );
+	SNAP_DestroyVisCache( &relay->viscache );
+
 	CM_ReleaseReference( relay->cms );
 	relay->cms = NULL;
 
 	relay->state = CA_UNINITIALIZED;
+
+	TV_RelayThreads_Unlock();
 }
 
 /*
@@ -382,7 +386,7 @@ void TV_Relay_Run( relay_t *relay, int msec )
 {
 	relay->realtime += msec;
 
-	if( setjmp( relay_abortframe ) )  // disconnect while running
+	if( setjmp( relay->abortframe ) )  // disconnect while running
 		return;
 
 	relay->serverTime = relay->realtime + relay->serverTimeDelta;
@@ -436,6 +440,9 @@ void TV_Relay_Init( relay_t *relay, upstream_t *upstream, int delay )
 	relay->client_entities.num_entities = tv_maxclients->integer * UPDATE_BACKUP * MAX_SNAP_ENTITIES;
 	relay->client_entities.entities = Mem_Alloc( upstream->mempool, sizeof( entity_state_t ) * relay->client_entities.num_entities );
 
+	relay->deltacache = SNAP_CreateDeltaCache( upstream->mempool );
+	relay->viscache = SNAP_CreateVisCache( upstream->mempool );
+
 	relay->cms = CM_New( upstream->mempool );
 	CM_AddReference( relay->cms );
 
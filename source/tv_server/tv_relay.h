@@ -23,6 +23,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "tv_local.h"
 
+#include <setjmp.h>
+
 #define EDICT_NUM( u, n ) ( (edict_t *)( (uint8_t *)u->gi.edicts + u->gi.edict_size*( n ) ) )
 #define NUM_FOR_EDICT( u, e ) ( ( (uint8_t *)( e )-(uint8_t *)u->gi.edicts ) / u->gi.edict_size )
 
@@ -66,6 +68,7 @@ typedef struct client_entities_s
 struct relay_s
 {
 	connstate_t state;
+	jmp_buf abortframe;             // for jumping over relay handling when it's disconnected
 
 	upstream_t *upstream;
 
@@ -85,6 +88,12 @@ struct relay_s
 
 	cmodel_state_t *cms;
 	fatvis_t fatvis;
+	vec3_t skyorigin;
+	netbatch_t netbatch;                // snapshot datagrams to downstream clients
+
+	snap_deltacache_t *deltacache;      // snapshot bytes shared between downstream clients
+	snap_viscache_t *viscache;          // visible entities shared between downstream clients
+	unsigned int sharekey;              // last key given to a shared client snapshot
 
 	ginfo_t gi;
 	int num_active_specs;
@@ -25,27 +25,81 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_relay.h"
 #include "tv_downstream.h"
 
+// distinct client snapshots shared per frame, clients beyond that get their own
+#define RELAY_MAX_SNAP_GROUPS	64
+
+typedef struct
+{
+	client_t *leader;                   // the client the snapshot was built for
+	unsigned int sharekey;
+} relay_snapgroup_t;
+
+/*
+* TV_Relay_SetSkyOrigin
+*/
+static void TV_Relay_SetSkyOrigin( relay_t *relay )
+{
+	int noents = 0;
+	float f1 = 0, f2 = 0;
+
+	relay->fatvis.skyorg = NULL;
+
+	if( relay->configstrings[CS_SKYBOX][0] == '\0' )
+		return;
+
+	if( sscanf( relay->configstrings[CS_SKYBOX], "%f %f %f %f %f %i", &relay->skyorigin[0], &relay->skyorigin[1], &relay->skyorigin[2], 
+		&f1, &f2, &noents ) >= 3 )
+	{
+		if( !noents )
+			relay->fatvis.skyorg = relay->skyorigin;
+	}
+}
+
+/*
+* TV_Relay_SameClientFrameSnap
+*
+* Whether the two clients get identical snapshots built this frame
+*/
+static bool TV_Relay_SameClientFrameSnap( relay_t *relay, client_t *a, client_t *b )
+{
+	entity_state_t sa, sb;
+
+	if( a->mv != b->mv )
+		return false;
+
+	if( relay->playernum < 0 )
+	{
+		// multiview snapshots are built without a client entity then,
+		// otherwise the client's own entity number ends up in the snapshot
+		return a->mv;
+	}
+
+	// both are moved into our slot, only their state matters
+	if( !a->edict || !b->edict || !a->edict->r.client || !b->edict->r.client )
+		return false;
+	if( a->edict->r.svflags != b->edict->r.svflags )
+		return false;
+	if( a->edict->r.client->ps.POVnum != b->edict->r.client->ps.POVnum )
+		return false; // cheap early out
+	if( memcmp( &a->edict->r.client->ps, &b->edict->r.client->ps, sizeof( player_state_t ) ) )
+		return false;
+
+	sa = a->edict->s;
+	sb = b->edict->s;
+	sa.number = sb.number = 0;
+	return memcmp( &sa, &sb, sizeof( entity_state_t ) ) ? false : true;
+}
+
 /*
 * TV_Relay_BuildClientFrameSnap
+*
+* relay->fatvis.skyorg must be up to date
 */
 void TV_Relay_BuildClientFrameSnap( relay_t *relay, client_t *client )
 {
 	edict_t *clent;
 	entity_state_t backup_state = { 0 };
 	entity_shared_t backup_shared = { 0 };
-	vec_t *skyorg = NULL, origin[3];
-
-	if( relay->configstrings[CS_SKYBOX][0] != '\0' )
-	{
-		int noents = 0;
-		float f1 = 0, f2 = 0;
-
-		if( sscanf( relay->configstrings[CS_SKYBOX], "%f %f %f %f %f %i", &origin[0], &origin[1], &origin[2], &f1, &f2, &noents ) >= 3 )
-		{
-			if( !noents )
-				skyorg = origin;
-		}
-	}
 
 	// pretend client occupies our slot on real server
 	clent = client->edict;
@@ -76,8 +130,7 @@ void TV_Relay_BuildClientFrameSnap( relay_t *relay, client_t *client )
 		}
 	}
 
-	relay->fatvis.skyorg = skyorg;		// HACK HACK HACK
-	SNAP_BuildClientFrameSnap( relay->cms, &relay->gi, relay->framenum, relay->realtime, &relay->fatvis,
+	SNAP_BuildClientFrameSnap( relay->cms, &relay->gi, relay->framenum, relay->realtime, &relay->fatvis, relay->viscache,
 		client, relay->module_export->GetGameState( relay->module ),
 		&relay->client_entities,
 		true, tv_mempool );
@@ -108,12 +161,10 @@ static bool TV_Relay_SendClientDatagram( relay_t *relay, client_t *client )
 	TV_Downstream_AddReliableCommandsToMessage( client, &msg );
 
 	// send over all the relevant entity_state_t
-	// and the player_state_t
-	TV_Relay_BuildClientFrameSnap( relay, client );
-
+	// and the player_state_t, the snapshot has already been built
 	frame = relay->curFrame;
 	SNAP_WriteFrameSnapToClient( &relay->gi, client, &msg, relay->framenum, relay->serverTime, relay->baselines,
-		&relay->client_entities, frame->numgamecommands, frame->gamecommands, frame->gamecommandsData );
+		&relay->client_entities, relay->deltacache, frame->numgamecommands, frame->gamecommands, frame->gamecommandsData );
 
 	return TV_Downstream_SendMessageToClient( client, &msg );
 }
@@ -166,11 +217,22 @@ void TV_Relay_ReconnectClients( relay_t *relay )
 */
 void TV_Relay_SendClientMessages( relay_t *relay )
 {
-	int i;
+	int i, j;
 	client_t *client;
+	bool sent;
+	relay_snapgroup_t groups[RELAY_MAX_SNAP_GROUPS];
+	int numgroups;
 
 	assert( relay );
 
+	TV_Relay_SetSkyOrigin( relay );
+
+	SNAP_FixEntityNumbers( &relay->gi );
+	SNAP_BeginDeltaCacheFrame( relay->deltacache );
+	SNAP_SetDeltaCacheVolatileEntity( relay->deltacache, relay->playernum >= 0 ? relay->playernum + 1 : 0 );
+	SNAP_BeginVisCacheFrame( relay->viscache, relay->cms, &relay->gi );
+	numgroups = 0;
+
 	// send a message to each connected client
 	for( i = 0, client = tvs.clients; i < tv_maxclients->integer; i++, client++ )
 	{
@@ -179,7 +241,39 @@ void TV_Relay_SendClientMessages( relay_t *relay )
 		if( client->relay != relay )
 			continue;
 
-		if( !TV_Relay_SendClientDatagram( relay, client ) )
+		// spectators chasing the same player share the snapshot, and the
+		// encoded bytes too when they also acknowledged the same one
+		for( j = 0; j < numgroups; j++ )
+		{
+			if( TV_Relay_SameClientFrameSnap( relay, groups[j].leader, client ) )
+				break;
+		}
+
+		if( j < numgroups )
+		{
+			SNAP_CopyClientFrameSnap( client, groups[j].leader, relay->framenum, tv_mempool );
+			client->snapShots[relay->framenum & UPDATE_MASK].sharekey = groups[j].sharekey;
+		}
+		else
+		{
+			TV_Relay_BuildClientFrameSnap( relay, client );
+
+			if( numgroups < RELAY_MAX_SNAP_GROUPS )
+			{
+				if( !++relay->sharekey )
+					relay->sharekey++;
+				groups[numgroups].leader = client;
+				groups[numgroups].sharekey = relay->sharekey;
+				client->snapShots[relay->framenum & UPDATE_MASK].sharekey = relay->sharekey;
+				numgroups++;
+			}
+		}
+
+		client->netchan.batch = &relay->netbatch;
+		sent = TV_Relay_SendClientDatagram( relay, client );
+		client->netchan.batch = NULL;
+
+		if( !sent )
 		{
 			Com_Printf( "%s" S_COLOR_WHITE ": Error sending message: %s\n", client->name, NET_ErrorString() );
 			if( client->reliable )
@@ -189,6 +283,8 @@ void TV_Relay_SendClientMessages( relay_t *relay )
 			}
 		}
 	}
+
+	NET_FlushBatch( &relay->netbatch );
 }
 
 /*
@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_relay_svcmd.h"
 #include "tv_relay_client.h"
 #include "tv_downstream_clcmd.h"
+#include "tv_main.h"
 
 /*
 * TV_Relay_ParseFrame
@@ -214,8 +215,11 @@ void TV_Relay_ParseServerMessage( relay_t *relay, msg_t *msg )
 
 			if( relay->state == CA_HANDSHAKE )
 			{
-				Cbuf_Execute(); // make sure any stuffed commands are done
+				TV_RelayThreads_Lock();
+				if( !TV_RelayThreads_Running() )
+					Cbuf_Execute(); // make sure any stuffed commands are done
 				TV_Relay_ParseServerData( relay, msg );
+				TV_RelayThreads_Unlock();
 			}
 			else
 			{
@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_relay_client.h"
 #include "tv_upstream.h"
 #include "tv_downstream.h"
+#include "tv_main.h"
 
 /*
 * TV_Relay_UpdateConfigString
@@ -212,6 +213,10 @@ void TV_Relay_ParseServerCommand( relay_t *relay, msg_t *msg )
 	svcmd_t *cmd;
 
 	text = MSG_ReadString( msg );
+
+	// the command tokenizer is shared by all relays
+	TV_RelayThreads_Lock();
+
 	Cmd_TokenizeString( text );
 	s = Cmd_Argv( 0 );
 
@@ -222,9 +227,11 @@ void TV_Relay_ParseServerCommand( relay_t *relay, msg_t *msg )
 		{
 			if( cmd->func )
 				cmd->func( relay );
+			TV_RelayThreads_Unlock();
 			return;
 		}
 	}
 
 	Com_Printf( "Unknown server command: %s\n", s );
+	TV_RelayThreads_Unlock();
 }
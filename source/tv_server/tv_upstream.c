@@ -26,11 +26,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_upstream_parse.h"
 #include "tv_upstream_demos.h"
 #include "tv_downstream.h"
-
-#include <setjmp.h>
-
-// for jumping over upstream handling when it's disconnected
-jmp_buf upstream_abortframe;
+#include "tv_main.h"
 
 /*
 * TV_UpstreamForText
@@ -165,7 +161,7 @@ static void TV_Upstream_Netchan_Transmit( upstream_t *upstream, msg_t *msg )
 
 	// do not enable client compression until I fix the compression+fragmentation rare case bug
 	/*if( cl_compresspackets->integer ) {
-	zerror = Netchan_CompressMessage( msg );
+	zerror = Netchan_CompressMessage( msg, upstream->netchan.compression );
 	if( zerror < 0 ) {  // it's compression error, just send uncompressed
 	Com_DPrintf( "TV_Upstream_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
 	}
@@ -192,7 +188,7 @@ static bool TV_Upstream_ProcessPacket( netchan_t *netchan, msg_t *msg )
 	/*sequence_ack = */MSG_ReadLong( msg );
 	if( msg->compressed )
 	{
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( msg, netchan->compression );
 		if( zerror < 0 )
 		{          // compression error. Drop the packet
 			Com_Printf( "Compression error %i. Dropping packet\n", zerror );
@@ -433,8 +429,8 @@ static void TV_Upstream_FreePackets( upstream_t *upstream )
 */
 static void TV_Upstream_ReadDemoMessage( upstream_t *upstream, int timeBias )
 {
-	static uint8_t msgbuf[MAX_MSGLEN];
-	static msg_t demomsg;
+	static ATTRIBUTE_THREADLOCAL uint8_t msgbuf[MAX_MSGLEN];
+	static ATTRIBUTE_THREADLOCAL msg_t demomsg;
 	bool init = true;
 	int read;
 
@@ -586,10 +582,17 @@ static void TV_Upstream_ReadPackets( upstream_t *upstream )
 */
 void TV_Upstream_SendConnectPacket( upstream_t *upstream )
 {
+	char userinfo[MAX_INFO_STRING];
+
 	upstream->userinfo_modified = false;
 
+	// tell the server which compression methods and snapshot encodings we can decode
+	Q_strncpyz( userinfo, TV_Upstream_Userinfo( upstream ), sizeof( userinfo ) );
+	Info_SetValueForKey( userinfo, NETCHAN_COMPRESSION_KEY, va( "%i", Netchan_CompressionMethods() ) );
+	Info_SetValueForKey( userinfo, SNAP_ENCODING_KEY, va( "%i", SNAP_ENCODING_BITPACKED ) );
+
 	Netchan_OutOfBandPrint( upstream->socket, &upstream->serveraddress, "connect %i %i %i \"%s\" %i\n",
-		APP_PROTOCOL_VERSION, Netchan_GamePort(), upstream->challenge, TV_Upstream_Userinfo( upstream ), 1 );
+		APP_PROTOCOL_VERSION, Netchan_GamePort(), upstream->challenge, userinfo, 1 );
 }
 
 /*
@@ -609,7 +612,7 @@ void TV_Upstream_Error( upstream_t *upstream, const char *format, ... )
 	va_end( argptr );
 
 	TV_Upstream_Disconnect( upstream, "%s", msg );
-	longjmp( upstream_abortframe, -1 );
+	longjmp( upstream->abortframe, -1 );
 }
 
 /*
@@ -629,6 +632,9 @@ void TV_Upstream_Disconnect( upstream_t *upstream, const char *format, ... )
 
 	Com_Printf( "%s" S_COLOR_WHITE ": Disconnected: %s\n", upstream->name, msg );
 
+	// the socket poll is shared with other upstreams
+	TV_RelayThreads_Lock();
+
 	if( upstream->state > CA_CONNECTING )
 	{
 		int i;
@@ -640,7 +646,10 @@ void TV_Upstream_Disconnect( upstream_t *upstream, const char *format, ... )
 	}
 
 	if( upstream->individual_socket )
+	{
+		NET_PollRemoveSocket( tvs.netpoll, upstream->socket );
 		NET_CloseSocket( upstream->socket );
+	}
 
 	if( upstream->demo.recording )
 		TV_Upstream_StopDemoRecord( upstream, false, false );
@@ -649,6 +658,8 @@ void TV_Upstream_Disconnect( upstream_t *upstream, const char *format, ... )
 		TV_Upstream_StopDemo( upstream );
 
 	upstream->state = CA_DISCONNECTED;
+
+	TV_RelayThreads_Unlock();
 }
 
 /*
@@ -669,6 +680,8 @@ void TV_Upstream_Shutdown( upstream_t *upstream, const char *format, ... )
 	Q_vsnprintfz( msg, sizeof( msg ), format, argptr );
 	va_end( argptr );
 
+	TV_RelayThreads_Lock();
+
 	if( upstream->relay.state != CA_UNINITIALIZED )
 		TV_Relay_Shutdown( &upstream->relay, "Upstream shutting down" );
 
@@ -723,6 +736,8 @@ void TV_Upstream_Shutdown( upstream_t *upstream, const char *format, ... )
 	Mem_Free( upstream );
 
 	Mem_FreePool( &mempool );
+
+	TV_RelayThreads_Unlock();
 }
 
 
@@ -798,7 +813,7 @@ void TV_Upstream_UpdateReliableCommandsToServer( upstream_t *upstream, msg_t *ms
 */
 void TV_Upstream_Run( upstream_t *upstream, int msec )
 {
-	if( setjmp( upstream_abortframe ) )  // disconnect while running
+	if( setjmp( upstream->abortframe ) )  // disconnect while running
 		return;
 
 	if( upstream->state > CA_DISCONNECTED )
@@ -957,6 +972,9 @@ void TV_Upstream_Connect( upstream_t *upstream, const char *servername, const ch
 		assert( false );
 	}
 
+	if( !NET_PollAddSocket( tvs.netpoll, upstream->socket, NULL, NULL, NULL ) )
+		Com_DPrintf( "%s" S_COLOR_WHITE ": Socket not monitored: %s\n", upstream->name, NET_ErrorString() );
+
 	upstream->serveraddress = *address;
 	if( NET_GetAddressPort( &upstream->serveraddress ) == 0 )
 		NET_SetAddressPort( &upstream->serveraddress, PORT_SERVER );
@@ -1017,7 +1035,10 @@ void TV_Upstream_Reconnect_f( upstream_t *upstream )
 	}
 
 	if( upstream->individual_socket )
+	{
+		NET_PollRemoveSocket( tvs.netpoll, upstream->socket );
 		NET_CloseSocket( upstream->socket );
+	}
 
 	if( upstream->demo.recording )
 		TV_Upstream_StopDemoRecord( upstream, false, false );
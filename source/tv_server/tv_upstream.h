@@ -28,6 +28,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 struct upstream_s
 {
 	connstate_t state;
+	jmp_buf abortframe;             // for jumping over upstream handling when it's disconnected
 
 	packet_t *packetqueue;
 	packet_t *packetqueue_head;
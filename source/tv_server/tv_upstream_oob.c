@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_upstream_oob.h"
 
 #include "tv_upstream.h"
+#include "tv_main.h"
 
 typedef struct
 {
@@ -55,7 +56,10 @@ static void TV_Upstream_ClientConnectPacket( upstream_t *upstream, msg_t *msg )
 	if( upstream->state != CA_CONNECTING )
 		return;
 
+	MSG_ReadStringLine( msg ); // session
 	Netchan_Setup( &upstream->netchan, upstream->socket, &upstream->serveraddress, Netchan_GamePort() );
+	// servers that don't know about negotiated compression send no method
+	upstream->netchan.compression = atoi( MSG_ReadStringLine( msg ) );
 	upstream->state = CA_HANDSHAKE;
 	TV_Upstream_AddReliableCommand( upstream, "new" );
 
@@ -110,6 +114,10 @@ void TV_Upstream_ConnectionlessPacket( upstream_t *upstream, msg_t *msg )
 	MSG_ReadLong( msg );    // skip the -1 marker
 
 	s = MSG_ReadStringLine( msg );
+
+	// the command tokenizer is shared by all relays
+	TV_RelayThreads_Lock();
+
 	Cmd_TokenizeString( s );
 	c = Cmd_Argv( 0 );
 
@@ -118,9 +126,11 @@ void TV_Upstream_ConnectionlessPacket( upstream_t *upstream, msg_t *msg )
 		if( !strcmp( c, cmd->name ) )
 		{
 			cmd->func( upstream, msg );
+			TV_RelayThreads_Unlock();
 			return;
 		}
 	}
 
 	Com_DPrintf( "%s" S_COLOR_WHITE ": Bad upstream connectionless packet: %s\n", upstream->name, c );
+	TV_RelayThreads_Unlock();
 }
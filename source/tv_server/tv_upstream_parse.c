@@ -26,13 +26,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_upstream_svcmd.h"
 #include "tv_upstream_demos.h"
 #include "tv_downstream_clcmd.h"
+#include "tv_main.h"
 
 /*
 * TV_Upstream_ParseFrame
 */
 static void TV_Upstream_ParseFrame( upstream_t *upstream, msg_t *msg )
 {
-	static snapshot_t snap;
+	static ATTRIBUTE_THREADLOCAL snapshot_t snap;
 
 	SNAP_SkipFrame( msg, &snap );
 
@@ -187,11 +188,18 @@ void TV_Upstream_ParseServerMessage( upstream_t *upstream, msg_t *msg )
 		case svc_serverdata:
 			if( upstream->state == CA_HANDSHAKE )
 			{
-				Cbuf_Execute(); // make sure any stuffed commands are done
+				TV_RelayThreads_Lock();
+
+				// console commands could touch upstreams running in other threads,
+				// those are executed on the main thread before the next frame then
+				if( !TV_RelayThreads_Running() )
+					Cbuf_Execute(); // make sure any stuffed commands are done
 
 				FS_Rescan();	// FIXME?
 
 				TV_Upstream_ParseServerData( upstream, msg );
+
+				TV_RelayThreads_Unlock();
 			}
 			else
 			{
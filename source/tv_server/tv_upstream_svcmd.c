@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tv_upstream.h"
 #include "tv_upstream_svcmd.h"
 #include "tv_upstream_demos.h"
+#include "tv_main.h"
 
 /*
 * TV_Upstream_ParseConfigstringCommand_f
@@ -246,6 +247,10 @@ void TV_Upstream_ParseServerCommand( upstream_t *upstream, msg_t *msg )
 	svcmd_t *cmd;
 
 	text = MSG_ReadString( msg );
+
+	// the command tokenizer is shared by all relays
+	TV_RelayThreads_Lock();
+
 	Cmd_TokenizeString( text );
 	s = Cmd_Argv( 0 );
 
@@ -256,9 +261,11 @@ void TV_Upstream_ParseServerCommand( upstream_t *upstream, msg_t *msg )
 		{
 			if( cmd->func )
 				cmd->func( upstream );
+			TV_RelayThreads_Unlock();
 			return;
 		}
 	}
 
 	Com_Printf( "Unknown server command: %s\n", s );
+	TV_RelayThreads_Unlock();
 }
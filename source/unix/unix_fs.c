@@ -28,7 +28,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #ifdef __ANDROID__
 #include "../android/android_sys.h"
@@ -270,6 +272,44 @@ void Sys_FS_UnlockFile( void *handle )
 {
 }
 
+/*
+* Sys_FS_MMapFile
+* 
+* Maps the whole file for reading, the mapping outlives the descriptor
+*/
+void *Sys_FS_MMapFile( const char *path, size_t *size )
+{
+	int fd;
+	struct stat buffer;
+	void *mapping;
+
+	fd = open( path, O_RDONLY );
+	if( fd == -1 )
+		return NULL;
+
+	if( fstat( fd, &buffer ) || buffer.st_size <= 0 )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	mapping = mmap( NULL, buffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( mapping == MAP_FAILED )
+		return NULL;
+
+	*size = buffer.st_size;
+	return mapping;
+}
+
+/*
+* Sys_FS_UnMMapFile
+*/
+void Sys_FS_UnMMapFile( void *mapping, size_t size )
+{
+	munmap( mapping, size );
+}
+
 /*
 * Sys_FS_CreateDirectory
 */
@@ -328,6 +328,13 @@ int main( int argc, char **argv )
 			time = newtime - oldtime;
 			if( time > 0 )
 				break;
+			if( dedicated->integer )
+			{
+				// the server schedules its own sleeps, so this only happens when a packet
+				// woke it up mid-millisecond: wait for the next tick instead of spinning
+				usleep( 1000 - Sys_Microseconds() % 1000 );
+				continue;
+			}
 #ifdef PUTCPU2SLEEP
 			Sys_Sleep( 0 );
 #endif
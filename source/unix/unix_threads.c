@@ -23,6 +23,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
+#include <sys/time.h>
+#include <errno.h>
 
 struct qthread_s {
 	pthread_t t;
@@ -32,6 +34,10 @@ struct qmutex_s {
 	pthread_mutex_t m;
 };
 
+struct qcondvar_s {
+	pthread_cond_t c;
+};
+
 typedef struct {
 	void *(*routine)(void *);
 	void *param;
@@ -77,6 +83,14 @@ void Sys_Mutex_Lock( qmutex_t *mutex )
 	pthread_mutex_lock( &mutex->m );
 }
 
+/*
+* Sys_Mutex_TryLock
+*/
+bool Sys_Mutex_TryLock( qmutex_t *mutex )
+{
+	return pthread_mutex_trylock( &mutex->m ) == 0;
+}
+
 /*
 * Sys_Mutex_Unlock
 */
@@ -85,6 +99,69 @@ void Sys_Mutex_Unlock( qmutex_t *mutex )
 	pthread_mutex_unlock( &mutex->m );
 }
 
+/*
+* Sys_CondVar_Create
+*/
+int Sys_CondVar_Create( qcondvar_t **pcond )
+{
+	int res;
+	qcondvar_t *cond;
+	pthread_cond_t c;
+
+	res = pthread_cond_init( &c, NULL );
+	if( res != 0 ) {
+		return res;
+	}
+
+	cond = ( qcondvar_t * )Q_malloc( sizeof( *cond ) );
+	cond->c = c;
+	*pcond = cond;
+	return 0;
+}
+
+/*
+* Sys_CondVar_Destroy
+*/
+void Sys_CondVar_Destroy( qcondvar_t *cond )
+{
+	if( !cond ) {
+		return;
+	}
+	pthread_cond_destroy( &cond->c );
+	Q_free( cond );
+}
+
+/*
+* Sys_CondVar_Wait
+*/
+bool Sys_CondVar_Wait( qcondvar_t *cond, qmutex_t *mutex, unsigned int timeout_msec )
+{
+	struct timeval now;
+	struct timespec ts;
+
+	if( timeout_msec == Q_THREADS_WAIT_INFINITE ) {
+		return pthread_cond_wait( &cond->c, &mutex->m ) == 0;
+	}
+
+	gettimeofday( &now, NULL );
+	ts.tv_sec = now.tv_sec + timeout_msec / 1000;
+	ts.tv_nsec = now.tv_usec * 1000 + ( timeout_msec % 1000 ) * 1000000;
+	if( ts.tv_nsec >= 1000000000 ) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	return pthread_cond_timedwait( &cond->c, &mutex->m, &ts ) != ETIMEDOUT;
+}
+
+/*
+* Sys_CondVar_Wake
+*/
+void Sys_CondVar_Wake( qcondvar_t *cond )
+{
+	pthread_cond_broadcast( &cond->c );
+}
+
 #ifdef __ANDROID__
 /*
 * Sys_Thread_Android_CancelHandler
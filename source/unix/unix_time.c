@@ -1,12 +1,29 @@
 #include <sys/time.h>
+#include <time.h>
 #include "../qcommon/qcommon.h"
 
 /*
 * Sys_Microseconds
+*
+* Uses the monotonic clock where available so that wall clock
+* adjustments can't make frame times jump or go backwards
 */
 static unsigned long sys_secbase;
 uint64_t Sys_Microseconds( void )
 {
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	if( !sys_secbase )
+	{
+		sys_secbase = ts.tv_sec;
+		return ts.tv_nsec / 1000;
+	}
+
+	return (uint64_t)( ts.tv_sec - sys_secbase )*1000000 + ts.tv_nsec / 1000;
+#else
 	struct timeval tp;
 	struct timezone tzp;
 
@@ -20,6 +37,7 @@ uint64_t Sys_Microseconds( void )
 
 	// TODO handle the wrap
 	return (uint64_t)( tp.tv_sec - sys_secbase )*1000000 + tp.tv_usec;
+#endif
 }
 
 /*
@@ -244,6 +244,49 @@ void Sys_FS_UnlockFile( void *handle )
 	CloseHandle( (HANDLE)handle );
 }
 
+/*
+* Sys_FS_MMapFile
+* 
+* Maps the whole file for reading, the view outlives the handles
+*/
+void *Sys_FS_MMapFile( const char *path, size_t *size )
+{
+	HANDLE handle, mapping;
+	LARGE_INTEGER filesize;
+	void *data;
+
+	handle = CreateFile( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL );
+	if( handle == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	if( !GetFileSizeEx( handle, &filesize ) || filesize.QuadPart <= 0 || (ULONGLONG)filesize.QuadPart > (SIZE_T)-1 )
+	{
+		CloseHandle( handle );
+		return NULL;
+	}
+
+	mapping = CreateFileMapping( handle, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( handle );
+	if( !mapping )
+		return NULL;
+
+	data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if( !data )
+		return NULL;
+
+	*size = (size_t)filesize.QuadPart;
+	return data;
+}
+
+/*
+* Sys_FS_UnMMapFile
+*/
+void Sys_FS_UnMMapFile( void *mapping, size_t size )
+{
+	UnmapViewOfFile( mapping );
+}
+
 /*
 * Sys_FS_CreateDirectory
 */
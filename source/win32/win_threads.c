@@ -67,6 +67,14 @@ void Sys_Mutex_Lock( qmutex_t *mutex )
 	EnterCriticalSection( &mutex->h );
 }
 
+/*
+* Sys_Mutex_TryLock
+*/
+bool Sys_Mutex_TryLock( qmutex_t *mutex )
+{
+	return TryEnterCriticalSection( &mutex->h ) != 0;
+}
+
 /*
 * Sys_Mutex_Unlock
 */
@@ -74,6 +82,51 @@ void Sys_Mutex_Unlock( qmutex_t *mutex )
 {
 	LeaveCriticalSection( &mutex->h );
 }
+
+struct qcondvar_s {
+	CONDITION_VARIABLE c;
+};
+
+/*
+* Sys_CondVar_Create
+*/
+int Sys_CondVar_Create( qcondvar_t **pcond )
+{
+	qcondvar_t *cond;
+
+	cond = ( qcondvar_t * )Q_malloc( sizeof( *cond ) );
+	InitializeConditionVariable( &cond->c );
+
+	*pcond = cond;
+	return 0;
+}
+
+/*
+* Sys_CondVar_Destroy
+*/
+void Sys_CondVar_Destroy( qcondvar_t *cond )
+{
+	if( !cond ) {
+		return;
+	}
+	Q_free( cond );
+}
+
+/*
+* Sys_CondVar_Wait
+*/
+bool Sys_CondVar_Wait( qcondvar_t *cond, qmutex_t *mutex, unsigned int timeout_msec )
+{
+	return SleepConditionVariableCS( &cond->c, &mutex->h, timeout_msec ) != 0;
+}
+
+/*
+* Sys_CondVar_Wake
+*/
+void Sys_CondVar_Wake( qcondvar_t *cond )
+{
+	WakeAllConditionVariable( &cond->c );
+}
 #else
 struct qmutex_s {
 	HANDLE h;
@@ -117,6 +170,14 @@ void Sys_Mutex_Lock( qmutex_t *mutex )
 	WaitForSingleObject( mutex->h, INFINITE );
 }
 
+/*
+* Sys_Mutex_TryLock
+*/
+bool Sys_Mutex_TryLock( qmutex_t *mutex )
+{
+	return WaitForSingleObject( mutex->h, 0 ) == WAIT_OBJECT_0;
+}
+
 /*
 * Sys_Mutex_Unlock
 */
@@ -186,5 +247,5 @@ void Sys_Thread_Yield( void )
 */
 int Sys_Atomic_Add( volatile int *value, int add, qmutex_t *mutex )
 {
-	return InterlockedExchangeAdd( (volatile LONG*)value, add );
+	return InterlockedExchangeAdd( (volatile LONG*)value, add ) + add;
 }